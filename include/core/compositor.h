@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <core/thermalGrid.h>
+
+// Per-pixel reduction applied across days
+enum class CompositeMode {
+    Maximum,
+    Mean,
+    Median,     // Median of the most recent medianDepth valid observations
+    LatestValid
+};
+
+// Streaming composite of daily thermal grids. Each day is folded into running per-pixel state and can be
+// released straight away, so memory stays bounded by the grid size (times medianDepth for the median).
+class TemporalCompositor {
+public:
+    TemporalCompositor(CompositeMode mode, int width, int height, int medianDepth = 8);
+
+    // Fold one day into the composite, oldest first; days of a different size are ignored
+    void addDay(const ThermalGrid &day);
+
+    // Composite so far; pixels never observed stay invalid
+    ThermalGrid result() const;
+
+    int numDays() const;
+
+private:
+    CompositeMode mode;
+    int width;
+    int height;
+    int medianDepth;
+    int daysAdded = 0;
+    std::vector<float> state;           // Running max / sum / latest value, or medianDepth samples per pixel
+    std::vector<unsigned short> counts; // Valid observations folded in per pixel
+};
+
+// Stream daily thermal PNGs from disk one at a time, oldest first
+ThermalGrid compositeThermalImages(const std::vector<std::string> &fileNames, CompositeMode mode, int medianDepth = 8);
\ No newline at end of file
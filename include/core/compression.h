@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// LZ4-style block compression: greedy single-probe hash matching into literal runs and back references of up to
+// 64 KiB. Fast enough to run beside the simulation; the format is self-contained and not interchangeable with LZ4.
+// Output is appended to compressed.
+void compressBlock(const unsigned char *data, size_t size, std::vector<unsigned char> &compressed);
+
+// Decode exactly outSize bytes; false if the block is malformed or does not decode to outSize bytes
+bool decompressBlock(const unsigned char *data, size_t size, unsigned char *out, size_t outSize);
+
+// Group byte k of every element together (and back). Float fields compress far better shuffled, since the sign
+// and exponent bytes of neighbouring values are nearly always equal.
+void shuffleBytes(const unsigned char *in, size_t count, size_t elementSize, unsigned char *out);
+void unshuffleBytes(const unsigned char *in, size_t count, size_t elementSize, unsigned char *out);
+
+// 64-bit content hash for change detection, not for security
+uint64_t hashBytes(const void *data, size_t size);
@@ -1,9 +1,24 @@
 #pragma once
 
+#include <atomic>
+#include <string>
+#include <vector>
+
 #include <core/coordHandler.h>
+#include <core/interpolation.h>
+
+// Look the location up in the city table
+Coords locateCity(const std::string &location);
+
+// Load locale weather data. Setting cancel stops the transfers within a tenth of a second, discarding what was
+// received; returns false if it did.
+bool localeWeatherData(double apiLat, double apiLong, const std::atomic<bool> *cancel = nullptr);
 
-// Scan data sources for latest data
-Coords initializeData(std::string location);
+// Fetch the thermal layer for the last numDays days, returning the file names oldest first. Days already on disk
+// are not downloaded again.
+std::vector<std::string> thermalHistory(int numDays);
+// The same file names, without fetching anything
+std::vector<std::string> thermalHistoryFiles(int numDays);
 
-// Load locale weather data
-void localeWeatherData(double apiLat, double apiLong);
\ No newline at end of file
+// Parse one current-conditions variable (e.g. temperature_2m) out of the saved weather responses
+std::vector<WeatherSample> loadWeatherSamples(const std::string &fileName, const std::string &variable);
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <core/thermalGrid.h>
+#include <core/threadPool.h>
+
+// Tuning for the multigrid inpainting solver
+struct GapFillSettings {
+    int coarsestSize = 8;     // Stop coarsening once either dimension reaches this many pixels
+    int coarsestSweeps = 200; // Relaxation sweeps on the coarsest level
+    int sweepsPerLevel = 6;   // Red-black sweeps after prolongating to each finer level
+    float relaxation = 1.6f;  // Over-relaxation factor
+    int blockRows = 32;       // Rows per cache block handed to a worker
+};
+
+// Fill pixels without observations by harmonic (Laplace) inpainting solved on a multigrid pyramid.
+// When previousDay matches in size, its anomaly against today's observations is inpainted first so filled
+// regions keep yesterday's spatial structure. Every pixel is marked valid afterwards.
+void fillThermalGaps(ThermalGrid &grid, const ThermalGrid *previousDay = nullptr, const GapFillSettings &settings = GapFillSettings(),
+                     ThreadPool &pool = threadPool());
+
+// A 2048x1024 field with cloud holes over about two fifths of it: fill error against the hidden truth with and
+// without the previous day, against single-level relaxation, and the fill's wall time over thread counts and block sizes
+void benchmarkGapFill();
\ No newline at end of file
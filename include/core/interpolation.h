@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include <core/coordHandler.h>
+#include <core/thermalGrid.h>
+
+// One scattered observation, such as a weather API response
+struct WeatherSample {
+    Coords coords;
+    float value;
+};
+
+// Scattered-to-grid interpolation schemes
+enum class InterpolationMethod {
+    InverseDistance,  // Weighted by inverse great-circle distance over the k nearest samples
+    NaturalNeighbour, // Laplace natural neighbour weights over a spherical Delaunay triangulation
+    OrdinaryKriging   // Local ordinary kriging over the k nearest samples with a fitted exponential variogram
+};
+
+struct InterpolationSettings {
+    InterpolationMethod method = InterpolationMethod::InverseDistance;
+    int neighbours = 8; // k for the k-nearest methods
+    float power = 2.0f; // Inverse distance exponent
+};
+
+// Dense equirectangular grid from scattered samples, row 0 at the north edge. Values keep the samples'
+// units; every cell is valid unless there are no samples.
+ThermalGrid interpolateSamples(const std::vector<WeatherSample> &samples, int width, int height, const InterpolationSettings &settings = InterpolationSettings());
+
+// Time every method against a smooth analytic field for 1k to 100k random samples
+void benchmarkInterpolation();
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include <core/threadPool.h>
+
+// Sums whose bits depend only on the inputs, never on the thread count. Every sum here is one fixed tree: items are
+// grouped into leaves of a fixed size and added in order within a leaf, then leaves are combined pairwise, the left
+// half always taking the largest power of two of leaves below the total. Threads only decide who evaluates which
+// leaf, so an 8-core and a 64-core run print the same diagnostics, and a parallel reduction matches pairwiseSum over
+// the same values.
+
+// Leaf size for sums over cells or values. Part of the definition of the result, not a tuning knob.
+constexpr int reductionLeaf = 32;
+
+// Pairwise sum of count values spaced stride apart, accumulated in double
+double pairwiseSum(const double *values, size_t count, size_t stride = 1);
+double pairwiseSum(const float *values, size_t count, size_t stride = 1);
+
+// Combine partials[0, count) in place with the same tree as pairwiseSum; the total ends up in partials[0]
+template <typename Partial, typename Add>
+void combinePairwise(Partial *partials, size_t count, const Add &add) {
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t i = 0; i + width < count; i += 2 * width) add(partials[i], partials[i + width]);
+    }
+}
+
+// N sums at once over items [begin, end): term(item) returns the item's N terms. Leaves of leafSize items are
+// spread over the pool. Use a leaf size of 1 when each item is already a deterministic partial, such as a row
+// summed with pairwiseSum.
+template <int N, typename Term>
+std::array<double, N> reduceSums(int begin, int end, int leafSize, const Term &term, ThreadPool &pool = threadPool()) {
+    std::array<double, N> total{};
+    if (end <= begin) return total;
+    const int leaves = (end - begin + leafSize - 1) / leafSize;
+    std::vector<std::array<double, N>> partials(leaves);
+    pool.parallelFor(0, leaves, [&](int leafBegin, int leafEnd) {
+        for (int leaf = leafBegin; leaf < leafEnd; ++leaf) {
+            std::array<double, N> sum{};
+            const int first = begin + leaf * leafSize, last = std::min(first + leafSize, end);
+            for (int item = first; item < last; ++item) {
+                const std::array<double, N> value = term(item);
+                for (int k = 0; k < N; ++k) sum[k] += value[k];
+            }
+            partials[leaf] = sum;
+        }
+    });
+    combinePairwise(partials.data(), partials.size(), [](std::array<double, N> &into, const std::array<double, N> &from) {
+        for (int k = 0; k < N; ++k) into[k] += from[k];
+    });
+    return partials[0];
+}
+
+template <typename Term>
+double reduceSum(int begin, int end, int leafSize, const Term &term, ThreadPool &pool = threadPool()) {
+    return reduceSums<1>(begin, end, leafSize, [&](int item) { return std::array<double, 1>{(double)term(item)}; }, pool)[0];
+}
+
+// Naive parallel sums against the deterministic ones at 1 to 8 threads: time and whether the bits agree
+void benchmarkReduction();
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <core/coordHandler.h>
+#include <core/thermalGrid.h>
+
+// Map projections the equirectangular (EPSG:4326) layers can be resampled into
+enum class Projection {
+    Equirectangular,
+    Orthographic,            // Hemisphere centred on a point such as the selected city
+    NorthPolarStereographic, // Northern hemisphere, equator on the inscribed circle
+    SouthPolarStereographic, // Southern hemisphere, equator on the inscribed circle
+    WebMercator              // EPSG:3857 square, clipped at +/-85.05 degrees
+};
+
+// Precomputed bilinear taps for every output pixel, stored as structure of arrays so the
+// apply loop only gathers & blends. Taps index into a row-major equirectangular source.
+struct RemapTable {
+    Projection projection;
+    int width;
+    int height;
+    int srcWidth;
+    int srcHeight;
+    Coords centre;
+    std::vector<unsigned char> inside;           // 0 where the pixel falls off the projected globe
+    std::vector<int> tap00, tap01, tap10, tap11; // Source texel indices (row, column offsets)
+    std::vector<unsigned short> weight00, weight01, weight10, weight11; // 8-bit fixed point, summing to 256
+};
+
+// Latitude / longitude seen by an output pixel, returning false outside the projection's domain
+bool inverseProject(Projection projection, Coords centre, double x, double y, Coords &coords);
+
+// Remap tables kept by remapTable; the least recently used is dropped beyond this
+constexpr size_t remapCacheCapacity = 4;
+
+// Cached remap table for a projection / output size / source size; built on first use and reused afterwards
+std::shared_ptr<const RemapTable> remapTable(Projection projection, int width, int height, int srcWidth, int srcHeight, Coords centre = Coords{0.0, 0.0});
+
+// Resample an RGBA8 equirectangular image; pixels outside the globe are transparent
+void reprojectImage(const RemapTable &table, const unsigned char *srcPixels, unsigned char *dstPixels);
+
+// Resample a decoded temperature grid, keeping only taps that hold observations
+ThermalGrid reprojectGrid(const RemapTable &table, const ThermalGrid &source);
+
+// Every projection at 1024x1024 from a synthetic 2048x1024 image: round trip of the inverse projection, the table
+// apply against a scalar trig + bilinear reference, and the cost of a view switch with and without the cache
+void benchmarkReprojection();
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+#include <core/coordHandler.h>
+#include <glm/glm.hpp>
+
+// Unit vector of a latitude / longitude pair, x towards (0, 0), z towards the north pole
+glm::dvec3 coordsToUnitVector(Coords coords);
+
+// Balanced k-d tree over points on the unit sphere. Chord length orders neighbours the same way
+// as great-circle distance, so queries work on 3D unit vectors without any trigonometry.
+class SphericalKdTree {
+public:
+    explicit SphericalKdTree(const std::vector<Coords> &coords);
+
+    // The k nearest points to coords, nearest first, as input indices and squared chord lengths
+    void nearest(Coords coords, int k, std::vector<int> &indices, std::vector<double> &chordsSquared) const;
+    void nearest(const glm::dvec3 &query, int k, std::vector<int> &indices, std::vector<double> &chordsSquared) const;
+
+    size_t size() const;
+
+private:
+    struct Node {
+        glm::dvec3 pos;
+        int index;
+        int axis;
+    };
+
+    void build(int begin, int end);
+    void search(int begin, int end, const glm::dvec3 &query, int k, std::vector<std::pair<double, int>> &heap) const;
+
+    std::vector<Node> nodes; // Implicit tree: each range's median is its root
+};
\ No newline at end of file
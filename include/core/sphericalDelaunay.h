@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Delaunay triangulation of points on the unit sphere, built by incremental Bowyer-Watson insertion
+// (equivalently, the convex hull of the points). The six octahedron vertices are inserted first as
+// auxiliary vertices so the hull always encloses the origin, even when the samples cover a small cap.
+class SphericalDelaunay {
+public:
+    explicit SphericalDelaunay(const std::vector<glm::dvec3> &points);
+
+    // Index of the first auxiliary vertex; input points keep their indices below it
+    int auxiliaryBegin() const;
+    int numVertices() const;
+
+    // Laplace (non-Sibsonian) natural neighbour weights of a query point: each natural neighbour is
+    // weighted by the Voronoi edge it would share with the query over its distance to the query.
+    // Weights are normalised; hint carries the last visited triangle between nearby queries.
+    void naturalNeighbours(const glm::dvec3 &query, std::vector<int> &neighbours, std::vector<double> &weights, int &hint) const;
+
+private:
+    // Counter-clockwise seen from outside; adjacent[i] lies across the edge opposite corner[i]
+    struct Triangle {
+        int corner[3];
+        int adjacent[3];
+    };
+
+    bool inCircumcircle(const Triangle &triangle, const glm::dvec3 &point) const;
+    int locate(const glm::dvec3 &point, int start) const;
+    void insert(int vertex);
+    // Triangles whose circumcircle contains point, grown from the triangle holding it
+    void cavity(const glm::dvec3 &point, int start, std::vector<int> &found) const;
+
+    std::vector<glm::dvec3> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<int> freeTriangles;
+    int numPoints;
+    int lastTriangle = 0;
+};
\ No newline at end of file
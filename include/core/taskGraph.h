@@ -0,0 +1,113 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <core/threadPool.h>
+
+// Where a task may run. OpenGL calls must stay on the thread that owns the context, which is the thread that
+// calls TaskGraph::run.
+enum class TaskAffinity {
+    Any,
+    MainThread
+};
+
+// When and where one task ran, relative to the start of its graph's run
+struct TaskTiming {
+    std::string name;
+    double start = 0.0;
+    double seconds = 0.0;
+    int worker = 0; // 0 is the thread that called run
+};
+
+class TaskScheduler;
+
+// Tasks joined by dependency edges, run once each in an order that respects every edge. Independent tasks
+// overlap across the scheduler's workers; among ready tasks the highest priority goes first.
+class TaskGraph {
+public:
+    using TaskId = int;
+
+    TaskId add(const std::string &name, std::function<void()> work, const std::vector<TaskId> &after = {}, int priority = 0,
+               TaskAffinity affinity = TaskAffinity::Any);
+    // task may not start until prerequisite has finished
+    void precede(TaskId prerequisite, TaskId task);
+
+    int size() const { return (int)tasks.size(); }
+
+    // Run every task and return once all have finished. A graph with a cycle runs nothing and returns false.
+    bool run(TaskScheduler &scheduler);
+    bool run();
+
+    // Timings of the latest run, in task order
+    const std::vector<TaskTiming> &timings() const { return taskTimings; }
+    double wallSeconds() const { return runSeconds; }
+    // Longest chain of dependent tasks in the latest run: no schedule can finish sooner
+    double criticalPathSeconds() const;
+    void printTimings(std::ostream &out) const;
+
+private:
+    friend class TaskScheduler;
+
+    struct Task {
+        std::string name;
+        std::function<void()> work;
+        std::vector<TaskId> successors;
+        int predecessors = 0;
+        int priority = 0;
+        TaskAffinity affinity = TaskAffinity::Any;
+    };
+
+    std::vector<Task> tasks;
+    std::vector<TaskTiming> taskTimings;
+    double runSeconds = 0.0;
+};
+
+// Runs task graphs by work stealing on the threads of a ThreadPool, so graphs and parallelFor share one set of
+// workers. Each thread keeps its own list of ready tasks and takes from it first; a task's successors become ready
+// on the thread that finished it, so a chain stays on one thread and in cache. Idle threads steal from the others.
+// Main-thread tasks wait in a separate list that only the caller of run takes from.
+class TaskScheduler {
+public:
+    explicit TaskScheduler(ThreadPool &pool = threadPool());
+
+    // Threads that run tasks, including the caller of TaskGraph::run
+    unsigned int size() const { return pool.size(); }
+
+private:
+    friend class TaskGraph;
+
+    struct Ready {
+        TaskGraph::TaskId task;
+        int priority;
+        long long order; // When it became ready: the owner takes the newest, thieves the oldest
+    };
+    struct ReadyList {
+        std::mutex mutex;
+        std::vector<Ready> tasks;
+    };
+    struct Run;
+
+    bool runOne(Run &run, int worker);
+    void finish(Run &run, TaskGraph::TaskId task, int worker);
+    void execute(TaskGraph &graph);
+
+    ThreadPool &pool;
+    std::vector<std::unique_ptr<ReadyList>> readyLists; // One per pool thread, the caller of run first
+    ReadyList mainThreadReady;
+    std::mutex mutex; // Guards generation, which wakes the caller of run
+    std::condition_variable wake;
+    unsigned long long generation = 0;
+    std::mutex runMutex; // One graph at a time
+};
+
+// Process-wide task scheduler on threadPool()
+TaskScheduler &taskScheduler();
+
+// Wall time of a wide synthetic graph run serially and by work stealing
+void benchmarkTaskGraph();
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+// Temperature range spanned by the GIBS MODIS land surface temperature colormap
+constexpr float thermalMinKelvin = 200.0f;
+constexpr float thermalMaxKelvin = 345.0f;
+
+// Decoded equirectangular temperature grid, row 0 at the north edge
+struct ThermalGrid {
+    int width = 0;
+    int height = 0;
+    std::vector<float> values;        // Kelvin
+    std::vector<unsigned char> valid; // 1 where the pixel holds an observation
+};
+
+// Invert the thermal colormap of an RGB(A) image into temperatures, masking transparent & black pixels
+ThermalGrid decodeThermalImage(const unsigned char *pixels, int width, int height, int channels);
+
+// Write the grid back through the thermal colormap; pixels without data become transparent black
+void encodeThermalImage(const ThermalGrid &grid, unsigned char *pixels, int channels);
\ No newline at end of file
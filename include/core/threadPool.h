@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads shared by the data processing and simulation stages, task graphs included
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int numThreads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    // Number of threads taking part in a parallelFor, including the caller
+    unsigned int size() const;
+
+    // Split [begin, end) into contiguous blocks of at least grain items and run body(blockBegin, blockEnd)
+    // across the workers and the calling thread, returning once every block has completed. Calls from several
+    // threads at once, such as tasks of one graph, share the workers; calls from inside a block run inline.
+    void parallelFor(int begin, int end, const std::function<void(int, int)> &body, int grain = 1);
+
+    // While set, workers with no parallelFor blocks to run call helper(worker), workers numbered from 1, until it
+    // returns false: how a task graph runs on these threads. wakeHelpers tells them it may have work again.
+    // Clearing it returns once no worker is still inside it. One helper at a time.
+    void setHelper(std::function<bool(int)> helper);
+    void wakeHelpers();
+
+private:
+    struct Job;
+    void workerLoop(int worker);
+    static void runBlocks(Job &job);
+    // Oldest job with blocks left to claim, dropping exhausted ones; called with mutex held
+    std::shared_ptr<Job> claimableJob();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex; // Guards the fields below
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::condition_variable helperIdle;
+    std::vector<std::shared_ptr<Job>> jobs;
+    std::function<bool(int)> helper;
+    int activeHelpers = 0;
+    unsigned long long generation = 0;
+    bool stopping = false;
+};
+
+// Process-wide pool sized to the hardware concurrency
+ThreadPool &threadPool();
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include <core/coordHandler.h>
+#include <core/thermalGrid.h>
+#include <core/threadPool.h>
+
+// Region ID for every pixel of an equirectangular grid, row 0 at the north edge; 0 is outside every region
+struct LabelGrid {
+    int width = 0;
+    int height = 0;
+    unsigned int numLabels = 1; // One past the largest ID written so far
+    std::vector<unsigned int> labels;
+};
+
+// Region outline in degrees, closed implicitly. Longitudes may run past +/-180 to cross the antimeridian.
+struct RegionPolygon {
+    unsigned int id;
+    std::vector<Coords> vertices;
+};
+
+// Per-region aggregates, weighted by pixel area
+struct ZonalStats {
+    size_t count = 0;                // Observed pixels in the region
+    double area = 0.0;               // Fraction of the globe's surface covered by those pixels
+    float mean = 0.0f;
+    float min = 0.0f;
+    float max = 0.0f;
+    std::vector<float> percentiles;  // In the order requested
+};
+
+// Empty label grid matching a raster layer
+LabelGrid makeLabelGrid(int width, int height);
+
+// Burn polygons into the grid with an even-odd scanline fill; later polygons overwrite earlier ones
+void rasterizePolygons(LabelGrid &grid, const std::vector<RegionPolygon> &polygons);
+
+// Label great-circle distance rings around a point: ring k covers [k, k + 1) * ringWidthKm and gets ID firstId + k
+void rasterizeRings(LabelGrid &grid, Coords centre, double ringWidthKm, int numRings, unsigned int firstId);
+
+// Aggregate every region in one parallel pass over the grid. Percentiles are fractions in [0, 1],
+// resolved from per-region histograms to a small fraction of a Kelvin.
+std::vector<ZonalStats> computeZonalStats(const ThermalGrid &grid, const LabelGrid &labels, const std::vector<float> &percentiles = {0.5f},
+                                          ThreadPool &pool = threadPool());
+
+// A few thousand polygons and rings on a full-resolution 2048x1024 grid: rasterisation time, agreement with a
+// serial per-region pass, and the aggregation's wall time over several thread counts
+void benchmarkZonalStats();
@@ -3,8 +3,34 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <vector>
+
 #include <core/coordHandler.h>
+#include <core/thermalGrid.h>
+#include <simulation/packedField.h>
 
 // Render Earth & associated objects
 void renderSimulation(unsigned int shaderProgram, Coords cityCoords, bool thermalView);
-void initializeObjects(Coords cityCoords);
\ No newline at end of file
+// Decoded mesh and textures, ready to upload
+struct RenderAssets {
+    std::vector<float> planetVertices;
+    std::vector<unsigned int> planetIndices;
+    std::vector<unsigned char> thermalPixels; // RGBA, city marker drawn in
+    int thermalWidth = 0, thermalHeight = 0;
+    std::vector<unsigned char> physicalPixels; // RGB
+    int physicalWidth = 0, physicalHeight = 0;
+};
+// CPU half of initializeObjects: builds the mesh and decodes, gap fills & marks the textures. Makes no GL calls,
+// so it can run off the thread that owns the context. Adds the marked pixels to apiCoords.
+// thermalComposite, when given, replaces the single day's thermal image. loadThermal false leaves the thermal
+// texture empty for callers that upload a field of their own; apiCoords is filled either way.
+RenderAssets prepareRenderAssets(Coords cityCoords, const ThermalGrid *thermalComposite = nullptr, bool loadThermal = true);
+// GL half: creates the buffers & textures and uploads assets. Must run on the context's thread.
+void initializeObjects(const RenderAssets &assets);
+// Show a simulated field of any size in place of the thermal texture. It goes up as an R16F texture straight from
+// its float16 rows; the shader applies the thermal colormap and draws the city marker. Must run on the context's
+// thread, after initializeObjects.
+void uploadFieldFrame(const PackedField<Float16Storage> &field);
+// Upload a float16 field as a single-channel R16F texture straight from its padded rows, with no conversion pass.
+// Texels hold value - field.storage.offset. Pass texture 0 to create one; returns the texture name.
+unsigned int uploadHalfFieldTexture(const PackedField<Float16Storage> &field, unsigned int texture = 0);
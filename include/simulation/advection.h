@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include <core/interpolation.h>
+#include <simulation/simulationState.h>
+
+// Horizontal wind on a lat/lon grid, m/s
+struct WindField {
+    Field eastward;
+    Field northward;
+};
+
+// Departure point of every grid cell for one timestep, as fractional (row, col) cell coordinates.
+// Tracing once and reusing the result is the expensive half of the scheme while the wind is unchanged.
+struct Trajectories {
+    double dt = 0.0;
+    std::vector<float> rows;
+    std::vector<float> cols;
+};
+
+enum class AdvectionInterpolation {
+    Bilinear,
+    Cubic // 4x4 Lagrange, clipped to the surrounding 2x2 values so no new extrema appear
+};
+
+// Wind components from scattered speed (km/h) and meteorological direction (degrees the wind blows from) samples.
+// The samples only describe the region they cover, so the wind is full strength over their latitude / longitude box
+// and fades linearly to calm a few degrees beyond it, rather than being extrapolated over the globe and the poles.
+// Components are interpolated by inverse distance, with exponent power, over the nearest neighbours samples.
+WindField windFromSamples(const LatLonGrid &grid, const std::vector<WeatherSample> &speed, const std::vector<WeatherSample> &direction,
+                          int neighbours = 8, float power = 2.0f);
+
+// Longest dt that keeps the wind within courant cells per step; semi-Lagrangian steps stay stable past it,
+// so this bounds trajectory accuracy rather than stability
+double courantTimestep(const LatLonGrid &grid, const WindField &wind, double courant);
+
+// Trace each cell centre back along its great circle by dt seconds, with the wind taken at the trajectory midpoint
+Trajectories traceDepartures(const LatLonGrid &grid, const WindField &wind, double dt);
+
+// destination = source sampled at the departure points; unconditionally stable, so dt is limited by accuracy alone
+void advectSemiLagrangian(const LatLonGrid &grid, const Trajectories &trajectories, const Field &source, Field &destination,
+                          AdvectionInterpolation interpolation = AdvectionInterpolation::Cubic);
+
+// Advect the state's temperature in place; the model clock is left to the caller
+void advectTemperature(SimulationState &state, const Trajectories &trajectories, AdvectionInterpolation interpolation = AdvectionInterpolation::Cubic);
+
+// Solid-body rotation of a cosine bell over the poles: error after one revolution and cells/s at long timesteps
+void benchmarkAdvection();
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <simulation/simulationState.h>
+
+struct CheckpointSettings {
+    int chunkRows = 16;      // Rows per independently compressed chunk
+    bool incremental = true; // Reference unchanged chunks in earlier checkpoints instead of writing them again
+    int fullEvery = 8;       // Write every chunk at least this often, bounding how many files a restart must open
+};
+
+// One written checkpoint
+struct CheckpointStats {
+    long long sequence = -1; // -1 if the checkpoint could not be written
+    double stallSeconds = 0.0; // Time save() held up the caller
+    double writeSeconds = 0.0; // Background compression and I/O
+    size_t rawBytes = 0;
+    size_t writtenBytes = 0;
+    int chunksWritten = 0;
+    int chunksReused = 0;
+};
+
+// Writes numbered checkpoints of a SimulationState into a directory from a background thread. save() only copies
+// the temperature into a snapshot buffer; shuffling, compression and the file write overlap with further stepping.
+// Each file is written under a temporary name and renamed, so a crash never leaves a torn checkpoint behind.
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(const std::string &directory, const CheckpointSettings &settings = CheckpointSettings());
+    ~CheckpointWriter();
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    // Snapshot the state and queue it. Waits only if an earlier checkpoint is still queued behind the one being written.
+    void save(const SimulationState &state);
+
+    // Block until every queued checkpoint is on disk
+    void flush();
+
+    // Stats of the checkpoints completed since the last call, oldest first
+    std::vector<CheckpointStats> takeStats();
+
+private:
+    struct Snapshot {
+        int nLat = 0;
+        int nLon = 0;
+        double resolution = 0.0;
+        double time = 0.0;
+        long long step = 0;
+        std::vector<float> values;
+    };
+
+    void writerLoop();
+    void write(const Snapshot &snapshot, CheckpointStats &stats);
+
+    std::string directory;
+    CheckpointSettings settings;
+    long long nextSequence = 0;
+    int savesSinceFull = 0;
+    // Where each chunk's current contents are stored, for incremental checkpoints
+    struct ChunkRecord {
+        uint64_t hash = 0;
+        long long sequence = -1;
+        uint64_t offset = 0;
+        uint64_t storedBytes = 0;
+        uint32_t flags = 0;
+    };
+    std::vector<ChunkRecord> chunks;
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    Snapshot pending;
+    bool hasPending = false;
+    bool writing = false;
+    bool stopping = false;
+    std::vector<CheckpointStats> completed;
+    double pendingStall = 0.0;
+};
+
+// File name of a checkpoint in a directory
+std::string checkpointPath(const std::string &directory, long long sequence);
+
+// Path of the highest-numbered checkpoint in the directory, or empty if there is none
+std::string latestCheckpoint(const std::string &directory);
+
+// Memory-map a checkpoint (and the earlier ones its unchanged chunks live in) and restore the state it holds,
+// grid and model clock included, so stepping resumes bit for bit. False if any file is missing or corrupt.
+bool loadCheckpoint(const std::string &path, SimulationState &state);
+
+// Stall per save against step time, compression ratio, incremental savings and restart time at 0.25 degrees
+void benchmarkCheckpoint();
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <memory>
+
+#include <simulation/energyBalance.h>
+#include <simulation/scheduler.h>
+
+// Columns advanced together by the radiation kernel: one AVX-512 register or two AVX registers of floats.
+// Field rows are padded to this many columns, so every block loads whole vectors.
+constexpr int columnBlock = 16;
+// The kernel reads and writes whole blocks, the last one running into the row padding
+static_assert(columnBlock == fieldRowMultiple, "column blocks must match the Field row padding");
+
+// Scheduler name of the column radiation component, distinct from the energy-balance "radiation"
+constexpr const char *columnRadiationName = "columnRadiation";
+
+// Layer counts the kernel is compiled for; each gets its own fully unrolled specialisation
+constexpr int columnLayerCounts[] = {8, 16, 32, 64};
+
+// Gray two-stream radiative transfer through an atmosphere of equal-pressure layers above the surface.
+// Shortwave is absorbed on the way down and reflected by the surface albedo of EnergyBalanceParams; longwave is
+// emitted and absorbed by every layer with one gray emissivity, using the diffusivity approximation for angles.
+struct ColumnRadiationParams {
+    double shortwaveDepth = 0.2;        // Total vertical optical depth to sunlight
+    double longwaveDepth = 1.0;         // Total vertical optical depth to thermal infrared
+    double diffusivityFactor = 1.66;    // Effective path length of isotropic longwave over a vertical one
+    double surfacePressure = 1.0e5;     // Pa
+    double specificHeat = 1004.0;       // J kg^-1 K^-1, dry air at constant pressure
+    double gravity = 9.81;              // m s^-2
+};
+
+// Layer temperatures of every column, layer 0 at the top. Stored structure of arrays across the horizontal: row r
+// of layer k is temperature.row(r * layers + k), so one latitude row of every layer is contiguous and each layer
+// of a block of columns is a single aligned vector load.
+struct ColumnAtmosphere {
+    int layers = 0;
+    Field temperature;
+
+    float *layerRow(int row, int layer) { return temperature.row(row * layers + layer); }
+    const float *layerRow(int row, int layer) const { return temperature.row(row * layers + layer); }
+};
+
+// Atmosphere of the given layer count over the state's grid, cooling with height from the surface temperature
+// along a standard lapse rate. Fails, with a message, for a layer count the kernel is not compiled for.
+bool initializeColumnAtmosphere(ColumnAtmosphere &atmosphere, const SimulationState &state, int layers);
+
+// Advance the surface (state.temperature) and every layer by dt with forward Euler radiative heating. The surface
+// has the heat capacity of params; the model clock sets the insolation and is left alone.
+void applyColumnRadiation(SimulationState &state, ColumnAtmosphere &atmosphere, const EnergyBalanceParams &params,
+                          const ColumnRadiationParams &radiation, double dt);
+
+// Largest stable dt of applyColumnRadiation for temperatures up to 330 K
+double columnRadiationTimestep(const ColumnAtmosphere &atmosphere, const EnergyBalanceParams &params, const ColumnRadiationParams &radiation);
+
+// Column radiation as a scheduler component named columnRadiationName, in place of the energy-balance radiation.
+// Pair it with a diffusion component.
+void addColumnRadiationComponent(Scheduler &scheduler, std::shared_ptr<ColumnAtmosphere> atmosphere, const EnergyBalanceParams &params,
+                                 const ColumnRadiationParams &radiation = ColumnRadiationParams(), int interval = 1);
+
+// Columns per second of the blocked kernel against one column at a time, at 1 degree for every layer count
+void benchmarkColumnRadiation();
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <simulation/energyBalance.h>
+
+// Latitude band of whole rows owned by one worker; rows are periodic in longitude, so halos are only
+// ever the rows directly north and south of the band
+struct Patch {
+    int rank = 0;
+    int firstRow = 0;
+    int numRows = 0;
+};
+
+// Split nLat rows into numRanks bands whose sizes differ by at most one row, north first
+std::vector<Patch> decomposeRows(int nLat, int numRanks);
+
+// Ordered byte stream to and from the neighbouring ranks of one worker. send may return before the peer has
+// read the data, which is what lets halo exchange overlap with interior computation.
+class HaloEndpoint {
+public:
+    virtual ~HaloEndpoint() = default;
+    virtual bool send(int peer, const void *data, size_t bytes) = 0;
+    virtual bool receive(int peer, void *data, size_t bytes) = 0;
+};
+
+// Single-producer single-consumer ring buffers between neighbouring ranks, mapped shared before the workers are
+// forked so every process sees the same rings. Only available on POSIX systems.
+class SharedMemoryRings {
+public:
+    SharedMemoryRings(int numRanks, size_t ringBytes);
+    ~SharedMemoryRings();
+    SharedMemoryRings(const SharedMemoryRings &) = delete;
+    SharedMemoryRings &operator=(const SharedMemoryRings &) = delete;
+
+    bool valid() const { return memory != nullptr; }
+
+    // Endpoint for one rank, to be created in that rank's process
+    std::unique_ptr<HaloEndpoint> endpoint(int rank);
+
+    // Header of one ring; its ringBytes of data follow it in the mapping
+    struct Ring;
+
+private:
+    Ring *ring(int from, int to) const;
+
+    int numRanks;
+    size_t ringBytes;
+    size_t mappedBytes = 0;
+    void *memory = nullptr;
+};
+
+// TCP connections to the neighbouring ranks. Rank r listens on basePort + r and connects to rank r - 1 at
+// hosts[r - 1] (hosts[0] for every rank when only one host is given), so the same code runs on localhost or
+// across nodes. Returns nullptr if the connections cannot be made within timeoutSeconds.
+std::unique_ptr<HaloEndpoint> connectSocketEndpoint(int rank, int numRanks, const std::vector<std::string> &hosts, int basePort,
+                                                    double timeoutSeconds = 10.0);
+
+// Time one rank spent stepping its patch, and how much of it was spent waiting on halos
+struct PatchTimings {
+    double seconds = 0.0;
+    double haloSeconds = 0.0;
+    bool ok = true;
+};
+
+// Advance the rows of the state inside the patch by steps energy-balance steps of dt, exchanging halo rows with
+// the neighbouring ranks every step. Boundary rows are sent first, the interior is stepped while they are in
+// flight, and the two edge rows follow once the neighbours' rows arrive. Rows outside the patch are left as they
+// were; the model clock advances as for the whole grid.
+PatchTimings stepPatch(SimulationState &state, const EnergyBalanceParams &params, double dt, int steps, const Patch &patch,
+                       HaloEndpoint &endpoint);
+
+enum class HaloTransport {
+    SharedMemory,
+    Socket // TCP over localhost
+};
+
+struct DecomposedRunStats {
+    int ranks = 0;
+    double seconds = 0.0;     // Wall time from fork to the last worker exiting
+    double haloSeconds = 0.0; // Largest per-rank halo wait
+    bool ok = false;
+};
+
+// Run steps of the energy-balance model split across numRanks forked worker processes on this machine, then gather
+// the result back into state. Gives bitwise the same temperatures as stepping the whole grid in one process.
+DecomposedRunStats runDecomposed(SimulationState &state, const EnergyBalanceParams &params, double dt, int steps, int numRanks,
+                                 HaloTransport transport, int basePort = 47000);
+
+// Strong and weak scaling of both transports on localhost, checked against the single-process model
+void benchmarkDecomposition();
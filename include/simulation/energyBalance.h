@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+
+#include <simulation/simulationState.h>
+
+// Per-cell surface properties on the model grid, taking the place of the uniform heat capacity and warm albedo
+struct SurfaceProperties {
+    Field inverseHeatCapacity;    // 1 / C of each cell, m^2 K J^-1
+    Field warmAlbedo;             // Albedo of each cell above the ice ramp
+    double minHeatCapacity = 0.0; // Smallest C of any cell, which bounds the explicit timestep
+};
+
+// Parameters of the diffusive energy-balance model
+//   C dT/dt = Q (1 - albedo(T)) - (A + B (T - 273.15)) + D laplacian(T)
+// with Q the daily-mean insolation and the Laplacian taken on the unit sphere
+struct EnergyBalanceParams {
+    double heatCapacity = 2.1e8;    // J m^-2 K^-1, roughly a 50 m ocean mixed layer
+    double diffusivity = 0.55;      // W m^-2 K^-1
+    double solarConstant = 1361.0;  // W m^-2
+    double obliquity = 23.44;       // Degrees
+    double olrA = 203.3;            // W m^-2, outgoing longwave at 0 C
+    double olrB = 2.09;             // W m^-2 K^-1
+    double warmAlbedo = 0.30;
+    double iceAlbedo = 0.62;
+    double iceTemperature = 263.15; // Centre of the albedo ramp, K
+    double iceRampWidth = 10.0;     // Width of the albedo ramp, K
+    // Per-cell heat capacity and warm albedo, or null for heatCapacity and warmAlbedo everywhere. Shared, not copied,
+    // between copies of the parameters; must be on the grid the model is stepped on. The explicit lat/lon steppers
+    // below and the ensemble honour it; the implicit multigrid diffusion keeps the uniform heatCapacity.
+    std::shared_ptr<const SurfaceProperties> surface;
+};
+
+// Heat capacity bounding the explicit timestep: the smallest of the surface's cells, or heatCapacity without one
+inline double minHeatCapacity(const EnergyBalanceParams &params) { return params.surface ? params.surface->minHeatCapacity : params.heatCapacity; }
+
+// Daily-mean top-of-atmosphere insolation (W m^-2) at a latitude in radians, time in seconds since 1 January
+double dailyInsolation(const EnergyBalanceParams &params, double latitude, double time);
+
+// Diffusion coefficients of one row of the unit-sphere Laplacian, in W m^-2 K^-1
+struct RowDiffusion {
+    float north;
+    float south;
+    float zonal;
+};
+
+RowDiffusion rowDiffusion(const LatLonGrid &grid, const EnergyBalanceParams &params, int row);
+
+// Constants of the per-cell update on one row, each rounded to float once, for Lanes parameter sets side by side:
+// one lane for a single model, several for ensemble members stepped together
+template <int Lanes>
+struct EnergyBalanceConstants {
+    alignas(32) float north[Lanes];
+    alignas(32) float south[Lanes];
+    alignas(32) float zonal[Lanes];
+    alignas(32) float scale[Lanes];
+    alignas(32) float olrA[Lanes];
+    alignas(32) float olrB[Lanes];
+    alignas(32) float warmAlbedo[Lanes];
+    alignas(32) float iceAlbedo[Lanes];
+    alignas(32) float rampSlope[Lanes];
+    alignas(32) float rampTop[Lanes];
+    alignas(32) float insolation[Lanes];
+
+    void set(int lane, const LatLonGrid &grid, const EnergyBalanceParams &params, int row, double dt, float rowInsolation) {
+        const RowDiffusion diffusion = rowDiffusion(grid, params, row);
+        north[lane] = diffusion.north;
+        south[lane] = diffusion.south;
+        zonal[lane] = diffusion.zonal;
+        scale[lane] = (float)(dt / params.heatCapacity);
+        olrA[lane] = (float)params.olrA;
+        olrB[lane] = (float)params.olrB;
+        warmAlbedo[lane] = (float)params.warmAlbedo;
+        iceAlbedo[lane] = (float)params.iceAlbedo;
+        // Albedo ramps linearly from ice to warm across the ramp, written as a clamp so it vectorises
+        rampSlope[lane] = (float)((params.iceAlbedo - params.warmAlbedo) / params.iceRampWidth);
+        rampTop[lane] = (float)(params.iceTemperature + 0.5 * params.iceRampWidth);
+        insolation[lane] = rowInsolation;
+    }
+};
+
+// Absorbed sunlight less outgoing longwave at temperature t, W m^-2, for a cell of the given warm albedo
+template <int Lanes>
+inline float radiativeForcing(const EnergyBalanceConstants<Lanes> &c, int lane, float t, float warmAlbedo) {
+    float albedo = std::min(std::max(warmAlbedo + c.rampSlope[lane] * (c.rampTop[lane] - t), warmAlbedo), c.iceAlbedo[lane]);
+    return c.insolation[lane] * (1.0f - albedo) - (c.olrA[lane] + c.olrB[lane] * (t - 273.15f));
+}
+
+template <int Lanes>
+inline float radiativeForcing(const EnergyBalanceConstants<Lanes> &c, int lane, float t) { return radiativeForcing(c, lane, t, c.warmAlbedo[lane]); }
+
+// One forward Euler cell update of the full model, for a cell of the given warm albedo and dt / heat capacity:
+// every stepper of the lat/lon model, single or ensemble, goes through this, so they stay the same physics to the bit
+template <int Lanes>
+inline float energyBalanceCell(const EnergyBalanceConstants<Lanes> &c, int lane, float t, float north, float south, float west, float east,
+                               float warmAlbedo, float scale) {
+    float tendency = radiativeForcing(c, lane, t, warmAlbedo) + c.north[lane] * (north - t) + c.south[lane] * (south - t) + c.zonal[lane] * (west + east - 2.0f * t);
+    return t + scale * tendency;
+}
+
+// The update of a cell with the uniform heat capacity and warm albedo of the lane's parameters
+template <int Lanes>
+inline float energyBalanceCell(const EnergyBalanceConstants<Lanes> &c, int lane, float t, float north, float south, float west, float east) {
+    return energyBalanceCell(c, lane, t, north, south, west, east, c.warmAlbedo[lane], c.scale[lane]);
+}
+
+// Largest explicit timestep (seconds) that keeps the stencil update stable on this grid
+double stableTimestep(const SimulationState &state, const EnergyBalanceParams &params);
+
+// Advance the state by dt seconds with one forward Euler stencil sweep over the thread pool
+void stepEnergyBalance(SimulationState &state, const EnergyBalanceParams &params, double dt);
+
+// One row of stepEnergyBalance: out is centre advanced by dt, given the rows either side (the row itself at a pole).
+// Lets row-decomposed drivers reproduce the whole-grid step exactly. out must not overlap the input rows.
+void stepEnergyBalanceRow(const LatLonGrid &grid, const EnergyBalanceParams &params, int row, double time, double dt,
+                          const float *north, const float *centre, const float *south, float *out);
+
+// The two halves of stepEnergyBalance as separate operators, for schedulers that advance them at
+// different rates. Neither touches the model clock.
+//   applyRadiation: pointwise insolation, albedo and outgoing longwave terms
+//   applyDiffusion: explicit meridional and zonal heat transport
+void applyRadiation(SimulationState &state, const EnergyBalanceParams &params, double dt);
+void applyDiffusion(SimulationState &state, const EnergyBalanceParams &params, double dt);
+
+// One row of applyDiffusion, with the same neighbour convention as stepEnergyBalanceRow
+void applyDiffusionRow(const LatLonGrid &grid, const EnergyBalanceParams &params, int row, double dt,
+                       const float *north, const float *centre, const float *south, float *out);
+
+// Largest stable explicit timestep of applyDiffusion alone
+double diffusionTimestep(const SimulationState &state, const EnergyBalanceParams &params);
+
+// Area-weighted global mean temperature, K; the same bits at any thread count
+double globalMeanTemperature(const SimulationState &state);
+
+// Steps per second of the headless model at 1, 0.25 and 0.1 degrees
+void benchmarkEnergyBalance();
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <simulation/energyBalance.h>
+
+// Members stepped together by one vector instruction: eight float lanes fill an AVX register
+constexpr int ensembleLanes = 8;
+
+// Read-only inputs shared by every member of one or more ensembles. The solar constant and obliquity come from
+// params, so the insolation of each row is computed once per step for all members.
+struct EnsembleInputs {
+    LatLonGrid grid;
+    EnergyBalanceParams params;
+};
+
+// Many perturbed copies of the energy-balance model advanced in lockstep. Members are stored in blocks of
+// ensembleLanes, interleaved cell by cell, so the innermost loop runs across members with unit stride and each
+// member keeps its own parameters. Blocks and rows are spread over the thread pool. Every member steps bit for bit
+// like stepEnergyBalance on a SimulationState with that member's parameters.
+class Ensemble {
+public:
+    // Heat capacity, diffusivity, outgoing longwave and albedo parameters are taken per member; the solar
+    // constant and obliquity are those of the shared inputs. Every member starts from initial.
+    Ensemble(std::shared_ptr<const EnsembleInputs> inputs, const std::vector<EnergyBalanceParams> &memberParams, const SimulationState &initial);
+
+    int size() const { return members; }
+    const EnsembleInputs &inputs() const { return *shared; }
+
+    void setMemberTemperature(int member, const Field &temperature);
+    // Member as a standalone state, grid and model clock included
+    void extractMember(int member, SimulationState &state) const;
+
+    // Largest dt every member can take
+    double stableTimestep() const;
+    void step(double dt);
+
+    // Area-weighted global mean temperature of every member, K: bitwise globalMeanTemperature of the member alone
+    std::vector<double> memberMeans() const;
+
+    double time() const { return clock; }
+    long long stepCount() const { return steps; }
+
+private:
+    // Start of one block's row: nLon cells of ensembleLanes members each
+    size_t offset(int block, int row) const { return ((size_t)block * shared->grid.nLat + row) * shared->grid.nLon * ensembleLanes; }
+
+    std::shared_ptr<const EnsembleInputs> shared;
+    std::vector<EnergyBalanceParams> memberParams; // Padded to whole blocks by repeating the last member
+    int members = 0;
+    int blocks = 0;
+    AlignedVector<float> temperature;
+    AlignedVector<float> scratch;
+    std::vector<float> insolation; // Current row insolation, shared by all members
+    double clock = 0.0;
+    long long steps = 0;
+};
+
+// Members with heat capacity, diffusivity, outgoing longwave slope and ice albedo scaled by independent uniform
+// factors in [1 - spread, 1 + spread]; the first member keeps the base parameters. Members share the base's
+// surface, whose heat capacities stand in for the perturbed one.
+std::vector<EnergyBalanceParams> perturbParameters(const EnergyBalanceParams &base, int members, double spread, unsigned int seed);
+
+// Member-steps per second for 64 to 512 members against stepping the members one at a time
+void benchmarkEnsemble();
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Cache line (and AVX-512 register) alignment for simulation arrays
+constexpr size_t fieldAlignment = 64;
+// Rows are padded to a whole number of 16-float vectors so every row starts aligned
+constexpr int fieldRowMultiple = 16;
+
+// Standard allocator returning fieldAlignment-aligned storage
+template <typename T>
+struct AlignedAllocator {
+    using value_type = T;
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U> &) {}
+
+    T *allocate(size_t count) {
+        size_t bytes = (count * sizeof(T) + fieldAlignment - 1) / fieldAlignment * fieldAlignment;
+#ifdef _MSC_VER
+        void *ptr = _aligned_malloc(bytes, fieldAlignment);
+#else
+        void *ptr = std::aligned_alloc(fieldAlignment, bytes);
+#endif
+        if (!ptr) throw std::bad_alloc();
+        return (T *)ptr;
+    }
+
+    void deallocate(T *ptr, size_t) {
+#ifdef _MSC_VER
+        _aligned_free(ptr);
+#else
+        std::free(ptr);
+#endif
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U> &) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Row-major 2D field on the simulation grid, row 0 at the north edge, with padded aligned rows
+struct Field {
+    int rows = 0;
+    int cols = 0;
+    int stride = 0;
+    AlignedVector<float> data;
+
+    Field() = default;
+    Field(int rows, int cols, float value = 0.0f)
+        : rows(rows), cols(cols), stride((cols + fieldRowMultiple - 1) / fieldRowMultiple * fieldRowMultiple),
+          data((size_t)rows * stride, value) {}
+
+    float *row(int r) { return data.data() + (size_t)r * stride; }
+    const float *row(int r) const { return data.data() + (size_t)r * stride; }
+    float &at(int r, int c) { return data[(size_t)r * stride + c]; }
+    float at(int r, int c) const { return data[(size_t)r * stride + c]; }
+};
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Dimensions of a field store, outermost first
+enum StoreDimension {
+    StoreTime = 0,
+    StoreLat = 1,
+    StoreLon = 2,
+    StoreVariable = 3
+};
+constexpr int storeDimensions = 4;
+
+using StoreIndex = std::array<int, storeDimensions>;
+
+// Half-open box of store elements; values for it are laid out row-major, variable fastest
+struct StoreRegion {
+    StoreIndex begin{};
+    StoreIndex end{};
+
+    size_t size() const;
+};
+
+// Chunks touched by one read or write
+struct StoreStats {
+    int chunks = 0;
+    int missingChunks = 0; // Read as the fill value
+    size_t rawBytes = 0;
+    size_t storedBytes = 0;
+};
+
+// Chunked float array of time x lat x lon x variable in a directory, laid out like Zarr: a plain-text store.txt with
+// the shape, chunk shape and variable names, and one file per chunk, chunks/t.y.x.v. Each chunk is byte-shuffled and
+// block-compressed on its own, so any chunk can be written or read without touching the others. Time is unlimited
+// and grows as later steps are written.
+//
+// Writes take any region and compress its chunks over the thread pool. A chunk the region covers only in part, such
+// as the time chunk a single step is appended to, is read back, updated and rewritten; any number of threads may
+// write at once as long as no two share a chunk. Each chunk file is written under a temporary name and renamed into
+// place. Reads take any region and load only the chunks it intersects; elements never written read as NaN.
+class FieldStore {
+public:
+    FieldStore() = default;
+    FieldStore(const FieldStore &) = delete;
+    FieldStore &operator=(const FieldStore &) = delete;
+
+    // Fresh store in directory, replacing any store already there
+    bool create(const std::string &directory, int nLat, int nLon, const std::vector<std::string> &variables, const StoreIndex &chunkShape);
+    // Existing store, for reading or for writing further time steps
+    bool open(const std::string &directory);
+
+    const std::string &path() const { return directory; }
+    // Current extent: time steps written so far, then nLat, nLon and the variable count
+    StoreIndex shape() const;
+    const StoreIndex &chunks() const { return chunkShape; }
+    const std::vector<std::string> &variables() const { return variableNames; }
+    int variableIndex(const std::string &name) const;
+
+    // region must lie within the lat, lon and variable extents; time grows to its end
+    bool write(const StoreRegion &region, const float *values, StoreStats *stats = nullptr);
+    bool read(const StoreRegion &region, float *values, StoreStats *stats = nullptr) const;
+
+private:
+    std::string chunkPath(const StoreIndex &chunk) const;
+    bool saveMetadata(int timeSteps);
+    // Elements of a chunk, clipped at the array's edges; time chunks are always whole
+    StoreRegion chunkBox(const StoreIndex &chunk) const;
+    // The chunk's elements into raw, NaN where never written; false if its file is corrupt
+    bool loadChunk(const StoreIndex &chunk, std::vector<float> &raw, StoreStats &stats) const;
+    bool writeChunk(const StoreIndex &chunk, const StoreRegion &region, const float *values, StoreStats &stats);
+
+    std::string directory;
+    StoreIndex chunkShape{};
+    int nLat = 0;
+    int nLon = 0;
+    std::vector<std::string> variableNames;
+    std::atomic<int> timeSteps{0};
+    std::atomic<unsigned int> temporaryCounter{0};
+    std::mutex metadataMutex; // Serialises rewrites of store.txt
+};
+
+// Write and read throughput at 0.25 degrees, appending single steps into partial time chunks, the chunks a point time
+// series and a single map read, and a read-back check of every value written
+void benchmarkFieldStore();
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+
+#include <simulation/energyBalance.h>
+#include <simulation/simulationState.h>
+
+enum class Smoother {
+    RedBlackLine,  // Alternate rows solved exactly along the periodic zonal line; robust to the polar anisotropy
+    Chebyshev      // Chebyshev polynomial over line Jacobi; no colouring, every row in parallel every sweep
+};
+
+struct MultigridSettings {
+    Smoother smoother = Smoother::RedBlackLine;
+    int preSweeps = 2;
+    int postSweeps = 2;
+    int maxCycles = 40;
+    double tolerance = 1e-6; // Relative residual
+};
+
+struct SolveStats {
+    int cycles = 0;
+    double residual = 0.0; // Final residual relative to the right-hand side
+    double seconds = 0.0;
+};
+
+// Geometric multigrid V-cycle for the Helmholtz problem on a lat/lon grid
+//   shift * T - diffusivity * laplacian(T) = rhs
+// with the Laplacian taken on the unit sphere and discretised like the explicit energy-balance stencil.
+// Rows are halved while the row count stays even; the coarsest grid is solved exactly by a zonal
+// Fourier transform and one tridiagonal solve per wavenumber. A zero shift gives the Poisson problem,
+// solved for the zero-mean solution after the right-hand side's mean is removed.
+class SphericalMultigrid {
+public:
+    SphericalMultigrid(const LatLonGrid &grid, double diffusivity, double shift, const MultigridSettings &settings = MultigridSettings());
+
+    // Change the shift, e.g. for a new timestep, without rebuilding the hierarchy
+    void setShift(double shift);
+
+    // solution holds the initial guess on entry
+    SolveStats solve(const Field &rhs, Field &solution);
+
+    // Plain point Jacobi on the same problem, for comparison; stops at the tolerance or after maxIterations
+    SolveStats solveJacobi(const Field &rhs, Field &solution, int maxIterations);
+
+    int numLevels() const { return (int)levels.size(); }
+
+private:
+    struct Level {
+        int nLat = 0;
+        int nLon = 0;
+        std::vector<float> area;      // Cell area per row, unit sphere
+        std::vector<float> northFlux; // Coupling across the nLat + 1 row boundaries, zero at the poles
+        std::vector<float> zonalFlux; // Coupling between neighbours along a row
+        std::vector<float> diagonal;
+        // Line solver factors: Thomas elimination of each row's periodic tridiagonal system plus its Sherman-Morrison
+        // correction. Kept in double: near the poles the zonal coupling dwarfs the diagonal surplus, and single
+        // precision loses the row mean that the smoother most needs to fix.
+        std::vector<double> lineUpper;
+        std::vector<double> lineInverse;
+        std::vector<double> lineCorrection;
+        std::vector<double> lineCorrectionScale;
+        Field x;
+        Field b;
+        Field r;
+        Field d;
+    };
+
+    void buildLevel(Level &level) const;
+    void factorLines(Level &level) const;
+    void residual(Level &level) const;
+    double residualNorm(Level &level) const;
+    void solveLine(const Level &level, int row, const double *rhs, float *out, double *work) const;
+    void smooth(Level &level, int sweeps) const;
+    void coarseSolve(Level &level) const;
+    void restrictResidual(Level &fine, Level &coarse) const;
+    void prolongateAdd(const Level &coarse, Level &fine) const;
+    void vCycle(int level);
+    double refinementResidual();
+
+    MultigridSettings settings;
+    double diffusivity;
+    double shift;
+    std::vector<Level> levels;
+    // Finest-level right-hand side and solution in double for iterative refinement
+    std::vector<double> refinedRhs;
+    std::vector<double> refinedSolution;
+};
+
+// One implicit diffusion step of the state's temperature: theta = 0.5 is Crank-Nicolson, 1 backward Euler.
+// The solver must have been built for this grid with params.diffusivity; its shift is reset to suit dt.
+SolveStats implicitDiffusion(SimulationState &state, SphericalMultigrid &solver, const EnergyBalanceParams &params, double dt, double theta = 0.5);
+
+// Streamfunction of a vorticity field (s^-1) on a sphere of the given radius, m^2/s
+SolveStats solveStreamfunction(const LatLonGrid &grid, const Field &vorticity, Field &streamfunction, double radius = 6.371e6);
+
+// Cycles, time and convergence of each smoother against plain Jacobi for diffusion and Poisson problems
+void benchmarkMultigrid();
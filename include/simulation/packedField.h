@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <simulation/energyBalance.h>
+#include <simulation/field.h>
+
+// How values are rounded when packed. Round-to-nearest loses any increment below half a storage step, which for
+// small explicit timesteps is every increment; stochastic rounding keeps them in expectation.
+enum class Rounding {
+    Nearest,
+    Stochastic
+};
+
+// Storage policies: each packs float32 values into Packed and back. Values are stored relative to offset, so a
+// temperature field kept in Celsius-like units gets the formats' fine spacing near zero rather than near 300 K.
+// noise is 32 uniformly random bits, used only for stochastic rounding.
+
+struct Float32Storage {
+    using Packed = float;
+    static constexpr const char *name = "float32";
+    float offset = 0.0f;
+
+    Packed pack(float value, Rounding, uint32_t) const { return value; }
+    float unpack(Packed packed) const { return packed; }
+};
+
+// IEEE binary16: 11 significant bits, range +-65504
+struct Float16Storage {
+    using Packed = uint16_t;
+    static constexpr const char *name = "float16";
+    float offset = 273.15f;
+
+    Packed pack(float value, Rounding rounding, uint32_t noise) const {
+        uint32_t bits;
+        float shifted = value - offset;
+        std::memcpy(&bits, &shifted, 4);
+        const uint32_t sign = (bits >> 16) & 0x8000u, magnitude = bits & 0x7fffffffu;
+        if (magnitude >= 0x7f800000u) return (Packed)(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));
+        int exponent = (int)(magnitude >> 23) - 127 + 15;
+        // Bits to drop from the 24-bit significand: 13 for normal halves, more for subnormals
+        int shift = exponent > 0 ? 13 : 14 - exponent;
+        if (shift > 24) return (Packed)sign;
+        uint32_t significand = exponent > 0 ? magnitude : (magnitude & 0x7fffffu) | 0x800000u;
+        uint32_t dropped = (1u << shift) - 1u;
+        uint32_t increment = rounding == Rounding::Nearest ? (dropped >> 1) + ((significand >> shift) & 1u) : (noise & dropped);
+        // A carry out of the significand rolls into the exponent field, which is the correctly rounded result
+        uint32_t rounded = exponent > 0 ? (significand + increment) >> 13 : (significand + increment) >> shift;
+        if (exponent > 0) rounded -= (uint32_t)(127 - 15) << 10;
+        return (Packed)(rounded >= 0x7c00u ? sign | 0x7c00u : sign | rounded);
+    }
+
+    float unpack(Packed packed) const {
+        uint32_t sign = (uint32_t)(packed & 0x8000u) << 16, exponent = (packed >> 10) & 0x1fu, mantissa = packed & 0x3ffu;
+        uint32_t bits;
+        if (exponent == 0x1f) {
+            bits = sign | 0x7f800000u | (mantissa << 13);
+        } else if (exponent != 0) {
+            bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        } else {
+            // Subnormal: the value is mantissa * 2^-24, exact in float
+            float value = (float)mantissa * 5.9604644775390625e-8f;
+            return (sign ? -value : value) + offset;
+        }
+        float value;
+        std::memcpy(&value, &bits, 4);
+        return value + offset;
+    }
+};
+
+// bfloat16: float32's exponent range with 8 significant bits
+struct BFloat16Storage {
+    using Packed = uint16_t;
+    static constexpr const char *name = "bfloat16";
+    float offset = 273.15f;
+
+    Packed pack(float value, Rounding rounding, uint32_t noise) const {
+        uint32_t bits;
+        float shifted = value - offset;
+        std::memcpy(&bits, &shifted, 4);
+        if ((bits & 0x7fffffffu) > 0x7f800000u) return (Packed)((bits >> 16) | 0x40u);
+        uint32_t increment = rounding == Rounding::Nearest ? 0x7fffu + ((bits >> 16) & 1u) : (noise & 0xffffu);
+        return (Packed)((bits + increment) >> 16);
+    }
+
+    float unpack(Packed packed) const {
+        uint32_t bits = (uint32_t)packed << 16;
+        float value;
+        std::memcpy(&value, &bits, 4);
+        return value + offset;
+    }
+};
+
+// Fixed point: offset + scale * q for q in [-32767, 32767]. Uniform spacing, so no precision is wasted on the
+// exponent, but values outside the range clamp.
+struct ScaledInt16Storage {
+    using Packed = int16_t;
+    static constexpr const char *name = "int16";
+    float offset = 250.0f;
+    float scale = 100.0f / 32767.0f; // 150 K to 350 K in 0.003 K steps
+
+    Packed pack(float value, Rounding rounding, uint32_t noise) const {
+        // Split in double, where the quotient and its floor are exact enough that no float rounding step biases the
+        // result; stochastic rounding then compares 24 noise bits against the fraction
+        double q = ((double)value - offset) / scale;
+        q = q < -32767.0 ? -32767.0 : q > 32767.0 ? 32767.0 : q;
+        double whole = std::floor(q), fraction = q - whole;
+        bool up = rounding == Rounding::Nearest ? fraction >= 0.5 : (noise >> 8) < (uint32_t)(fraction * 16777216.0);
+        return (Packed)((int)whole + (up ? 1 : 0));
+    }
+
+    float unpack(Packed packed) const { return offset + scale * (float)packed; }
+};
+
+// Counter-based random bits, so a stochastically rounded run is reproducible however its rows are scheduled
+inline uint32_t roundingNoise(uint32_t rowSeed, uint32_t col) {
+    uint32_t h = rowSeed ^ (col * 0x9e3779b1u);
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    return h ^ (h >> 16);
+}
+
+// Field in packed storage, laid out like Field with rows padded to fieldRowMultiple elements
+template <typename Storage>
+struct PackedField {
+    using Packed = typename Storage::Packed;
+    int rows = 0;
+    int cols = 0;
+    int stride = 0;
+    Storage storage;
+    AlignedVector<Packed> data;
+
+    PackedField() = default;
+    PackedField(int rows, int cols, const Storage &storage = Storage())
+        : rows(rows), cols(cols), stride((cols + fieldRowMultiple - 1) / fieldRowMultiple * fieldRowMultiple), storage(storage),
+          data((size_t)rows * stride) {}
+
+    Packed *row(int r) { return data.data() + (size_t)r * stride; }
+    const Packed *row(int r) const { return data.data() + (size_t)r * stride; }
+    size_t bytes() const { return data.size() * sizeof(Packed); }
+};
+
+// SimulationState whose prognostic fields live in packed storage. Each field picks its own policy: the temperature
+// here, and any fields added later, are independent template parameters of the stepping code.
+template <typename TemperatureStorage>
+struct PackedSimulationState {
+    LatLonGrid grid;
+    PackedField<TemperatureStorage> temperature;
+    PackedField<TemperatureStorage> scratch;
+    Rounding rounding = Rounding::Nearest;
+    uint32_t seed = 0x5eed1234u;
+    double time = 0.0;
+    long long step = 0;
+};
+
+// Pack a float32 state, or unpack one back into it
+template <typename Storage>
+PackedSimulationState<Storage> packState(const SimulationState &state, const Storage &storage, Rounding rounding);
+template <typename Storage>
+void unpackState(const PackedSimulationState<Storage> &packed, SimulationState &state);
+
+// Round a float32 field to nearest into packed storage of the same shape, with the same row packing as the stepper
+template <typename Storage>
+void packField(const Field &field, PackedField<Storage> &packed);
+
+// stepEnergyBalance on packed storage: rows are unpacked into float32, stepped with the same row kernel and packed
+// again, so only the memory traffic changes
+template <typename Storage>
+void stepEnergyBalance(PackedSimulationState<Storage> &state, const EnergyBalanceParams &params, double dt);
+
+// Area-weighted global mean of the packed temperature, K
+template <typename Storage>
+double globalMeanTemperature(const PackedSimulationState<Storage> &state);
+
+// Error against a float32 reference and cells/s for every storage policy and rounding mode
+void benchmarkMixedPrecision();
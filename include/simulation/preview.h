@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <core/interpolation.h>
+#include <core/thermalGrid.h>
+#include <simulation/energyBalance.h>
+#include <simulation/packedField.h>
+
+struct PreviewSettings {
+    // Grids run in turn, coarsest first; the first should be cheap enough to show within a frame or two
+    std::vector<double> resolutions{4.0, 2.0, 1.0, 0.5, 0.25};
+    int stepsPerLevel = 8; // Stable explicit steps run on each grid before it is shown again and refined
+};
+
+// One displayable state of a progressive run
+struct PreviewFrame {
+    int level = -1;
+    double resolution = 0.0;
+    int step = 0;          // Steps run on this level's grid so far
+    double seconds = 0.0;  // Since start()
+    PackedField<Float16Storage> packed; // Temperature on the level's grid, row 0 north, in float16 ready to upload as an R16F texture
+};
+
+// Runs the energy-balance model from an image of the thermal layer on a coarse grid first, then on ever finer ones, in
+// a background thread. Each level decodes only the pixels its grid samples, and starts from the
+// previous level's state interpolated onto its grid plus the detail the coarser observations could not hold, so no
+// level starts over. A frame is published as soon as a level is initialised and again after its steps. Levels step
+// through a Scheduler with the energy-balance components, advecting the temperature once observed wind is given.
+class ProgressiveSimulation {
+public:
+    // pixels is the RGBA thermal image, row 0 north, still in the colormap
+    ProgressiveSimulation(std::vector<unsigned char> pixels, int width, int height, const EnergyBalanceParams &params,
+                          const PreviewSettings &settings = PreviewSettings());
+    ~ProgressiveSimulation();
+    ProgressiveSimulation(const ProgressiveSimulation &) = delete;
+    ProgressiveSimulation &operator=(const ProgressiveSimulation &) = delete;
+
+    void start();
+    // Observed 10 m wind speed (km/h) and direction (degrees from), as in the weather responses. May be called while
+    // running; levels set up afterwards advect with it.
+    void setWind(const std::vector<WeatherSample> &speed, const std::vector<WeatherSample> &direction);
+    // Newest frame not yet taken, without waiting; false if there is none
+    bool takeFrame(PreviewFrame &frame);
+    bool finished() const { return done; }
+    // Block until the finest level has run
+    void wait();
+
+    // State of the finest level completed so far
+    SimulationState result();
+
+private:
+    void run();
+    void publish(int level, const SimulationState &state, int step);
+
+    std::vector<unsigned char> pixels;
+    int width;
+    int height;
+    EnergyBalanceParams params;
+    PreviewSettings settings;
+    std::thread worker;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> done{false};
+    std::chrono::steady_clock::time_point startTime;
+    std::mutex mutex; // Guards the fields below
+    PreviewFrame latest;
+    bool fresh = false;
+    SimulationState finest;
+    std::vector<WeatherSample> windSpeed;
+    std::vector<WeatherSample> windDirection;
+};
+
+// Observations for a grid of this resolution from an RGBA thermal image, decoding only the pixels it needs: every
+// stride-th pixel of each row and column, with stride as large as still leaves a few samples per cell
+ThermalGrid sampleForGrid(const unsigned char *pixels, int width, int height, const LatLonGrid &grid);
+
+// Newest thermal image of the last numDays days already on disk, as RGBA; false when there is none
+bool loadLatestThermalImage(int numDays, std::vector<unsigned char> &pixels, int &width, int &height);
+
+// Time to the first frame and to each refinement level from an image in memory, coarse decoding included, on the
+// latest thermal image or a synthetic field
+void benchmarkPreview();
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <simulation/advection.h>
+#include <simulation/energyBalance.h>
+
+// One physical process advanced by the scheduler. step must advance the state by dt without touching the model clock.
+struct PhysicsComponent {
+    std::string name;
+    std::function<void(SimulationState &, double)> step;
+    // Optional: count substeps of dt in one call, the same as calling step count times. Lets a sub-cycled component
+    // fuse its substeps instead of sweeping the state once per substep.
+    std::function<void(SimulationState &, double, long long)> stepRepeated;
+    // Largest stable dt for the current state, re-evaluated every time it is needed; empty for unconditionally stable processes
+    std::function<double(const SimulationState &)> stableTimestep;
+    int interval = 1;      // Advance once every interval model steps, over the time accumulated since the last call
+    bool subcycle = false; // Split into equal substeps under its own limit instead of bounding the model step
+    // Components, added before this one, that it must follow within a step. Unset, it follows every one of them, which is
+    // plain operator splitting. Components that read and write disjoint parts of the state can name fewer (or
+    // none) and then run at the same time as the others.
+    std::optional<std::vector<std::string>> after;
+    int priority = 0; // Among components ready at once, higher goes first
+};
+
+// Wall time spent in one component
+struct ComponentTimer {
+    std::string name;
+    long long calls = 0;
+    long long substeps = 0;
+    double seconds = 0.0;
+    double lastDt = 0.0; // Length of the latest substep
+};
+
+// Adaptive-timestep operator-splitting integrator. Each model step is the largest dt that every
+// non-subcycled component can take (times the safety factor), capped at maxTimestep. The components due in a step
+// then run in order by their after lists: as a task graph on taskScheduler() when the lists let some overlap, and
+// directly on the calling thread when they make a chain.
+class Scheduler {
+public:
+    explicit Scheduler(double maxTimestep, double safetyFactor = 0.9);
+
+    void addComponent(const PhysicsComponent &component);
+
+    // Advance one model step, returning the dt taken
+    double step(SimulationState &state);
+
+    // Step until the model clock reaches endTime, shortening the last step to land on it. Interval components not due
+    // on that step still run over their pending time, so none is left behind at endTime.
+    void advanceTo(SimulationState &state, double endTime);
+
+    const std::vector<ComponentTimer> &timers() const { return componentTimers; }
+    void resetTimers();
+    void printTimers(std::ostream &out) const;
+
+private:
+    double nextTimestep(const SimulationState &state) const;
+    // flush runs every component, due or not, over the time it has accumulated
+    void advance(SimulationState &state, double dt, bool flush);
+    // One call of a component over span seconds, sub-cycled if it asks to be, timed
+    void runComponent(SimulationState &state, size_t index, double span);
+
+    struct Entry {
+        PhysicsComponent component;
+        double pending = 0.0;
+        long long stepsSinceCall = 0;
+    };
+
+    double maxTimestep;
+    double safetyFactor;
+    std::vector<Entry> entries;
+    std::vector<ComponentTimer> componentTimers;
+    long long modelSteps = 0;
+    double modelSeconds = 0.0;
+    double wallSeconds = 0.0;
+};
+
+// The energy-balance model as separately scheduled radiation, diffusion and (with a wind field) advection.
+// Diffusion is sub-cycled so its pole-bound limit no longer sets the model step; the wind must outlive the scheduler.
+void addEnergyBalanceComponents(Scheduler &scheduler, const EnergyBalanceParams &params, int radiationInterval = 1,
+                                const WindField *wind = nullptr, double maxCourant = 8.0);
+
+// Timer breakdown of a 1 degree run for several radiation intervals
+void benchmarkScheduler();
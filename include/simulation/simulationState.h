@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include <core/thermalGrid.h>
+#include <simulation/field.h>
+
+// Regular latitude / longitude grid of cell centres, row 0 nearest the north pole
+struct LatLonGrid {
+    int nLat = 0;
+    int nLon = 0;
+    double resolution = 0.0;        // Degrees per cell
+    std::vector<double> latitudes;  // Cell centre latitudes, radians
+    std::vector<double> cosLat;     // Cosine at cell centres
+    std::vector<double> cosEdge;    // Cosine at the nLat + 1 row boundaries, north first
+    std::vector<double> areaWeight; // Fraction of the sphere covered by one cell in each row
+};
+
+// Prognostic state stepped by the simulation physics
+struct SimulationState {
+    LatLonGrid grid;
+    Field temperature; // Kelvin
+    Field scratch;     // Double buffer for stencil updates
+    double time = 0.0; // Seconds since 1 January
+    long long step = 0;
+};
+
+// Grid of the given resolution in degrees; 180 must divide into whole rows
+LatLonGrid makeLatLonGrid(double resolution);
+
+// Fresh state at a uniform temperature
+SimulationState createSimulation(double resolution, float temperature = 288.0f);
+
+// Area-average a decoded thermal field onto the simulation grid; cells without observations are inpainted
+void initializeFromThermal(SimulationState &state, const ThermalGrid &thermal);
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <memory>
+
+#include <simulation/energyBalance.h>
+#include <simulation/scheduler.h>
+#include <simulation/surfaceMask.h>
+
+// Mixed-layer ocean under thermodynamic sea ice, beneath an atmosphere with the (much smaller) heat capacity of
+// EnergyBalanceParams. The two exchange heat through a linearised bulk flux; ice insulates the ocean in series with it.
+struct SlabOceanParams {
+    double heatCapacity = 2.1e8;         // J m^-2 K^-1, 50 m mixed layer
+    double exchangeCoefficient = 20.0;   // W m^-2 K^-1, sensible plus latent air-sea flux per kelvin
+    double freezingTemperature = 271.35; // K, sea water
+    double iceConductivity = 2.03;       // W m^-1 K^-1
+    double iceDensity = 917.0;           // kg m^-3
+    double latentHeatOfFusion = 3.34e5;  // J kg^-1
+    double initialIceThickness = 2.0;    // m, wherever the air starts below freezing
+};
+
+// Ocean state on the atmosphere's grid, row-major with the padded rows of Field. Land cells carry zeros throughout.
+//
+// The ocean steps far less often than the atmosphere. Between its steps the atmosphere sees a fixed surface: each
+// cell's temperature and its conductance to the atmosphere (zero over land) are set when the ocean steps. The heat the
+// atmosphere hands down every step piles up in fluxBuffer, and the next ocean step takes it in one go, so energy is
+// conserved exactly whatever the coupling interval.
+struct SlabOcean {
+    Field ocean;              // 1 for ocean cells, 0 for land
+    Field temperature;        // Mixed layer, K; at freezing under ice
+    Field iceThickness;       // m
+    Field surfaceTemperature; // Seen by the atmosphere: the mixed layer, or freezing under ice
+    Field conductance;        // W m^-2 K^-1 from surface to atmosphere
+    Field fluxBuffer;         // J m^-2 into the ocean since its last step
+};
+
+// Ocean beneath state on the ocean cells of mask (every cell when the mask is empty), starting at the air temperature
+// or at freezing under initialIceThickness of ice where the air is colder.
+void initializeSlabOcean(SlabOcean &ocean, const SimulationState &state, const SurfaceMask &mask, const SlabOceanParams &params = SlabOceanParams());
+
+// Atmospheric-rate half of the coupling: move the air-sea flux over dt between state.temperature, of heat capacity
+// atmosphereHeatCapacity, and the ocean's flux buffer.
+void exchangeSurfaceFluxes(SimulationState &state, SlabOcean &ocean, double atmosphereHeatCapacity, double dt);
+
+// Ocean-rate half: take up the buffered heat, growing ice from a mixed layer cooled past freezing and melting it
+// from above or below as heat arrives, then refresh the surface the atmosphere sees.
+void stepSlabOcean(SlabOcean &ocean, const SlabOceanParams &params);
+
+// Fraction of the sphere under ice, and area-weighted mean mixed layer temperature of the open ocean
+double iceCoverage(const SlabOcean &ocean, const LatLonGrid &grid);
+double meanOceanTemperature(const SlabOcean &ocean, const LatLonGrid &grid);
+
+// The coupled ocean as two scheduler components: "surfaceFluxes" every model step, following the atmospheric
+// components, and "ocean" every couplingInterval steps over the time accumulated since its last call. The ocean
+// touches none of the atmosphere's state, so it waits only for the fluxes. atmosphere is the energy-balance
+// parameter set the atmosphere runs with.
+void addSlabOceanComponents(Scheduler &scheduler, std::shared_ptr<SlabOcean> ocean, const EnergyBalanceParams &atmosphere,
+                            const SlabOceanParams &params = SlabOceanParams(), int couplingInterval = 8);
+
+// Ocean and flux cost at 4 degrees over a model season for several coupling intervals, and their drift from coupling
+// every step
+void benchmarkSlabOcean();
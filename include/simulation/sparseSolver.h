@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+
+#include <simulation/multigrid.h>
+#include <simulation/sphericalMesh.h>
+
+// Rows packed together by the SELL kernel: a slice column's values and column indices are one 32-byte load each,
+// accumulated in two AVX2 gathers of four doubles, or four SSE2 register pairs without AVX2
+constexpr int sellChunk = 8;
+
+// Compressed sparse rows with every row's columns in ascending order. Values are single precision, like the mesh
+// tables they come from; the vectors they multiply are double, as the solver needs.
+struct CsrMatrix {
+    int rows = 0;
+    std::vector<int> offsets; // rows + 1 entries; row r owns [offsets[r], offsets[r + 1])
+    std::vector<int> columns;
+    std::vector<float> values;
+
+    size_t nonZeros() const { return values.size(); }
+};
+
+// SELL-C-sigma: rows sorted by length, longest first, within windows of sigma rows, then cut into slices of sellChunk
+// rows. Each slice is stored column-major and padded to its longest row, so the kernel walks sellChunk rows in lock
+// step with unit-stride loads. Sorting keeps rows of like length together and the padding small; keeping the
+// window small keeps the rows of a slice close in the mesh and x reads cache friendly.
+struct SellMatrix {
+    int rows = 0;
+    int sigma = 1;
+    std::vector<int> permutation;  // Original row of each packed row; padding rows past the end are absent
+    std::vector<int> sliceOffsets; // First entry of each slice, plus the total
+    std::vector<int> sliceWidths;
+    std::vector<int> columns;      // Padding entries repeat a real column with a zero value
+    std::vector<float> values;
+
+    size_t storedEntries() const { return values.size(); }
+};
+
+SellMatrix makeSellMatrix(const CsrMatrix &matrix, int sigma = 32);
+
+// y = A x over the thread pool
+void multiply(const CsrMatrix &matrix, const double *x, double *y);
+void multiply(const SellMatrix &matrix, const double *x, double *y);
+
+// Finite-volume operators of a spherical mesh in the area-weighted form that keeps them symmetric: row c is the
+// Laplacian of cell c times its area, negated. assembleDiffusionMatrix adds shift times the cell area to the
+// diagonal and scales the Laplacian by diffusivity; a positive shift makes it positive definite.
+CsrMatrix assembleLaplacian(const SphericalMesh &mesh);
+CsrMatrix assembleDiffusionMatrix(const SphericalMesh &mesh, double diffusivity, double shift);
+
+enum class Preconditioner {
+    Jacobi,             // Inverse diagonal
+    IncompleteCholesky, // IC(0) on the matrix's own pattern; triangular solves go one dependency level at a time
+    Polynomial          // Chebyshev polynomial in the Jacobi-scaled matrix; only matrix products, fully parallel
+};
+
+struct PcgSettings {
+    Preconditioner preconditioner = Preconditioner::Jacobi;
+    int polynomialDegree = 4;
+    int maxIterations = 1000;
+    double tolerance = 1e-8; // Relative residual
+};
+
+// Conjugate gradients on a symmetric positive definite matrix, with every vector operation spread over the thread
+// pool. The product runs on CSR or a SELL-C-sigma copy, whichever measured faster on this matrix when the solver was
+// built; both give the same bits. Dot products use the fixed-tree sums of reduction.h, so the iterates do not depend
+// on the thread count. SolveStats::cycles counts iterations. The solver keeps scratch vectors, so one solve runs at
+// a time.
+class PcgSolver {
+public:
+    explicit PcgSolver(const CsrMatrix &matrix, const PcgSettings &settings = PcgSettings());
+
+    // solution holds the initial guess on entry
+    SolveStats solve(const std::vector<double> &rhs, std::vector<double> &solution) const;
+
+    bool usesSell() const { return sellProduct; }
+
+private:
+    void product(const double *x, double *y) const;
+    void precondition(const std::vector<double> &residual, std::vector<double> &out) const;
+    void factorIncompleteCholesky(const CsrMatrix &matrix);
+    void triangularSolve(const CsrMatrix &factor, const std::vector<std::vector<int>> &levels, bool lower, std::vector<double> &values) const;
+
+    PcgSettings settings;
+    int rows = 0;
+    bool sellProduct = true;
+    CsrMatrix csr;   // Kept only when it is the faster format
+    SellMatrix sell; // Likewise
+    std::vector<double> inverseDiagonal;
+    double spectrumTop = 2.0; // Bound on the eigenvalues of the Jacobi-scaled matrix
+    // IC(0): lower factor and its transpose, with rows grouped into levels that depend only on earlier levels
+    CsrMatrix lowerFactor;
+    CsrMatrix upperFactor;
+    std::vector<std::vector<int>> lowerLevels;
+    std::vector<std::vector<int>> upperLevels;
+    mutable std::vector<double> work;
+    mutable std::vector<double> work2;
+};
+
+// Solver for backward Euler diffusion steps of length dt on the mesh. The matrix, its product format and the
+// preconditioner are built here once, for every step of that length.
+PcgSolver diffusionSolver(const SphericalMesh &mesh, const EnergyBalanceParams &params, double dt, const PcgSettings &settings = PcgSettings());
+
+// One backward Euler diffusion step of the mesh temperatures. The solver must come from diffusionSolver for this
+// mesh, params and dt.
+SolveStats implicitDiffusion(MeshSimulationState &state, const PcgSolver &solver, const EnergyBalanceParams &params, double dt);
+
+// SpMV bandwidth of CSR and SELL-C-sigma against a measured copy, then PCG iterations and time for each
+// preconditioner, on both meshes
+void benchmarkSparseSolver();
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <complex>
+#include <memory>
+#include <vector>
+
+#include <simulation/energyBalance.h>
+
+// Gaussian grid of nLat rows (even), row 0 nearest the north pole, 2 nLat columns. Latitudes are the Gauss-Legendre
+// nodes and areaWeight the quadrature weights, so every grid-point routine (globalMeanTemperature, applyRadiation,
+// ...) runs on it unchanged. cosEdge holds the boundaries between equal-weight bands.
+LatLonGrid makeGaussianGrid(int nLat);
+
+// Smallest Gaussian grid that transforms products of two fields at this triangular truncation without aliasing
+// (nLat >= (3T + 1) / 2), rounded up so the row length has no prime factors above 5
+int gaussianRows(int truncation);
+
+// Fully normalised associated Legendre functions at the northern Gaussian latitudes of one grid, for m <= n <= T.
+// The southern half follows by symmetry: P(n, m, -mu) = (-1)^(n + m) P(n, m, mu). For each m the values of latitude
+// pair j are contiguous, those with n - m even first and then the odd ones, so the sums for the symmetric and
+// antisymmetric halves of a pair are each one unit-stride loop.
+struct LegendreTable {
+    int truncation = 0;
+    int nLat = 0;
+    std::vector<double> weights;     // Gaussian weights of the northern rows
+    std::vector<size_t> waveOffset;  // Start of each m's block
+    std::vector<double> values;      // [m][pair][even n - m, then odd n - m]
+
+    const double *pair(int m, int pair) const { return values.data() + waveOffset[m] + (size_t)pair * (truncation - m + 1); }
+};
+
+// Cached Legendre table for a truncation and grid; built on first use and shared afterwards
+std::shared_ptr<const LegendreTable> legendreTable(int truncation, int nLat);
+
+// Spherical harmonic analysis and synthesis at triangular truncation T on its Gaussian grid. Longitude goes through a
+// real FFT per row and latitude through Gauss-Legendre quadrature per zonal wavenumber. Rows are transformed in
+// north / south pairs, so one pass over the Legendre table serves both hemispheres; the FFTs are spread over latitude
+// pairs and the Legendre sums over wavenumbers on the thread pool.
+class SphericalHarmonicTransform {
+public:
+    explicit SphericalHarmonicTransform(int truncation);
+
+    int truncation() const { return trunc; }
+    const LatLonGrid &grid() const { return gaussian; }
+    // Coefficients of wavenumbers m = 0..T, each n = m..T: index(m, n)
+    int size() const { return coefficients; }
+    int index(int m, int n) const { return waveStart[m] + n - m; }
+
+    // Coefficients of a grid field, for m >= 0; negative m are the complex conjugates
+    void analyse(const Field &field, std::vector<std::complex<double>> &spectrum) const;
+    // Grid field of a spectrum, truncated to T
+    void synthesise(const std::vector<std::complex<double>> &spectrum, Field &field) const;
+
+private:
+    // Real FFT of one row, through a complex transform of half the length
+    struct FourierPlan;
+
+    int trunc;
+    LatLonGrid gaussian;
+    std::shared_ptr<const LegendreTable> legendre;
+    std::shared_ptr<const FourierPlan> fourier;
+    std::vector<int> waveStart;
+    int coefficients = 0;
+    std::vector<int> waveOrder; // Wavenumbers with long and short Legendre sums interleaved, for load balance
+};
+
+// The energy-balance model on a spectral dynamical core: radiation is evaluated on the Gaussian grid, then the
+// temperature is transformed and diffused exactly in spectral space, where the Laplacian is -n (n + 1). Diffusion
+// costs the same at any timestep, so the step is bounded only by radiation, not by the polar cells.
+class SpectralEnergyBalance {
+public:
+    SpectralEnergyBalance(int truncation, const EnergyBalanceParams &params, float temperature = 288.0f);
+
+    SimulationState &state() { return current; }
+    const SimulationState &state() const { return current; }
+    const SphericalHarmonicTransform &transform() const { return sht; }
+
+    // Largest stable dt of the radiation term
+    double stableTimestep() const;
+    // Advance the state and the model clock by dt
+    void step(double dt);
+
+private:
+    SphericalHarmonicTransform sht;
+    EnergyBalanceParams params;
+    SimulationState current;
+    std::vector<std::complex<double>> spectrum;
+};
+
+// Transform cost and wall time per model day of the spectral core at T42 to T255, against the grid-point core on a
+// regular grid with the same rows
+void benchmarkSpectralCore();
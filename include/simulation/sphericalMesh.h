@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <simulation/energyBalance.h>
+
+// Quasi-uniform tilings of the sphere
+enum class MeshType {
+    Icosahedral, // Voronoi cells around the vertices of a subdivided icosahedron: 12 pentagons, the rest hexagons
+    CubedSphere  // Equiangular gnomonic cube faces split into n x n quadrilaterals
+};
+
+// Cells on the unit sphere with every per-cell and per-edge table stored contiguously.
+// Neighbour tables are compressed rows: cell c owns entries [neighbourOffsets[c], neighbourOffsets[c + 1]),
+// listed counter-clockwise seen from outside, and the cell's polygon corners follow the same layout.
+struct SphericalMesh {
+    MeshType type;
+    int resolution;                    // Divisions per icosahedron edge or cells per cube edge
+    std::vector<glm::dvec3> centres;
+    std::vector<double> areas;         // Steradians
+    std::vector<float> sinLat;         // Sine of each centre's latitude
+    std::vector<int> neighbourOffsets;
+    std::vector<int> neighbours;
+    std::vector<float> edgeLengths;    // Arc length of the edge shared with each neighbour, radians
+    std::vector<float> edgeDistances;  // Arc distance between the two cell centres, radians
+    std::vector<float> laplacianWeights; // edgeLength / (edgeDistance * area): unit-sphere Laplacian coefficients
+    std::vector<glm::dvec3> corners;   // Polygon corners; corner k lies between neighbours k - 1 and k
+
+    int numCells() const { return (int)centres.size(); }
+};
+
+// 10 n^2 + 2 cells
+SphericalMesh makeIcosahedralMesh(int divisions);
+
+// 6 n^2 cells
+SphericalMesh makeCubedSphereMesh(int cellsPerEdge);
+
+// Interleaved position (3) + texture coordinate (2) triangles covering every cell, in the renderer's
+// frame (north along +y) with equirectangular texture coordinates; seam triangles get their own vertices
+void buildRenderMesh(const SphericalMesh &mesh, std::vector<float> &vertices, std::vector<unsigned int> &indices);
+
+// Cell-centred energy-balance state on a spherical mesh
+struct MeshSimulationState {
+    const SphericalMesh *mesh = nullptr;
+    std::vector<float> temperature; // Kelvin
+    std::vector<float> scratch;
+    double time = 0.0;
+    long long step = 0;
+};
+
+MeshSimulationState createMeshSimulation(const SphericalMesh &mesh, float temperature = 288.0f);
+
+// Sample a gap-filled thermal field at every cell centre
+void initializeFromThermal(MeshSimulationState &state, const ThermalGrid &thermal);
+
+// Largest stable explicit timestep; bounded by the smallest cell rather than by the poles
+double stableTimestep(const MeshSimulationState &state, const EnergyBalanceParams &params);
+
+// Forward Euler energy-balance step over equal-sized blocks of cells
+void stepEnergyBalance(MeshSimulationState &state, const EnergyBalanceParams &params, double dt);
+
+double globalMeanTemperature(const MeshSimulationState &state);
+
+// Cell uniformity, stable timestep and steps/s of both meshes next to the lat/lon grid
+void benchmarkSphericalMesh();
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <simulation/energyBalance.h>
+#include <simulation/simulationState.h>
+
+enum class SurfaceType : unsigned char {
+    Ocean = 0,
+    Land = 1,
+    Ice = 2
+};
+
+// Surface type and albedo of every cell of a grid, row-major without padding
+struct SurfaceMask {
+    int nLat = 0;
+    int nLon = 0;
+    std::vector<unsigned char> type;   // SurfaceType covering the largest area of the cell
+    std::vector<unsigned char> albedo; // Area-weighted mean albedo, in steps of 1 / 255
+
+    bool empty() const { return type.empty(); }
+    SurfaceType at(int row, int col) const { return (SurfaceType)type[(size_t)row * nLon + col]; }
+    float albedoAt(int row, int col) const { return albedo[(size_t)row * nLon + col] / 255.0f; }
+};
+
+// Column heat capacities of each surface type, J m^-2 K^-1
+struct SurfaceParams {
+    double oceanHeatCapacity = 2.1e8; // 50 m mixed layer, as EnergyBalanceParams
+    double landHeatCapacity = 1.0e7;  // Top metres of soil plus the atmospheric column
+    double iceHeatCapacity = 2.0e7;   // Thin ice over the mixed layer's top, plus the atmospheric column
+};
+
+// Classify an equirectangular basemap (row 0 at 90 N, column 0 at 180 W) by colour and average it onto the grid.
+// Each pixel's share of a cell is its exact overlap area on the sphere, so any grid, regular or Gaussian, coarser or
+// finer than the image, is covered. Blue pixels are ocean, bright grey or white ones ice, and the rest land with
+// an albedo rising with brightness.
+SurfaceMask classifySurface(const unsigned char *pixels, int width, int height, int channels, const LatLonGrid &grid);
+
+// Basemap the surface is classified from. Caches derived from it on this machine, the mask and the stencil tuning,
+// are kept in its directory.
+constexpr const char *defaultBasemap = "physicalMap.jpg";
+
+// Path of a cache file kept beside the basemap
+std::string basemapCachePath(const std::string &fileName, const std::string &basemap = defaultBasemap);
+
+// Mask of the basemap image on the grid. The first call for a grid classifies the image and writes cacheFile
+// (by default surfaceMask_<nLat>x<nLon>.bin next to the basemap); later runs read it back without decoding the image,
+// until the basemap changes. Returns an empty mask, with a message, if the basemap cannot be read.
+SurfaceMask loadSurfaceMask(const LatLonGrid &grid, const std::string &basemap = defaultBasemap, const std::string &cacheFile = "");
+
+// Heat capacity of every cell from its surface type, for rows of the mask's grid
+Field surfaceHeatCapacity(const SurfaceMask &mask, const SurfaceParams &params = SurfaceParams());
+
+// The mask as per-cell properties of the energy-balance model, for EnergyBalanceParams::surface. Heat capacities
+// are those of surfaceHeatCapacity. The mask's albedo is the bare surface's while params.warmAlbedo also counts
+// cloud, so each cell's warm albedo is params.warmAlbedo moved by its surface albedo's departure from the
+// area-weighted mean: the land-sea contrast without retuning the global albedo. Null, with a message, if the
+// mask is not on the grid.
+std::shared_ptr<const SurfaceProperties> surfaceProperties(const SurfaceMask &mask, const LatLonGrid &grid, const EnergyBalanceParams &params,
+                                                           const SurfaceParams &surfaceParams = SurfaceParams());
+
+// Classification time against a cache hit at 1, 0.25 and 0.1 degrees, on physicalMap.jpg or a synthetic basemap,
+// then a month of the 4 degree model with and without the mask's surface
+void benchmarkSurfaceMask();
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+#include <simulation/energyBalance.h>
+
+// Shape of a tiled sweep. The grid is cut into bands of bandRows latitude rows; each band is advanced fusedSteps
+// timesteps in a cache-resident buffer before its rows are written back, so the field streams through memory once
+// per fusedSteps steps instead of every step. A band recomputes fusedSteps - 1 rows of its neighbours on each side
+// (overlapped tiling), which keeps bands independent at the cost of some redundant work.
+struct StencilTiling {
+    int bandRows = 16;
+    int fusedSteps = 1;
+};
+
+// Operators the tiled engine can run
+enum class StencilOperator {
+    EnergyBalance, // stepEnergyBalance
+    Diffusion      // applyDiffusion
+};
+
+// steps timesteps of stepEnergyBalance or applyDiffusion, bit for bit the same as calling them steps times.
+// stepEnergyBalanceTiled advances the model clock like stepEnergyBalance; applyDiffusionTiled leaves it alone.
+void stepEnergyBalanceTiled(SimulationState &state, const EnergyBalanceParams &params, double dt, int steps, const StencilTiling &tiling);
+void applyDiffusionTiled(SimulationState &state, const EnergyBalanceParams &params, double dt, int steps, const StencilTiling &tiling);
+
+// Tuning results live here unless a caller names another file: stencilTuning.txt beside the basemap, with the
+// surface mask caches. One line per operator, grid and thread count.
+std::string defaultStencilTuningFile();
+
+// Tiling for one operator on grids of this size at the current thread count. The first call for a new combination
+// times a set of candidate tilings on the grid and appends the fastest to tuningFile; later calls, in this or
+// any later run, read it back.
+StencilTiling tunedTiling(StencilOperator op, const LatLonGrid &grid, const std::string &tuningFile = "");
+
+// GB/s and GFLOP/s of the tuned tiled sweeps against the naive one-step-at-a-time sweep at 0.25 and 0.1 degrees
+void benchmarkTiledStencils();
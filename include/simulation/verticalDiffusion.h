@@ -0,0 +1,57 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <simulation/columnRadiation.h>
+#include <simulation/scheduler.h>
+
+// Tridiagonal systems of many columns solved together, interleaved column-fastest like the layers of a
+// ColumnAtmosphere: row k of each coefficient field holds equation k of every column, so one vector load takes the
+// same equation from columnBlock neighbouring columns. Row k of column j reads
+//   lower[k][j] x[k-1][j] + diagonal[k][j] x[k][j] + upper[k][j] x[k+1][j] = rhs[k][j]
+// Columns may be shorter than layers: equations from lengths[j] down are left out and their values kept as they are.
+struct TridiagonalBatch {
+    int layers = 0;
+    int columns = 0;
+    Field lower;              // Row 0 unused
+    Field diagonal;
+    Field upper;              // Unused in each column's last equation
+    std::vector<int> lengths; // Equations in each column; every column has all layers when empty
+};
+
+// Batch for columns systems of layers equations, coefficients zeroed
+TridiagonalBatch makeTridiagonalBatch(int layers, int columns);
+
+// Solve in place: on entry values[k * valueStride + j] is the right-hand side of equation k of column j, on return the
+// solution. Thomas elimination runs a chunk of columns in step, one per vector lane, with chunks spread over the
+// thread pool; valueStride must cover the columns rounded up to whole columnBlock vectors, as Field rows do. The systems must be
+// diagonally dominant (or otherwise safe without pivoting).
+void solveTridiagonalBatch(const TridiagonalBatch &batch, float *values, size_t valueStride);
+void solveTridiagonalBatch(const TridiagonalBatch &batch, Field &values);
+
+// One system stored contiguously, with modified as scratch for length values; the scalar baseline
+void solveTridiagonalColumn(const float *lower, const float *diagonal, const float *upper, float *values, float *modified, int length);
+
+// Turbulent mixing between the equal-pressure layers of a ColumnAtmosphere, strongest in the boundary layer over
+// the surface and weak in the free atmosphere above
+struct VerticalDiffusionParams {
+    double boundaryDiffusivity = 3.0e4; // Pa^2 s^-1 at the surface: a 100 hPa layer mixes in about an hour
+    double freeDiffusivity = 30.0;      // Pa^2 s^-1 far above it
+    double boundaryLayerDepth = 1.0e4;  // Pa over which the diffusivity decays towards the free value
+    double surfacePressure = 1.0e5;     // Pa, as ColumnRadiationParams
+};
+
+// Backward Euler step of the layer temperatures, stable for any dt. No heat crosses the top or the surface, so the
+// column mean is conserved. Each latitude row is one batch of nLon columns sharing the same coefficients.
+void applyVerticalDiffusion(ColumnAtmosphere &atmosphere, const VerticalDiffusionParams &params, double dt);
+
+// Vertical diffusion as a scheduler component named "verticalDiffusion", running every interval steps. It touches
+// only the layers, so it waits for nothing but the column radiation that also writes them.
+void addVerticalDiffusionComponent(Scheduler &scheduler, std::shared_ptr<ColumnAtmosphere> atmosphere,
+                                   const VerticalDiffusionParams &params = VerticalDiffusionParams(), int interval = 1);
+
+// Columns per second of the batched solver against one contiguous column at a time: general systems with
+// per-column coefficients and lengths at 1 degree for every layer count, then vertical diffusion at 0.25 degrees,
+// where the in-place per-column solve that gathers each column from the layer rows is timed too
+void benchmarkVerticalDiffusion();
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+#include <core/compositor.h>
+#include <core/threadPool.h>
+#include <renderLogic/stb_image.h>
+
+TemporalCompositor::TemporalCompositor(CompositeMode mode, int width, int height, int medianDepth)
+    : mode(mode), width(width), height(height), medianDepth(std::max(medianDepth, 1)) {
+    size_t numPixels = (size_t)width * height;
+    state.assign(mode == CompositeMode::Median ? numPixels * this->medianDepth : numPixels, 0.0f);
+    counts.assign(numPixels, 0);
+}
+
+void TemporalCompositor::addDay(const ThermalGrid &day) {
+    if (day.width != width || day.height != height) return;
+    threadPool().parallelFor(0, height, [&](int rowBegin, int rowEnd) {
+        for (size_t idx = (size_t)rowBegin * width; idx < (size_t)rowEnd * width; ++idx) {
+            if (!day.valid[idx]) continue;
+            float value = day.values[idx];
+            unsigned short count = counts[idx];
+            switch (mode) {
+                case CompositeMode::Maximum:
+                    state[idx] = count ? std::max(state[idx], value) : value;
+                    break;
+                case CompositeMode::Mean:
+                    state[idx] += value;
+                    break;
+                case CompositeMode::Median:
+                    // Ring buffer of the latest medianDepth observations
+                    state[idx * medianDepth + count % medianDepth] = value;
+                    break;
+                case CompositeMode::LatestValid:
+                    state[idx] = value;
+                    break;
+            }
+            if (count < 0xFFFF) counts[idx] = count + 1;
+        }
+    }, 16);
+    ++daysAdded;
+}
+
+ThermalGrid TemporalCompositor::result() const {
+    ThermalGrid grid;
+    grid.width = width;
+    grid.height = height;
+    grid.values.assign((size_t)width * height, 0.0f);
+    grid.valid.assign((size_t)width * height, 0);
+    threadPool().parallelFor(0, height, [&](int rowBegin, int rowEnd) {
+        std::vector<float> samples(medianDepth);
+        for (size_t idx = (size_t)rowBegin * width; idx < (size_t)rowEnd * width; ++idx) {
+            unsigned short count = counts[idx];
+            if (count == 0) continue;
+            if (mode == CompositeMode::Median) {
+                int numSamples = std::min((int)count, medianDepth);
+                std::copy(state.begin() + idx * medianDepth, state.begin() + idx * medianDepth + numSamples, samples.begin());
+                auto middle = samples.begin() + numSamples / 2;
+                std::nth_element(samples.begin(), middle, samples.begin() + numSamples);
+                float median = *middle;
+                if (numSamples % 2 == 0) median = 0.5f * (median + *std::max_element(samples.begin(), middle));
+                grid.values[idx] = median;
+            } else if (mode == CompositeMode::Mean) {
+                grid.values[idx] = state[idx] / count;
+            } else {
+                grid.values[idx] = state[idx];
+            }
+            grid.valid[idx] = 1;
+        }
+    }, 16);
+    return grid;
+}
+
+int TemporalCompositor::numDays() const {
+    return daysAdded;
+}
+
+ThermalGrid compositeThermalImages(const std::vector<std::string> &fileNames, CompositeMode mode, int medianDepth) {
+    std::unique_ptr<TemporalCompositor> compositor;
+    for (const auto &fileName : fileNames) {
+        int width, height, nrChannels;
+        unsigned char *pixels = stbi_load(fileName.c_str(), &width, &height, &nrChannels, STBI_rgb_alpha);
+        if (!pixels) {
+            std::cout << "Skipping thermal composite day " << fileName << std::endl;
+            continue;
+        }
+        // The first readable day fixes the composite's size
+        if (!compositor) compositor = std::make_unique<TemporalCompositor>(mode, width, height, medianDepth);
+        compositor->addDay(decodeThermalImage(pixels, width, height, STBI_rgb_alpha));
+        stbi_image_free(pixels);
+    }
+    if (!compositor) return ThermalGrid();
+    return compositor->result();
+}
\ No newline at end of file
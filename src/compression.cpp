@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cstring>
+
+#include <core/compression.h>
+
+constexpr int minMatch = 4;
+constexpr int hashBits = 14;
+constexpr size_t maxOffset = 65535;
+// The last bytes are always literals, so the decoder's match copy never has to stop short of a run
+constexpr size_t literalTail = 5;
+
+namespace {
+
+uint32_t read32(const unsigned char *p) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+uint32_t sequenceHash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - hashBits);
+}
+
+// Lengths past 15 continue in bytes of 255 and a final remainder byte
+void writeLength(std::vector<unsigned char> &out, size_t length) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back((unsigned char)length);
+}
+
+void writeSequence(std::vector<unsigned char> &out, const unsigned char *literals, size_t literalCount, size_t offset, size_t matchLength) {
+    size_t matchCode = matchLength >= minMatch ? matchLength - minMatch : 0;
+    out.push_back((unsigned char)((std::min(literalCount, (size_t)15) << 4) | std::min(matchCode, (size_t)15)));
+    if (literalCount >= 15) writeLength(out, literalCount - 15);
+    out.insert(out.end(), literals, literals + literalCount);
+    if (matchLength == 0) return;
+    out.push_back((unsigned char)(offset & 0xff));
+    out.push_back((unsigned char)(offset >> 8));
+    if (matchCode >= 15) writeLength(out, matchCode - 15);
+}
+
+} // namespace
+
+void compressBlock(const unsigned char *data, size_t size, std::vector<unsigned char> &compressed) {
+    std::vector<uint32_t> table((size_t)1 << hashBits, 0);
+    size_t anchor = 0, position = 0;
+    const size_t matchLimit = size > literalTail ? size - literalTail : 0;
+    while (position + minMatch <= matchLimit) {
+        uint32_t sequence = read32(data + position);
+        uint32_t &slot = table[sequenceHash(sequence)];
+        size_t candidate = slot;
+        slot = (uint32_t)position;
+        if (candidate >= position || position - candidate > maxOffset || read32(data + candidate) != sequence) {
+            // Skip faster through data that refuses to match
+            position += 1 + ((position - anchor) >> 6);
+            continue;
+        }
+        size_t length = minMatch;
+        while (position + length < matchLimit && data[candidate + length] == data[position + length]) ++length;
+        writeSequence(compressed, data + anchor, position - anchor, position - candidate, length);
+        position += length;
+        anchor = position;
+    }
+    writeSequence(compressed, data + anchor, size - anchor, 0, 0);
+}
+
+bool decompressBlock(const unsigned char *data, size_t size, unsigned char *out, size_t outSize) {
+    const unsigned char *in = data, *end = data + size;
+    size_t written = 0;
+    auto readLength = [&](size_t &length) {
+        unsigned char byte;
+        do {
+            if (in >= end) return false;
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+    while (in < end) {
+        unsigned char token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(literals)) return false;
+        if ((size_t)(end - in) < literals || outSize - written < literals) return false;
+        std::memcpy(out + written, in, literals);
+        in += literals;
+        written += literals;
+        if (in == end) break; // The final sequence carries literals only
+        if (end - in < 2) return false;
+        size_t offset = in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(length)) return false;
+        length += minMatch;
+        if (offset == 0 || offset > written || outSize - written < length) return false;
+        // Byte by byte, as overlapping matches repeat their own output
+        const unsigned char *source = out + written - offset;
+        for (size_t i = 0; i < length; ++i) out[written + i] = source[i];
+        written += length;
+    }
+    return written == outSize;
+}
+
+void shuffleBytes(const unsigned char *in, size_t count, size_t elementSize, unsigned char *out) {
+    for (size_t byte = 0; byte < elementSize; ++byte) {
+        unsigned char *plane = out + byte * count;
+        for (size_t i = 0; i < count; ++i) plane[i] = in[i * elementSize + byte];
+    }
+}
+
+void unshuffleBytes(const unsigned char *in, size_t count, size_t elementSize, unsigned char *out) {
+    for (size_t byte = 0; byte < elementSize; ++byte) {
+        const unsigned char *plane = in + byte * count;
+        for (size_t i = 0; i < count; ++i) out[i * elementSize + byte] = plane[i];
+    }
+}
+
+uint64_t hashBytes(const void *data, size_t size) {
+    // Eight bytes at a time through a multiply-xorshift mix, then the tail
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; ++i) hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    hash ^= hash >> 29;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    return hash ^ (hash >> 32);
+}
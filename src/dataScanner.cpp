@@ -1,13 +1,18 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <ctime>
 #include <sstream>
 #include <iomanip>
+#include <cstdlib>
 #include <curl/curl.h>
 
 #include <core/coordHandler.h>
 #include <core/dataScanner.h>
+#include <core/fileReader.h>
 
 const int epochTime = 1900, monthOffset = 1;
 const double latSteps = 180.0, longSteps = 360.0;
@@ -17,8 +22,9 @@ CURLM *multi = curl_multi_init();
 
 // Curl thermal PNG received data write callback
 size_t thermal_write_callback(char *ptr, size_t size, size_t nmemb, void *userdata) {
+    const std::string *fileName = (const std::string *)userdata;
     std::ofstream thermalImage;
-    thermalImage.open("thermalImage.png", std::ios::out | std::ios::app | std::ios::binary);
+    thermalImage.open(*fileName, std::ios::out | std::ios::app | std::ios::binary);
     thermalImage.write(ptr, nmemb);
     thermalImage.close();
     return nmemb;
@@ -33,9 +39,9 @@ size_t weather_write_callback(char *ptr, size_t size, size_t nmemb, void *userda
     return nmemb;
 }
 
-void thermalData(tm date) {
+void thermalData(tm date, const std::string &fileName) {
     // Avoid fetching duplicate data
-    std::ifstream thermalFile("thermalImage.png");
+    std::ifstream thermalFile(fileName);
     if (thermalFile.good()) return;
     std::ostringstream oss;
     oss << "https://gibs.earthdata.nasa.gov/wms/epsg4326/best/wms.cgi?"
@@ -58,6 +64,7 @@ void thermalData(tm date) {
         CURLcode res;
         curl_easy_setopt(curlHandle, CURLOPT_URL, thermalLink.c_str());
         curl_easy_setopt(curlHandle, CURLOPT_WRITEFUNCTION, &thermal_write_callback);
+        curl_easy_setopt(curlHandle, CURLOPT_WRITEDATA, &fileName);
         res = curl_easy_perform(curlHandle);
         if (res == CURLE_OK) {
             std::cout << "Curl thermal query executed successfully." << std::endl;
@@ -68,7 +75,8 @@ void thermalData(tm date) {
     }
 }
 
-void weatherData(double latitude, double longitude) {
+// Queue the current-conditions request for one point on the multi handle; null if curl could not make a handle
+CURL *weatherData(double latitude, double longitude) {
     std::ostringstream oss;
     oss << "https://api.open-meteo.com/v1/forecast?"
         << "latitude=" 
@@ -97,12 +105,15 @@ void weatherData(double latitude, double longitude) {
         curl_easy_setopt(curlHandle, CURLOPT_WRITEFUNCTION, &weather_write_callback);
         curl_multi_add_handle(multi, curlHandle);
     }
+    return curlHandle;
 }
 
-void localeWeatherData(double apiLat, double apiLong) {
+bool localeWeatherData(double apiLat, double apiLong, const std::atomic<bool> *cancel) {
     // Avoid fetching duplicate data
     std::fstream weatherFile("weatherData.txt");
-    if (weatherFile.good()) return;
+    if (weatherFile.good()) return true;
+    weatherFile.close();
+    std::vector<CURL *> pending;
     const int apiRateLimit = 400; // Empirical rate limit
     const double degreeDist = 1.0;
     int rateRoot = (int)sqrt(apiRateLimit) / 2;
@@ -110,13 +121,13 @@ void localeWeatherData(double apiLat, double apiLong) {
     if (!apiCoords.empty()) {
         for (int latitude = -rateRoot; latitude < rateRoot; ++latitude) {
             for (int longitude = -rateRoot; longitude < rateRoot; ++longitude) {
-                weatherData(apiLat + latitude * degreeOffset, apiLong + longitude * degreeOffset);
+                pending.push_back(weatherData(apiLat + latitude * degreeOffset, apiLong + longitude * degreeOffset));
             }
         }
     } else {
         std::cout << "Using API-Coords data." << std::endl;
         for (auto apiCoord : apiCoords) {
-            weatherData(apiCoord.latitude, apiCoord.longitude);
+            pending.push_back(weatherData(apiCoord.latitude, apiCoord.longitude));
         }
     }
     int numTransfers, numOk = 0, numFailed = 0;
@@ -124,8 +135,20 @@ void localeWeatherData(double apiLat, double apiLong) {
     CURLMcode mc = curl_multi_perform(multi, &numTransfers);
     while (numTransfers > 0)
     {
+        // Short waits so a cancel is seen promptly. The unfinished transfers are dropped along with the partial
+        // responses, so the next run fetches them again.
+        if (cancel && cancel->load()) {
+            for (CURL *handle : pending) {
+                if (!handle) continue;
+                curl_multi_remove_handle(multi, handle);
+                curl_easy_cleanup(handle);
+            }
+            std::remove("weatherData.txt");
+            std::cout << "Weather API calls cancelled after " << numOk + numFailed << " of " << pending.size() << std::endl;
+            return false;
+        }
         int numfds;
-        CURLMcode mc = curl_multi_wait(multi, nullptr, 0, 1000, &numfds);
+        CURLMcode mc = curl_multi_wait(multi, nullptr, 0, 100, &numfds);
         curl_multi_perform(multi, &numTransfers);
         CURLMsg *msg;
         int msgsLeft;
@@ -139,19 +162,83 @@ void localeWeatherData(double apiLat, double apiLong) {
                 }
                 curl_multi_remove_handle(multi, handle);
                 curl_easy_cleanup(handle);
+                std::replace(pending.begin(), pending.end(), handle, (CURL *)nullptr);
             }
         }
     }
     std::cout << "Weather API Calls - Ok: " + std::to_string(numOk) + " - Failed: " << std::to_string(numFailed) << std::endl;
+    return true;
 }
 
-Coords initializeData(std::string location) {
-    std::cout << "Scanning data sources." << std::endl;
+// Dated file the thermal layer of one day is cached in
+std::string thermalFileName(const tm &datetime) {
+    std::ostringstream oss;
+    oss << "thermalImage-"
+        << (epochTime + datetime.tm_year) << "-"
+        << std::setw(2) << std::setfill('0') << (monthOffset + datetime.tm_mon) << "-"
+        << std::setw(2) << std::setfill('0') << datetime.tm_mday
+        << ".png";
+    return oss.str();
+}
+
+// Local date numDays - 1 days ago down to today, oldest first
+std::vector<tm> recentDays(int numDays) {
+    std::vector<tm> days;
     time_t timestamp = time(&timestamp);
-    struct tm datetime = *localtime(&timestamp);
-    thermalData(datetime);
+    for (int day = numDays - 1; day >= 0; --day) {
+        time_t dayTimestamp = timestamp - day * 24 * 60 * 60;
+        days.push_back(*localtime(&dayTimestamp));
+    }
+    return days;
+}
+
+std::vector<std::string> thermalHistoryFiles(int numDays) {
+    std::vector<std::string> fileNames;
+    for (const tm &datetime : recentDays(numDays)) fileNames.push_back(thermalFileName(datetime));
+    return fileNames;
+}
+
+std::vector<std::string> thermalHistory(int numDays) {
+    std::vector<std::string> fileNames;
+    for (const tm &datetime : recentDays(numDays)) {
+        fileNames.push_back(thermalFileName(datetime));
+        thermalData(datetime, fileNames.back());
+    }
+    return fileNames;
+}
+
+std::vector<WeatherSample> loadWeatherSamples(const std::string &fileName, const std::string &variable) {
+    std::vector<WeatherSample> samples;
+    std::string contents = extractFileContents(fileName);
+    // Responses are appended back to back, each opening with its coordinates
+    const std::string recordKey = "{\"latitude\":", longitudeKey = "\"longitude\":", currentKey = "\"current\":{";
+    const std::string valueKey = "\"" + variable + "\":";
+    size_t record = contents.find(recordKey);
+    while (record != std::string::npos) {
+        size_t next = contents.find(recordKey, record + 1);
+        size_t end = next == std::string::npos ? contents.size() : next;
+        size_t longitude = contents.find(longitudeKey, record), current = contents.find(currentKey, record);
+        size_t value = current < end ? contents.find(valueKey, current) : std::string::npos;
+        if (longitude < end && value < end) {
+            const char *latStart = contents.c_str() + record + recordKey.size();
+            const char *lonStart = contents.c_str() + longitude + longitudeKey.size();
+            const char *valueStart = contents.c_str() + value + valueKey.size();
+            char *latEnd, *lonEnd, *valueEnd;
+            double lat = strtod(latStart, &latEnd), lon = strtod(lonStart, &lonEnd);
+            float sample = strtof(valueStart, &valueEnd);
+            // Skip null readings
+            if (latEnd != latStart && lonEnd != lonStart && valueEnd != valueStart) {
+                samples.push_back({Coords{lat, lon}, sample});
+            }
+        }
+        record = next;
+    }
+    return samples;
+}
+
+Coords locateCity(const std::string &location) {
     auto cityMap = initCityCoords();
     auto cityCoords = cityMap[location];
     std::cout << location << ": " << cityCoords.latitude << " " << cityCoords.longitude << std::endl;
     return cityCoords;
-}
\ No newline at end of file
+}
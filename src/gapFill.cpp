@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include <core/gapFill.h>
+#include <core/threadPool.h>
+
+constexpr double gapFillPi = 3.14159265358979323846;
+
+// One level of the inpainting pyramid
+struct InpaintLevel {
+    int width;
+    int height;
+    std::vector<float> values;
+    std::vector<unsigned char> known;
+};
+
+// Red-black over-relaxation of the unknown pixels towards the mean of their four neighbours.
+// Longitude wraps around the globe while the polar rows reflect onto themselves.
+void relaxLevel(InpaintLevel &level, int sweeps, const GapFillSettings &settings, ThreadPool &pool) {
+    const int width = level.width, height = level.height;
+    float *values = level.values.data();
+    const unsigned char *known = level.known.data();
+    const float omega = settings.relaxation;
+    for (int sweep = 0; sweep < sweeps; ++sweep) {
+        for (int color = 0; color < 2; ++color) {
+            pool.parallelFor(0, height, [&](int rowBegin, int rowEnd) {
+                for (int row = rowBegin; row < rowEnd; ++row) {
+                    const float *up = values + (size_t)std::max(row - 1, 0) * width;
+                    const float *down = values + (size_t)std::min(row + 1, height - 1) * width;
+                    float *centre = values + (size_t)row * width;
+                    const unsigned char *rowKnown = known + (size_t)row * width;
+                    for (int col = (row + color) & 1; col < width; col += 2) {
+                        if (rowKnown[col]) continue;
+                        int left = col == 0 ? width - 1 : col - 1;
+                        int right = col == width - 1 ? 0 : col + 1;
+                        float average = 0.25f * (up[col] + down[col] + centre[left] + centre[right]);
+                        centre[col] += omega * (average - centre[col]);
+                    }
+                }
+            }, settings.blockRows);
+        }
+    }
+}
+
+// Average the known children of each 2x2 block; a coarse pixel is known if any child is
+InpaintLevel restrictLevel(const InpaintLevel &fine, const GapFillSettings &settings, ThreadPool &pool) {
+    InpaintLevel coarse;
+    coarse.width = (fine.width + 1) / 2;
+    coarse.height = (fine.height + 1) / 2;
+    coarse.values.assign((size_t)coarse.width * coarse.height, 0.0f);
+    coarse.known.assign((size_t)coarse.width * coarse.height, 0);
+    pool.parallelFor(0, coarse.height, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            for (int col = 0; col < coarse.width; ++col) {
+                float sum = 0.0f;
+                int count = 0;
+                for (int dy = 0; dy < 2; ++dy) {
+                    int fineRow = std::min(2 * row + dy, fine.height - 1);
+                    for (int dx = 0; dx < 2; ++dx) {
+                        size_t fineIdx = (size_t)fineRow * fine.width + std::min(2 * col + dx, fine.width - 1);
+                        if (!fine.known[fineIdx]) continue;
+                        sum += fine.values[fineIdx];
+                        ++count;
+                    }
+                }
+                size_t idx = (size_t)row * coarse.width + col;
+                if (count > 0) {
+                    coarse.values[idx] = sum / count;
+                    coarse.known[idx] = 1;
+                }
+            }
+        }
+    }, settings.blockRows);
+    return coarse;
+}
+
+// Seed the unknown fine pixels with a bilinear interpolation of the coarse solution
+void prolongateLevel(const InpaintLevel &coarse, InpaintLevel &fine, const GapFillSettings &settings, ThreadPool &pool) {
+    pool.parallelFor(0, fine.height, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            float y = std::min(std::max((row + 0.5f) * 0.5f - 0.5f, 0.0f), (float)(coarse.height - 1));
+            int y0 = (int)y, y1 = std::min(y0 + 1, coarse.height - 1);
+            float fy = y - y0;
+            for (int col = 0; col < fine.width; ++col) {
+                size_t idx = (size_t)row * fine.width + col;
+                if (fine.known[idx]) continue;
+                float x = (col + 0.5f) * 0.5f - 0.5f;
+                int x0 = (int)std::floor(x);
+                float fx = x - x0;
+                x0 = (x0 + coarse.width) % coarse.width;
+                int x1 = (x0 + 1) % coarse.width;
+                const float *top = coarse.values.data() + (size_t)y0 * coarse.width;
+                const float *bottom = coarse.values.data() + (size_t)y1 * coarse.width;
+                float upper = top[x0] + fx * (top[x1] - top[x0]);
+                float lower = bottom[x0] + fx * (bottom[x1] - bottom[x0]);
+                fine.values[idx] = upper + fy * (lower - upper);
+            }
+        }
+    }, settings.blockRows);
+}
+
+// Harmonic inpainting of values wherever known is zero, using nested iteration from the coarsest level up
+void inpaintField(std::vector<float> &values, const std::vector<unsigned char> &known, int width, int height, const GapFillSettings &settings,
+                  ThreadPool &pool) {
+    std::vector<InpaintLevel> pyramid;
+    pyramid.push_back({width, height, std::move(values), known});
+    while (std::min(pyramid.back().width, pyramid.back().height) > settings.coarsestSize) {
+        InpaintLevel coarse = restrictLevel(pyramid.back(), settings, pool);
+        pyramid.push_back(std::move(coarse));
+    }
+
+    // Start the coarsest unknowns from the mean of the known pixels
+    InpaintLevel &coarsest = pyramid.back();
+    double sum = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < coarsest.values.size(); ++i) {
+        if (!coarsest.known[i]) continue;
+        sum += coarsest.values[i];
+        ++count;
+    }
+    float mean = count ? (float)(sum / count) : 0.0f;
+    for (size_t i = 0; i < coarsest.values.size(); ++i) {
+        if (!coarsest.known[i]) coarsest.values[i] = mean;
+    }
+    relaxLevel(coarsest, settings.coarsestSweeps, settings, pool);
+
+    for (int level = (int)pyramid.size() - 2; level >= 0; --level) {
+        prolongateLevel(pyramid[level + 1], pyramid[level], settings, pool);
+        relaxLevel(pyramid[level], settings.sweepsPerLevel, settings, pool);
+    }
+    values = std::move(pyramid.front().values);
+}
+
+void fillThermalGaps(ThermalGrid &grid, const ThermalGrid *previousDay, const GapFillSettings &settings, ThreadPool &pool) {
+    const size_t numPixels = grid.values.size();
+    if (std::find(grid.valid.begin(), grid.valid.end(), 1) == grid.valid.end()) return;
+    std::vector<unsigned char> known = grid.valid;
+
+    if (previousDay && previousDay->width == grid.width && previousDay->height == grid.height) {
+        // Inpaint today's departure from yesterday, then add it back onto yesterday's values
+        std::vector<float> anomaly(numPixels, 0.0f);
+        std::vector<unsigned char> anomalyKnown(numPixels, 0);
+        bool overlap = false;
+        for (size_t i = 0; i < numPixels; ++i) {
+            if (!grid.valid[i] || !previousDay->valid[i]) continue;
+            anomaly[i] = grid.values[i] - previousDay->values[i];
+            anomalyKnown[i] = 1;
+            overlap = true;
+        }
+        if (overlap) inpaintField(anomaly, anomalyKnown, grid.width, grid.height, settings, pool);
+        for (size_t i = 0; i < numPixels; ++i) {
+            if (grid.valid[i] || !previousDay->valid[i]) continue;
+            grid.values[i] = previousDay->values[i] + anomaly[i];
+            known[i] = 1;
+        }
+    }
+
+    inpaintField(grid.values, known, grid.width, grid.height, settings, pool);
+    std::fill(grid.valid.begin(), grid.valid.end(), 1);
+}
+
+void benchmarkGapFill() {
+    const int width = 2048, height = 1024, numClouds = 700, repeats = 3;
+    std::mt19937 rng(26);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    // Smooth temperatures with a little small-scale texture; yesterday is the same field with a broad anomaly
+    ThermalGrid truth, yesterday;
+    for (ThermalGrid *grid : {&truth, &yesterday}) {
+        grid->width = width;
+        grid->height = height;
+        grid->values.resize((size_t)width * height);
+        grid->valid.assign(grid->values.size(), 1);
+    }
+    for (int row = 0; row < height; ++row) {
+        double lat = gapFillPi / 2.0 - (row + 0.5) / height * gapFillPi;
+        for (int col = 0; col < width; ++col) {
+            double lon = (col + 0.5) / width * 2.0 * gapFillPi - gapFillPi;
+            size_t idx = (size_t)row * width + col;
+            truth.values[idx] = (float)(300.0 - 50.0 * std::sin(lat) * std::sin(lat) + 6.0 * std::sin(7.0 * lon) * std::cos(5.0 * lat) +
+                                        1.5 * std::sin(0.11 * col + 0.07 * row));
+            yesterday.values[idx] = truth.values[idx] - (float)(4.0 * std::cos(lat) * std::cos(2.0 * lon + 0.5));
+        }
+    }
+
+    // Round clouds of 4-60 pixels, wrapping in longitude, hide today's observations
+    ThermalGrid observed = truth;
+    for (int cloud = 0; cloud < numClouds; ++cloud) {
+        int centreRow = (int)(uniform(rng) * height), centreCol = (int)(uniform(rng) * width), radius = 4 + (int)(56.0 * uniform(rng) * uniform(rng));
+        for (int row = std::max(centreRow - radius, 0); row <= std::min(centreRow + radius, height - 1); ++row) {
+            for (int dx = -radius; dx <= radius; ++dx) {
+                int dy = row - centreRow;
+                if (dx * dx + dy * dy <= radius * radius) observed.valid[(size_t)row * width + (centreCol + dx + width) % width] = 0;
+            }
+        }
+    }
+    size_t hidden = std::count(observed.valid.begin(), observed.valid.end(), 0);
+
+    auto elapsed = [](std::chrono::steady_clock::time_point start) { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+    auto fill = [&](const ThermalGrid *previousDay, const GapFillSettings &settings, ThreadPool &pool, double &ms) {
+        ThermalGrid filled;
+        ms = 1e300;
+        for (int repeat = 0; repeat < repeats; ++repeat) {
+            filled = observed;
+            auto start = std::chrono::steady_clock::now();
+            fillThermalGaps(filled, previousDay, settings, pool);
+            ms = std::min(ms, elapsed(start));
+        }
+        return filled;
+    };
+    // RMS and largest error over the hidden pixels only
+    auto report = [&](const char *label, const ThermalGrid &filled, double ms) {
+        double sumSquares = 0.0, maxError = 0.0;
+        for (size_t idx = 0; idx < filled.values.size(); ++idx) {
+            if (observed.valid[idx]) continue;
+            double error = std::abs((double)filled.values[idx] - truth.values[idx]);
+            sumSquares += error * error;
+            maxError = std::max(maxError, error);
+        }
+        std::cout << "  " << std::left << std::setw(34) << label << std::right << std::fixed << std::setprecision(1) << std::setw(8) << ms << " ms, rms "
+                  << std::setprecision(3) << std::sqrt(sumSquares / hidden) << " K, max " << std::setprecision(2) << maxError << " K" << std::endl;
+    };
+
+    std::cout << "Gap fill benchmark, " << width << "x" << height << " grid, " << std::fixed << std::setprecision(1) << 100.0 * hidden / truth.values.size()
+              << "% hidden under " << numClouds << " clouds, best of " << repeats << std::endl;
+    double ms = 0.0;
+    const GapFillSettings defaults;
+    ThermalGrid filled = fill(nullptr, defaults, threadPool(), ms);
+    report("multigrid", filled, ms);
+    filled = fill(&yesterday, defaults, threadPool(), ms);
+    report("multigrid + previous day", filled, ms);
+    // Relaxation on the full grid alone, with as many sweeps as the pyramid's coarsest level gets
+    GapFillSettings singleLevel = defaults;
+    singleLevel.coarsestSize = std::max(width, height);
+    filled = fill(nullptr, singleLevel, threadPool(), ms);
+    report("single level, same sweeps", filled, ms);
+
+    double oneThread = 0.0;
+    for (unsigned int threads : {1u, 2u, 4u, 8u}) {
+        ThreadPool pool(threads);
+        fill(nullptr, defaults, pool, ms);
+        if (threads == 1) oneThread = ms;
+        std::cout << "  " << threads << " threads " << std::setprecision(1) << std::setw(7) << ms << " ms, " << std::setprecision(2) << oneThread / ms
+                  << "x, " << std::setprecision(0) << (double)width * height / ms * 1e-3 << " Mpixel/s" << std::endl;
+    }
+    for (int blockRows : {8, 32, 128}) {
+        GapFillSettings blocked = defaults;
+        blocked.blockRows = blockRows;
+        fill(nullptr, blocked, threadPool(), ms);
+        std::cout << "  " << std::setw(3) << blockRows << " rows per block " << std::setprecision(1) << std::setw(7) << ms << " ms" << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include <core/interpolation.h>
+#include <core/spatialIndex.h>
+#include <core/sphericalDelaunay.h>
+#include <core/threadPool.h>
+
+constexpr double interpolationPi = 3.14159265358979323846;
+constexpr int maxKrigingNeighbours = 32;
+
+// Great-circle angle subtended by a chord of the unit sphere
+inline double chordToAngle(double chordSquared) {
+    return 2.0 * std::asin(std::min(std::sqrt(chordSquared) * 0.5, 1.0));
+}
+
+// Exponential semivariogram gamma(h) = nugget + sill * (1 - exp(-h / range)), h in radians
+struct Variogram {
+    double nugget = 0.0;
+    double sill = 0.0;
+    double range = 1.0;
+
+    double covariance(double h) const {
+        return sill * std::exp(-h / range) + (h == 0.0 ? nugget : 0.0);
+    }
+};
+
+// Least-squares fit of the exponential model to the binned empirical semivariogram of a sample subset
+Variogram fitVariogram(const std::vector<WeatherSample> &samples, const std::vector<glm::dvec3> &positions) {
+    const int maxPairsSamples = 1000, numBins = 20;
+    int stride = std::max(1, (int)samples.size() / maxPairsSamples);
+    std::vector<int> subset;
+    for (int i = 0; i < (int)samples.size(); i += stride) subset.push_back(i);
+
+    double maxDistance = 0.0;
+    std::vector<std::pair<double, double>> pairs;
+    for (size_t a = 0; a < subset.size(); ++a) {
+        for (size_t b = a + 1; b < subset.size(); ++b) {
+            glm::dvec3 offset = positions[subset[a]] - positions[subset[b]];
+            double h = chordToAngle(glm::dot(offset, offset));
+            double difference = samples[subset[a]].value - samples[subset[b]].value;
+            pairs.emplace_back(h, 0.5 * difference * difference);
+            maxDistance = std::max(maxDistance, h);
+        }
+    }
+    Variogram variogram;
+    if (pairs.empty() || maxDistance <= 0.0) return variogram;
+
+    // Kriging only looks at nearby samples, so fit the lag range that matters
+    double binWidth = 0.5 * maxDistance / numBins;
+    std::vector<double> lagSum(numBins, 0.0), gammaSum(numBins, 0.0);
+    std::vector<int> counts(numBins, 0);
+    for (const auto &pair : pairs) {
+        int bin = (int)(pair.first / binWidth);
+        if (bin >= numBins) continue;
+        lagSum[bin] += pair.first;
+        gammaSum[bin] += pair.second;
+        ++counts[bin];
+    }
+    double bestError = 1e300;
+    for (int candidate = 0; candidate < 24; ++candidate) {
+        double range = binWidth * std::pow(2.0, candidate * 0.5 - 2.0);
+        // gamma is linear in (nugget, sill) for a fixed range: solve the 2x2 normal equations
+        double sxx = 0, sxy = 0, syy = 0, sx = 0, sy = 0, n = 0;
+        for (int bin = 0; bin < numBins; ++bin) {
+            if (!counts[bin]) continue;
+            double x = 1.0 - std::exp(-(lagSum[bin] / counts[bin]) / range), y = gammaSum[bin] / counts[bin];
+            sxx += counts[bin] * x * x;
+            sxy += counts[bin] * x * y;
+            sx += counts[bin] * x;
+            sy += counts[bin] * y;
+            syy += counts[bin] * y * y;
+            n += counts[bin];
+        }
+        double det = n * sxx - sx * sx;
+        if (std::fabs(det) < 1e-300) continue;
+        double sill = std::max((n * sxy - sx * sy) / det, 0.0);
+        double nugget = std::max((sy - sill * sx) / n, 0.0);
+        double error = syy - 2.0 * nugget * sy - 2.0 * sill * sxy + nugget * nugget * n + 2.0 * nugget * sill * sx + sill * sill * sxx;
+        if (error < bestError) {
+            bestError = error;
+            variogram = {nugget, sill, range};
+        }
+    }
+    return variogram;
+}
+
+// Solve the (n x n) system in place with partial pivoting; false when singular
+bool solveDense(double *matrix, double *rhs, int n) {
+    for (int col = 0; col < n; ++col) {
+        int pivot = col;
+        for (int row = col + 1; row < n; ++row) {
+            if (std::fabs(matrix[row * n + col]) > std::fabs(matrix[pivot * n + col])) pivot = row;
+        }
+        if (std::fabs(matrix[pivot * n + col]) < 1e-12) return false;
+        if (pivot != col) {
+            for (int k = 0; k < n; ++k) std::swap(matrix[col * n + k], matrix[pivot * n + k]);
+            std::swap(rhs[col], rhs[pivot]);
+        }
+        for (int row = col + 1; row < n; ++row) {
+            double factor = matrix[row * n + col] / matrix[col * n + col];
+            for (int k = col; k < n; ++k) matrix[row * n + k] -= factor * matrix[col * n + k];
+            rhs[row] -= factor * rhs[col];
+        }
+    }
+    for (int row = n - 1; row >= 0; --row) {
+        double sum = rhs[row];
+        for (int k = row + 1; k < n; ++k) sum -= matrix[row * n + k] * rhs[k];
+        rhs[row] = sum / matrix[row * n + row];
+    }
+    return true;
+}
+
+float inverseDistanceValue(const std::vector<WeatherSample> &samples, const std::vector<int> &indices, const std::vector<double> &chordsSquared, float power) {
+    double sum = 0.0, weightSum = 0.0;
+    for (size_t i = 0; i < indices.size(); ++i) {
+        double angle = chordToAngle(chordsSquared[i]);
+        if (angle < 1e-9) return samples[indices[i]].value;
+        double weight = std::pow(angle, -(double)power);
+        sum += weight * samples[indices[i]].value;
+        weightSum += weight;
+    }
+    return weightSum > 0.0 ? (float)(sum / weightSum) : 0.0f;
+}
+
+ThermalGrid interpolateSamples(const std::vector<WeatherSample> &samples, int width, int height, const InterpolationSettings &settings) {
+    ThermalGrid grid;
+    grid.width = width;
+    grid.height = height;
+    grid.values.assign((size_t)width * height, 0.0f);
+    grid.valid.assign((size_t)width * height, 0);
+    if (samples.empty()) return grid;
+
+    std::vector<Coords> coords;
+    std::vector<glm::dvec3> positions;
+    for (const auto &sample : samples) {
+        coords.push_back(sample.coords);
+        positions.push_back(coordsToUnitVector(sample.coords));
+    }
+    SphericalKdTree tree(coords);
+    const int k = std::min(std::max(settings.neighbours, 1), (int)samples.size());
+
+    std::unique_ptr<SphericalDelaunay> triangulation;
+    std::vector<float> auxiliaryValues;
+    if (settings.method == InterpolationMethod::NaturalNeighbour) {
+        triangulation = std::make_unique<SphericalDelaunay>(positions);
+        // Octahedron vertices take inverse distance values so queries far from the data stay bounded
+        const glm::dvec3 axes[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+        std::vector<int> indices;
+        std::vector<double> chordsSquared;
+        for (const auto &axis : axes) {
+            tree.nearest(axis, k, indices, chordsSquared);
+            auxiliaryValues.push_back(inverseDistanceValue(samples, indices, chordsSquared, settings.power));
+        }
+    }
+    Variogram variogram;
+    if (settings.method == InterpolationMethod::OrdinaryKriging) variogram = fitVariogram(samples, positions);
+
+    // Cell centre unit vectors are separable into per-row latitude and per-column longitude terms
+    std::vector<double> cosLon(width), sinLon(width);
+    for (int col = 0; col < width; ++col) {
+        double lon = (col + 0.5) / width * 2.0 * interpolationPi - interpolationPi;
+        cosLon[col] = std::cos(lon);
+        sinLon[col] = std::sin(lon);
+    }
+    threadPool().parallelFor(0, height, [&](int rowBegin, int rowEnd) {
+        std::vector<int> indices;
+        std::vector<double> chordsSquared, weights;
+        const int krigingSize = std::min(k, maxKrigingNeighbours) + 1;
+        std::vector<double> matrix(krigingSize * krigingSize), rhs(krigingSize);
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            double lat = interpolationPi / 2.0 - (row + 0.5) / height * interpolationPi;
+            double cosLat = std::cos(lat), sinLat = std::sin(lat);
+            int hint = -1;
+            for (int col = 0; col < width; ++col) {
+                glm::dvec3 query(cosLat * cosLon[col], cosLat * sinLon[col], sinLat);
+                size_t idx = (size_t)row * width + col;
+                float value = 0.0f;
+                switch (settings.method) {
+                    case InterpolationMethod::InverseDistance: {
+                        tree.nearest(query, k, indices, chordsSquared);
+                        value = inverseDistanceValue(samples, indices, chordsSquared, settings.power);
+                        break;
+                    }
+                    case InterpolationMethod::NaturalNeighbour: {
+                        triangulation->naturalNeighbours(query, indices, weights, hint);
+                        double sum = 0.0;
+                        for (size_t i = 0; i < indices.size(); ++i) {
+                            int vertex = indices[i];
+                            float vertexValue = vertex < triangulation->auxiliaryBegin() ? samples[vertex].value : auxiliaryValues[vertex - triangulation->auxiliaryBegin()];
+                            sum += weights[i] * vertexValue;
+                        }
+                        value = (float)sum;
+                        break;
+                    }
+                    case InterpolationMethod::OrdinaryKriging: {
+                        tree.nearest(query, krigingSize - 1, indices, chordsSquared);
+                        int n = (int)indices.size();
+                        if (chordToAngle(chordsSquared[0]) < 1e-9) {
+                            value = samples[indices[0]].value;
+                            break;
+                        }
+                        // Covariance form: [C 1; 1' 0] [w; mu] = [c0; 1]
+                        int size = n + 1;
+                        for (int a = 0; a < n; ++a) {
+                            for (int b = 0; b < n; ++b) {
+                                glm::dvec3 offset = positions[indices[a]] - positions[indices[b]];
+                                matrix[a * size + b] = variogram.covariance(a == b ? 0.0 : chordToAngle(glm::dot(offset, offset)));
+                            }
+                            matrix[a * size + n] = 1.0;
+                            matrix[n * size + a] = 1.0;
+                            rhs[a] = variogram.covariance(chordToAngle(chordsSquared[a]));
+                        }
+                        matrix[n * size + n] = 0.0;
+                        rhs[n] = 1.0;
+                        if (variogram.sill > 0.0 && solveDense(matrix.data(), rhs.data(), size)) {
+                            double sum = 0.0;
+                            for (int a = 0; a < n; ++a) sum += rhs[a] * samples[indices[a]].value;
+                            value = (float)sum;
+                        } else {
+                            value = inverseDistanceValue(samples, indices, chordsSquared, settings.power);
+                        }
+                        break;
+                    }
+                }
+                grid.values[idx] = value;
+                grid.valid[idx] = 1;
+            }
+        }
+    }, 4);
+    return grid;
+}
+
+void benchmarkInterpolation() {
+    const int width = 720, height = 360;
+    auto field = [](double lat, double lon) {
+        double phi = lat * interpolationPi / 180.0, lambda = lon * interpolationPi / 180.0;
+        return 280.0 + 20.0 * std::cos(2.0 * phi) + 5.0 * std::sin(3.0 * lambda) * std::cos(phi);
+    };
+    const char *names[3] = {"inverse distance", "natural neighbour", "ordinary kriging"};
+    std::cout << "Interpolation benchmark (" << width << "x" << height << " grid, " << threadPool().size() << " threads)" << std::endl;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    for (int numSamples : {1000, 10000, 100000}) {
+        std::vector<WeatherSample> samples(numSamples);
+        for (auto &sample : samples) {
+            // Uniform on the sphere: uniform in sin(latitude)
+            double lat = std::asin(uniform(rng)) * 180.0 / interpolationPi, lon = uniform(rng) * 180.0;
+            sample = {Coords{lat, lon}, (float)field(lat, lon)};
+        }
+        for (int method = 0; method < 3; ++method) {
+            InterpolationSettings settings;
+            settings.method = (InterpolationMethod)method;
+            auto start = std::chrono::steady_clock::now();
+            ThermalGrid grid = interpolateSamples(samples, width, height, settings);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            double squaredError = 0.0;
+            for (int row = 0; row < height; ++row) {
+                for (int col = 0; col < width; ++col) {
+                    double error = grid.values[(size_t)row * width + col] - field(90.0 - (row + 0.5) * 180.0 / height, (col + 0.5) * 360.0 / width - 180.0);
+                    squaredError += error * error;
+                }
+            }
+            std::cout << std::setw(7) << numSamples << " samples  " << std::setw(18) << names[method] << "  "
+                      << std::fixed << std::setprecision(1) << std::setw(9) << ms << " ms  rmse "
+                      << std::setprecision(3) << std::sqrt(squaredError / ((double)width * height)) << " K" << std::endl;
+        }
+    }
+}
\ No newline at end of file
@@ -1,13 +1,43 @@
+#include <atomic>
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <memory>
+#include <thread>
 
 #include <core/fileReader.h>
 #include <core/dataScanner.h>
+#include <core/gapFill.h>
+#include <core/compositor.h>
+#include <core/interpolation.h>
+#include <core/reduction.h>
+#include <core/reprojection.h>
+#include <core/taskGraph.h>
+#include <core/zonalStats.h>
 #include <renderLogic/render.h>
+#include <simulation/advection.h>
+#include <simulation/checkpoint.h>
+#include <simulation/columnRadiation.h>
+#include <simulation/decomposition.h>
+#include <simulation/energyBalance.h>
+#include <simulation/ensemble.h>
+#include <simulation/fieldStore.h>
+#include <simulation/multigrid.h>
+#include <simulation/packedField.h>
+#include <simulation/preview.h>
+#include <simulation/scheduler.h>
+#include <simulation/slabOcean.h>
+#include <simulation/sparseSolver.h>
+#include <simulation/spectral.h>
+#include <simulation/surfaceMask.h>
+#include <simulation/sphericalMesh.h>
+#include <simulation/tiledStencil.h>
+#include <simulation/verticalDiffusion.h>
 
 // Globals
 const std::string filePath = __FILE__;
 bool thermalView = true;
+const int compositeDays = 4;
 
 // Keyboard input
 void processInput(GLFWwindow *window) {
@@ -25,7 +55,71 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
 }
 
+// Headless benchmark runs, selected by name
+int runBenchmark(const std::string &name) {
+    if (name == "interpolation") {
+        benchmarkInterpolation();
+    } else if (name == "simulation") {
+        benchmarkEnergyBalance();
+    } else if (name == "advection") {
+        benchmarkAdvection();
+    } else if (name == "scheduler") {
+        benchmarkScheduler();
+    } else if (name == "mesh") {
+        benchmarkSphericalMesh();
+    } else if (name == "multigrid") {
+        benchmarkMultigrid();
+    } else if (name == "decomposition") {
+        benchmarkDecomposition();
+    } else if (name == "checkpoint") {
+        benchmarkCheckpoint();
+    } else if (name == "precision") {
+        benchmarkMixedPrecision();
+    } else if (name == "ensemble") {
+        benchmarkEnsemble();
+    } else if (name == "reduction") {
+        benchmarkReduction();
+    } else if (name == "stencil") {
+        benchmarkTiledStencils();
+    } else if (name == "tasks") {
+        benchmarkTaskGraph();
+    } else if (name == "radiation") {
+        benchmarkColumnRadiation();
+    } else if (name == "spectral") {
+        benchmarkSpectralCore();
+    } else if (name == "surface") {
+        benchmarkSurfaceMask();
+    } else if (name == "store") {
+        benchmarkFieldStore();
+    } else if (name == "preview") {
+        benchmarkPreview();
+    } else if (name == "ocean") {
+        benchmarkSlabOcean();
+    } else if (name == "vertical") {
+        benchmarkVerticalDiffusion();
+    } else if (name == "sparse") {
+        benchmarkSparseSolver();
+    } else if (name == "reprojection") {
+        benchmarkReprojection();
+    } else if (name == "zonal") {
+        benchmarkZonalStats();
+    } else if (name == "inpainting") {
+        benchmarkGapFill();
+    } else {
+        std::cout << "Unknown benchmark: " << name << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
 int main(int argc, char **argv) {
+    // Benchmarks run without a window: Simulation --benchmark <name>
+    if (argc > 2 && std::string(argv[1]) == "--benchmark") return runBenchmark(argv[2]);
+    const auto launchTime = std::chrono::steady_clock::now();
+    // Simulation --preview [location]: show the simulated field coarse at once, refining while the window runs
+    const bool previewMode = argc > 1 && std::string(argv[1]) == "--preview";
+    const int firstLocationArg = previewMode ? 2 : 1;
+
     // Initialization
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -54,84 +148,145 @@ int main(int argc, char **argv) {
     glViewport(0, 0, 1200, 900);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
-    // Vertex Shader
-    const std::string vsFile = filePath + "\\..\\renderLogic\\vertexShader.vert";
-    const std::string vertexShaderSource = extractFileContents(vsFile);
-    const char *vsShaderSource = vertexShaderSource.c_str();
-    unsigned int vertexShader;
-    vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vsShaderSource, NULL);
-    glCompileShader(vertexShader);
-    
-    int  success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-    } else std::cout << "Compiled vertex Shader." << std::endl;
-
-    // Fragment Shader
-    const std::string fsFile = filePath + "\\..\\renderLogic\\fragmentShader.frag";
-    const std::string fragmentShaderSource = extractFileContents(fsFile);
-    const char *fsShaderSource = fragmentShaderSource.c_str();
-    unsigned int fragmentShader;
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fsShaderSource, NULL);
-    glCompileShader(fragmentShader);
-
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-    } else std::cout << "Compiled fragment Shader." << std::endl;
-
-    // Shader program
-    unsigned int shaderProgram;
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if(!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKAGE_FAILED\n" << infoLog << std::endl;
-    } else std::cout << "Linked shader program." << std::endl;
-
-    glUseProgram(shaderProgram);
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    Coords cityCoords;
-    // Data collection
-    if (argc > 1) {
-        std::string location = "";
-        for (int i = 1; i < argc; ++i) {
+    // Startup runs as a task graph: downloads, file reads and texture decoding overlap, while everything that
+    // touches the GL context stays on this thread
+    std::string location = "Oakville Canada"; // Default location
+    if (argc > firstLocationArg) {
+        location = "";
+        for (int i = firstLocationArg; i < argc; ++i) {
             location += std::string(argv[i]);
             if (i != argc - 1) location += " ";
         }
-        cityCoords = initializeData(location);
-    } else {
-        // Default location
-        cityCoords = initializeData("Oakville Canada");
     }
+    std::string vertexShaderSource, fragmentShaderSource;
+    unsigned int shaderProgram = 0;
+    Coords cityCoords;
+    ThermalGrid thermalComposite;
+    std::unique_ptr<ProgressiveSimulation> preview;
+    RenderAssets renderAssets;
+    TaskGraph startup;
 
+    TaskGraph::TaskId readShaders = startup.add("readShaders", [&]() {
+        vertexShaderSource = extractFileContents(filePath + "\\..\\renderLogic\\vertexShader.vert");
+        fragmentShaderSource = extractFileContents(filePath + "\\..\\renderLogic\\fragmentShader.frag");
+    });
+    startup.add("compileShaders", [&]() {
+        // Vertex Shader
+        const char *vsShaderSource = vertexShaderSource.c_str();
+        unsigned int vertexShader;
+        vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertexShader, 1, &vsShaderSource, NULL);
+        glCompileShader(vertexShader);
+
+        int  success;
+        char infoLog[512];
+        glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        } else std::cout << "Compiled vertex Shader." << std::endl;
+
+        // Fragment Shader
+        const char *fsShaderSource = fragmentShaderSource.c_str();
+        unsigned int fragmentShader;
+        fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragmentShader, 1, &fsShaderSource, NULL);
+        glCompileShader(fragmentShader);
+
+        glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        } else std::cout << "Compiled fragment Shader." << std::endl;
+
+        // Shader program
+        shaderProgram = glCreateProgram();
+        glAttachShader(shaderProgram, vertexShader);
+        glAttachShader(shaderProgram, fragmentShader);
+        glLinkProgram(shaderProgram);
+
+        glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+        if(!success) {
+            glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::PROGRAM::LINKAGE_FAILED\n" << infoLog << std::endl;
+        } else std::cout << "Linked shader program." << std::endl;
+
+        glUseProgram(shaderProgram);
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+    }, {readShaders}, 0, TaskAffinity::MainThread);
+
+    // Data collection. The downloads take turns: curl's lazy global setup and localtime are not thread safe.
+    // The composite's history includes today and yesterday, so there is no separate latest-image download.
+    std::cout << "Scanning data sources." << std::endl;
+    TaskGraph::TaskId cities = startup.add("cities", [&]() { cityCoords = locateCity(location); });
+    TaskGraph::TaskId assets;
+    if (previewMode) {
+        // The preview needs one image, not the composite: the newest already on disk, fetched only when there is
+        // none. Level 0 decodes a strided sample of it, so a frame is waiting when the window opens.
+        startup.add("preview", [&]() {
+            std::vector<unsigned char> pixels;
+            int width, height;
+            if (!loadLatestThermalImage(compositeDays, pixels, width, height)) {
+                thermalHistory(1);
+                if (!loadLatestThermalImage(1, pixels, width, height)) {
+                    std::cout << "No thermal image to preview" << std::endl;
+                    return;
+                }
+            }
+            preview = std::make_unique<ProgressiveSimulation>(std::move(pixels), width, height, EnergyBalanceParams());
+            preview->start();
+        }, {}, 2);
+        // The preview's frames take the thermal texture's place
+        assets = startup.add("renderAssets", [&]() {
+            renderAssets = prepareRenderAssets(cityCoords, nullptr, false);
+        }, {cities}, 1);
+    } else {
+        // Latest valid observation over the past few days fills most cloud gaps
+        TaskGraph::TaskId history = startup.add("composite", [&]() {
+            thermalComposite = compositeThermalImages(thermalHistory(compositeDays), CompositeMode::LatestValid);
+        }, {}, 2);
+        assets = startup.add("renderAssets", [&]() {
+            renderAssets = prepareRenderAssets(cityCoords, &thermalComposite);
+        }, {cities, history}, 1);
+    }
     // Initialize objects
-    initializeObjects(cityCoords);
+    startup.add("uploadObjects", [&]() { initializeObjects(renderAssets); }, {assets}, 0, TaskAffinity::MainThread);
 
-    localeWeatherData(cityCoords.latitude, cityCoords.longitude);
+    if (!startup.run()) return -1;
+    startup.printTimings(std::cout);
+
+    // Weather stations sit on the pixels the city marker covers. On a first run that is hundreds of requests, so
+    // they finish behind the event loop; the preview's later levels then advect with the observed wind. Closing the
+    // window cancels whatever is still in flight.
+    std::atomic<bool> stopWeather{false};
+    std::thread weather([&]() {
+        if (!localeWeatherData(cityCoords.latitude, cityCoords.longitude, &stopWeather)) return;
+        if (preview) preview->setWind(loadWeatherSamples("weatherData.txt", "wind_speed_10m"), loadWeatherSamples("weatherData.txt", "wind_direction_10m"));
+    });
 
     // Event loop
+    PreviewFrame previewFrame;
+    bool firstPreviewFrame = true;
     while(!glfwWindowShouldClose(window))
     {
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f );
         glClear(GL_COLOR_BUFFER_BIT);
         processInput(window);
         glfwPollEvents();
+        const bool newPreviewFrame = preview && preview->takeFrame(previewFrame);
+        if (newPreviewFrame) uploadFieldFrame(previewFrame.packed);
         renderSimulation(shaderProgram, cityCoords, thermalView);
         glfwSwapBuffers(window);
+        if (newPreviewFrame && firstPreviewFrame) {
+            const double sinceLaunch = std::chrono::duration<double>(std::chrono::steady_clock::now() - launchTime).count();
+            std::cout << "First preview frame on screen " << sinceLaunch * 1e3 << " ms after launch (" << previewFrame.resolution << " deg, ready "
+                      << previewFrame.seconds * 1e3 << " ms after its image loaded)" << std::endl;
+            firstPreviewFrame = false;
+        }
     }
+    stopWeather = true;
+    weather.join();
   
     glfwTerminate();
     return 0;
@@ -0,0 +1,86 @@
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+
+#include <core/reduction.h>
+
+namespace {
+
+template <typename T>
+double leafSum(const T *values, size_t count, size_t stride) {
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i) sum += values[i * stride];
+    return sum;
+}
+
+// Recursion of the tree combinePairwise walks bottom up: the left half holds the largest power of two of leaves
+// below the total
+template <typename T>
+double treeSum(const T *values, size_t count, size_t stride) {
+    const size_t leaves = (count + reductionLeaf - 1) / reductionLeaf;
+    if (leaves <= 1) return leafSum(values, count, stride);
+    size_t left = 1;
+    while (left * 2 < leaves) left *= 2;
+    const size_t split = left * reductionLeaf;
+    return treeSum(values, split, stride) + treeSum(values + split * stride, count - split, stride);
+}
+
+uint64_t sumBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, 8);
+    return bits;
+}
+
+} // namespace
+
+double pairwiseSum(const double *values, size_t count, size_t stride) {
+    return treeSum(values, count, stride);
+}
+
+double pairwiseSum(const float *values, size_t count, size_t stride) {
+    return treeSum(values, count, stride);
+}
+
+void benchmarkReduction() {
+    // Area-weighted terms of a 0.1 deg field: magnitudes over several decades and both signs, as in an energy budget
+    const int count = 1800 * 3600;
+    std::vector<double> values(count);
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> exponent(-3.0, 3.0);
+    for (double &value : values) value = (generator() & 1 ? 1.0 : -1.0) * std::pow(10.0, exponent(generator));
+    const double reference = pairwiseSum(values.data(), values.size());
+    const int repeats = 5;
+
+    std::cout << "Reduction benchmark: " << count << " doubles, best of " << repeats << std::endl;
+    for (unsigned int threads : {1u, 2u, 3u, 4u, 8u}) {
+        ThreadPool pool(threads);
+        // Naive: each block sums in order and adds into the total in whatever order blocks finish
+        double naive = 0.0, naiveSeconds = 1e300, deterministic = 0.0, deterministicSeconds = 1e300;
+        for (int repeat = 0; repeat < repeats; ++repeat) {
+            auto start = std::chrono::steady_clock::now();
+            std::mutex mutex;
+            double total = 0.0;
+            pool.parallelFor(0, count, [&](int begin, int end) {
+                double sum = 0.0;
+                for (int i = begin; i < end; ++i) sum += values[i];
+                std::lock_guard<std::mutex> lock(mutex);
+                total += sum;
+            }, 4096);
+            naiveSeconds = std::min(naiveSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            naive = total;
+
+            start = std::chrono::steady_clock::now();
+            deterministic = reduceSum(0, count, reductionLeaf, [&](int i) { return values[i]; }, pool);
+            deterministicSeconds = std::min(deterministicSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::cout << "  " << threads << " threads  naive " << std::fixed << std::setprecision(2) << std::setw(6) << naiveSeconds * 1e3 << " ms "
+                  << std::hexfloat << naive << std::fixed << "  deterministic " << std::setw(6) << deterministicSeconds * 1e3 << " ms (" << std::setprecision(2)
+                  << deterministicSeconds / naiveSeconds << "x) " << (sumBits(deterministic) == sumBits(reference) ? "identical to" : "DIFFERS from")
+                  << " the serial pairwise sum" << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
@@ -5,13 +5,40 @@ out vec4 FragColor;
 uniform sampler2D thermalTexture;
 uniform sampler2D physicalTexture;
 uniform bool      thermalView;
+// Simulated field: R16F texels holding Kelvin minus fieldOffset
+uniform sampler2D fieldTexture;
+uniform bool      fieldView;
+uniform float     fieldOffset;
+uniform vec2      thermalRange; // Kelvin at the cold and hot ends of the colormap
+uniform vec2      markerCoord;  // Texture coordinates of the city
+
+// Same violet-to-red hue ramp as encodeThermalImage
+vec3 thermalColour(float kelvin)
+{
+    float t = clamp((kelvin - thermalRange.x) / (thermalRange.y - thermalRange.x), 0.0, 1.0);
+    float hue = (1.0 - t) * 4.5;
+    float x = 1.0 - abs(mod(hue, 2.0) - 1.0);
+    if (hue < 1.0) return vec3(1.0, x, 0.0);
+    if (hue < 2.0) return vec3(x, 1.0, 0.0);
+    if (hue < 3.0) return vec3(0.0, 1.0, x);
+    if (hue < 4.0) return vec3(0.0, x, 1.0);
+    return vec3(x, 0.0, 1.0);
+}
 
 void main()
 {
-    if (thermalView) 
+    if (thermalView && fieldView)
+    {
+        vec3 colour = thermalColour(texture(fieldTexture, TexCoord).r + fieldOffset);
+        // City marker: 5 texels of the 2048 x 1024 thermal image, whatever the field's resolution
+        vec2 offset = TexCoord - markerCoord;
+        offset.x -= floor(offset.x + 0.5);
+        if (length(offset * vec2(2048.0, 1024.0)) < 5.0) colour = vec3(1.0);
+        FragColor = mix(vec4(colour, 1.0), texture(physicalTexture, TexCoord), 0.5);
+    } else if (thermalView) 
     {
         FragColor = mix(texture(thermalTexture, TexCoord), texture(physicalTexture, TexCoord), 0.5);
     } else {
         FragColor = texture(physicalTexture, TexCoord);
     }
-}
\ No newline at end of file
+}
@@ -1,5 +1,6 @@
 #define STB_IMAGE_IMPLEMENTATION
 
+#include <algorithm>
 #include <vector>
 #include <iostream>
 
@@ -7,12 +8,14 @@
 #include <renderLogic/stb_image.h>
 #include <core/coordHandler.h>
 #include <core/dataScanner.h>
+#include <core/thermalGrid.h>
+#include <core/gapFill.h>
+#include <simulation/sphericalMesh.h>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
 // Constants
-constexpr int longitudinalDivisor = 18;
-constexpr int latitudinalDivisor = 18;
+constexpr int planetMeshDivisions = 24;
 constexpr int dimensionality = 3;
 constexpr float PI = 3.14f;
 constexpr float longitudeCorrection = -89.75f;
@@ -22,78 +25,94 @@ std::vector<Coords> apiCoords;
 // Planet
 std::vector<float> planetVertices;
 std::vector<unsigned int> planetIndices;
-glm::vec4 planetNormal = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f);
 
 unsigned int planetVBO;
 unsigned int planetVAO;
 unsigned int planetEBO;
 unsigned int thermalTexture;
 unsigned int physicalTexture;
+unsigned int fieldTexture = 0; // Simulated field, once one has been uploaded
+float fieldOffset = 0.0f;
 unsigned int pointVAO, pointVBO;
 
-void initializeObjects(Coords cityCoords) {
-    // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_PROGRAM_POINT_SIZE);
-    glCullFace(GL_BACK);
-    // Vertices
-    planetVertices.push_back(planetNormal.x);
-    planetVertices.push_back(planetNormal.y);
-    planetVertices.push_back(planetNormal.z);
-    // Texture Coords
-    planetVertices.push_back(0.5f);
-    planetVertices.push_back(0.0f);
-    for (int latitude = 1; latitude < latitudinalDivisor; ++latitude) {
-        auto latNormal = glm::rotate(glm::mat4(1.0f), (float)latitude * PI / 18.0f, glm::vec3(0.0f, 0.0f, 1.0f)) * planetNormal;
-        for (int longitude = 0; longitude <= longitudinalDivisor; ++longitude) {
-            int lonWrapped = longitude % longitudinalDivisor;
-            auto rotNormal = glm::rotate(glm::mat4(1.0f), (float)lonWrapped * 2 * PI / 18.0f, glm::vec3(0.0f, 1.0f, 0.0f)) * latNormal;
-            planetVertices.push_back(rotNormal.x);
-            planetVertices.push_back(rotNormal.y);
-            planetVertices.push_back(rotNormal.z);
-            // Texture Coords
-            float u = (longitude == longitudinalDivisor)
-                ? 1.0f
-                : (float)(longitude) / (float)(longitudinalDivisor);
-            planetVertices.push_back(u);
-            planetVertices.push_back((float)latitude / (float)latitudinalDivisor);
-        }
+RenderAssets prepareRenderAssets(Coords cityCoords, const ThermalGrid *thermalComposite, bool loadThermal) {
+    RenderAssets assets;
+    // Vertices & Indices
+    SphericalMesh planetMesh = makeIcosahedralMesh(planetMeshDivisions);
+    buildRenderMesh(planetMesh, assets.planetVertices, assets.planetIndices);
+
+    // Thermal Texture
+    int width = 0, height = 0, nrChannels;
+    const int imgHeight = 512, imgWidth = 1024;
+    unsigned char *thermalData = nullptr;
+    if (loadThermal && thermalComposite && !thermalComposite->values.empty()) {
+        // Multi-day composite stands in for the single day's image
+        width = thermalComposite->width;
+        height = thermalComposite->height;
+        ThermalGrid thermalGrid = *thermalComposite;
+        fillThermalGaps(thermalGrid);
+        assets.thermalPixels.resize((size_t)width * height * STBI_rgb_alpha);
+        encodeThermalImage(thermalGrid, assets.thermalPixels.data(), STBI_rgb_alpha);
+        thermalData = assets.thermalPixels.data();
+    } else if (loadThermal) {
+        thermalData = stbi_load(thermalHistoryFiles(1).back().c_str(), &width, &height, &nrChannels, STBI_rgb_alpha);
     }
-    planetVertices.push_back(-planetNormal.x);
-    planetVertices.push_back(-planetNormal.y);
-    planetVertices.push_back(-planetNormal.z);
-    // Texture Coords
-    planetVertices.push_back(0.5f);
-    planetVertices.push_back(1.0f);
-    // Indices
-    // \- Top
-    for (int longitude = 0; longitude < longitudinalDivisor; ++longitude) {
-        int next = (longitude + 1) % longitudinalDivisor;
-        planetIndices.push_back(0);
-        planetIndices.push_back(1 + longitude);
-        planetIndices.push_back(1 + next);
+    nrChannels = STBI_rgb_alpha;
+    // Fill cloud & ocean gaps before the city marker is drawn in
+    if (thermalData && assets.thermalPixels.empty()) {
+        ThermalGrid thermalGrid = decodeThermalImage(thermalData, width, height, nrChannels);
+        int prevWidth, prevHeight, prevChannels;
+        unsigned char *previousData = stbi_load(thermalHistoryFiles(2).front().c_str(), &prevWidth, &prevHeight, &prevChannels, STBI_rgb_alpha);
+        if (previousData) {
+            ThermalGrid previousGrid = decodeThermalImage(previousData, prevWidth, prevHeight, STBI_rgb_alpha);
+            fillThermalGaps(thermalGrid, &previousGrid);
+        } else {
+            fillThermalGaps(thermalGrid);
+        }
+        stbi_image_free(previousData);
+        encodeThermalImage(thermalGrid, thermalData, nrChannels);
+        assets.thermalPixels.assign(thermalData, thermalData + (size_t)width * height * nrChannels);
+        stbi_image_free(thermalData);
+        thermalData = assets.thermalPixels.data();
     }
-    // \- Sphere
-    int ringWidth = longitudinalDivisor + 1;
-    for (int latitude = 0; latitude < latitudinalDivisor - 2; ++latitude) {
-        for (int longitude = 0; longitude < longitudinalDivisor; ++longitude) {
-            planetIndices.push_back(1 + latitude * ringWidth + longitude);
-            planetIndices.push_back(1 + (latitude + 1) * ringWidth + longitude);
-            planetIndices.push_back(1 + latitude * ringWidth + longitude + 1);
-
-            planetIndices.push_back(1 + (latitude + 1) * ringWidth + longitude + 1);
-            planetIndices.push_back(1 + latitude * ringWidth + longitude + 1);
-            planetIndices.push_back(1 + (latitude + 1) * ringWidth + longitude);
+    // The marker's pixels are the weather query points, with or without a thermal image to draw them into
+    int targetRow = -cityCoords.latitude / 90.0 * imgHeight + imgHeight, targetCol = cityCoords.longitude / 180.0 * imgWidth + imgWidth, targetPixelRadius = 5;
+    for (int row = std::max(targetRow - targetPixelRadius, 0); row <= std::min(targetRow + targetPixelRadius, 1023); ++row) {
+        for (int col = std::max(targetCol - targetPixelRadius, 0); col <= std::min(targetCol + targetPixelRadius, 2047); ++col) {
+            if (pow(abs(targetRow - row), 2) + pow(abs(targetCol - col), 2) < pow(targetPixelRadius, 2)) {
+                Coords coords{(double)(-row + imgHeight) / imgHeight * 90.0, (double)(col - imgWidth) / imgWidth * 180};
+                apiCoords.push_back(coords);
+                if (!thermalData) continue;
+                unsigned char* pixOffset = thermalData + (row * 2048 + col) * nrChannels;
+                pixOffset[0] = 255;
+                pixOffset[1] = 255;
+                pixOffset[2] = 255;
+            }
         }
     }
-    // \- Bottom
-    int numVert = planetVertices.size() / 5, botVert = numVert - 1, firstOnRing = botVert - (longitudinalDivisor + 1);
-    for (int longitude = 0; longitude < longitudinalDivisor; ++longitude) {
-        int next = (longitude + 1) % longitudinalDivisor;
-        planetIndices.push_back(botVert);
-        planetIndices.push_back(firstOnRing + next);
-        planetIndices.push_back(firstOnRing + longitude);
+    if (thermalData) {
+        assets.thermalWidth = width;
+        assets.thermalHeight = height;
+    }
+
+    // Physical Texture
+    unsigned char *physData = stbi_load("physicalMap.jpg", &width, &height, &nrChannels, 0);
+    if (physData) {
+        assets.physicalPixels.assign(physData, physData + (size_t)width * height * nrChannels);
+        assets.physicalWidth = width;
+        assets.physicalHeight = height;
     }
+    stbi_image_free(physData);
+    return assets;
+}
+
+void initializeObjects(const RenderAssets &assets) {
+    // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glCullFace(GL_BACK);
+    planetVertices = assets.planetVertices;
+    planetIndices = assets.planetIndices;
 
     // Planet
     glGenBuffers(1, &planetVBO);
@@ -111,53 +130,35 @@ void initializeObjects(Coords cityCoords) {
     // Thermal Texture
     glGenTextures(1, &thermalTexture);
     glBindTexture(GL_TEXTURE_2D, thermalTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    // Planet mesh cells straddling the antimeridian sample just past u = 0 / 1
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
-    int width, height, nrChannels;
-    const int imgHeight = 512, imgWidth = 1024;
-    unsigned char *thermalData = stbi_load("thermalImage.png", &width, &height, &nrChannels, 0);
-    int targetRow = -cityCoords.latitude / 90.0 * imgHeight + imgHeight, targetCol = cityCoords.longitude / 180.0 * imgWidth + imgWidth, targetPixelRadius = 5;
-    for (int row = 0; row < 1024; ++row) {
-        for (int col = 0; col < 2048; ++col) {
-            unsigned char* pixOffset = thermalData + (row * 2048 + col) * nrChannels;
-            if (pow(abs(targetRow - row), 2) + pow(abs(targetCol - col), 2) < pow(targetPixelRadius, 2)) {
-                Coords coords{(double)(-row + imgHeight) / imgHeight * 90.0, (double)(col - imgWidth) / imgWidth * 180};
-                apiCoords.push_back(coords);
-                pixOffset[0] = 255;
-                pixOffset[1] = 255;
-                pixOffset[2] = 255;
-            }
-        }    
-    }
-    if (thermalData) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, thermalData);
+    if (!assets.thermalPixels.empty()) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, assets.thermalWidth, assets.thermalHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, assets.thermalPixels.data());
         glGenerateMipmap(GL_TEXTURE_2D);
     } else {
         std::cout << "Failed to load texture" << std::endl;
     }
-    stbi_image_free(thermalData);
 
     // Physical Texture
     glGenTextures(1, &physicalTexture);
     glBindTexture(GL_TEXTURE_2D, physicalTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
-    unsigned char *physData = stbi_load("physicalMap.jpg", &width, &height, &nrChannels, 0);
-    if (physData) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, physData);
+    if (!assets.physicalPixels.empty()) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, assets.physicalWidth, assets.physicalHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, assets.physicalPixels.data());
         glGenerateMipmap(GL_TEXTURE_2D);
     } else {
         std::cout << "Failed to load texture" << std::endl;
     }
-    stbi_image_free(physData);
 
     // Point
     // float pointPos[] = { 0.0f, 0.0f, 0.0f};
@@ -191,6 +192,13 @@ void renderSimulation(unsigned int shaderProgram, Coords cityCoords, bool therma
     glBindTexture(GL_TEXTURE_2D, physicalTexture);
     glUniform1i(glGetUniformLocation(shaderProgram, "physicalTexture"), 1);
     glUniform1i(glGetUniformLocation(shaderProgram, "thermalView"), thermalView);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, fieldTexture);
+    glUniform1i(glGetUniformLocation(shaderProgram, "fieldTexture"), 2);
+    glUniform1i(glGetUniformLocation(shaderProgram, "fieldView"), fieldTexture != 0);
+    glUniform1f(glGetUniformLocation(shaderProgram, "fieldOffset"), fieldOffset);
+    glUniform2f(glGetUniformLocation(shaderProgram, "thermalRange"), thermalMinKelvin, thermalMaxKelvin);
+    glUniform2f(glGetUniformLocation(shaderProgram, "markerCoord"), (float)((cityCoords.longitude + 180.0) / 360.0), (float)((90.0 - cityCoords.latitude) / 180.0));
     glBindVertexArray(planetVAO);
     glDrawElements(GL_TRIANGLES, planetIndices.size(), GL_UNSIGNED_INT, 0);
 
@@ -200,3 +208,28 @@ void renderSimulation(unsigned int shaderProgram, Coords cityCoords, bool therma
     //     glDrawArrays(GL_POINTS, 0, 2);
     // }
 }
+
+void uploadFieldFrame(const PackedField<Float16Storage> &field) {
+    fieldTexture = uploadHalfFieldTexture(field, fieldTexture);
+    fieldOffset = field.storage.offset;
+}
+
+unsigned int uploadHalfFieldTexture(const PackedField<Float16Storage> &field, unsigned int texture) {
+    if (texture == 0) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+    // Row 0 is the north edge, matching the top of the equirectangular textures above
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, field.stride);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, field.cols, field.rows, 0, GL_RED, GL_HALF_FLOAT, field.data.data());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return texture;
+}
@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+#include <core/reprojection.h>
+#include <core/threadPool.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define REPROJECTION_SSE2
+#endif
+
+constexpr double reprojectionPi = 3.14159265358979323846;
+constexpr double degToRad = reprojectionPi / 180.0;
+constexpr double radToDeg = 180.0 / reprojectionPi;
+
+bool inverseProject(Projection projection, Coords centre, double x, double y, Coords &coords) {
+    double rho = std::sqrt(x * x + y * y);
+    switch (projection) {
+        case Projection::Equirectangular: {
+            coords = {y * 90.0, x * 180.0};
+            return true;
+        }
+        case Projection::Orthographic: {
+            if (rho > 1.0) return false;
+            double lat0 = centre.latitude * degToRad, lon0 = centre.longitude * degToRad;
+            if (rho == 0.0) {
+                coords = centre;
+                return true;
+            }
+            double c = std::asin(rho), sinC = std::sin(c), cosC = std::cos(c);
+            double lat = std::asin(cosC * std::sin(lat0) + y * sinC * std::cos(lat0) / rho);
+            double lon = lon0 + std::atan2(x * sinC, rho * cosC * std::cos(lat0) - y * sinC * std::sin(lat0));
+            coords = {lat * radToDeg, lon * radToDeg};
+            return true;
+        }
+        case Projection::NorthPolarStereographic:
+        case Projection::SouthPolarStereographic: {
+            if (rho > 1.0) return false;
+            // Unit sphere stereographic radius of the equator is 2
+            double colatitude = 2.0 * std::atan(rho);
+            bool north = projection == Projection::NorthPolarStereographic;
+            double lat = reprojectionPi / 2.0 - colatitude;
+            double lon = north ? std::atan2(x, -y) : std::atan2(x, y);
+            coords = {(north ? lat : -lat) * radToDeg, lon * radToDeg};
+            return true;
+        }
+        case Projection::WebMercator: {
+            double lat = 2.0 * std::atan(std::exp(y * reprojectionPi)) - reprojectionPi / 2.0;
+            coords = {lat * radToDeg, x * 180.0};
+            return true;
+        }
+    }
+    return false;
+}
+
+std::unique_ptr<RemapTable> buildRemapTable(Projection projection, int width, int height, int srcWidth, int srcHeight, Coords centre) {
+    auto table = std::make_unique<RemapTable>();
+    table->projection = projection;
+    table->width = width;
+    table->height = height;
+    table->srcWidth = srcWidth;
+    table->srcHeight = srcHeight;
+    table->centre = centre;
+    size_t numPixels = (size_t)width * height;
+    table->inside.assign(numPixels, 0);
+    for (auto *taps : {&table->tap00, &table->tap01, &table->tap10, &table->tap11}) taps->assign(numPixels, 0);
+    for (auto *weights : {&table->weight00, &table->weight01, &table->weight10, &table->weight11}) weights->assign(numPixels, 0);
+    threadPool().parallelFor(0, height, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            double y = 1.0 - 2.0 * (row + 0.5) / height;
+            for (int col = 0; col < width; ++col) {
+                double x = 2.0 * (col + 0.5) / width - 1.0;
+                Coords coords;
+                if (!inverseProject(projection, centre, x, y, coords)) continue;
+                double srcCol = (coords.longitude + 180.0) / 360.0 * srcWidth - 0.5;
+                double srcRow = (90.0 - coords.latitude) / 180.0 * srcHeight - 0.5;
+                srcRow = std::min(std::max(srcRow, 0.0), (double)(srcHeight - 1));
+                int col0 = (int)std::floor(srcCol), row0 = (int)srcRow;
+                double fx = srcCol - col0, fy = srcRow - row0;
+                col0 = ((col0 % srcWidth) + srcWidth) % srcWidth;
+                int col1 = (col0 + 1) % srcWidth, row1 = std::min(row0 + 1, srcHeight - 1);
+                // Quantise so the four weights always sum to exactly 256
+                int wx = (int)std::lround(fx * 16.0), wy = (int)std::lround(fy * 16.0);
+                size_t idx = (size_t)row * width + col;
+                table->inside[idx] = 1;
+                table->tap00[idx] = row0 * srcWidth + col0;
+                table->tap01[idx] = row0 * srcWidth + col1;
+                table->tap10[idx] = row1 * srcWidth + col0;
+                table->tap11[idx] = row1 * srcWidth + col1;
+                table->weight00[idx] = (unsigned short)((16 - wx) * (16 - wy));
+                table->weight01[idx] = (unsigned short)(wx * (16 - wy));
+                table->weight10[idx] = (unsigned short)((16 - wx) * wy);
+                table->weight11[idx] = (unsigned short)(wx * wy);
+            }
+        }
+    }, 8);
+    return table;
+}
+
+std::shared_ptr<const RemapTable> remapTable(Projection projection, int width, int height, int srcWidth, int srcHeight, Coords centre) {
+    using Key = std::tuple<int, int, int, int, int, double, double>;
+    static std::mutex cacheMutex;
+    // Most recently used first; each orthographic centre is its own ~25 MB table at 1024x1024, so keep only a few
+    static std::list<std::pair<Key, std::shared_ptr<const RemapTable>>> recent;
+    static std::map<Key, decltype(recent)::iterator> cache;
+    // Only the orthographic view depends on the centre point
+    if (projection != Projection::Orthographic) centre = Coords{0.0, 0.0};
+    Key key = std::make_tuple((int)projection, width, height, srcWidth, srcHeight, centre.latitude, centre.longitude);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto found = cache.find(key);
+    if (found != cache.end()) {
+        recent.splice(recent.begin(), recent, found->second);
+        return found->second->second;
+    }
+    recent.emplace_front(key, buildRemapTable(projection, width, height, srcWidth, srcHeight, centre));
+    cache[key] = recent.begin();
+    if (recent.size() > remapCacheCapacity) {
+        // Callers still holding the evicted table keep it alive through their shared_ptr
+        cache.erase(recent.back().first);
+        recent.pop_back();
+    }
+    return recent.front().second;
+}
+
+// Blend the four taps of one pixel with the table's fixed point weights
+inline uint32_t blendTexel(const RemapTable &table, const uint32_t *src, size_t idx) {
+    uint32_t texels[4] = {src[table.tap00[idx]], src[table.tap01[idx]], src[table.tap10[idx]], src[table.tap11[idx]]};
+    unsigned int weights[4] = {table.weight00[idx], table.weight01[idx], table.weight10[idx], table.weight11[idx]};
+    uint32_t result = 0;
+    for (int channel = 0; channel < 4; ++channel) {
+        unsigned int sum = 128;
+        for (int tap = 0; tap < 4; ++tap) sum += ((texels[tap] >> (8 * channel)) & 0xFF) * weights[tap];
+        result |= (sum >> 8) << (8 * channel);
+    }
+    return result;
+}
+
+void reprojectImage(const RemapTable &table, const unsigned char *srcPixels, unsigned char *dstPixels) {
+    const uint32_t *src = (const uint32_t *)srcPixels;
+    uint32_t *dst = (uint32_t *)dstPixels;
+    threadPool().parallelFor(0, table.height, [&](int rowBegin, int rowEnd) {
+        size_t idx = (size_t)rowBegin * table.width, end = (size_t)rowEnd * table.width;
+#ifdef REPROJECTION_SSE2
+        // Two RGBA pixels per register: eight 16-bit channel lanes multiplied by broadcast tap weights
+        const __m128i zero = _mm_setzero_si128(), rounding = _mm_set1_epi16(128);
+        const std::vector<int> *taps[4] = {&table.tap00, &table.tap01, &table.tap10, &table.tap11};
+        const std::vector<unsigned short> *weights[4] = {&table.weight00, &table.weight01, &table.weight10, &table.weight11};
+        for (; idx + 2 <= end; idx += 2) {
+            __m128i sum = rounding;
+            for (int tap = 0; tap < 4; ++tap) {
+                const int *tapIdx = taps[tap]->data() + idx;
+                const unsigned short *tapWeight = weights[tap]->data() + idx;
+                __m128i texels = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, (int)src[tapIdx[1]], (int)src[tapIdx[0]]), zero);
+                __m128i weight = _mm_set_epi16(tapWeight[1], tapWeight[1], tapWeight[1], tapWeight[1], tapWeight[0], tapWeight[0], tapWeight[0], tapWeight[0]);
+                sum = _mm_add_epi16(sum, _mm_mullo_epi16(texels, weight));
+            }
+            _mm_storel_epi64((__m128i *)(dst + idx), _mm_packus_epi16(_mm_srli_epi16(sum, 8), zero));
+        }
+#endif
+        for (; idx < end; ++idx) dst[idx] = blendTexel(table, src, idx);
+    }, 8);
+}
+
+ThermalGrid reprojectGrid(const RemapTable &table, const ThermalGrid &source) {
+    ThermalGrid result;
+    result.width = table.width;
+    result.height = table.height;
+    result.values.assign((size_t)table.width * table.height, 0.0f);
+    result.valid.assign((size_t)table.width * table.height, 0);
+    threadPool().parallelFor(0, table.height, [&](int rowBegin, int rowEnd) {
+        for (size_t idx = (size_t)rowBegin * table.width; idx < (size_t)rowEnd * table.width; ++idx) {
+            if (!table.inside[idx]) continue;
+            int taps[4] = {table.tap00[idx], table.tap01[idx], table.tap10[idx], table.tap11[idx]};
+            float weights[4] = {(float)table.weight00[idx], (float)table.weight01[idx], (float)table.weight10[idx], (float)table.weight11[idx]};
+            float sum = 0.0f, weightSum = 0.0f;
+            for (int tap = 0; tap < 4; ++tap) {
+                if (!source.valid[taps[tap]]) continue;
+                sum += weights[tap] * source.values[taps[tap]];
+                weightSum += weights[tap];
+            }
+            if (weightSum <= 0.0f) continue;
+            result.values[idx] = sum / weightSum;
+            result.valid[idx] = 1;
+        }
+    }, 8);
+    return result;
+}
+
+// Projected (x, y) of a point on the globe, the inverse of inverseProject; used to check it
+bool forwardProject(Projection projection, Coords centre, Coords coords, double &x, double &y) {
+    double lat = coords.latitude * degToRad, lon = coords.longitude * degToRad;
+    switch (projection) {
+        case Projection::Equirectangular:
+            x = coords.longitude / 180.0;
+            y = coords.latitude / 90.0;
+            return true;
+        case Projection::Orthographic: {
+            double lat0 = centre.latitude * degToRad, dLon = lon - centre.longitude * degToRad;
+            x = std::cos(lat) * std::sin(dLon);
+            y = std::cos(lat0) * std::sin(lat) - std::sin(lat0) * std::cos(lat) * std::cos(dLon);
+            return true;
+        }
+        case Projection::NorthPolarStereographic: {
+            double rho = std::tan((reprojectionPi / 2.0 - lat) / 2.0);
+            x = rho * std::sin(lon);
+            y = -rho * std::cos(lon);
+            return true;
+        }
+        case Projection::SouthPolarStereographic: {
+            double rho = std::tan((reprojectionPi / 2.0 + lat) / 2.0);
+            x = rho * std::sin(lon);
+            y = rho * std::cos(lon);
+            return true;
+        }
+        case Projection::WebMercator:
+            x = coords.longitude / 180.0;
+            y = std::log(std::tan(reprojectionPi / 4.0 + lat / 2.0)) / reprojectionPi;
+            return true;
+    }
+    return false;
+}
+
+void benchmarkReprojection() {
+    const int srcWidth = 2048, srcHeight = 1024, size = 1024, repeats = 3;
+    const Coords centre{43.45, -79.68}; // Oakville, the default location
+    // Smooth RGBA source, continuous across the antimeridian, so bilinear sampling is well defined everywhere
+    std::vector<unsigned char> src((size_t)srcWidth * srcHeight * 4);
+    for (int row = 0; row < srcHeight; ++row) {
+        double lat = (90.0 - (row + 0.5) * 180.0 / srcHeight) * degToRad;
+        for (int col = 0; col < srcWidth; ++col) {
+            double lon = ((col + 0.5) * 360.0 / srcWidth - 180.0) * degToRad;
+            unsigned char *pix = src.data() + ((size_t)row * srcWidth + col) * 4;
+            pix[0] = (unsigned char)std::lround(127.5 + 120.0 * std::sin(lat));
+            pix[1] = (unsigned char)std::lround(127.5 + 120.0 * std::cos(lat) * std::cos(3.0 * lon));
+            pix[2] = (unsigned char)std::lround(127.5 + 120.0 * std::cos(lat) * std::sin(2.0 * lon));
+            pix[3] = 255;
+        }
+    }
+    const char *names[5] = {"equirectangular", "orthographic", "north polar", "south polar", "web mercator"};
+    std::vector<unsigned char> dst((size_t)size * size * 4), reference(dst.size());
+    auto elapsed = [](std::chrono::steady_clock::time_point start) { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+
+    std::cout << "Reprojection benchmark (" << threadPool().size() << " threads), " << srcWidth << "x" << srcHeight << " RGBA to " << size << "x" << size
+              << ", best of " << repeats << std::endl;
+    for (int p = 0; p < 5; ++p) {
+        const Projection projection = (Projection)p;
+        auto start = std::chrono::steady_clock::now();
+        const std::shared_ptr<const RemapTable> cachedTable = remapTable(projection, size, size, srcWidth, srcHeight, centre);
+        const RemapTable &table = *cachedTable;
+        const double firstUse = elapsed(start);
+        start = std::chrono::steady_clock::now();
+        const bool cached = remapTable(projection, size, size, srcWidth, srcHeight, centre) == cachedTable;
+        const double cachedLookup = elapsed(start);
+
+        // Round trip: every pixel's latitude / longitude must project back onto the pixel
+        double roundTrip = 0.0;
+        size_t insidePixels = 0;
+        for (int row = 0; row < size; ++row) {
+            double y = 1.0 - 2.0 * (row + 0.5) / size;
+            for (int col = 0; col < size; ++col) {
+                double x = 2.0 * (col + 0.5) / size - 1.0, backX, backY;
+                Coords coords;
+                if (!inverseProject(projection, centre, x, y, coords)) continue;
+                ++insidePixels;
+                if (forwardProject(projection, centre, coords, backX, backY)) {
+                    roundTrip = std::max(roundTrip, 0.5 * size * std::max(std::abs(backX - x), std::abs(backY - y)));
+                } else {
+                    roundTrip = 1e300;
+                }
+            }
+        }
+
+        // Scalar reference: trig and double precision bilinear for every pixel, as a view switch would without the table
+        double scalarMs = 1e300;
+        for (int repeat = 0; repeat < repeats; ++repeat) {
+            start = std::chrono::steady_clock::now();
+            threadPool().parallelFor(0, size, [&](int rowBegin, int rowEnd) {
+                for (int row = rowBegin; row < rowEnd; ++row) {
+                    double y = 1.0 - 2.0 * (row + 0.5) / size;
+                    for (int col = 0; col < size; ++col) {
+                        double x = 2.0 * (col + 0.5) / size - 1.0;
+                        unsigned char *out = reference.data() + ((size_t)row * size + col) * 4;
+                        Coords coords;
+                        if (!inverseProject(projection, centre, x, y, coords)) {
+                            std::fill(out, out + 4, 0);
+                            continue;
+                        }
+                        double srcCol = (coords.longitude + 180.0) / 360.0 * srcWidth - 0.5;
+                        double srcRow = std::min(std::max((90.0 - coords.latitude) / 180.0 * srcHeight - 0.5, 0.0), (double)(srcHeight - 1));
+                        int col0 = (int)std::floor(srcCol), row0 = (int)srcRow;
+                        double fx = srcCol - col0, fy = srcRow - row0;
+                        col0 = ((col0 % srcWidth) + srcWidth) % srcWidth;
+                        int col1 = (col0 + 1) % srcWidth, row1 = std::min(row0 + 1, srcHeight - 1);
+                        const unsigned char *t00 = src.data() + ((size_t)row0 * srcWidth + col0) * 4, *t01 = src.data() + ((size_t)row0 * srcWidth + col1) * 4;
+                        const unsigned char *t10 = src.data() + ((size_t)row1 * srcWidth + col0) * 4, *t11 = src.data() + ((size_t)row1 * srcWidth + col1) * 4;
+                        for (int c = 0; c < 4; ++c) {
+                            double top = t00[c] + fx * (t01[c] - t00[c]), bottom = t10[c] + fx * (t11[c] - t10[c]);
+                            out[c] = (unsigned char)std::lround(top + fy * (bottom - top));
+                        }
+                    }
+                }
+            }, 8);
+            scalarMs = std::min(scalarMs, elapsed(start));
+        }
+
+        // Without the cache every switch rebuilds the table; with it, a switch is the apply alone
+        double uncachedMs = 1e300, cachedMs = 1e300;
+        for (int repeat = 0; repeat < repeats; ++repeat) {
+            start = std::chrono::steady_clock::now();
+            std::unique_ptr<RemapTable> rebuilt = buildRemapTable(projection, size, size, srcWidth, srcHeight, centre);
+            reprojectImage(*rebuilt, src.data(), dst.data());
+            uncachedMs = std::min(uncachedMs, elapsed(start));
+            start = std::chrono::steady_clock::now();
+            reprojectImage(*remapTable(projection, size, size, srcWidth, srcHeight, centre), src.data(), dst.data());
+            cachedMs = std::min(cachedMs, elapsed(start));
+        }
+
+        // The vector apply must match the scalar blend exactly, and the fixed point taps the reference to a level or two
+        bool vectorMatches = true;
+        int maxDifference = 0;
+        double sumDifference = 0.0;
+        const uint32_t *src32 = (const uint32_t *)src.data(), *dst32 = (const uint32_t *)dst.data();
+        for (size_t idx = 0; idx < (size_t)size * size; ++idx) {
+            if (dst32[idx] != blendTexel(table, src32, idx)) vectorMatches = false;
+            for (int c = 0; c < 4; ++c) {
+                int difference = std::abs((int)dst[idx * 4 + c] - (int)reference[idx * 4 + c]);
+                maxDifference = std::max(maxDifference, difference);
+                sumDifference += difference;
+            }
+        }
+
+        std::cout << "  " << std::left << std::setw(16) << names[p] << std::right << std::fixed << std::setprecision(1) << std::setw(5)
+                  << 100.0 * insidePixels / ((double)size * size) << "% on the globe, round trip " << std::scientific << std::setprecision(1) << roundTrip
+                  << " px" << std::fixed << std::endl;
+        std::cout << "    table " << std::setprecision(2) << std::setw(7) << firstUse << " ms first use, " << std::setprecision(4) << cachedLookup << " ms "
+                  << (cached ? "cached" : "NOT CACHED") << std::setprecision(2) << "; switch " << std::setw(7) << uncachedMs << " ms uncached, " << std::setw(6)
+                  << cachedMs << " ms cached (" << std::setprecision(1) << uncachedMs / cachedMs << "x), scalar trig + bilinear " << std::setprecision(2)
+                  << std::setw(7) << scalarMs << " ms" << std::endl;
+        std::cout << "    vs scalar reference: max " << maxDifference << ", mean " << std::setprecision(3) << sumDifference / ((double)size * size * 4)
+                  << " levels; vector apply " << (vectorMatches ? "identical to" : "DIFFERS from") << " the scalar blend" << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
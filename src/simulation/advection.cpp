@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include <core/reduction.h>
+#include <core/spatialIndex.h>
+#include <core/threadPool.h>
+#include <simulation/advection.h>
+
+constexpr double advectionPi = 3.14159265358979323846;
+constexpr double earthRadius = 6.371e6;      // m
+constexpr double kilometresPerHour = 1.0 / 3.6;
+constexpr int midpointIterations = 2;
+constexpr double windTaperDegrees = 5.0;
+
+WindField windFromSamples(const LatLonGrid &grid, const std::vector<WeatherSample> &speed, const std::vector<WeatherSample> &direction, int neighbours,
+                          float power) {
+    WindField wind{Field(grid.nLat, grid.nLon), Field(grid.nLat, grid.nLon)};
+    // Speed and direction are parsed separately and nulls dropped from each, so pair them by location
+    std::map<std::pair<double, double>, float> directions;
+    for (const auto &sample : direction) directions[{sample.coords.latitude, sample.coords.longitude}] = sample.value;
+    // Interpolate components rather than speed and direction, which would average badly across north
+    std::vector<WeatherSample> eastward, northward;
+    for (const auto &sample : speed) {
+        auto it = directions.find({sample.coords.latitude, sample.coords.longitude});
+        if (it == directions.end()) continue;
+        double metresPerSecond = sample.value * kilometresPerHour, from = it->second * advectionPi / 180.0;
+        eastward.push_back({sample.coords, (float)(-metresPerSecond * std::sin(from))});
+        northward.push_back({sample.coords, (float)(-metresPerSecond * std::cos(from))});
+    }
+    if (eastward.empty()) return wind;
+    // Extent of the samples, with longitudes unwrapped around the first so a lattice across the antimeridian stays whole
+    const double reference = eastward[0].coords.longitude;
+    auto unwrap = [reference](double lon) { return lon - 360.0 * std::round((lon - reference) / 360.0); };
+    double south = 90.0, north = -90.0, west = reference, east = reference;
+    for (const auto &sample : eastward) {
+        south = std::min(south, sample.coords.latitude);
+        north = std::max(north, sample.coords.latitude);
+        west = std::min(west, unwrap(sample.coords.longitude));
+        east = std::max(east, unwrap(sample.coords.longitude));
+    }
+    // Inverse distance over the nearest samples, evaluated only where the taper leaves any wind
+    std::vector<Coords> positions;
+    for (const auto &sample : eastward) positions.push_back(sample.coords);
+    const SphericalKdTree tree(positions);
+    neighbours = std::min(std::max(neighbours, 1), (int)positions.size());
+    threadPool().parallelFor(0, grid.nLat, [&](int rowBegin, int rowEnd) {
+        std::vector<int> indices;
+        std::vector<double> chordsSquared;
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            const double lat = grid.latitudes[row] * 180.0 / advectionPi;
+            const double latOutside = std::max(0.0, std::max(south - lat, lat - north));
+            if (latOutside >= windTaperDegrees) continue;
+            float *outU = wind.eastward.row(row), *outV = wind.northward.row(row);
+            for (int col = 0; col < grid.nLon; ++col) {
+                // Distance outside the sampled box in degrees of arc, east-west gaps shrunk by the cosine of latitude
+                const double lon = unwrap((col + 0.5) * 360.0 / grid.nLon - 180.0);
+                const double lonOutside = std::max(0.0, std::max(west - lon, lon - east)) * grid.cosLat[row];
+                const double taper = 1.0 - std::sqrt(latOutside * latOutside + lonOutside * lonOutside) / windTaperDegrees;
+                if (taper <= 0.0) continue;
+                tree.nearest(Coords{lat, lon}, neighbours, indices, chordsSquared);
+                double u = 0.0, v = 0.0, weightSum = 0.0;
+                for (size_t i = 0; i < indices.size(); ++i) {
+                    const double angle = 2.0 * std::asin(std::min(std::sqrt(chordsSquared[i]) * 0.5, 1.0));
+                    if (angle < 1e-9) {
+                        u = eastward[indices[i]].value;
+                        v = northward[indices[i]].value;
+                        weightSum = 1.0;
+                        break;
+                    }
+                    const double weight = std::pow(angle, -(double)power);
+                    u += weight * eastward[indices[i]].value;
+                    v += weight * northward[indices[i]].value;
+                    weightSum += weight;
+                }
+                outU[col] = (float)(taper * u / weightSum);
+                outV[col] = (float)(taper * v / weightSum);
+            }
+        }
+    }, 8);
+    return wind;
+}
+
+double courantTimestep(const LatLonGrid &grid, const WindField &wind, double courant) {
+    const double dLat = advectionPi / grid.nLat, dLon = 2.0 * advectionPi / grid.nLon;
+    double maxRate = 0.0;
+    for (int row = 0; row < grid.nLat; ++row) {
+        float maxEastward = 0.0f, maxNorthward = 0.0f;
+        const float *eastward = wind.eastward.row(row), *northward = wind.northward.row(row);
+        for (int col = 0; col < grid.nLon; ++col) {
+            maxEastward = std::max(maxEastward, std::abs(eastward[col]));
+            maxNorthward = std::max(maxNorthward, std::abs(northward[col]));
+        }
+        // Cells per second crossed in each direction
+        maxRate = std::max(maxRate, maxEastward / (earthRadius * grid.cosLat[row] * dLon) + maxNorthward / (earthRadius * dLat));
+    }
+    return maxRate > 0.0 ? courant / maxRate : 1e300;
+}
+
+// Grid rows and columns around a fractional position. Rows past a pole continue down the far side,
+// half way round in longitude, where the local east and north directions are reversed.
+struct Stencil {
+    int rows[4];
+    int cols[4][4];
+    float sign[4];
+    float rowFraction;
+    float colFraction;
+};
+
+inline void makeStencil(int nLat, int nLon, float row, float col, Stencil &stencil) {
+    int row0 = (int)std::floor(row), col0 = (int)std::floor(col);
+    stencil.rowFraction = row - row0;
+    stencil.colFraction = col - col0;
+    for (int r = 0; r < 4; ++r) {
+        int gridRow = row0 - 1 + r, shift = 0;
+        stencil.sign[r] = 1.0f;
+        if (gridRow < 0) {
+            gridRow = -gridRow - 1;
+            shift = nLon / 2;
+            stencil.sign[r] = -1.0f;
+        } else if (gridRow >= nLat) {
+            gridRow = 2 * nLat - gridRow - 1;
+            shift = nLon / 2;
+            stencil.sign[r] = -1.0f;
+        }
+        stencil.rows[r] = gridRow;
+        for (int c = 0; c < 4; ++c) {
+            int gridCol = (col0 - 1 + c + shift) % nLon;
+            stencil.cols[r][c] = gridCol < 0 ? gridCol + nLon : gridCol;
+        }
+    }
+}
+
+inline void cubicWeights(float t, float weights[4]) {
+    weights[0] = -t * (t - 1.0f) * (t - 2.0f) / 6.0f;
+    weights[1] = (t + 1.0f) * (t - 1.0f) * (t - 2.0f) / 2.0f;
+    weights[2] = -(t + 1.0f) * t * (t - 2.0f) / 2.0f;
+    weights[3] = (t + 1.0f) * t * (t - 1.0f) / 6.0f;
+}
+
+inline float sampleBilinear(const Field &field, const Stencil &stencil, bool vector) {
+    float value = 0.0f;
+    for (int r = 1; r <= 2; ++r) {
+        const float *values = field.row(stencil.rows[r]);
+        float rowValue = values[stencil.cols[r][1]] + stencil.colFraction * (values[stencil.cols[r][2]] - values[stencil.cols[r][1]]);
+        if (vector) rowValue *= stencil.sign[r];
+        value += (r == 1 ? 1.0f - stencil.rowFraction : stencil.rowFraction) * rowValue;
+    }
+    return value;
+}
+
+inline float sampleCubic(const Field &field, const Stencil &stencil) {
+    float rowWeights[4], colWeights[4];
+    cubicWeights(stencil.rowFraction, rowWeights);
+    cubicWeights(stencil.colFraction, colWeights);
+    float value = 0.0f, low = 1e30f, high = -1e30f;
+    for (int r = 0; r < 4; ++r) {
+        const float *values = field.row(stencil.rows[r]);
+        float rowValue = 0.0f;
+        for (int c = 0; c < 4; ++c) rowValue += colWeights[c] * values[stencil.cols[r][c]];
+        value += rowWeights[r] * rowValue;
+        if (r == 1 || r == 2) {
+            low = std::min(low, std::min(values[stencil.cols[r][1]], values[stencil.cols[r][2]]));
+            high = std::max(high, std::max(values[stencil.cols[r][1]], values[stencil.cols[r][2]]));
+        }
+    }
+    return std::min(std::max(value, low), high);
+}
+
+Trajectories traceDepartures(const LatLonGrid &grid, const WindField &wind, double dt) {
+    const int nLat = grid.nLat, nLon = grid.nLon;
+    const double dLat = advectionPi / nLat, dLon = 2.0 * advectionPi / nLon;
+    Trajectories trajectories;
+    trajectories.dt = dt;
+    trajectories.rows.resize((size_t)nLat * nLon);
+    trajectories.cols.resize((size_t)nLat * nLon);
+    auto toGrid = [&](const glm::dvec3 &p, float &row, float &col) {
+        double lat = std::asin(std::min(std::max(p.z, -1.0), 1.0)), lon = std::atan2(p.y, p.x);
+        row = (float)((advectionPi / 2.0 - lat) / dLat - 0.5);
+        col = (float)((lon + advectionPi) / dLon - 0.5);
+        if (col < 0.0f) col += (float)nLon;
+    };
+    // Wind as a 3D vector tangent to the sphere at p
+    auto windAt = [&](const glm::dvec3 &p) {
+        float row, col;
+        toGrid(p, row, col);
+        Stencil stencil;
+        makeStencil(nLat, nLon, row, col, stencil);
+        double u = sampleBilinear(wind.eastward, stencil, true), v = sampleBilinear(wind.northward, stencil, true);
+        double horizontal = std::sqrt(p.x * p.x + p.y * p.y);
+        glm::dvec3 east = horizontal > 1e-12 ? glm::dvec3(-p.y / horizontal, p.x / horizontal, 0.0) : glm::dvec3(0.0, 1.0, 0.0);
+        glm::dvec3 north = glm::cross(p, east);
+        return u * east + v * north;
+    };
+    threadPool().parallelFor(0, nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            double lat = grid.latitudes[row];
+            for (int col = 0; col < nLon; ++col) {
+                double lon = -advectionPi + (col + 0.5) * dLon;
+                glm::dvec3 arrival(std::cos(lat) * std::cos(lon), std::cos(lat) * std::sin(lon), std::sin(lat));
+                glm::dvec3 velocity((double)wind.eastward.row(row)[col] * glm::dvec3(-std::sin(lon), std::cos(lon), 0.0)
+                    + (double)wind.northward.row(row)[col] * glm::dvec3(-std::sin(lat) * std::cos(lon), -std::sin(lat) * std::sin(lon), std::cos(lat)));
+                glm::dvec3 departure = arrival;
+                for (int iteration = 0; iteration <= midpointIterations; ++iteration) {
+                    double speed = glm::length(velocity);
+                    if (speed * dt < 1e-9 * earthRadius) break;
+                    glm::dvec3 heading = velocity / speed;
+                    double angle = speed * dt / earthRadius;
+                    departure = std::cos(angle) * arrival - std::sin(angle) * heading;
+                    if (iteration == midpointIterations) break;
+                    // Re-estimate the wind half way back, carried into the arrival point's tangent plane
+                    glm::dvec3 midpoint = std::cos(0.5 * angle) * arrival - std::sin(0.5 * angle) * heading;
+                    glm::dvec3 midVelocity = windAt(midpoint);
+                    glm::dvec3 tangent = midVelocity - glm::dot(midVelocity, arrival) * arrival;
+                    double tangentLength = glm::length(tangent);
+                    velocity = tangentLength > 0.0 ? tangent * (glm::length(midVelocity) / tangentLength) : tangent;
+                }
+                size_t idx = (size_t)row * nLon + col;
+                toGrid(departure, trajectories.rows[idx], trajectories.cols[idx]);
+            }
+        }
+    }, 4);
+    return trajectories;
+}
+
+void advectSemiLagrangian(const LatLonGrid &grid, const Trajectories &trajectories, const Field &source, Field &destination, AdvectionInterpolation interpolation) {
+    const int nLat = grid.nLat, nLon = grid.nLon;
+    threadPool().parallelFor(0, nLat, [&](int rowBegin, int rowEnd) {
+        Stencil stencil;
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            const float *rows = trajectories.rows.data() + (size_t)row * nLon, *cols = trajectories.cols.data() + (size_t)row * nLon;
+            float *out = destination.row(row);
+            for (int col = 0; col < nLon; ++col) {
+                makeStencil(nLat, nLon, rows[col], cols[col], stencil);
+                out[col] = interpolation == AdvectionInterpolation::Cubic ? sampleCubic(source, stencil) : sampleBilinear(source, stencil, false);
+            }
+        }
+    }, 4);
+}
+
+void advectTemperature(SimulationState &state, const Trajectories &trajectories, AdvectionInterpolation interpolation) {
+    advectSemiLagrangian(state.grid, trajectories, state.temperature, state.scratch, interpolation);
+    std::swap(state.temperature, state.scratch);
+}
+
+void benchmarkAdvection() {
+    std::cout << "Semi-Lagrangian advection benchmark (" << threadPool().size() << " threads)" << std::endl;
+    // Williamson et al. test 1: solid-body rotation once round in 12 days on an axis tilted so the flow crosses the poles
+    const double period = 12.0 * 86400.0, tilt = advectionPi / 2.0 - 0.05;
+    const double speed = 2.0 * advectionPi * earthRadius / period;
+    for (double resolution : {1.0, 0.5}) {
+        LatLonGrid grid = makeLatLonGrid(resolution);
+        WindField wind{Field(grid.nLat, grid.nLon), Field(grid.nLat, grid.nLon)};
+        Field initial(grid.nLat, grid.nLon);
+        for (int row = 0; row < grid.nLat; ++row) {
+            double lat = grid.latitudes[row];
+            for (int col = 0; col < grid.nLon; ++col) {
+                double lon = -advectionPi + (col + 0.5) * 2.0 * advectionPi / grid.nLon;
+                wind.eastward.row(row)[col] = (float)(speed * (std::cos(lat) * std::cos(tilt) + std::sin(lat) * std::cos(lon) * std::sin(tilt)));
+                wind.northward.row(row)[col] = (float)(-speed * std::sin(lon) * std::sin(tilt));
+                // Cosine bell of radius R / 3 centred on the equator at longitude -90
+                double distance = std::acos(std::min(1.0, std::cos(lat) * std::cos(lon + advectionPi / 2.0)));
+                initial.row(row)[col] = distance < 1.0 / 3.0 ? (float)(500.0 * (1.0 + std::cos(3.0 * advectionPi * distance))) : 0.0f;
+            }
+        }
+        for (int stepsPerRevolution : {72, 288}) {
+            double dt = period / stepsPerRevolution;
+            // Courant number at the fastest polar row shows how far past the explicit limit the step is
+            double courant = speed * dt / (earthRadius * grid.cosLat[0] * 2.0 * advectionPi / grid.nLon);
+            for (AdvectionInterpolation interpolation : {AdvectionInterpolation::Bilinear, AdvectionInterpolation::Cubic}) {
+                auto start = std::chrono::steady_clock::now();
+                Trajectories trajectories = traceDepartures(grid, wind, dt);
+                double traceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                Field current = initial, next(grid.nLat, grid.nLon);
+                start = std::chrono::steady_clock::now();
+                for (int step = 0; step < stepsPerRevolution; ++step) {
+                    advectSemiLagrangian(grid, trajectories, current, next, interpolation);
+                    std::swap(current, next);
+                }
+                double advectSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::array<double, 2> squares = reduceSums<2>(0, grid.nLat, 1, [&](int row) {
+                    std::array<double, 2> sums{};
+                    for (int col = 0; col < grid.nLon; ++col) {
+                        double difference = current.row(row)[col] - initial.row(row)[col];
+                        sums[0] += difference * difference * grid.areaWeight[row];
+                        sums[1] += (double)initial.row(row)[col] * initial.row(row)[col] * grid.areaWeight[row];
+                    }
+                    return sums;
+                });
+                const double errorSquared = squares[0], normSquared = squares[1];
+                double cells = (double)grid.nLat * grid.nLon;
+                std::cout << std::setw(5) << resolution << " deg  " << std::setw(4) << stepsPerRevolution << " steps  Courant " << std::fixed << std::setprecision(0)
+                          << std::setw(5) << courant << (interpolation == AdvectionInterpolation::Cubic ? "  cubic    " : "  bilinear ")
+                          << "l2 error " << std::setprecision(4) << std::sqrt(errorSquared / normSquared) << "  trace " << std::setprecision(1) << std::setw(6)
+                          << cells / traceSeconds / 1e6 << " Mcells/s  advect " << std::setw(6) << cells * stepsPerRevolution / advectSeconds / 1e6 << " Mcells/s"
+                          << std::defaultfloat << std::setprecision(6) << std::endl;
+            }
+        }
+    }
+}
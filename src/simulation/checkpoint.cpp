@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <core/compression.h>
+#include <simulation/checkpoint.h>
+#include <simulation/energyBalance.h>
+
+// Layout, native endianness: FileHeader, numChunks ChunkEntry records, then the chunk data. Chunk data holds the
+// chunk's rows of temperature without row padding, byte-shuffled and compressed unless that failed to shrink it.
+constexpr char checkpointMagic[8] = {'E', 'B', 'M', 'C', 'K', 'P', 'T', '\0'};
+constexpr uint32_t checkpointVersion = 1;
+constexpr uint32_t chunkCompressed = 1;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t nLat;
+    int32_t nLon;
+    int32_t chunkRows;
+    int32_t numChunks;
+    uint32_t reserved;
+    double resolution;
+    double time;
+    int64_t step;
+    int64_t sequence;
+};
+
+// sequence names the checkpoint file holding the data, which for reused chunks is an earlier one
+struct ChunkEntry {
+    int64_t sequence;
+    uint64_t offset;
+    uint64_t storedBytes;
+    uint64_t hash;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+std::string checkpointPath(const std::string &directory, long long sequence) {
+    std::ostringstream name;
+    name << (directory.empty() ? "." : directory) << "/checkpoint_" << std::setw(6) << std::setfill('0') << sequence << ".ckpt";
+    return name.str();
+}
+
+// Sequence number of a checkpoint file name, or -1
+long long checkpointSequence(const std::string &fileName) {
+    const std::string prefix = "checkpoint_", suffix = ".ckpt";
+    if (fileName.size() <= prefix.size() + suffix.size() || fileName.compare(0, prefix.size(), prefix) != 0 ||
+        fileName.compare(fileName.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return -1;
+    }
+    std::string digits = fileName.substr(prefix.size(), fileName.size() - prefix.size() - suffix.size());
+    if (digits.empty() || !std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; })) return -1;
+    return std::stoll(digits);
+}
+
+std::string latestCheckpoint(const std::string &directory) {
+    std::error_code error;
+    long long latest = -1;
+    for (const auto &entry : std::filesystem::directory_iterator(directory.empty() ? "." : directory, error)) {
+        latest = std::max(latest, checkpointSequence(entry.path().filename().string()));
+    }
+    return latest < 0 ? std::string() : checkpointPath(directory, latest);
+}
+
+CheckpointWriter::CheckpointWriter(const std::string &directory, const CheckpointSettings &settings) : directory(directory), settings(settings) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::string latest = latestCheckpoint(directory);
+    if (!latest.empty()) nextSequence = checkpointSequence(std::filesystem::path(latest).filename().string()) + 1;
+    this->settings.chunkRows = std::max(1, settings.chunkRows);
+    this->settings.fullEvery = std::max(1, settings.fullEvery);
+    writer = std::thread(&CheckpointWriter::writerLoop, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+}
+
+void CheckpointWriter::save(const SimulationState &state) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    // One checkpoint may queue behind the one being written; a third has to wait for a slot
+    idle.wait(lock, [&] { return !hasPending; });
+    const int nLat = state.grid.nLat, nLon = state.grid.nLon;
+    pending.nLat = nLat;
+    pending.nLon = nLon;
+    pending.resolution = state.grid.resolution;
+    pending.time = state.time;
+    pending.step = state.step;
+    pending.values.resize((size_t)nLat * nLon);
+    for (int row = 0; row < nLat; ++row) std::copy(state.temperature.row(row), state.temperature.row(row) + nLon, pending.values.begin() + (size_t)row * nLon);
+    hasPending = true;
+    pendingStall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    lock.unlock();
+    wake.notify_all();
+}
+
+void CheckpointWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [&] { return !hasPending && !writing; });
+}
+
+std::vector<CheckpointStats> CheckpointWriter::takeStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<CheckpointStats> stats;
+    std::swap(stats, completed);
+    return stats;
+}
+
+void CheckpointWriter::writerLoop() {
+    // Compression runs serially on this thread: handing it to the shared pool would queue it against the stepping
+    Snapshot current;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return hasPending || stopping; });
+        if (!hasPending) return;
+        std::swap(current, pending);
+        CheckpointStats stats;
+        stats.stallSeconds = pendingStall;
+        hasPending = false;
+        writing = true;
+        lock.unlock();
+        idle.notify_all();
+        write(current, stats);
+        lock.lock();
+        writing = false;
+        completed.push_back(stats);
+        idle.notify_all();
+    }
+}
+
+void CheckpointWriter::write(const Snapshot &snapshot, CheckpointStats &stats) {
+    auto start = std::chrono::steady_clock::now();
+    const int nLat = snapshot.nLat, nLon = snapshot.nLon, chunkRows = settings.chunkRows;
+    const int numChunks = (nLat + chunkRows - 1) / chunkRows;
+    const long long sequence = nextSequence++;
+    bool full = !settings.incremental || (int)chunks.size() != numChunks || savesSinceFull + 1 >= settings.fullEvery;
+    // Records change on a copy: later checkpoints may only point at this file once it is safely on disk
+    std::vector<ChunkRecord> updated = chunks;
+    if ((int)updated.size() != numChunks) updated.assign(numChunks, ChunkRecord());
+
+    const uint64_t dataStart = sizeof(FileHeader) + numChunks * sizeof(ChunkEntry);
+    std::vector<ChunkEntry> entries(numChunks);
+    std::vector<unsigned char> data, shuffled;
+    for (int chunk = 0; chunk < numChunks; ++chunk) {
+        const int firstRow = chunk * chunkRows, rows = std::min(chunkRows, nLat - firstRow);
+        const size_t count = (size_t)rows * nLon, rawBytes = count * sizeof(float);
+        const unsigned char *raw = (const unsigned char *)(snapshot.values.data() + (size_t)firstRow * nLon);
+        ChunkRecord &record = updated[chunk];
+        uint64_t hash = hashBytes(raw, rawBytes);
+        if (full || record.sequence < 0 || record.hash != hash) {
+            shuffled.resize(rawBytes);
+            shuffleBytes(raw, count, sizeof(float), shuffled.data());
+            size_t before = data.size();
+            compressBlock(shuffled.data(), rawBytes, data);
+            record.flags = chunkCompressed;
+            if (data.size() - before >= rawBytes) {
+                data.resize(before);
+                data.insert(data.end(), raw, raw + rawBytes);
+                record.flags = 0;
+            }
+            record.hash = hash;
+            record.sequence = sequence;
+            record.offset = dataStart + before;
+            record.storedBytes = data.size() - before;
+            ++stats.chunksWritten;
+        } else {
+            ++stats.chunksReused;
+        }
+        entries[chunk] = ChunkEntry{record.sequence, record.offset, record.storedBytes, record.hash, record.flags, 0};
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, checkpointMagic, sizeof(checkpointMagic));
+    header.version = checkpointVersion;
+    header.nLat = nLat;
+    header.nLon = nLon;
+    header.chunkRows = chunkRows;
+    header.numChunks = numChunks;
+    header.resolution = snapshot.resolution;
+    header.time = snapshot.time;
+    header.step = snapshot.step;
+    header.sequence = sequence;
+    std::string path = checkpointPath(directory, sequence), temporary = path + ".tmp";
+    bool written;
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write((const char *)&header, sizeof(header));
+        file.write((const char *)entries.data(), entries.size() * sizeof(ChunkEntry));
+        file.write((const char *)data.data(), data.size());
+        file.close();
+        written = (bool)file;
+    }
+    std::error_code error;
+    if (!written) {
+        std::cout << "Failed to write checkpoint " << temporary << std::endl;
+    } else {
+        std::filesystem::rename(temporary, path, error);
+        if (error) std::cout << "Failed to move checkpoint into place: " << path << std::endl;
+    }
+    stats.rawBytes = snapshot.values.size() * sizeof(float);
+    if (written && !error) {
+        chunks = std::move(updated);
+        savesSinceFull = full ? 0 : savesSinceFull + 1;
+        stats.sequence = sequence;
+        stats.writtenBytes = dataStart + data.size();
+    } else {
+        // No record points at the lost file, so the next checkpoint still compares against the last one on disk
+        std::filesystem::remove(temporary, error);
+    }
+    stats.writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Read-only view of a whole file: mapped where the platform allows, read into memory otherwise
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path) {
+#ifndef _WIN32
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) return;
+        struct stat info;
+        if (fstat(descriptor, &info) == 0 && info.st_size > 0) {
+            void *mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapped != MAP_FAILED) {
+                bytes = (const unsigned char *)mapped;
+                length = (size_t)info.st_size;
+            }
+        }
+        close(descriptor);
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) return;
+        buffer.resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read((char *)buffer.data(), buffer.size());
+        if (file) {
+            bytes = buffer.data();
+            length = buffer.size();
+        }
+#endif
+    }
+    ~MappedFile() {
+#ifndef _WIN32
+        if (bytes) munmap((void *)bytes, length);
+#endif
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    std::vector<unsigned char> buffer;
+#endif
+};
+
+bool loadCheckpoint(const std::string &path, SimulationState &state) {
+    auto fail = [&](const std::string &message) {
+        std::cout << "Failed to restore checkpoint " << path << ": " << message << std::endl;
+        return false;
+    };
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    std::map<long long, std::unique_ptr<MappedFile>> files;
+    auto mapped = std::make_unique<MappedFile>(path);
+    const MappedFile &file = *mapped;
+    if (file.size() < sizeof(FileHeader)) return fail("missing or truncated");
+    FileHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, checkpointMagic, sizeof(checkpointMagic)) != 0 || header.version != checkpointVersion) return fail("not a checkpoint");
+    if (header.nLat <= 0 || header.nLon <= 0 || header.chunkRows <= 0 || header.numChunks != (header.nLat + header.chunkRows - 1) / header.chunkRows ||
+        file.size() < sizeof(FileHeader) + (size_t)header.numChunks * sizeof(ChunkEntry)) {
+        return fail("bad header");
+    }
+    LatLonGrid grid = makeLatLonGrid(header.resolution);
+    if (grid.nLat != header.nLat || grid.nLon != header.nLon) return fail("grid does not match its resolution");
+    std::vector<ChunkEntry> entries(header.numChunks);
+    std::memcpy(entries.data(), file.data() + sizeof(FileHeader), entries.size() * sizeof(ChunkEntry));
+    files[header.sequence] = std::move(mapped);
+
+    SimulationState restored;
+    restored.grid = grid;
+    restored.temperature = Field(header.nLat, header.nLon);
+    std::vector<float> values;
+    std::vector<unsigned char> shuffled;
+    for (int chunk = 0; chunk < header.numChunks; ++chunk) {
+        const ChunkEntry &entry = entries[chunk];
+        auto found = files.find(entry.sequence);
+        if (found == files.end()) found = files.emplace(entry.sequence, std::make_unique<MappedFile>(checkpointPath(directory, entry.sequence))).first;
+        const MappedFile &source = *found->second;
+        if (!source.data() || entry.offset > source.size() || entry.storedBytes > source.size() - entry.offset) {
+            return fail("chunk " + std::to_string(chunk) + " missing from checkpoint " + std::to_string(entry.sequence));
+        }
+        const int firstRow = chunk * header.chunkRows, rows = std::min((int)header.chunkRows, header.nLat - firstRow);
+        const size_t count = (size_t)rows * header.nLon, rawBytes = count * sizeof(float);
+        const unsigned char *stored = source.data() + entry.offset;
+        values.resize(count);
+        if (entry.flags & chunkCompressed) {
+            shuffled.resize(rawBytes);
+            if (!decompressBlock(stored, entry.storedBytes, shuffled.data(), rawBytes)) return fail("chunk " + std::to_string(chunk) + " is corrupt");
+            unshuffleBytes(shuffled.data(), count, sizeof(float), (unsigned char *)values.data());
+        } else {
+            if (entry.storedBytes != rawBytes) return fail("chunk " + std::to_string(chunk) + " has the wrong size");
+            std::memcpy(values.data(), stored, rawBytes);
+        }
+        if (hashBytes(values.data(), rawBytes) != entry.hash) return fail("chunk " + std::to_string(chunk) + " fails its checksum");
+        for (int row = 0; row < rows; ++row) std::copy(values.begin() + (size_t)row * header.nLon, values.begin() + (size_t)(row + 1) * header.nLon, restored.temperature.row(firstRow + row));
+    }
+    restored.scratch = restored.temperature;
+    restored.time = header.time;
+    restored.step = header.step;
+    state = std::move(restored);
+    return true;
+}
+
+void benchmarkCheckpoint() {
+    EnergyBalanceParams params;
+    const double resolution = 0.25;
+    const int steps = 200, checkpointEvery = 20;
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "climate_checkpoint_benchmark";
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+    SimulationState state = createSimulation(resolution);
+    for (int row = 0; row < state.grid.nLat; ++row) {
+        double sinLat = std::sin(state.grid.latitudes[row]);
+        for (int col = 0; col < state.grid.nLon; ++col) {
+            state.temperature.row(row)[col] = (float)(300.0 - 45.0 * sinLat * sinLat + 3.0 * std::cos(4.0 * col * 6.283185307179586 / state.grid.nLon));
+        }
+    }
+    const double dt = stableTimestep(state, params);
+    std::cout << "Checkpoint benchmark, " << resolution << " deg, a checkpoint every " << checkpointEvery << " of " << steps << " steps" << std::endl;
+
+    double stepSeconds = 0.0, stallSeconds = 0.0, writeSeconds = 0.0;
+    size_t rawBytes = 0, writtenBytes = 0;
+    int saves = 0;
+    SimulationState saved;
+    {
+        CheckpointWriter writer(directory.string());
+        for (int step = 1; step <= steps; ++step) {
+            auto start = std::chrono::steady_clock::now();
+            stepEnergyBalance(state, params, dt);
+            stepSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (step % checkpointEvery != 0) continue;
+            writer.save(state);
+            if (step == steps) saved = state;
+            ++saves;
+        }
+        writer.flush();
+        for (const CheckpointStats &stats : writer.takeStats()) {
+            stallSeconds += stats.stallSeconds;
+            writeSeconds += stats.writeSeconds;
+            rawBytes += stats.rawBytes;
+            writtenBytes += stats.writtenBytes;
+        }
+        std::cout << std::fixed << std::setprecision(2) << "  step " << stepSeconds / steps * 1e3 << " ms, save stall " << stallSeconds / saves * 1e3
+                  << " ms, background write " << writeSeconds / saves * 1e3 << " ms, " << (double)rawBytes / writtenBytes << "x compression" << std::endl;
+        // The model changes every cell each step, so incremental saves only pay off for unchanged fields; a repeat
+        // save of the same state shows the best case
+        writer.save(state);
+        writer.flush();
+        CheckpointStats stats = writer.takeStats().back();
+        std::cout << "  repeat save: " << stats.chunksReused << " of " << stats.chunksReused + stats.chunksWritten << " chunks reused, "
+                  << stats.writtenBytes << " bytes" << std::endl;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    SimulationState restored;
+    bool loaded = loadCheckpoint(latestCheckpoint(directory.string()), restored);
+    double restoreSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (loaded) {
+        for (int step = 0; step < 10; ++step) {
+            stepEnergyBalance(saved, params, dt);
+            stepEnergyBalance(restored, params, dt);
+        }
+        bool identical = saved.time == restored.time && saved.step == restored.step;
+        for (int row = 0; row < saved.grid.nLat && identical; ++row) {
+            identical = std::memcmp(saved.temperature.row(row), restored.temperature.row(row), saved.grid.nLon * sizeof(float)) == 0;
+        }
+        std::cout << "  restart " << restoreSeconds * 1e3 << " ms, 10 steps later " << (identical ? "bit-identical" : "DIFFERENT") << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+    std::filesystem::remove_all(directory, error);
+}
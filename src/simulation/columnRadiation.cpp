@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <core/threadPool.h>
+#include <simulation/columnRadiation.h>
+
+constexpr float stefanBoltzmann = 5.670374e-8f;
+// Hottest temperature the stable timestep allows for
+constexpr double hottestColumn = 330.0;
+// Standard atmosphere exponent R lapse / g relating temperature to pressure below the tropopause, and its floor
+constexpr double lapseExponent = 0.1903;
+constexpr double tropopauseTemperature = 210.0;
+
+namespace {
+
+// Terms shared by every column of a step
+struct RadiationConstants {
+    float layerScale;     // dt over layer heat capacity
+    float surfaceScale;   // dt over surface heat capacity
+    float emissivity;     // Longwave absorbed and emitted by one layer
+    float transmissivity; // 1 - emissivity
+    float emission;       // emissivity * sigma
+    float warmAlbedo, iceAlbedo, rampSlope, rampTop;
+};
+
+RadiationConstants radiationConstants(int layers, const EnergyBalanceParams &params, const ColumnRadiationParams &radiation, double dt) {
+    const double layerHeatCapacity = radiation.specificHeat * radiation.surfacePressure / (layers * radiation.gravity);
+    const double emissivity = 1.0 - std::exp(-radiation.diffusivityFactor * radiation.longwaveDepth / layers);
+    return RadiationConstants{
+        (float)(dt / layerHeatCapacity), (float)(dt / params.heatCapacity),
+        (float)emissivity, (float)(1.0 - emissivity), (float)(emissivity * stefanBoltzmann),
+        (float)params.warmAlbedo, (float)params.iceAlbedo,
+        (float)((params.iceAlbedo - params.warmAlbedo) / params.iceRampWidth),
+        (float)(params.iceTemperature + 0.5 * params.iceRampWidth)
+    };
+}
+
+// Sunlight absorbed by each layer of a row, then that reaching the surface, W m^-2
+void rowShortwave(double insolation, int layers, const ColumnRadiationParams &radiation, float *shortwave) {
+    const double layerTransmission = std::exp(-radiation.shortwaveDepth / layers);
+    double beam = insolation;
+    for (int layer = 0; layer < layers; ++layer) {
+        shortwave[layer] = (float)(beam * (1.0 - layerTransmission));
+        beam *= layerTransmission;
+    }
+    shortwave[layers] = (float)beam;
+}
+
+// One row, columnBlock columns at a time. Every loop over lanes has a fixed trip count and every layer loop is
+// unrolled for the layer count, so the whole block stays in vector registers and the stack.
+template <int Layers>
+void radiateRow(const RadiationConstants &c, const float *shortwave, float *surface, float *layerRows, int layerStride, int nLon) {
+    for (int col = 0; col < nLon; col += columnBlock) {
+        alignas(fieldAlignment) float emission[Layers][columnBlock];
+        alignas(fieldAlignment) float absorbed[Layers][columnBlock];
+        alignas(fieldAlignment) float up[columnBlock], down[columnBlock], next[columnBlock];
+        for (int layer = 0; layer < Layers; ++layer) {
+            const float *t = layerRows + (size_t)layer * layerStride + col;
+            for (int lane = 0; lane < columnBlock; ++lane) {
+                float t2 = t[lane] * t[lane];
+                emission[layer][lane] = c.emission * t2 * t2;
+            }
+        }
+        // Upward stream from the surface, then downward from space
+        for (int lane = 0; lane < columnBlock; ++lane) {
+            float t2 = surface[col + lane] * surface[col + lane];
+            up[lane] = stefanBoltzmann * t2 * t2;
+            down[lane] = 0.0f;
+        }
+        for (int layer = Layers - 1; layer >= 0; --layer) {
+            for (int lane = 0; lane < columnBlock; ++lane) {
+                absorbed[layer][lane] = c.emissivity * up[lane];
+                up[lane] = c.transmissivity * up[lane] + emission[layer][lane];
+            }
+        }
+        for (int layer = 0; layer < Layers; ++layer) {
+            for (int lane = 0; lane < columnBlock; ++lane) {
+                absorbed[layer][lane] += c.emissivity * down[lane];
+                down[lane] = c.transmissivity * down[lane] + emission[layer][lane];
+            }
+        }
+
+        // Padding columns are computed along with the rest but never written back
+        const int count = std::min(columnBlock, nLon - col);
+        for (int layer = 0; layer < Layers; ++layer) {
+            float *t = layerRows + (size_t)layer * layerStride + col;
+            for (int lane = 0; lane < columnBlock; ++lane) {
+                next[lane] = t[lane] + c.layerScale * (shortwave[layer] + absorbed[layer][lane] - 2.0f * emission[layer][lane]);
+            }
+            std::copy(next, next + count, t);
+        }
+        for (int lane = 0; lane < columnBlock; ++lane) {
+            float t = surface[col + lane], t2 = t * t;
+            float albedo = std::min(std::max(c.warmAlbedo + c.rampSlope * (c.rampTop - t), c.warmAlbedo), c.iceAlbedo);
+            next[lane] = t + c.surfaceScale * (shortwave[Layers] * (1.0f - albedo) + down[lane] - stefanBoltzmann * t2 * t2);
+        }
+        std::copy(next, next + count, surface + col);
+    }
+}
+
+using RowKernel = void (*)(const RadiationConstants &, const float *, float *, float *, int, int);
+
+RowKernel rowKernel(int layers) {
+    switch (layers) {
+    case 8: return radiateRow<8>;
+    case 16: return radiateRow<16>;
+    case 32: return radiateRow<32>;
+    case 64: return radiateRow<64>;
+    default: return nullptr;
+    }
+}
+
+// The same physics one column at a time with the layer count known only at run time, as a baseline
+void radiateColumns(SimulationState &state, ColumnAtmosphere &atmosphere, const EnergyBalanceParams &params,
+                    const ColumnRadiationParams &radiation, double dt) {
+    const LatLonGrid &grid = state.grid;
+    const int layers = atmosphere.layers;
+    const RadiationConstants c = radiationConstants(layers, params, radiation, dt);
+    threadPool().parallelFor(0, grid.nLat, [&](int rowBegin, int rowEnd) {
+        std::vector<float> shortwave(layers + 1), emission(layers), absorbed(layers);
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            rowShortwave(dailyInsolation(params, grid.latitudes[row], state.time), layers, radiation, shortwave.data());
+            float *surface = state.temperature.row(row);
+            for (int col = 0; col < grid.nLon; ++col) {
+                for (int layer = 0; layer < layers; ++layer) {
+                    float t = atmosphere.layerRow(row, layer)[col], t2 = t * t;
+                    emission[layer] = c.emission * t2 * t2;
+                }
+                float t = surface[col], t2 = t * t;
+                float up = stefanBoltzmann * t2 * t2, down = 0.0f;
+                for (int layer = layers - 1; layer >= 0; --layer) {
+                    absorbed[layer] = c.emissivity * up;
+                    up = c.transmissivity * up + emission[layer];
+                }
+                for (int layer = 0; layer < layers; ++layer) {
+                    absorbed[layer] += c.emissivity * down;
+                    down = c.transmissivity * down + emission[layer];
+                }
+                for (int layer = 0; layer < layers; ++layer) {
+                    float &value = atmosphere.layerRow(row, layer)[col];
+                    value = value + c.layerScale * (shortwave[layer] + absorbed[layer] - 2.0f * emission[layer]);
+                }
+                float albedo = std::min(std::max(c.warmAlbedo + c.rampSlope * (c.rampTop - t), c.warmAlbedo), c.iceAlbedo);
+                surface[col] = t + c.surfaceScale * (shortwave[layers] * (1.0f - albedo) + down - stefanBoltzmann * t2 * t2);
+            }
+        }
+    });
+}
+
+} // namespace
+
+bool initializeColumnAtmosphere(ColumnAtmosphere &atmosphere, const SimulationState &state, int layers) {
+    if (!rowKernel(layers)) {
+        std::cout << "Column radiation is not compiled for " << layers << " layers" << std::endl;
+        return false;
+    }
+    const LatLonGrid &grid = state.grid;
+    atmosphere.layers = layers;
+    atmosphere.temperature = Field(grid.nLat * layers, grid.nLon);
+    for (int row = 0; row < grid.nLat; ++row) {
+        const float *surface = state.temperature.row(row);
+        for (int layer = 0; layer < layers; ++layer) {
+            // Layer midpoint pressure over the surface pressure
+            const double sigma = (layer + 0.5) / layers, scale = std::pow(sigma, lapseExponent);
+            float *values = atmosphere.layerRow(row, layer);
+            // Padding too, so the kernel only ever reads finite temperatures
+            for (int col = 0; col < atmosphere.temperature.stride; ++col) {
+                const double t = col < grid.nLon ? surface[col] : surface[0];
+                values[col] = (float)std::max(t * scale, tropopauseTemperature);
+            }
+        }
+    }
+    return true;
+}
+
+void applyColumnRadiation(SimulationState &state, ColumnAtmosphere &atmosphere, const EnergyBalanceParams &params,
+                          const ColumnRadiationParams &radiation, double dt) {
+    const LatLonGrid &grid = state.grid;
+    const int layers = atmosphere.layers;
+    const RowKernel kernel = rowKernel(layers);
+    if (!kernel) return;
+    const RadiationConstants c = radiationConstants(layers, params, radiation, dt);
+    const int layerStride = atmosphere.temperature.stride;
+    threadPool().parallelFor(0, grid.nLat, [&](int rowBegin, int rowEnd) {
+        std::vector<float> shortwave(layers + 1);
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            rowShortwave(dailyInsolation(params, grid.latitudes[row], state.time), layers, radiation, shortwave.data());
+            kernel(c, shortwave.data(), state.temperature.row(row), atmosphere.layerRow(row, 0), layerStride, grid.nLon);
+        }
+    });
+}
+
+double columnRadiationTimestep(const ColumnAtmosphere &atmosphere, const EnergyBalanceParams &params, const ColumnRadiationParams &radiation) {
+    if (atmosphere.layers <= 0) return 1e300;
+    // Cooling rates of a layer (emitting both ways) and the surface at the hottest temperature; halved for the
+    // coupling between them
+    const RadiationConstants c = radiationConstants(atmosphere.layers, params, radiation, 1.0);
+    const double t3 = hottestColumn * hottestColumn * hottestColumn;
+    const double layerRate = 8.0 * c.emission * t3 * c.layerScale;
+    const double surfaceRate = 4.0 * stefanBoltzmann * t3 * c.surfaceScale;
+    return 0.5 / std::max(layerRate, surfaceRate);
+}
+
+void addColumnRadiationComponent(Scheduler &scheduler, std::shared_ptr<ColumnAtmosphere> atmosphere, const EnergyBalanceParams &params,
+                                 const ColumnRadiationParams &radiation, int interval) {
+    PhysicsComponent component;
+    component.name = columnRadiationName;
+    component.step = [atmosphere, params, radiation](SimulationState &state, double dt) {
+        applyColumnRadiation(state, *atmosphere, params, radiation, dt);
+    };
+    component.stableTimestep = [atmosphere, params, radiation](const SimulationState &) {
+        return columnRadiationTimestep(*atmosphere, params, radiation);
+    };
+    component.interval = interval;
+    scheduler.addComponent(component);
+}
+
+void benchmarkColumnRadiation() {
+    const EnergyBalanceParams params;
+    const ColumnRadiationParams radiation;
+    const double resolution = 1.0;
+    std::cout << "Column radiation benchmark (" << threadPool().size() << " threads), " << resolution << " deg, "
+              << columnBlock << " columns per block" << std::endl;
+    SimulationState initial = createSimulation(resolution);
+    for (int row = 0; row < initial.grid.nLat; ++row) {
+        double sinLat = std::sin(initial.grid.latitudes[row]);
+        std::fill(initial.temperature.row(row), initial.temperature.row(row) + initial.grid.nLon, (float)(300.0 - 45.0 * sinLat * sinLat));
+    }
+    const double columns = (double)initial.grid.nLat * initial.grid.nLon;
+    for (int layers : columnLayerCounts) {
+        SimulationState blocked = initial, reference = initial;
+        ColumnAtmosphere blockedAtmosphere, referenceAtmosphere;
+        initializeColumnAtmosphere(blockedAtmosphere, blocked, layers);
+        referenceAtmosphere = blockedAtmosphere;
+        const double dt = columnRadiationTimestep(blockedAtmosphere, params, radiation);
+
+        // Same number of steps for both so the final states can be compared
+        const int steps = std::max(4, 256 / layers);
+        auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < steps; ++step) applyColumnRadiation(blocked, blockedAtmosphere, params, radiation, dt);
+        double blockedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        for (int step = 0; step < steps; ++step) radiateColumns(reference, referenceAtmosphere, params, radiation, dt);
+        double referenceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        float maxDifference = 0.0f;
+        for (int row = 0; row < initial.grid.nLat; ++row) {
+            for (int col = 0; col < initial.grid.nLon; ++col) {
+                maxDifference = std::max(maxDifference, std::abs(blocked.temperature.at(row, col) - reference.temperature.at(row, col)));
+                for (int layer = 0; layer < layers; ++layer) {
+                    maxDifference = std::max(maxDifference, std::abs(blockedAtmosphere.layerRow(row, layer)[col] - referenceAtmosphere.layerRow(row, layer)[col]));
+                }
+            }
+        }
+        std::cout << "  " << std::setw(2) << layers << " layers  blocked " << std::fixed << std::setprecision(2) << std::setw(8)
+                  << columns * steps / blockedSeconds / 1e6 << " Mcolumns/s  per column " << std::setw(8) << columns * steps / referenceSeconds / 1e6
+                  << " Mcolumns/s  (" << referenceSeconds / blockedSeconds << "x)  max difference " << std::scientific << std::setprecision(1)
+                  << maxDifference << " K  mean " << std::fixed << std::setprecision(2) << globalMeanTemperature(blocked) << " K" << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <utility>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <core/threadPool.h>
+#include <simulation/decomposition.h>
+
+std::vector<Patch> decomposeRows(int nLat, int numRanks) {
+    numRanks = std::max(1, std::min(numRanks, nLat));
+    std::vector<Patch> patches(numRanks);
+    int row = 0;
+    for (int rank = 0; rank < numRanks; ++rank) {
+        patches[rank].rank = rank;
+        patches[rank].firstRow = row;
+        patches[rank].numRows = nLat / numRanks + (rank < nLat % numRanks ? 1 : 0);
+        row += patches[rank].numRows;
+    }
+    return patches;
+}
+
+// Written and read byte counts live on separate cache lines so producer and consumer do not contend
+struct SharedMemoryRings::Ring {
+    alignas(64) std::atomic<unsigned long long> written;
+    alignas(64) std::atomic<unsigned long long> read;
+
+    unsigned char *data() { return (unsigned char *)this + sizeof(Ring); }
+};
+
+static_assert(std::atomic<unsigned long long>::is_always_lock_free, "ring counters must be lock free to live in shared memory");
+
+namespace {
+
+size_t ringStride(size_t ringBytes) {
+    return sizeof(SharedMemoryRings::Ring) + (ringBytes + 63) / 64 * 64;
+}
+
+// Rings are indexed by peer: 0 for the northern neighbour, 1 for the southern one
+class RingEndpoint : public HaloEndpoint {
+public:
+    using Ring = SharedMemoryRings::Ring;
+
+    RingEndpoint(int rank, Ring *outgoingNorth, Ring *incomingNorth, Ring *outgoingSouth, Ring *incomingSouth, size_t capacity)
+        : rank(rank), outgoing{outgoingNorth, outgoingSouth}, incoming{incomingNorth, incomingSouth}, capacity(capacity) {}
+
+    bool send(int peer, const void *data, size_t bytes) override {
+        Ring *target = peer == rank - 1 ? outgoing[0] : peer == rank + 1 ? outgoing[1] : nullptr;
+        if (!target) return false;
+        const unsigned char *source = (const unsigned char *)data;
+        unsigned long long written = target->written.load(std::memory_order_relaxed);
+        while (bytes > 0) {
+            size_t space;
+            while ((space = capacity - (size_t)(written - target->read.load(std::memory_order_acquire))) == 0) std::this_thread::yield();
+            size_t offset = (size_t)(written % capacity), chunk = std::min({bytes, space, capacity - offset});
+            std::memcpy(target->data() + offset, source, chunk);
+            written += chunk;
+            target->written.store(written, std::memory_order_release);
+            source += chunk;
+            bytes -= chunk;
+        }
+        return true;
+    }
+
+    bool receive(int peer, void *data, size_t bytes) override {
+        Ring *source = peer == rank - 1 ? incoming[0] : peer == rank + 1 ? incoming[1] : nullptr;
+        if (!source) return false;
+        unsigned char *target = (unsigned char *)data;
+        unsigned long long read = source->read.load(std::memory_order_relaxed);
+        while (bytes > 0) {
+            size_t available;
+            while ((available = (size_t)(source->written.load(std::memory_order_acquire) - read)) == 0) std::this_thread::yield();
+            size_t offset = (size_t)(read % capacity), chunk = std::min({bytes, available, capacity - offset});
+            std::memcpy(target, source->data() + offset, chunk);
+            read += chunk;
+            source->read.store(read, std::memory_order_release);
+            target += chunk;
+            bytes -= chunk;
+        }
+        return true;
+    }
+
+private:
+    int rank;
+    Ring *outgoing[2];
+    Ring *incoming[2];
+    size_t capacity;
+};
+
+} // namespace
+
+SharedMemoryRings::SharedMemoryRings(int numRanks, size_t ringBytes) : numRanks(numRanks), ringBytes(ringBytes) {
+#ifndef _WIN32
+    // One ring in each direction between every pair of neighbouring bands
+    mappedBytes = std::max(1, 2 * (numRanks - 1)) * ringStride(ringBytes);
+    void *mapped = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+        std::cout << "Failed to map " << mappedBytes << " bytes of shared memory for halo rings" << std::endl;
+        return;
+    }
+    memory = mapped;
+    for (int index = 0; index < 2 * (numRanks - 1); ++index) {
+        Ring *r = (Ring *)((unsigned char *)memory + index * ringStride(ringBytes));
+        new (&r->written) std::atomic<unsigned long long>(0);
+        new (&r->read) std::atomic<unsigned long long>(0);
+    }
+#endif
+}
+
+SharedMemoryRings::~SharedMemoryRings() {
+#ifndef _WIN32
+    if (memory) munmap(memory, mappedBytes);
+#endif
+}
+
+SharedMemoryRings::Ring *SharedMemoryRings::ring(int from, int to) const {
+    if (!memory || std::abs(from - to) != 1 || std::min(from, to) < 0 || std::max(from, to) >= numRanks) return nullptr;
+    int index = 2 * std::min(from, to) + (from > to ? 1 : 0);
+    return (Ring *)((unsigned char *)memory + index * ringStride(ringBytes));
+}
+
+std::unique_ptr<HaloEndpoint> SharedMemoryRings::endpoint(int rank) {
+    return std::make_unique<RingEndpoint>(rank, ring(rank, rank - 1), ring(rank - 1, rank), ring(rank, rank + 1), ring(rank + 1, rank), ringBytes);
+}
+
+#ifndef _WIN32
+namespace {
+
+class SocketEndpoint : public HaloEndpoint {
+public:
+    SocketEndpoint(int rank, int north, int south) : rank(rank), north(north), south(south) {}
+    ~SocketEndpoint() override {
+        if (north >= 0) close(north);
+        if (south >= 0) close(south);
+    }
+
+    bool send(int peer, const void *data, size_t bytes) override {
+        int socket = peer == rank - 1 ? north : peer == rank + 1 ? south : -1;
+        const char *source = (const char *)data;
+        while (socket >= 0 && bytes > 0) {
+            ssize_t sent = ::send(socket, source, bytes, MSG_NOSIGNAL);
+            if (sent <= 0) return false;
+            source += sent;
+            bytes -= (size_t)sent;
+        }
+        return socket >= 0;
+    }
+
+    bool receive(int peer, void *data, size_t bytes) override {
+        int socket = peer == rank - 1 ? north : peer == rank + 1 ? south : -1;
+        char *target = (char *)data;
+        while (socket >= 0 && bytes > 0) {
+            ssize_t received = recv(socket, target, bytes, 0);
+            if (received <= 0) return false;
+            target += received;
+            bytes -= (size_t)received;
+        }
+        return socket >= 0;
+    }
+
+private:
+    int rank;
+    int north;
+    int south;
+};
+
+void setNoDelay(int socket) {
+    int one = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+} // namespace
+#endif
+
+std::unique_ptr<HaloEndpoint> connectSocketEndpoint(int rank, int numRanks, const std::vector<std::string> &hosts, int basePort, double timeoutSeconds) {
+#ifdef _WIN32
+    std::cout << "Socket halo exchange is only available on POSIX systems" << std::endl;
+    return nullptr;
+#else
+    int listener = -1, north = -1, south = -1;
+    auto fail = [&](const std::string &message) -> std::unique_ptr<HaloEndpoint> {
+        std::cout << "Rank " << rank << ": " << message << std::endl;
+        for (int socket : {listener, north, south}) {
+            if (socket >= 0) close(socket);
+        }
+        return nullptr;
+    };
+    // Listen for the southern neighbour before connecting north, so the chain of connects cannot deadlock
+    if (rank + 1 < numRanks) {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons((unsigned short)(basePort + rank));
+        if (listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 1) != 0) {
+            return fail("could not listen on port " + std::to_string(basePort + rank));
+        }
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeoutSeconds);
+    if (rank > 0) {
+        const std::string &host = hosts.empty() ? std::string("127.0.0.1") : hosts[std::min((size_t)rank - 1, hosts.size() - 1)];
+        addrinfo hints{}, *found = nullptr;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), std::to_string(basePort + rank - 1).c_str(), &hints, &found) != 0 || !found) {
+            return fail("could not resolve " + host);
+        }
+        // The northern neighbour may not be listening yet
+        while (true) {
+            north = socket(AF_INET, SOCK_STREAM, 0);
+            if (north >= 0 && connect(north, found->ai_addr, found->ai_addrlen) == 0) break;
+            if (north >= 0) close(north);
+            north = -1;
+            if (std::chrono::steady_clock::now() > deadline) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        freeaddrinfo(found);
+        if (north < 0) return fail("could not connect to " + host + ":" + std::to_string(basePort + rank - 1));
+        setNoDelay(north);
+    }
+    if (listener >= 0) {
+        // A southern rank that never starts must not hang this one: wait for it only until the same deadline
+        pollfd pending{listener, POLLIN, 0};
+        int ready = 0;
+        do {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            ready = poll(&pending, 1, (int)std::max<long long>(remaining, 0));
+        } while (ready < 0 && errno == EINTR);
+        if (ready <= 0) return fail("timed out waiting for rank " + std::to_string(rank + 1));
+        south = accept(listener, nullptr, nullptr);
+        close(listener);
+        listener = -1;
+        if (south < 0) return fail("no connection from rank " + std::to_string(rank + 1));
+        setNoDelay(south);
+    }
+    return std::make_unique<SocketEndpoint>(rank, north, south);
+#endif
+}
+
+PatchTimings stepPatch(SimulationState &state, const EnergyBalanceParams &params, double dt, int steps, const Patch &patch, HaloEndpoint &endpoint) {
+    const LatLonGrid &grid = state.grid;
+    const int nLat = grid.nLat, nLon = grid.nLon, numRows = patch.numRows, firstRow = patch.firstRow;
+    const bool hasNorth = firstRow > 0, hasSouth = firstRow + numRows < nLat;
+    const size_t rowBytes = (size_t)nLon * sizeof(float);
+    // Local copy of the band with one halo row either side
+    Field current(numRows + 2, nLon), next(numRows + 2, nLon);
+    for (int row = 0; row < numRows; ++row) std::copy(state.temperature.row(firstRow + row), state.temperature.row(firstRow + row) + nLon, current.row(row + 1));
+    PatchTimings timings;
+    auto start = std::chrono::steady_clock::now();
+    auto stepRow = [&](int local) {
+        int row = firstRow + local - 1;
+        // At a pole the row is its own neighbour, as in stepEnergyBalance
+        const float *north = row == 0 ? current.row(local) : current.row(local - 1);
+        const float *south = row == nLat - 1 ? current.row(local) : current.row(local + 1);
+        stepEnergyBalanceRow(grid, params, row, state.time, dt, north, current.row(local), south, next.row(local));
+    };
+    for (int step = 0; step < steps && timings.ok; ++step) {
+        if (hasNorth) timings.ok &= endpoint.send(patch.rank - 1, current.row(1), rowBytes);
+        if (hasSouth) timings.ok &= endpoint.send(patch.rank + 1, current.row(numRows), rowBytes);
+        for (int local = 2; local < numRows; ++local) stepRow(local);
+        auto waitStart = std::chrono::steady_clock::now();
+        if (hasNorth) timings.ok &= endpoint.receive(patch.rank - 1, current.row(0), rowBytes);
+        if (hasSouth) timings.ok &= endpoint.receive(patch.rank + 1, current.row(numRows + 1), rowBytes);
+        timings.haloSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+        stepRow(1);
+        if (numRows > 1) stepRow(numRows);
+        std::swap(current, next);
+        state.time += dt;
+        ++state.step;
+    }
+    timings.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (int row = 0; row < numRows; ++row) std::copy(current.row(row + 1), current.row(row + 1) + nLon, state.temperature.row(firstRow + row));
+    return timings;
+}
+
+DecomposedRunStats runDecomposed(SimulationState &state, const EnergyBalanceParams &params, double dt, int steps, int numRanks,
+                                 HaloTransport transport, int basePort) {
+    DecomposedRunStats stats;
+#ifdef _WIN32
+    std::cout << "Multi-process decomposition is only available on POSIX systems" << std::endl;
+    return stats;
+#else
+    const int nLat = state.grid.nLat, nLon = state.grid.nLon;
+    std::vector<Patch> patches = decomposeRows(nLat, numRanks);
+    numRanks = (int)patches.size();
+    stats.ranks = numRanks;
+    // Workers write their bands and timings straight into a shared mapping the parent gathers from
+    size_t resultBytes = (size_t)nLat * nLon * sizeof(float) + numRanks * sizeof(PatchTimings);
+    void *mapped = mmap(nullptr, resultBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+        std::cout << "Failed to map shared memory for the decomposed result" << std::endl;
+        return stats;
+    }
+    float *result = (float *)mapped;
+    PatchTimings *rankTimings = (PatchTimings *)(result + (size_t)nLat * nLon);
+    std::unique_ptr<SharedMemoryRings> rings;
+    if (transport == HaloTransport::SharedMemory) {
+        // Room for a few rows in flight each way; a rank never gets more than one step ahead of its neighbours
+        rings = std::make_unique<SharedMemoryRings>(numRanks, 4 * (size_t)nLon * sizeof(float));
+        if (!rings->valid()) {
+            munmap(mapped, resultBytes);
+            return stats;
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<pid_t> workers;
+    for (const Patch &patch : patches) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            // Worker: only this thread survives the fork, so it steps its band serially and leaves with _exit,
+            // skipping the parent's static destructors (the thread pool among them)
+            std::unique_ptr<HaloEndpoint> endpoint = rings ? rings->endpoint(patch.rank) : connectSocketEndpoint(patch.rank, numRanks, {"127.0.0.1"}, basePort);
+            PatchTimings timings;
+            timings.ok = false;
+            if (endpoint) timings = stepPatch(state, params, dt, steps, patch, *endpoint);
+            for (int row = 0; row < patch.numRows; ++row) {
+                const float *values = state.temperature.row(patch.firstRow + row);
+                std::copy(values, values + nLon, result + (size_t)(patch.firstRow + row) * nLon);
+            }
+            rankTimings[patch.rank] = timings;
+            _exit(timings.ok ? 0 : 1);
+        }
+        if (pid < 0) {
+            std::cout << "Failed to fork worker " << patch.rank << std::endl;
+            break;
+        }
+        workers.push_back(pid);
+    }
+    bool ok = workers.size() == patches.size();
+    for (pid_t pid : workers) {
+        int status = 0;
+        if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (ok) {
+        for (int row = 0; row < nLat; ++row) std::copy(result + (size_t)row * nLon, result + (size_t)(row + 1) * nLon, state.temperature.row(row));
+        for (int rank = 0; rank < numRanks; ++rank) stats.haloSeconds = std::max(stats.haloSeconds, rankTimings[rank].haloSeconds);
+        state.time += steps * dt;
+        state.step += steps;
+    } else {
+        std::cout << "Decomposed run over " << numRanks << " ranks failed" << std::endl;
+    }
+    stats.ok = ok;
+    munmap(mapped, resultBytes);
+    return stats;
+#endif
+}
+
+void benchmarkDecomposition() {
+    EnergyBalanceParams params;
+    const int steps = 40;
+    const int maxRanks = (int)std::max(2u, std::min(16u, std::thread::hardware_concurrency()));
+    auto initialState = [](double resolution) {
+        SimulationState state = createSimulation(resolution);
+        for (int row = 0; row < state.grid.nLat; ++row) {
+            double sinLat = std::sin(state.grid.latitudes[row]);
+            for (int col = 0; col < state.grid.nLon; ++col) {
+                state.temperature.row(row)[col] = (float)(300.0 - 45.0 * sinLat * sinLat + 3.0 * std::cos(4.0 * col * 6.283185307179586 / state.grid.nLon));
+            }
+        }
+        return state;
+    };
+    auto maxDifference = [](const SimulationState &a, const SimulationState &b) {
+        double difference = 0.0;
+        for (int row = 0; row < a.grid.nLat; ++row) {
+            for (int col = 0; col < a.grid.nLon; ++col) difference = std::max(difference, (double)std::abs(a.temperature.at(row, col) - b.temperature.at(row, col)));
+        }
+        return difference;
+    };
+    std::cout << "Decomposition benchmark, " << steps << " steps, up to " << maxRanks << " worker processes" << std::endl;
+    int port = 47000;
+    for (HaloTransport transport : {HaloTransport::SharedMemory, HaloTransport::Socket}) {
+        const char *name = transport == HaloTransport::SharedMemory ? "shared memory" : "localhost TCP";
+        // Strong scaling: one 0.25 degree grid over more and more ranks
+        SimulationState reference = initialState(0.25);
+        double dt = stableTimestep(reference, params);
+        auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < steps; ++step) stepEnergyBalance(reference, params, dt);
+        double serialSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "  " << name << ", strong scaling at 0.25 deg (" << threadPool().size() << " thread reference " << std::fixed
+                  << std::setprecision(1) << serialSeconds * 1e3 << " ms)" << std::endl;
+        double oneRank = 0.0;
+        for (int ranks = 1; ranks <= maxRanks; ranks *= 2) {
+            SimulationState state = initialState(0.25);
+            DecomposedRunStats stats = runDecomposed(state, params, dt, steps, ranks, transport, port);
+            port += ranks + 1;
+            if (!stats.ok) continue;
+            if (ranks == 1) oneRank = stats.seconds;
+            std::cout << "    " << std::setw(2) << ranks << " ranks " << std::setw(8) << stats.seconds * 1e3 << " ms  speedup " << std::setprecision(2)
+                      << std::setw(5) << oneRank / stats.seconds << "  efficiency " << std::setw(4) << oneRank / stats.seconds / ranks << "  halo wait "
+                      << std::setprecision(1) << std::setw(6) << stats.haloSeconds * 1e3 << " ms  max difference " << std::defaultfloat
+                      << maxDifference(state, reference) << " K" << std::fixed << std::endl;
+        }
+        // Weak scaling: rows grow with the rank count so cells per rank stay near 360x720
+        std::cout << "  " << name << ", weak scaling" << std::endl;
+        double baseline = 0.0;
+        for (int ranks = 1; ranks <= maxRanks; ranks *= 2) {
+            int nLat = 2 * (int)std::lround(180.0 * std::sqrt((double)ranks));
+            SimulationState state = initialState(180.0 / nLat);
+            DecomposedRunStats stats = runDecomposed(state, params, stableTimestep(state, params), steps, ranks, transport, port);
+            port += ranks + 1;
+            if (!stats.ok) continue;
+            if (ranks == 1) baseline = stats.seconds;
+            double cellsPerRank = (double)state.grid.nLat * state.grid.nLon / ranks;
+            std::cout << "    " << std::setw(2) << ranks << " ranks " << std::setw(5) << state.grid.nLon << "x" << std::setw(4) << state.grid.nLat
+                      << std::setprecision(2) << std::setw(6) << cellsPerRank / 1e6 << " Mcells/rank " << std::setprecision(1) << std::setw(8)
+                      << stats.seconds * 1e3 << " ms  efficiency " << std::setprecision(2) << baseline / stats.seconds << std::endl;
+        }
+        std::cout << std::defaultfloat << std::setprecision(6);
+    }
+}
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+
+#include <core/reduction.h>
+#include <core/threadPool.h>
+#include <simulation/energyBalance.h>
+
+constexpr double ebmPi = 3.14159265358979323846;
+constexpr double secondsPerDay = 86400.0;
+constexpr double daysPerYear = 365.25;
+constexpr double vernalEquinoxDay = 80.0;
+
+namespace {
+
+// Calls update(col, west, east) for every cell of a periodic row, ends peeled off so the interior loop is a plain
+// unit-stride sweep
+template <typename Update>
+inline void sweepRow(int nLon, const float *centre, Update update) {
+    update(0, centre[nLon - 1], centre[1 % nLon]);
+    for (int col = 1; col < nLon - 1; ++col) update(col, centre[col - 1], centre[col + 1]);
+    if (nLon > 1) update(nLon - 1, centre[nLon - 2], centre[0]);
+}
+
+} // namespace
+
+double dailyInsolation(const EnergyBalanceParams &params, double latitude, double time) {
+    double day = std::fmod(time / secondsPerDay, daysPerYear);
+    double declination = params.obliquity * ebmPi / 180.0 * std::sin(2.0 * ebmPi * (day - vernalEquinoxDay) / daysPerYear);
+    // Hour angle of sunset, clamped for polar day and night
+    double cosSunset = std::min(std::max(-std::tan(latitude) * std::tan(declination), -1.0), 1.0);
+    double sunset = std::acos(cosSunset);
+    return params.solarConstant / ebmPi * (sunset * std::sin(latitude) * std::sin(declination) + std::cos(latitude) * std::cos(declination) * std::sin(sunset));
+}
+
+RowDiffusion rowDiffusion(const LatLonGrid &grid, const EnergyBalanceParams &params, int row) {
+    double dLat = ebmPi / grid.nLat, dLon = 2.0 * ebmPi / grid.nLon, cosLat = grid.cosLat[row];
+    return RowDiffusion{
+        (float)(params.diffusivity * grid.cosEdge[row] / (cosLat * dLat * dLat)),
+        (float)(params.diffusivity * grid.cosEdge[row + 1] / (cosLat * dLat * dLat)),
+        (float)(params.diffusivity / (cosLat * cosLat * dLon * dLon))
+    };
+}
+
+double stableTimestep(const SimulationState &state, const EnergyBalanceParams &params) {
+    double limit = 1e300;
+    for (int row = 0; row < state.grid.nLat; ++row) {
+        RowDiffusion diffusion = rowDiffusion(state.grid, params, row);
+        double rate = diffusion.north + diffusion.south + 2.0 * diffusion.zonal + params.olrB;
+        limit = std::min(limit, minHeatCapacity(params) / rate);
+    }
+    return limit;
+}
+
+void stepEnergyBalanceRow(const LatLonGrid &grid, const EnergyBalanceParams &params, int row, double time, double dt,
+                          const float *__restrict north, const float *__restrict centre, const float *__restrict south, float *__restrict out) {
+    EnergyBalanceConstants<1> constants;
+    constants.set(0, grid, params, row, dt, (float)dailyInsolation(params, grid.latitudes[row], time));
+    if (params.surface) {
+        const float *__restrict albedo = params.surface->warmAlbedo.row(row);
+        const float *__restrict inverseCapacity = params.surface->inverseHeatCapacity.row(row);
+        const float dtf = (float)dt;
+        sweepRow(grid.nLon, centre, [=](int col, float west, float east) {
+            out[col] = energyBalanceCell(constants, 0, centre[col], north[col], south[col], west, east, albedo[col], dtf * inverseCapacity[col]);
+        });
+    } else {
+        sweepRow(grid.nLon, centre, [=](int col, float west, float east) { out[col] = energyBalanceCell(constants, 0, centre[col], north[col], south[col], west, east); });
+    }
+}
+
+void stepEnergyBalance(SimulationState &state, const EnergyBalanceParams &params, double dt) {
+    const LatLonGrid &grid = state.grid;
+    const int nLat = grid.nLat;
+    const Field &current = state.temperature;
+    Field &next = state.scratch;
+    threadPool().parallelFor(0, nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            stepEnergyBalanceRow(grid, params, row, state.time, dt, current.row(std::max(row - 1, 0)), current.row(row),
+                                 current.row(std::min(row + 1, nLat - 1)), next.row(row));
+        }
+    }, 4);
+    std::swap(state.temperature, state.scratch);
+    state.time += dt;
+    ++state.step;
+}
+
+void applyRadiation(SimulationState &state, const EnergyBalanceParams &params, double dt) {
+    const LatLonGrid &grid = state.grid;
+    threadPool().parallelFor(0, grid.nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            EnergyBalanceConstants<1> constants;
+            constants.set(0, grid, params, row, dt, (float)dailyInsolation(params, grid.latitudes[row], state.time));
+            float *values = state.temperature.row(row);
+            if (params.surface) {
+                const float *albedo = params.surface->warmAlbedo.row(row), *inverseCapacity = params.surface->inverseHeatCapacity.row(row);
+                const float dtf = (float)dt;
+                for (int col = 0; col < grid.nLon; ++col) values[col] = values[col] + dtf * inverseCapacity[col] * radiativeForcing(constants, 0, values[col], albedo[col]);
+            } else {
+                for (int col = 0; col < grid.nLon; ++col) values[col] = values[col] + constants.scale[0] * radiativeForcing(constants, 0, values[col]);
+            }
+        }
+    }, 4);
+}
+
+void applyDiffusionRow(const LatLonGrid &grid, const EnergyBalanceParams &params, int row, double dt,
+                       const float *__restrict north, const float *__restrict centre, const float *__restrict south, float *__restrict out) {
+    const RowDiffusion diffusion = rowDiffusion(grid, params, row);
+    auto transport = [=](int col, float west, float east) {
+        float t = centre[col];
+        return diffusion.north * (north[col] - t) + diffusion.south * (south[col] - t) + diffusion.zonal * (west + east - 2.0f * t);
+    };
+    if (params.surface) {
+        const float *__restrict inverseCapacity = params.surface->inverseHeatCapacity.row(row);
+        const float dtf = (float)dt;
+        sweepRow(grid.nLon, centre, [=](int col, float west, float east) { out[col] = centre[col] + dtf * inverseCapacity[col] * transport(col, west, east); });
+    } else {
+        const float scale = (float)(dt / params.heatCapacity);
+        sweepRow(grid.nLon, centre, [=](int col, float west, float east) { out[col] = centre[col] + scale * transport(col, west, east); });
+    }
+}
+
+void applyDiffusion(SimulationState &state, const EnergyBalanceParams &params, double dt) {
+    const LatLonGrid &grid = state.grid;
+    const int nLat = grid.nLat;
+    const Field &current = state.temperature;
+    Field &next = state.scratch;
+    threadPool().parallelFor(0, nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            applyDiffusionRow(grid, params, row, dt, current.row(std::max(row - 1, 0)), current.row(row), current.row(std::min(row + 1, nLat - 1)),
+                              next.row(row));
+        }
+    }, 4);
+    std::swap(state.temperature, state.scratch);
+}
+
+double diffusionTimestep(const SimulationState &state, const EnergyBalanceParams &params) {
+    double limit = 1e300;
+    for (int row = 0; row < state.grid.nLat; ++row) {
+        RowDiffusion diffusion = rowDiffusion(state.grid, params, row);
+        limit = std::min(limit, minHeatCapacity(params) / (diffusion.north + diffusion.south + 2.0 * diffusion.zonal));
+    }
+    return limit;
+}
+
+double globalMeanTemperature(const SimulationState &state) {
+    return reduceSum(0, state.grid.nLat, 1, [&](int row) { return pairwiseSum(state.temperature.row(row), state.grid.nLon) * state.grid.areaWeight[row]; });
+}
+
+void benchmarkEnergyBalance() {
+    EnergyBalanceParams params;
+    std::cout << "Energy balance benchmark (" << threadPool().size() << " threads)" << std::endl;
+    for (double resolution : {1.0, 0.25, 0.1}) {
+        SimulationState state = createSimulation(resolution);
+        for (int row = 0; row < state.grid.nLat; ++row) {
+            double sinLat = std::sin(state.grid.latitudes[row]);
+            std::fill(state.temperature.row(row), state.temperature.row(row) + state.grid.nLon, (float)(300.0 - 45.0 * sinLat * sinLat));
+        }
+        double dt = stableTimestep(state, params);
+        // Warm up once, then step until a second has passed
+        stepEnergyBalance(state, params, dt);
+        int steps = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0.0;
+        while (elapsed < 1.0 || steps < 3) {
+            stepEnergyBalance(state, params, dt);
+            ++steps;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        double cells = (double)state.grid.nLat * state.grid.nLon;
+        std::cout << std::setw(5) << resolution << " deg  " << state.grid.nLon << "x" << state.grid.nLat
+                  << std::fixed << std::setprecision(1) << "  " << std::setw(9) << steps / elapsed << " steps/s  "
+                  << std::setw(8) << cells * steps / elapsed / 1e6 << " Mcells/s  mean " << globalMeanTemperature(state) << " K  dt "
+                  << std::defaultfloat << std::setprecision(3) << dt << " s" << std::endl;
+    }
+}
\ No newline at end of file
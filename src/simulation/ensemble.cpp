@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <utility>
+
+#include <core/reduction.h>
+#include <core/threadPool.h>
+#include <simulation/ensemble.h>
+
+Ensemble::Ensemble(std::shared_ptr<const EnsembleInputs> inputs, const std::vector<EnergyBalanceParams> &params, const SimulationState &initial)
+    : shared(std::move(inputs)), memberParams(params), members((int)params.size()) {
+    const int nLat = shared->grid.nLat, nLon = shared->grid.nLon;
+    blocks = (members + ensembleLanes - 1) / ensembleLanes;
+    memberParams.resize((size_t)blocks * ensembleLanes, params.empty() ? shared->params : params.back());
+    temperature.resize((size_t)blocks * nLat * nLon * ensembleLanes);
+    scratch.resize(temperature.size());
+    insolation.resize(nLat);
+    for (int block = 0; block < blocks; ++block) {
+        for (int row = 0; row < nLat; ++row) {
+            const float *source = initial.temperature.row(row);
+            float *out = temperature.data() + offset(block, row);
+            for (int col = 0; col < nLon; ++col) std::fill(out + col * ensembleLanes, out + (col + 1) * ensembleLanes, source[col]);
+        }
+    }
+    clock = initial.time;
+    steps = initial.step;
+}
+
+void Ensemble::setMemberTemperature(int member, const Field &field) {
+    const int block = member / ensembleLanes, lane = member % ensembleLanes;
+    for (int row = 0; row < shared->grid.nLat; ++row) {
+        float *out = temperature.data() + offset(block, row) + lane;
+        const float *source = field.row(row);
+        for (int col = 0; col < shared->grid.nLon; ++col) out[col * ensembleLanes] = source[col];
+    }
+}
+
+void Ensemble::extractMember(int member, SimulationState &state) const {
+    const int block = member / ensembleLanes, lane = member % ensembleLanes;
+    state.grid = shared->grid;
+    state.temperature = Field(shared->grid.nLat, shared->grid.nLon);
+    state.scratch = Field(shared->grid.nLat, shared->grid.nLon);
+    for (int row = 0; row < shared->grid.nLat; ++row) {
+        const float *source = temperature.data() + offset(block, row) + lane;
+        float *out = state.temperature.row(row);
+        for (int col = 0; col < shared->grid.nLon; ++col) out[col] = source[col * ensembleLanes];
+    }
+    state.time = clock;
+    state.step = steps;
+}
+
+double Ensemble::stableTimestep() const {
+    SimulationState geometry;
+    geometry.grid = shared->grid;
+    double limit = 1e300;
+    for (int member = 0; member < members; ++member) limit = std::min(limit, ::stableTimestep(geometry, memberParams[member]));
+    return limit;
+}
+
+// One cell of every member in a block. A fixed trip count over unaliased pointers is what lets the
+// compiler turn the lane loop into straight vector code.
+inline void updateLanes(const float *__restrict centre, const float *__restrict north, const float *__restrict south, const float *__restrict west,
+                        const float *__restrict east, float *__restrict out, const EnergyBalanceConstants<ensembleLanes> &c) {
+    for (int lane = 0; lane < ensembleLanes; ++lane) out[lane] = energyBalanceCell(c, lane, centre[lane], north[lane], south[lane], west[lane], east[lane]);
+}
+
+// The same with each lane's own warm albedo and dt / heat capacity for this cell, for members with a surface
+inline void updateLanes(const float *__restrict centre, const float *__restrict north, const float *__restrict south, const float *__restrict west,
+                        const float *__restrict east, float *__restrict out, const EnergyBalanceConstants<ensembleLanes> &c,
+                        const float *__restrict warmAlbedo, const float *__restrict scale) {
+    for (int lane = 0; lane < ensembleLanes; ++lane) {
+        out[lane] = energyBalanceCell(c, lane, centre[lane], north[lane], south[lane], west[lane], east[lane], warmAlbedo[lane], scale[lane]);
+    }
+}
+
+void Ensemble::step(double dt) {
+    const LatLonGrid &grid = shared->grid;
+    const int nLat = grid.nLat, nLon = grid.nLon;
+    for (int row = 0; row < nLat; ++row) insolation[row] = (float)dailyInsolation(shared->params, grid.latitudes[row], clock);
+    threadPool().parallelFor(0, blocks * nLat, [&](int itemBegin, int itemEnd) {
+        for (int item = itemBegin; item < itemEnd; ++item) {
+            const int block = item / nLat, row = item % nLat;
+            EnergyBalanceConstants<ensembleLanes> constants;
+            for (int lane = 0; lane < ensembleLanes; ++lane) constants.set(lane, grid, memberParams[(size_t)block * ensembleLanes + lane], row, dt, insolation[row]);
+            const float *centre = temperature.data() + offset(block, row);
+            const float *above = temperature.data() + offset(block, std::max(row - 1, 0));
+            const float *below = temperature.data() + offset(block, std::min(row + 1, nLat - 1));
+            float *out = scratch.data() + offset(block, row);
+            // Surface rows of the members that have one; the others keep their uniform constants
+            const float *albedoRows[ensembleLanes] = {}, *inverseCapacityRows[ensembleLanes] = {};
+            bool anySurface = false;
+            for (int lane = 0; lane < ensembleLanes; ++lane) {
+                const SurfaceProperties *surface = memberParams[(size_t)block * ensembleLanes + lane].surface.get();
+                if (!surface) continue;
+                albedoRows[lane] = surface->warmAlbedo.row(row);
+                inverseCapacityRows[lane] = surface->inverseHeatCapacity.row(row);
+                anySurface = true;
+            }
+            const float dtf = (float)dt;
+            for (int col = 0; col < nLon; ++col) {
+                const int west = col == 0 ? nLon - 1 : col - 1, east = col == nLon - 1 ? 0 : col + 1;
+                if (!anySurface) {
+                    updateLanes(centre + col * ensembleLanes, above + col * ensembleLanes, below + col * ensembleLanes, centre + west * ensembleLanes,
+                                centre + east * ensembleLanes, out + col * ensembleLanes, constants);
+                    continue;
+                }
+                alignas(32) float warmAlbedo[ensembleLanes], scale[ensembleLanes];
+                for (int lane = 0; lane < ensembleLanes; ++lane) {
+                    warmAlbedo[lane] = albedoRows[lane] ? albedoRows[lane][col] : constants.warmAlbedo[lane];
+                    scale[lane] = inverseCapacityRows[lane] ? dtf * inverseCapacityRows[lane][col] : constants.scale[lane];
+                }
+                updateLanes(centre + col * ensembleLanes, above + col * ensembleLanes, below + col * ensembleLanes, centre + west * ensembleLanes,
+                            centre + east * ensembleLanes, out + col * ensembleLanes, constants, warmAlbedo, scale);
+            }
+        }
+    }, 2);
+    std::swap(temperature, scratch);
+    clock += dt;
+    ++steps;
+}
+
+std::vector<double> Ensemble::memberMeans() const {
+    const LatLonGrid &grid = shared->grid;
+    std::vector<double> means(members, 0.0);
+    for (int block = 0; block < blocks; ++block) {
+        // Each lane is summed with the tree globalMeanTemperature uses, so a member's mean matches its standalone run
+        std::array<double, ensembleLanes> sums = reduceSums<ensembleLanes>(0, grid.nLat, 1, [&](int row) {
+            const float *values = temperature.data() + offset(block, row);
+            std::array<double, ensembleLanes> rowSums;
+            for (int lane = 0; lane < ensembleLanes; ++lane) rowSums[lane] = pairwiseSum(values + lane, grid.nLon, ensembleLanes) * grid.areaWeight[row];
+            return rowSums;
+        });
+        for (int lane = 0; lane < ensembleLanes && block * ensembleLanes + lane < members; ++lane) means[block * ensembleLanes + lane] = sums[lane];
+    }
+    return means;
+}
+
+std::vector<EnergyBalanceParams> perturbParameters(const EnergyBalanceParams &base, int members, double spread, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> factor(1.0 - spread, 1.0 + spread);
+    std::vector<EnergyBalanceParams> params(members, base);
+    for (int member = 1; member < members; ++member) {
+        params[member].heatCapacity *= factor(generator);
+        params[member].diffusivity *= factor(generator);
+        params[member].olrB *= factor(generator);
+        params[member].iceAlbedo *= factor(generator);
+    }
+    return params;
+}
+
+void benchmarkEnsemble() {
+    const double resolution = 1.0;
+    const int steps = 50;
+    auto inputs = std::make_shared<EnsembleInputs>();
+    inputs->grid = makeLatLonGrid(resolution);
+    SimulationState initial = createSimulation(resolution);
+    for (int row = 0; row < initial.grid.nLat; ++row) {
+        double sinLat = std::sin(initial.grid.latitudes[row]);
+        std::fill(initial.temperature.row(row), initial.temperature.row(row) + initial.grid.nLon, (float)(300.0 - 45.0 * sinLat * sinLat));
+    }
+    std::cout << "Ensemble benchmark (" << threadPool().size() << " threads), " << resolution << " deg, " << steps << " steps" << std::endl;
+    for (int members : {64, 256, 512}) {
+        std::vector<EnergyBalanceParams> params = perturbParameters(inputs->params, members, 0.1, 42);
+        Ensemble ensemble(inputs, params, initial);
+        const double dt = ensemble.stableTimestep();
+        ensemble.step(dt);
+        auto start = std::chrono::steady_clock::now();
+        for (int step = 1; step < steps; ++step) ensemble.step(dt);
+        double batched = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // The same members one at a time, on a sample of members to keep the run short
+        const int sampled = std::min(members, 16);
+        SimulationState single;
+        start = std::chrono::steady_clock::now();
+        for (int member = 0; member < sampled; ++member) {
+            single = initial;
+            for (int step = 0; step < steps; ++step) stepEnergyBalance(single, params[member], dt);
+        }
+        double separate = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * members / sampled;
+
+        // The last sampled member must match its standalone run exactly
+        SimulationState extracted;
+        ensemble.extractMember(sampled - 1, extracted);
+        bool identical = ensemble.memberMeans()[sampled - 1] == globalMeanTemperature(single);
+        for (int row = 0; row < single.grid.nLat && identical; ++row) {
+            identical = std::equal(single.temperature.row(row), single.temperature.row(row) + single.grid.nLon, extracted.temperature.row(row));
+        }
+        std::cout << std::setw(4) << members << " members  " << std::fixed << std::setprecision(0) << std::setw(8) << members * (steps - 1) / batched
+                  << " member-steps/s batched, " << std::setw(6) << members * steps / separate << " one at a time ("
+                  << std::setprecision(2) << members * (steps - 1) / batched / (members * steps / separate) << "x)  "
+                  << (identical ? "matches" : "DIFFERS from") << " standalone" << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
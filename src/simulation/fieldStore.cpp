@@ -0,0 +1,438 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include <core/compression.h>
+#include <core/threadPool.h>
+#include <simulation/fieldStore.h>
+
+// Chunk file layout, native endianness: ChunkHeader, then the chunk's elements row-major (variable fastest),
+// byte-shuffled and compressed unless that failed to shrink them
+constexpr char chunkMagic[8] = {'E', 'B', 'M', 'C', 'H', 'N', 'K', '\0'};
+constexpr uint32_t chunkIsCompressed = 1;
+constexpr int storeFormat = 1;
+
+struct ChunkHeader {
+    char magic[8];
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t rawBytes;
+};
+
+size_t StoreRegion::size() const {
+    size_t count = 1;
+    for (int dim = 0; dim < storeDimensions; ++dim) count *= (size_t)std::max(end[dim] - begin[dim], 0);
+    return count;
+}
+
+namespace {
+
+// Copy the overlap of two regions between their row-major buffers, one run of variables at a time
+void copyOverlap(const StoreRegion &from, const float *source, const StoreRegion &to, float *target, const StoreRegion &overlap) {
+    auto extent = [](const StoreRegion &region, int dim) { return (size_t)(region.end[dim] - region.begin[dim]); };
+    auto offset = [&](const StoreRegion &region, int t, int y, int x) {
+        return (((size_t)(t - region.begin[StoreTime]) * extent(region, StoreLat) + (y - region.begin[StoreLat])) * extent(region, StoreLon)
+                + (x - region.begin[StoreLon])) * extent(region, StoreVariable) + (overlap.begin[StoreVariable] - region.begin[StoreVariable]);
+    };
+    const size_t run = extent(overlap, StoreVariable);
+    for (int t = overlap.begin[StoreTime]; t < overlap.end[StoreTime]; ++t) {
+        for (int y = overlap.begin[StoreLat]; y < overlap.end[StoreLat]; ++y) {
+            for (int x = overlap.begin[StoreLon]; x < overlap.end[StoreLon]; ++x) {
+                std::memcpy(target + offset(to, t, y, x), source + offset(from, t, y, x), run * sizeof(float));
+            }
+        }
+    }
+}
+
+StoreRegion intersect(const StoreRegion &a, const StoreRegion &b) {
+    StoreRegion overlap;
+    for (int dim = 0; dim < storeDimensions; ++dim) {
+        overlap.begin[dim] = std::max(a.begin[dim], b.begin[dim]);
+        overlap.end[dim] = std::max(std::min(a.end[dim], b.end[dim]), overlap.begin[dim]);
+    }
+    return overlap;
+}
+
+// Every chunk index from first to last inclusive, time outermost
+std::vector<StoreIndex> chunkRange(const StoreIndex &first, const StoreIndex &last) {
+    std::vector<StoreIndex> chunks;
+    StoreIndex chunk = first;
+    while (true) {
+        chunks.push_back(chunk);
+        int dim = storeDimensions - 1;
+        while (dim >= 0 && chunk[dim] == last[dim]) {
+            chunk[dim] = first[dim];
+            --dim;
+        }
+        if (dim < 0) return chunks;
+        ++chunk[dim];
+    }
+}
+
+} // namespace
+
+bool FieldStore::create(const std::string &path, int rows, int cols, const std::vector<std::string> &variables, const StoreIndex &shape) {
+    auto fail = [&](const std::string &message) {
+        std::cout << "Failed to create field store " << path << ": " << message << std::endl;
+        return false;
+    };
+    if (rows <= 0 || cols <= 0 || variables.empty()) return fail("empty shape");
+    for (int dim = 0; dim < storeDimensions; ++dim) {
+        if (shape[dim] <= 0) return fail("chunk sizes must be positive");
+    }
+    for (const std::string &name : variables) {
+        if (name.empty() || name.find_first_of(" \t\n") != std::string::npos) return fail("variable names must be single words");
+    }
+    std::error_code error;
+    // Only what a store owns is cleared, never the rest of the directory
+    std::filesystem::remove_all(std::filesystem::path(path) / "chunks", error);
+    std::filesystem::create_directories(std::filesystem::path(path) / "chunks", error);
+    if (error) return fail(error.message());
+    directory = path;
+    nLat = rows;
+    nLon = cols;
+    variableNames = variables;
+    chunkShape = shape;
+    timeSteps = 0;
+    std::lock_guard<std::mutex> lock(metadataMutex);
+    return saveMetadata(0) || fail("cannot write store.txt");
+}
+
+bool FieldStore::open(const std::string &path) {
+    auto fail = [&](const std::string &message) {
+        std::cout << "Failed to open field store " << path << ": " << message << std::endl;
+        return false;
+    };
+    std::ifstream file(std::filesystem::path(path) / "store.txt");
+    if (!file) return fail("missing store.txt");
+    int format = 0, steps = -1, variableCount = 0;
+    StoreIndex shape{}, chunkSizes{};
+    std::vector<std::string> names;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "format") {
+            fields >> format;
+        } else if (key == "shape") {
+            fields >> shape[StoreTime] >> shape[StoreLat] >> shape[StoreLon] >> shape[StoreVariable];
+            steps = shape[StoreTime];
+            variableCount = shape[StoreVariable];
+        } else if (key == "chunks") {
+            fields >> chunkSizes[StoreTime] >> chunkSizes[StoreLat] >> chunkSizes[StoreLon] >> chunkSizes[StoreVariable];
+        } else if (key == "variables") {
+            std::string name;
+            while (fields >> name) names.push_back(name);
+        }
+    }
+    if (format != storeFormat) return fail("unknown format");
+    if (steps < 0 || shape[StoreLat] <= 0 || shape[StoreLon] <= 0 || variableCount != (int)names.size() || variableCount <= 0) return fail("bad shape");
+    for (int dim = 0; dim < storeDimensions; ++dim) {
+        if (chunkSizes[dim] <= 0) return fail("bad chunk shape");
+    }
+    directory = path;
+    nLat = shape[StoreLat];
+    nLon = shape[StoreLon];
+    variableNames = names;
+    chunkShape = chunkSizes;
+    timeSteps = steps;
+    return true;
+}
+
+StoreIndex FieldStore::shape() const {
+    return StoreIndex{timeSteps.load(), nLat, nLon, (int)variableNames.size()};
+}
+
+int FieldStore::variableIndex(const std::string &name) const {
+    auto found = std::find(variableNames.begin(), variableNames.end(), name);
+    return found == variableNames.end() ? -1 : (int)(found - variableNames.begin());
+}
+
+std::string FieldStore::chunkPath(const StoreIndex &chunk) const {
+    std::ostringstream name;
+    name << chunk[StoreTime] << '.' << chunk[StoreLat] << '.' << chunk[StoreLon] << '.' << chunk[StoreVariable];
+    return (std::filesystem::path(directory) / "chunks" / name.str()).string();
+}
+
+bool FieldStore::saveMetadata(int steps) {
+    const std::filesystem::path target = std::filesystem::path(directory) / "store.txt";
+    const std::filesystem::path temporary = std::filesystem::path(directory) / "store.txt.tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        file << "format " << storeFormat << '\n'
+             << "shape " << steps << ' ' << nLat << ' ' << nLon << ' ' << variableNames.size() << '\n'
+             << "chunks " << chunkShape[StoreTime] << ' ' << chunkShape[StoreLat] << ' ' << chunkShape[StoreLon] << ' ' << chunkShape[StoreVariable] << '\n'
+             << "compressor shuffle+block\n"
+             << "variables";
+        for (const std::string &name : variableNames) file << ' ' << name;
+        file << '\n';
+        if (!file) return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, target, error);
+    return !error;
+}
+
+StoreRegion FieldStore::chunkBox(const StoreIndex &chunk) const {
+    const StoreIndex extent = shape();
+    StoreRegion box;
+    for (int dim = 0; dim < storeDimensions; ++dim) {
+        box.begin[dim] = chunk[dim] * chunkShape[dim];
+        // Time chunks are always whole; the others are clipped at the edge of the array
+        box.end[dim] = dim == StoreTime ? box.begin[dim] + chunkShape[dim] : std::min(box.begin[dim] + chunkShape[dim], extent[dim]);
+    }
+    return box;
+}
+
+bool FieldStore::loadChunk(const StoreIndex &chunk, std::vector<float> &raw, StoreStats &stats) const {
+    raw.assign(chunkBox(chunk).size(), std::numeric_limits<float>::quiet_NaN());
+    std::ifstream file(chunkPath(chunk), std::ios::binary | std::ios::ate);
+    if (!file) {
+        stats.missingChunks = 1;
+        return true;
+    }
+    const size_t fileBytes = (size_t)file.tellg();
+    ChunkHeader header;
+    file.seekg(0);
+    if (fileBytes < sizeof(header) || !file.read((char *)&header, sizeof(header)) || std::memcmp(header.magic, chunkMagic, sizeof(chunkMagic)) != 0 ||
+        header.rawBytes != raw.size() * sizeof(float)) {
+        return false;
+    }
+    std::vector<unsigned char> stored(fileBytes - sizeof(header));
+    if (!file.read((char *)stored.data(), stored.size())) return false;
+    if (header.flags & chunkIsCompressed) {
+        std::vector<unsigned char> shuffled(header.rawBytes);
+        if (!decompressBlock(stored.data(), stored.size(), shuffled.data(), shuffled.size())) return false;
+        unshuffleBytes(shuffled.data(), raw.size(), sizeof(float), (unsigned char *)raw.data());
+    } else if (stored.size() == header.rawBytes) {
+        std::memcpy(raw.data(), stored.data(), stored.size());
+    } else {
+        return false;
+    }
+    stats.chunks = 1;
+    stats.rawBytes = header.rawBytes;
+    stats.storedBytes = fileBytes;
+    return true;
+}
+
+bool FieldStore::writeChunk(const StoreIndex &chunk, const StoreRegion &region, const float *values, StoreStats &stats) {
+    const StoreRegion box = chunkBox(chunk), overlap = intersect(box, region);
+    std::vector<float> raw(box.size());
+    if (overlap.size() != box.size()) {
+        // Partly covered: keep what the chunk already holds outside the region
+        StoreStats existing;
+        if (!loadChunk(chunk, raw, existing)) return false;
+    }
+    copyOverlap(region, values, box, raw.data(), overlap);
+
+    const size_t rawBytes = raw.size() * sizeof(float);
+    std::vector<unsigned char> shuffled(rawBytes), data;
+    shuffleBytes((const unsigned char *)raw.data(), raw.size(), sizeof(float), shuffled.data());
+    compressBlock(shuffled.data(), rawBytes, data);
+    ChunkHeader header{};
+    std::memcpy(header.magic, chunkMagic, sizeof(chunkMagic));
+    header.rawBytes = rawBytes;
+    header.flags = chunkIsCompressed;
+    if (data.size() >= rawBytes) {
+        data.assign((const unsigned char *)raw.data(), (const unsigned char *)raw.data() + rawBytes);
+        header.flags = 0;
+    }
+
+    const std::string path = chunkPath(chunk);
+    // Unique per write, so concurrent writers of the same chunk never share a temporary file
+    const std::string temporary = path + ".tmp" + std::to_string(temporaryCounter.fetch_add(1));
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write((const char *)&header, sizeof(header));
+        file.write((const char *)data.data(), data.size());
+        if (!file) return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) return false;
+    stats.rawBytes = rawBytes;
+    stats.storedBytes = sizeof(header) + data.size();
+    return true;
+}
+
+bool FieldStore::write(const StoreRegion &region, const float *values, StoreStats *stats) {
+    auto fail = [&](const std::string &message) {
+        std::cout << "Failed to write to field store " << directory << ": " << message << std::endl;
+        return false;
+    };
+    if (directory.empty()) return fail("store is not open");
+    const StoreIndex extent = shape();
+    for (int dim = 0; dim < storeDimensions; ++dim) {
+        if (region.begin[dim] < 0 || region.begin[dim] >= region.end[dim] || (dim != StoreTime && region.end[dim] > extent[dim])) return fail("region out of bounds");
+    }
+
+    StoreIndex first, last;
+    for (int dim = 0; dim < storeDimensions; ++dim) {
+        first[dim] = region.begin[dim] / chunkShape[dim];
+        last[dim] = (region.end[dim] - 1) / chunkShape[dim];
+    }
+    const std::vector<StoreIndex> chunks = chunkRange(first, last);
+    std::vector<StoreStats> chunkStats(chunks.size());
+    std::vector<unsigned char> written(chunks.size(), 0);
+    threadPool().parallelFor(0, (int)chunks.size(), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) written[i] = writeChunk(chunks[i], region, values, chunkStats[i]);
+    }, 1);
+    if (std::count(written.begin(), written.end(), 0) > 0) return fail("cannot write chunk files, or a partly written chunk is corrupt");
+
+    if (stats) {
+        *stats = StoreStats();
+        for (const StoreStats &chunk : chunkStats) {
+            ++stats->chunks;
+            stats->rawBytes += chunk.rawBytes;
+            stats->storedBytes += chunk.storedBytes;
+        }
+    }
+    // Extend the time axis; concurrent writers race only to record the larger extent
+    std::lock_guard<std::mutex> lock(metadataMutex);
+    if (region.end[StoreTime] > timeSteps) {
+        timeSteps = region.end[StoreTime];
+        if (!saveMetadata(timeSteps)) return fail("cannot write store.txt");
+    }
+    return true;
+}
+
+bool FieldStore::read(const StoreRegion &region, float *values, StoreStats *stats) const {
+    auto fail = [&](const std::string &message) {
+        std::cout << "Failed to read from field store " << directory << ": " << message << std::endl;
+        return false;
+    };
+    const StoreIndex extent = shape();
+    for (int dim = 0; dim < storeDimensions; ++dim) {
+        if (region.begin[dim] < 0 || region.begin[dim] >= region.end[dim] || region.end[dim] > extent[dim]) return fail("region out of bounds");
+    }
+    StoreIndex first, last;
+    for (int dim = 0; dim < storeDimensions; ++dim) {
+        first[dim] = region.begin[dim] / chunkShape[dim];
+        last[dim] = (region.end[dim] - 1) / chunkShape[dim];
+    }
+    const std::vector<StoreIndex> chunks = chunkRange(first, last);
+    std::vector<StoreStats> chunkStats(chunks.size());
+    std::vector<unsigned char> corrupt(chunks.size(), 0);
+    threadPool().parallelFor(0, (int)chunks.size(), [&](int begin, int end) {
+        std::vector<float> raw;
+        for (int i = begin; i < end; ++i) {
+            if (!loadChunk(chunks[i], raw, chunkStats[i])) {
+                corrupt[i] = 1;
+                continue;
+            }
+            const StoreRegion box = chunkBox(chunks[i]);
+            copyOverlap(box, raw.data(), region, values, intersect(box, region));
+        }
+    }, 1);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        if (corrupt[i]) return fail("chunk " + chunkPath(chunks[i]) + " is corrupt");
+    }
+
+    if (stats) {
+        *stats = StoreStats();
+        for (const StoreStats &chunk : chunkStats) {
+            stats->chunks += chunk.chunks;
+            stats->missingChunks += chunk.missingChunks;
+            stats->rawBytes += chunk.rawBytes;
+            stats->storedBytes += chunk.storedBytes;
+        }
+    }
+    return true;
+}
+
+void benchmarkFieldStore() {
+    const int nLat = 720, nLon = 1440, steps = 16;
+    const std::vector<std::string> variables{"temperature", "insolation", "albedo"};
+    const StoreIndex chunkShape{4, 90, 180, 3};
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "climate_store_benchmark";
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+
+    FieldStore store;
+    if (!store.create(directory.string(), nLat, nLon, variables, chunkShape)) return;
+    std::cout << "Field store benchmark (" << threadPool().size() << " threads): " << steps << " steps of " << nLat << "x" << nLon << "x"
+              << variables.size() << ", chunks " << chunkShape[0] << "x" << chunkShape[1] << "x" << chunkShape[2] << "x" << chunkShape[3] << std::endl;
+
+    // Smooth fields stored as a model would produce them: one time chunk at a time, then single steps appended
+    const int nVar = (int)variables.size(), appended = 6;
+    auto fill = [&](int firstStep, int count, std::vector<float> &values) {
+        values.resize((size_t)count * nLat * nLon * nVar);
+        for (int t = 0; t < count; ++t) {
+            for (int y = 0; y < nLat; ++y) {
+                const double lat = 3.14159265358979 * (0.5 - (y + 0.5) / nLat);
+                for (int x = 0; x < nLon; ++x) {
+                    float *cell = values.data() + (((size_t)t * nLat + y) * nLon + x) * nVar;
+                    cell[0] = (float)(300.0 - 45.0 * std::sin(lat) * std::sin(lat) + 2.0 * std::sin(0.01 * x + 0.1 * (firstStep + t)));
+                    cell[1] = (float)(400.0 * std::cos(lat));
+                    cell[2] = std::abs(lat) > 1.2 ? 0.6f : 0.3f;
+                }
+            }
+        }
+    };
+    std::vector<float> block;
+    auto timedWrite = [&](int firstStep, int count, StoreStats &total, double &seconds) {
+        fill(firstStep, count, block);
+        StoreRegion region{{firstStep, 0, 0, 0}, {firstStep + count, nLat, nLon, nVar}};
+        StoreStats stats;
+        auto start = std::chrono::steady_clock::now();
+        if (!store.write(region, block.data(), &stats)) return false;
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        total.chunks += stats.chunks;
+        total.rawBytes += stats.rawBytes;
+        total.storedBytes += stats.storedBytes;
+        return true;
+    };
+    StoreStats total, appendTotal;
+    double writeSeconds = 0.0, appendSeconds = 0.0;
+    for (int step = 0; step < steps; step += chunkShape[StoreTime]) {
+        if (!timedWrite(step, chunkShape[StoreTime], total, writeSeconds)) return;
+    }
+    for (int step = steps; step < steps + appended; ++step) {
+        if (!timedWrite(step, 1, appendTotal, appendSeconds)) return;
+    }
+    std::cout << std::fixed << std::setprecision(1) << "  write " << total.chunks << " chunks, " << total.rawBytes / 1048576.0 << " MiB in "
+              << writeSeconds * 1e3 << " ms (" << total.rawBytes / 1048576.0 / writeSeconds << " MiB/s), " << std::setprecision(2)
+              << (double)total.rawBytes / total.storedBytes << "x compression" << std::endl;
+    std::cout << std::setprecision(1) << "  append " << appended << " single steps, " << appendTotal.chunks << " partial chunks rewritten in "
+              << appendSeconds * 1e3 << " ms (" << appendSeconds / appended * 1e3 << " ms per step)" << std::endl;
+
+    FieldStore reopened;
+    if (!reopened.open(directory.string())) return;
+    auto timedRead = [&](const char *name, const StoreRegion &region) {
+        std::vector<float> values(region.size());
+        StoreStats stats;
+        auto start = std::chrono::steady_clock::now();
+        if (!reopened.read(region, values.data(), &stats)) return;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "  " << std::left << std::setw(26) << name << std::right << std::setw(5) << stats.chunks << " chunks "
+                  << std::setprecision(2) << std::setw(8) << seconds * 1e3 << " ms, " << std::setw(7) << stats.storedBytes / 1024.0 << " KiB read" << std::endl;
+    };
+    const int cityRow = 190, cityCol = 521;
+    timedRead("time series at one cell", StoreRegion{{0, cityRow, cityCol, 0}, {steps, cityRow + 1, cityCol + 1, 1}});
+    timedRead("one variable, one step", StoreRegion{{5, 0, 0, 0}, {6, nLat, nLon, 1}});
+    timedRead("everything", StoreRegion{{0, 0, 0, 0}, {steps, nLat, nLon, nVar}});
+
+    // Every value written, aligned and appended, read back one time chunk at a time; the appended steps end
+    // part way through their last chunk, which still reads back whole
+    const int written = steps + appended;
+    bool identical = reopened.shape()[StoreTime] == written;
+    std::vector<float> expected, actual;
+    for (int step = 0; step < written && identical; step += chunkShape[StoreTime]) {
+        const int count = std::min(chunkShape[StoreTime], written - step);
+        fill(step, count, expected);
+        actual.resize(expected.size());
+        identical = reopened.read(StoreRegion{{step, 0, 0, 0}, {step + count, nLat, nLon, nVar}}, actual.data()) &&
+                    std::memcmp(expected.data(), actual.data(), expected.size() * sizeof(float)) == 0;
+    }
+    std::cout << "  read back " << written << " steps: " << (identical ? "identical" : "DIFFERENT") << std::endl;
+    std::cout << std::defaultfloat << std::setprecision(6);
+    std::filesystem::remove_all(directory, error);
+}
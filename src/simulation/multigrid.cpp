@@ -0,0 +1,512 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+
+#include <core/reduction.h>
+#include <core/threadPool.h>
+#include <simulation/multigrid.h>
+
+constexpr double multigridPi = 3.14159265358979323846;
+// Spectrum of line Jacobi preconditioned Helmholtz operators lies in (0, 2); the smoother damps the upper part
+constexpr double chebyshevLow = 0.3;
+constexpr double chebyshevHigh = 2.0;
+
+SphericalMultigrid::SphericalMultigrid(const LatLonGrid &grid, double diffusivity, double shift, const MultigridSettings &settings)
+    : settings(settings), diffusivity(diffusivity), shift(shift) {
+    int nLat = grid.nLat, nLon = grid.nLon;
+    while (true) {
+        Level level;
+        level.nLat = nLat;
+        level.nLon = nLon;
+        levels.push_back(std::move(level));
+        if (nLat % 2 != 0 || nLat < 4) break;
+        nLat /= 2;
+        nLon /= 2;
+    }
+    for (Level &level : levels) buildLevel(level);
+}
+
+void SphericalMultigrid::buildLevel(Level &level) const {
+    const int nLat = level.nLat, nLon = level.nLon;
+    const double dLat = multigridPi / nLat, dLon = 2.0 * multigridPi / nLon;
+    level.area.resize(nLat);
+    level.zonalFlux.resize(nLat);
+    level.northFlux.resize(nLat + 1);
+    level.diagonal.resize(nLat);
+    for (int edge = 0; edge <= nLat; ++edge) {
+        double cosEdge = edge == 0 || edge == nLat ? 0.0 : std::cos(multigridPi / 2.0 - edge * dLat);
+        level.northFlux[edge] = (float)(diffusivity * cosEdge * dLon / dLat);
+    }
+    for (int row = 0; row < nLat; ++row) {
+        double cosLat = std::cos(multigridPi / 2.0 - (row + 0.5) * dLat);
+        // Matches rowDiffusion once multiplied through by the cell area
+        level.area[row] = (float)(cosLat * dLat * dLon);
+        level.zonalFlux[row] = (float)(diffusivity * dLat / (cosLat * dLon));
+        level.diagonal[row] = (float)(shift * level.area[row]) + level.northFlux[row] + level.northFlux[row + 1] + 2.0f * level.zonalFlux[row];
+    }
+    if (level.x.rows != nLat) {
+        level.x = Field(nLat, nLon);
+        level.b = Field(nLat, nLon);
+        level.r = Field(nLat, nLon);
+        level.d = Field(nLat, nLon);
+        level.lineUpper.resize((size_t)nLat * nLon);
+        level.lineInverse.resize((size_t)nLat * nLon);
+        level.lineCorrection.resize((size_t)nLat * nLon);
+        level.lineCorrectionScale.resize(2 * nLat);
+    }
+    factorLines(level);
+}
+
+void SphericalMultigrid::setShift(double newShift) {
+    shift = newShift;
+    for (Level &level : levels) buildLevel(level);
+}
+
+void SphericalMultigrid::factorLines(Level &level) const {
+    const int nLon = level.nLon;
+    for (int row = 0; row < level.nLat; ++row) {
+        // diagonal x[j] - zonal (x[j - 1] + x[j + 1]) = rhs[j] with periodic ends, split as in Numerical Recipes' cyclic
+        double diagonal = level.diagonal[row], offDiagonal = -level.zonalFlux[row], gamma = -diagonal;
+        double *upper = level.lineUpper.data() + (size_t)row * nLon, *inverse = level.lineInverse.data() + (size_t)row * nLon;
+        double *z = level.lineCorrection.data() + (size_t)row * nLon;
+        for (int col = 0; col < nLon; ++col) {
+            double modified = col == 0 ? diagonal - gamma : col == nLon - 1 ? diagonal - offDiagonal * offDiagonal / gamma : diagonal;
+            double denominator = modified - (col == 0 ? 0.0 : offDiagonal * upper[col - 1]);
+            inverse[col] = 1.0 / denominator;
+            upper[col] = offDiagonal / denominator;
+        }
+        // Correction vector z solves the tridiagonal part against u = (gamma, 0, ..., 0, offDiagonal)
+        for (int col = 0; col < nLon; ++col) {
+            double u = col == 0 ? gamma : col == nLon - 1 ? offDiagonal : 0.0;
+            z[col] = (u - (col == 0 ? 0.0 : offDiagonal * z[col - 1])) * inverse[col];
+        }
+        for (int col = nLon - 2; col >= 0; --col) z[col] -= upper[col] * z[col + 1];
+        double ratio = offDiagonal / gamma;
+        level.lineCorrectionScale[2 * row] = ratio;
+        level.lineCorrectionScale[2 * row + 1] = 1.0 / (1.0 + z[0] + ratio * z[nLon - 1]);
+    }
+}
+
+void SphericalMultigrid::solveLine(const Level &level, int row, const double *rhs, float *out, double *work) const {
+    const int nLon = level.nLon;
+    const double offDiagonal = -level.zonalFlux[row];
+    const size_t offset = (size_t)row * nLon;
+    const double *upper = level.lineUpper.data() + offset, *inverse = level.lineInverse.data() + offset, *correction = level.lineCorrection.data() + offset;
+    double previous = 0.0;
+    for (int col = 0; col < nLon; ++col) {
+        previous = (rhs[col] - offDiagonal * previous) * inverse[col];
+        work[col] = previous;
+    }
+    for (int col = nLon - 2; col >= 0; --col) work[col] -= upper[col] * work[col + 1];
+    double factor = (work[0] + level.lineCorrectionScale[2 * row] * work[nLon - 1]) * level.lineCorrectionScale[2 * row + 1];
+    for (int col = 0; col < nLon; ++col) out[col] = (float)(work[col] - factor * correction[col]);
+}
+
+void SphericalMultigrid::residual(Level &level) const {
+    const int nLat = level.nLat, nLon = level.nLon;
+    threadPool().parallelFor(0, nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            const float *x = level.x.row(row), *north = level.x.row(std::max(row - 1, 0)), *south = level.x.row(std::min(row + 1, nLat - 1));
+            const float *b = level.b.row(row);
+            float *r = level.r.row(row);
+            const float centreWeight = (float)(shift * level.area[row]), zonal = level.zonalFlux[row];
+            const float northFlux = level.northFlux[row], southFlux = level.northFlux[row + 1];
+            for (int col = 0; col < nLon; ++col) {
+                float west = x[col == 0 ? nLon - 1 : col - 1], east = x[col == nLon - 1 ? 0 : col + 1];
+                // Differences first: near the poles the zonal terms nearly cancel and would swamp the rest
+                float centre = x[col];
+                r[col] = b[col] - (centreWeight * centre + northFlux * (centre - north[col]) + southFlux * (centre - south[col]) + zonal * ((centre - west) + (centre - east)));
+            }
+        }
+    }, 4);
+}
+
+double SphericalMultigrid::residualNorm(Level &level) const {
+    residual(level);
+    return std::sqrt(reduceSum(0, level.nLat, 1, [&](int row) {
+        const float *r = level.r.row(row);
+        double sum = 0.0;
+        for (int col = 0; col < level.nLon; ++col) sum += (double)r[col] * r[col];
+        return sum;
+    }));
+}
+
+void SphericalMultigrid::smooth(Level &level, int sweeps) const {
+    const int nLat = level.nLat, nLon = level.nLon;
+    if (settings.smoother == Smoother::Chebyshev) {
+        const double theta = 0.5 * (chebyshevHigh + chebyshevLow), delta = 0.5 * (chebyshevHigh - chebyshevLow), sigma = theta / delta;
+        double rhoOld = 1.0 / sigma;
+        for (int sweep = 0; sweep < sweeps; ++sweep) {
+            residual(level);
+            double rho = sweep == 0 ? 0.0 : 1.0 / (2.0 * sigma - rhoOld);
+            float keep = (float)(rho * rhoOld), step = sweep == 0 ? (float)(1.0 / theta) : (float)(2.0 * rho / delta);
+            threadPool().parallelFor(0, nLat, [&](int rowBegin, int rowEnd) {
+                std::vector<double> rhs(nLon), work(nLon);
+                std::vector<float> preconditioned(nLon);
+                for (int row = rowBegin; row < rowEnd; ++row) {
+                    std::copy(level.r.row(row), level.r.row(row) + nLon, rhs.begin());
+                    solveLine(level, row, rhs.data(), preconditioned.data(), work.data());
+                    float *d = level.d.row(row), *x = level.x.row(row);
+                    for (int col = 0; col < nLon; ++col) {
+                        d[col] = keep * d[col] + step * preconditioned[col];
+                        x[col] += d[col];
+                    }
+                }
+            }, 4);
+            if (sweep > 0) rhoOld = rho;
+        }
+        return;
+    }
+    for (int sweep = 0; sweep < sweeps; ++sweep) {
+        for (int colour = 0; colour < 2; ++colour) {
+            // Rows of one parity only read rows of the other, so they solve independently
+            threadPool().parallelFor(0, (nLat + 1 - colour) / 2, [&](int lineBegin, int lineEnd) {
+                std::vector<double> rhs(nLon), work(nLon);
+                for (int line = lineBegin; line < lineEnd; ++line) {
+                    int row = 2 * line + colour;
+                    const float *north = level.x.row(std::max(row - 1, 0)), *south = level.x.row(std::min(row + 1, nLat - 1)), *b = level.b.row(row);
+                    const double northFlux = level.northFlux[row], southFlux = level.northFlux[row + 1];
+                    for (int col = 0; col < nLon; ++col) rhs[col] = b[col] + northFlux * north[col] + southFlux * south[col];
+                    solveLine(level, row, rhs.data(), level.x.row(row), work.data());
+                }
+            }, 2);
+        }
+    }
+}
+
+void SphericalMultigrid::coarseSolve(Level &level) const {
+    const int nLat = level.nLat, nLon = level.nLon, numModes = nLon / 2 + 1;
+    const bool singular = shift == 0.0;
+    std::vector<double> cosTable(nLon), sinTable(nLon);
+    for (int j = 0; j < nLon; ++j) {
+        cosTable[j] = std::cos(2.0 * multigridPi * j / nLon);
+        sinTable[j] = std::sin(2.0 * multigridPi * j / nLon);
+    }
+    // The operator is constant along rows, so each zonal wavenumber decouples into a tridiagonal system over rows
+    std::vector<double> cosPart((size_t)nLat * numModes), sinPart((size_t)nLat * numModes);
+    for (int row = 0; row < nLat; ++row) {
+        const float *b = level.b.row(row);
+        for (int k = 0; k < numModes; ++k) {
+            double re = 0.0, im = 0.0;
+            for (int j = 0; j < nLon; ++j) {
+                int phase = (int)(((long long)k * j) % nLon);
+                re += b[j] * cosTable[phase];
+                im += b[j] * sinTable[phase];
+            }
+            cosPart[(size_t)row * numModes + k] = re;
+            sinPart[(size_t)row * numModes + k] = im;
+        }
+    }
+    std::vector<double> upper(nLat);
+    for (int k = 0; k < numModes; ++k) {
+        double previousUpper = 0.0, previousCos = 0.0, previousSin = 0.0;
+        for (int row = 0; row < nLat; ++row) {
+            double diagonal = level.diagonal[row] - 2.0 * level.zonalFlux[row] * cosTable[k];
+            double lower = -level.northFlux[row], upperCoefficient = -level.northFlux[row + 1];
+            size_t idx = (size_t)row * numModes + k;
+            double re = cosPart[idx], im = sinPart[idx];
+            // Pin the free constant of the Poisson problem at the first row
+            if (singular && k == 0 && row == 0) {
+                diagonal = 1.0;
+                upperCoefficient = 0.0;
+                re = im = 0.0;
+            }
+            double denominator = diagonal - lower * previousUpper;
+            previousUpper = upperCoefficient / denominator;
+            upper[row] = previousUpper;
+            previousCos = (re - lower * previousCos) / denominator;
+            previousSin = (im - lower * previousSin) / denominator;
+            cosPart[idx] = previousCos;
+            sinPart[idx] = previousSin;
+        }
+        for (int row = nLat - 2; row >= 0; --row) {
+            size_t idx = (size_t)row * numModes + k, below = idx + numModes;
+            cosPart[idx] -= upper[row] * cosPart[below];
+            sinPart[idx] -= upper[row] * sinPart[below];
+        }
+    }
+    for (int row = 0; row < nLat; ++row) {
+        float *x = level.x.row(row);
+        const double *re = cosPart.data() + (size_t)row * numModes, *im = sinPart.data() + (size_t)row * numModes;
+        for (int j = 0; j < nLon; ++j) {
+            double value = re[0];
+            for (int k = 1; k < numModes; ++k) {
+                int phase = (int)(((long long)k * j) % nLon);
+                double weight = 2 * k == nLon ? 1.0 : 2.0;
+                value += weight * (re[k] * cosTable[phase] + im[k] * sinTable[phase]);
+            }
+            x[j] = (float)(value / nLon);
+        }
+    }
+}
+
+void SphericalMultigrid::restrictResidual(Level &fine, Level &coarse) const {
+    // Residuals are cell integrals, so a coarse cell's is the sum of its four children
+    threadPool().parallelFor(0, coarse.nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            const float *upper = fine.r.row(2 * row), *lower = fine.r.row(2 * row + 1);
+            float *b = coarse.b.row(row), *x = coarse.x.row(row), *d = coarse.d.row(row);
+            for (int col = 0; col < coarse.nLon; ++col) {
+                b[col] = upper[2 * col] + upper[2 * col + 1] + lower[2 * col] + lower[2 * col + 1];
+                x[col] = 0.0f;
+                d[col] = 0.0f;
+            }
+        }
+    }, 4);
+}
+
+void SphericalMultigrid::prolongateAdd(const Level &coarse, Level &fine) const {
+    // Cell-centred bilinear weights 9/16, 3/16, 3/16, 1/16; rows beyond the poles fall back to the edge row
+    const int nLon = coarse.nLon;
+    threadPool().parallelFor(0, fine.nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            int coarseRow = row / 2, otherRow = std::min(std::max(row % 2 == 0 ? coarseRow - 1 : coarseRow + 1, 0), coarse.nLat - 1);
+            const float *near = coarse.x.row(coarseRow), *far = coarse.x.row(otherRow);
+            float *x = fine.x.row(row);
+            for (int col = 0; col < fine.nLon; ++col) {
+                int coarseCol = col / 2, otherCol = col % 2 == 0 ? (coarseCol == 0 ? nLon - 1 : coarseCol - 1) : (coarseCol == nLon - 1 ? 0 : coarseCol + 1);
+                x[col] += 0.5625f * near[coarseCol] + 0.1875f * (far[coarseCol] + near[otherCol]) + 0.0625f * far[otherCol];
+            }
+        }
+    }, 4);
+}
+
+void SphericalMultigrid::vCycle(int index) {
+    Level &level = levels[index];
+    if (index == (int)levels.size() - 1) {
+        coarseSolve(level);
+        return;
+    }
+    smooth(level, settings.preSweeps);
+    residual(level);
+    restrictResidual(level, levels[index + 1]);
+    vCycle(index + 1);
+    prolongateAdd(levels[index + 1], level);
+    smooth(level, settings.postSweeps);
+}
+
+double SphericalMultigrid::refinementResidual() {
+    Level &fine = levels[0];
+    const int nLat = fine.nLat, nLon = fine.nLon;
+    std::vector<double> rowSums(nLat);
+    threadPool().parallelFor(0, nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            const double *x = &refinedSolution[(size_t)row * nLon], *b = &refinedRhs[(size_t)row * nLon];
+            const double *north = &refinedSolution[(size_t)std::max(row - 1, 0) * nLon], *south = &refinedSolution[(size_t)std::min(row + 1, nLat - 1) * nLon];
+            const double centreWeight = shift * fine.area[row], zonal = fine.zonalFlux[row];
+            const double northFlux = fine.northFlux[row], southFlux = fine.northFlux[row + 1];
+            float *r = fine.b.row(row);
+            double sum = 0.0;
+            for (int col = 0; col < nLon; ++col) {
+                double west = x[col == 0 ? nLon - 1 : col - 1], east = x[col == nLon - 1 ? 0 : col + 1], centre = x[col];
+                double value = b[col] - (centreWeight * centre + northFlux * (centre - north[col]) + southFlux * (centre - south[col]) + zonal * ((centre - west) + (centre - east)));
+                r[col] = (float)value;
+                sum += value * value;
+            }
+            rowSums[row] = sum;
+        }
+    }, 4);
+    return std::sqrt(pairwiseSum(rowSums.data(), rowSums.size()));
+}
+
+SolveStats SphericalMultigrid::solve(const Field &rhs, Field &solution) {
+    auto start = std::chrono::steady_clock::now();
+    Level &fine = levels[0];
+    const int nLat = fine.nLat, nLon = fine.nLon;
+    refinedRhs.resize((size_t)nLat * nLon);
+    refinedSolution.resize((size_t)nLat * nLon);
+    double totalArea = 0.0;
+    for (int row = 0; row < nLat; ++row) {
+        const float *source = rhs.row(row), *guess = solution.row(row);
+        for (int col = 0; col < nLon; ++col) {
+            refinedRhs[(size_t)row * nLon + col] = (double)fine.area[row] * source[col];
+            refinedSolution[(size_t)row * nLon + col] = guess[col];
+        }
+        totalArea += (double)nLon * fine.area[row];
+    }
+    const double sum = pairwiseSum(refinedRhs.data(), refinedRhs.size());
+    // The Poisson problem only has a solution for a zero-mean right-hand side
+    if (shift == 0.0) {
+        for (int row = 0; row < nLat; ++row) {
+            double offset = sum / totalArea * fine.area[row];
+            for (int col = 0; col < nLon; ++col) refinedRhs[(size_t)row * nLon + col] -= offset;
+        }
+    }
+    double rhsNorm = reduceSum(0, (int)refinedRhs.size(), reductionLeaf, [&](int i) { return refinedRhs[i] * refinedRhs[i]; });
+    rhsNorm = std::max(std::sqrt(rhsNorm), 1e-300);
+    // Iterative refinement: the residual and solution are carried in double and each V-cycle, in single precision,
+    // only solves for the correction. Near the poles the zonal coupling is so much stronger than the right-hand side
+    // that a float solution alone stalls the residual around 1e-4 at fine resolutions.
+    SolveStats stats;
+    while (true) {
+        stats.residual = refinementResidual() / rhsNorm;
+        if (stats.residual <= settings.tolerance || stats.cycles >= settings.maxCycles) break;
+        std::fill(fine.x.data.begin(), fine.x.data.end(), 0.0f);
+        vCycle(0);
+        for (int row = 0; row < nLat; ++row) {
+            const float *correction = fine.x.row(row);
+            for (int col = 0; col < nLon; ++col) refinedSolution[(size_t)row * nLon + col] += correction[col];
+        }
+        ++stats.cycles;
+    }
+    double mean = 0.0;
+    if (shift == 0.0) {
+        mean = reduceSum(0, nLat, 1, [&](int row) { return pairwiseSum(&refinedSolution[(size_t)row * nLon], nLon) * fine.area[row] / totalArea; });
+    }
+    for (int row = 0; row < nLat; ++row) {
+        float *out = solution.row(row);
+        for (int col = 0; col < nLon; ++col) out[col] = (float)(refinedSolution[(size_t)row * nLon + col] - mean);
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+SolveStats SphericalMultigrid::solveJacobi(const Field &rhs, Field &solution, int maxIterations) {
+    auto start = std::chrono::steady_clock::now();
+    Level &fine = levels[0];
+    double rhsNorm = 0.0;
+    for (int row = 0; row < fine.nLat; ++row) {
+        const float *source = rhs.row(row);
+        float *b = fine.b.row(row);
+        for (int col = 0; col < fine.nLon; ++col) {
+            b[col] = fine.area[row] * source[col];
+            rhsNorm += (double)b[col] * b[col];
+        }
+    }
+    rhsNorm = std::max(std::sqrt(rhsNorm), 1e-300);
+    fine.x = solution;
+    SolveStats stats;
+    for (; stats.cycles < maxIterations; ++stats.cycles) {
+        residual(fine);
+        threadPool().parallelFor(0, fine.nLat, [&](int rowBegin, int rowEnd) {
+            for (int row = rowBegin; row < rowEnd; ++row) {
+                float *x = fine.x.row(row);
+                const float *r = fine.r.row(row);
+                const float inverse = 1.0f / fine.diagonal[row];
+                for (int col = 0; col < fine.nLon; ++col) x[col] += r[col] * inverse;
+            }
+        }, 4);
+        if (stats.cycles % 16 == 15 && residualNorm(fine) / rhsNorm <= settings.tolerance) {
+            ++stats.cycles;
+            break;
+        }
+    }
+    stats.residual = residualNorm(fine) / rhsNorm;
+    solution = fine.x;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+SolveStats implicitDiffusion(SimulationState &state, SphericalMultigrid &solver, const EnergyBalanceParams &params, double dt, double theta) {
+    const LatLonGrid &grid = state.grid;
+    const int nLat = grid.nLat, nLon = grid.nLon;
+    const double shift = params.heatCapacity / (theta * dt);
+    const double dLat = multigridPi / nLat, dLon = 2.0 * multigridPi / nLon;
+    solver.setShift(shift);
+    // C / (theta dt) T + (1 - theta) / theta D laplacian(T) from the current state
+    Field rhs(nLat, nLon);
+    const float explicitWeight = (float)((1.0 - theta) / theta * params.diffusivity);
+    threadPool().parallelFor(0, nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            const float *t = state.temperature.row(row);
+            const float *north = state.temperature.row(std::max(row - 1, 0)), *south = state.temperature.row(std::min(row + 1, nLat - 1));
+            double cosLat = grid.cosLat[row];
+            const float northWeight = (float)(grid.cosEdge[row] / (cosLat * dLat * dLat)), southWeight = (float)(grid.cosEdge[row + 1] / (cosLat * dLat * dLat));
+            const float zonalWeight = (float)(1.0 / (cosLat * cosLat * dLon * dLon));
+            float *out = rhs.row(row);
+            for (int col = 0; col < nLon; ++col) {
+                float west = t[col == 0 ? nLon - 1 : col - 1], east = t[col == nLon - 1 ? 0 : col + 1];
+                float laplacian = northWeight * (north[col] - t[col]) + southWeight * (south[col] - t[col]) + zonalWeight * (west + east - 2.0f * t[col]);
+                out[col] = (float)shift * t[col] + explicitWeight * laplacian;
+            }
+        }
+    }, 4);
+    state.scratch = state.temperature;
+    SolveStats stats = solver.solve(rhs, state.scratch);
+    std::swap(state.temperature, state.scratch);
+    return stats;
+}
+
+SolveStats solveStreamfunction(const LatLonGrid &grid, const Field &vorticity, Field &streamfunction, double radius) {
+    // laplacian(psi) = zeta on the sphere of the given radius; the solver works on the unit sphere with -laplacian
+    SphericalMultigrid solver(grid, 1.0, 0.0);
+    Field rhs(grid.nLat, grid.nLon);
+    const float scale = (float)(-radius * radius);
+    for (int row = 0; row < grid.nLat; ++row) {
+        for (int col = 0; col < grid.nLon; ++col) rhs.row(row)[col] = scale * vorticity.row(row)[col];
+    }
+    if (streamfunction.rows != grid.nLat || streamfunction.cols != grid.nLon) streamfunction = Field(grid.nLat, grid.nLon);
+    return solver.solve(rhs, streamfunction);
+}
+
+void benchmarkMultigrid() {
+    EnergyBalanceParams params;
+    const double dt = 86400.0;
+    std::cout << "Multigrid benchmark (" << threadPool().size() << " threads)" << std::endl;
+    const std::pair<Smoother, const char *> smoothers[2] = {{Smoother::RedBlackLine, "red-black line"}, {Smoother::Chebyshev, "Chebyshev line"}};
+    for (double resolution : {1.0, 0.5, 0.25}) {
+        LatLonGrid grid = makeLatLonGrid(resolution);
+        // Smooth large-scale structure plus grid-scale noise, so every part of the spectrum needs removing
+        Field source(grid.nLat, grid.nLon);
+        unsigned int seed = 12345u;
+        for (int row = 0; row < grid.nLat; ++row) {
+            double lat = grid.latitudes[row];
+            for (int col = 0; col < grid.nLon; ++col) {
+                double lon = 2.0 * multigridPi * col / grid.nLon;
+                seed = seed * 1664525u + 1013904223u;
+                source.row(row)[col] = (float)(std::sin(3.0 * lat) * std::cos(2.0 * lon) + std::cos(lat) * std::cos(lat) + 0.1 * ((seed >> 8) / 16777216.0 - 0.5));
+            }
+        }
+        double cells = (double)grid.nLat * grid.nLon;
+        for (int problem = 0; problem < 2; ++problem) {
+            const char *name = problem == 0 ? "Crank-Nicolson, dt 1 day" : "Poisson";
+            double shift = problem == 0 ? params.heatCapacity / (0.5 * dt) : 0.0, diffusivity = problem == 0 ? params.diffusivity : 1.0;
+            std::cout << std::setw(5) << resolution << " deg " << grid.nLon << "x" << grid.nLat << "  " << name << std::endl;
+            for (const auto &smoother : smoothers) {
+                MultigridSettings settings;
+                settings.smoother = smoother.first;
+                SphericalMultigrid solver(grid, diffusivity, shift, settings);
+                Field solution(grid.nLat, grid.nLon);
+                SolveStats stats = solver.solve(source, solution);
+                std::cout << "  " << std::left << std::setw(16) << smoother.second << std::right << solver.numLevels() << " levels " << std::setw(3) << stats.cycles
+                          << " cycles  residual " << std::scientific << std::setprecision(1) << stats.residual << std::fixed << "  factor "
+                          << std::setprecision(3) << std::pow(std::max(stats.residual, 1e-300), 1.0 / std::max(stats.cycles, 1)) << "  " << std::setprecision(1)
+                          << std::setw(7) << stats.seconds * 1e3 << " ms  " << std::setw(6) << stats.seconds * 1e9 / cells << " ns/cell"
+                          << std::defaultfloat << std::setprecision(6) << std::endl;
+            }
+            // Jacobi gets a hundred times the multigrid cell updates and still barely dents the smooth error
+            SphericalMultigrid solver(grid, diffusivity, shift);
+            Field solution(grid.nLat, grid.nLon);
+            SolveStats stats = solver.solveJacobi(source, solution, 2000);
+            std::cout << "  " << std::left << std::setw(16) << "Jacobi" << std::right << "         " << std::setw(4) << stats.cycles << " iters  residual "
+                      << std::scientific << std::setprecision(1) << stats.residual << std::fixed << "  " << std::setw(7) << stats.seconds * 1e3 << " ms"
+                      << std::defaultfloat << std::setprecision(6) << std::endl;
+        }
+    }
+    // One day of diffusion at 1 degree: implicit Crank-Nicolson against sub-cycled explicit steps
+    SimulationState implicitState = createSimulation(1.0), explicitState = createSimulation(1.0);
+    for (SimulationState *state : {&implicitState, &explicitState}) {
+        for (int row = 0; row < state->grid.nLat; ++row) {
+            double sinLat = std::sin(state->grid.latitudes[row]);
+            std::fill(state->temperature.row(row), state->temperature.row(row) + state->grid.nLon, (float)(300.0 - 45.0 * sinLat * sinLat));
+        }
+    }
+    SphericalMultigrid solver(implicitState.grid, params.diffusivity, 0.0);
+    SolveStats stats = implicitDiffusion(implicitState, solver, params, dt);
+    auto start = std::chrono::steady_clock::now();
+    double limit = 0.9 * diffusionTimestep(explicitState, params);
+    int substeps = (int)std::ceil(dt / limit);
+    for (int step = 0; step < substeps; ++step) applyDiffusion(explicitState, params, dt / substeps);
+    double explicitSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double difference = 0.0;
+    for (int row = 0; row < implicitState.grid.nLat; ++row) {
+        for (int col = 0; col < implicitState.grid.nLon; ++col) {
+            difference = std::max(difference, (double)std::abs(implicitState.temperature.row(row)[col] - explicitState.temperature.row(row)[col]));
+        }
+    }
+    std::cout << "1 deg, 1 day of diffusion: implicit " << stats.seconds * 1e3 << " ms (" << stats.cycles << " cycles), explicit "
+              << explicitSeconds * 1e3 << " ms (" << substeps << " substeps), max difference " << difference << " K" << std::endl;
+}
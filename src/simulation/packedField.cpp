@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+#include <core/reduction.h>
+#include <core/threadPool.h>
+#include <simulation/packedField.h>
+
+namespace {
+
+// Random bits for one row of one step; independent of how rows are split across threads
+uint32_t rowSeed(uint32_t seed, long long step, int row) {
+    return roundingNoise(seed ^ ((uint32_t)step * 0x85ebca6bu), (uint32_t)row);
+}
+
+template <typename Storage>
+void packRow(const Storage &storage, const float *in, typename Storage::Packed *out, int count, Rounding rounding, uint32_t seed) {
+    // Split on the rounding mode outside the loop so each loop body is branch free
+    if (rounding == Rounding::Nearest) {
+        for (int i = 0; i < count; ++i) out[i] = storage.pack(in[i], Rounding::Nearest, 0);
+    } else {
+        for (int i = 0; i < count; ++i) out[i] = storage.pack(in[i], Rounding::Stochastic, roundingNoise(seed, (uint32_t)i));
+    }
+}
+
+template <typename Storage>
+void unpackRow(const Storage &storage, const typename Storage::Packed *in, float *out, int count) {
+    for (int i = 0; i < count; ++i) out[i] = storage.unpack(in[i]);
+}
+
+#ifdef __F16C__
+// Hardware conversions when the build targets F16C; stochastic rounding still goes through the scalar policy
+void packRow(const Float16Storage &storage, const float *in, uint16_t *out, int count, Rounding rounding, uint32_t seed) {
+    int i = 0;
+    if (rounding == Rounding::Nearest) {
+        const __m256 offset = _mm256_set1_ps(storage.offset);
+        for (; i + 8 <= count; i += 8) {
+            __m128i packed = _mm256_cvtps_ph(_mm256_sub_ps(_mm256_loadu_ps(in + i), offset), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128((__m128i *)(out + i), packed);
+        }
+    }
+    for (; i < count; ++i) out[i] = storage.pack(in[i], rounding, roundingNoise(seed, (uint32_t)i));
+}
+
+void unpackRow(const Float16Storage &storage, const uint16_t *in, float *out, int count) {
+    const __m256 offset = _mm256_set1_ps(storage.offset);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(in + i))), offset));
+    for (; i < count; ++i) out[i] = storage.unpack(in[i]);
+}
+#endif
+
+} // namespace
+
+template <typename Storage>
+PackedSimulationState<Storage> packState(const SimulationState &state, const Storage &storage, Rounding rounding) {
+    PackedSimulationState<Storage> packed;
+    packed.grid = state.grid;
+    packed.temperature = PackedField<Storage>(state.grid.nLat, state.grid.nLon, storage);
+    packed.scratch = PackedField<Storage>(state.grid.nLat, state.grid.nLon, storage);
+    packed.rounding = rounding;
+    packed.time = state.time;
+    packed.step = state.step;
+    for (int row = 0; row < state.grid.nLat; ++row) {
+        packRow(storage, state.temperature.row(row), packed.temperature.row(row), state.grid.nLon, rounding, rowSeed(packed.seed, packed.step, row));
+    }
+    return packed;
+}
+
+template <typename Storage>
+void unpackState(const PackedSimulationState<Storage> &packed, SimulationState &state) {
+    state.grid = packed.grid;
+    state.temperature = Field(packed.grid.nLat, packed.grid.nLon);
+    state.scratch = Field(packed.grid.nLat, packed.grid.nLon);
+    state.time = packed.time;
+    state.step = packed.step;
+    for (int row = 0; row < packed.grid.nLat; ++row) {
+        unpackRow(packed.temperature.storage, packed.temperature.row(row), state.temperature.row(row), packed.grid.nLon);
+    }
+}
+
+template <typename Storage>
+void packField(const Field &field, PackedField<Storage> &packed) {
+    for (int row = 0; row < packed.rows; ++row) packRow(packed.storage, field.row(row), packed.row(row), packed.cols, Rounding::Nearest, 0);
+}
+
+template <typename Storage>
+void stepEnergyBalance(PackedSimulationState<Storage> &state, const EnergyBalanceParams &params, double dt) {
+    const LatLonGrid &grid = state.grid;
+    const int nLat = grid.nLat, nLon = grid.nLon;
+    const PackedField<Storage> &current = state.temperature;
+    PackedField<Storage> &next = state.scratch;
+    const Storage &storage = current.storage;
+    threadPool().parallelFor(0, nLat, [&](int rowBegin, int rowEnd) {
+        // Three unpacked rows roll down the block, so each packed row is decoded once per block
+        std::vector<float> buffers[4];
+        for (std::vector<float> &buffer : buffers) buffer.resize(nLon);
+        float *north = buffers[0].data(), *centre = buffers[1].data(), *south = buffers[2].data(), *out = buffers[3].data();
+        unpackRow(storage, current.row(std::max(rowBegin - 1, 0)), north, nLon);
+        unpackRow(storage, current.row(rowBegin), centre, nLon);
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            unpackRow(storage, current.row(std::min(row + 1, nLat - 1)), south, nLon);
+            // Poles take themselves as their outer neighbour, as in the float32 step
+            stepEnergyBalanceRow(grid, params, row, state.time, dt, row == 0 ? centre : north, centre, row == nLat - 1 ? centre : south, out);
+            packRow(storage, out, next.row(row), nLon, state.rounding, rowSeed(state.seed, state.step + 1, row));
+            std::swap(north, centre);
+            std::swap(centre, south);
+        }
+    }, 4);
+    std::swap(state.temperature, state.scratch);
+    state.time += dt;
+    ++state.step;
+}
+
+template <typename Storage>
+double globalMeanTemperature(const PackedSimulationState<Storage> &state) {
+    // Rows go through the same tree as the float32 mean, so a float32-stored state gives exactly its result
+    return reduceSum(0, state.grid.nLat, 1, [&](int row) {
+        std::vector<float> values(state.grid.nLon);
+        unpackRow(state.temperature.storage, state.temperature.row(row), values.data(), state.grid.nLon);
+        return pairwiseSum(values.data(), values.size()) * state.grid.areaWeight[row];
+    });
+}
+
+#define INSTANTIATE_PACKED_STORAGE(Storage)                                                                                            \
+    template PackedSimulationState<Storage> packState<Storage>(const SimulationState &, const Storage &, Rounding);                    \
+    template void unpackState<Storage>(const PackedSimulationState<Storage> &, SimulationState &);                                     \
+    template void packField<Storage>(const Field &, PackedField<Storage> &);                                                          \
+    template void stepEnergyBalance<Storage>(PackedSimulationState<Storage> &, const EnergyBalanceParams &, double);                  \
+    template double globalMeanTemperature<Storage>(const PackedSimulationState<Storage> &);
+
+INSTANTIATE_PACKED_STORAGE(Float32Storage)
+INSTANTIATE_PACKED_STORAGE(Float16Storage)
+INSTANTIATE_PACKED_STORAGE(BFloat16Storage)
+INSTANTIATE_PACKED_STORAGE(ScaledInt16Storage)
+
+namespace {
+
+SimulationState mixedPrecisionInitialState(double resolution) {
+    SimulationState state = createSimulation(resolution);
+    for (int row = 0; row < state.grid.nLat; ++row) {
+        double sinLat = std::sin(state.grid.latitudes[row]);
+        for (int col = 0; col < state.grid.nLon; ++col) {
+            state.temperature.row(row)[col] = (float)(300.0 - 45.0 * sinLat * sinLat + 3.0 * std::cos(4.0 * col * 6.283185307179586 / state.grid.nLon));
+        }
+    }
+    return state;
+}
+
+// Mean preservation: stochastic rounding must be unbiased, so packing many values spread between storage steps
+// gives back their mean to within its sampling error. Returns the mean error, and its size in standard errors.
+template <typename Storage>
+double packBias(const Storage &storage, double &standardErrors) {
+    const int count = 1 << 20;
+    double sum = 0.0, squared = 0.0;
+    for (int i = 0; i < count; ++i) {
+        float value = (float)(250.0 + 80.0 * (i + 0.5) / count);
+        double error = (double)storage.unpack(storage.pack(value, Rounding::Stochastic, roundingNoise(0x9e3779b9u, (uint32_t)i))) - value;
+        sum += error;
+        squared += error * error;
+    }
+    double mean = sum / count;
+    double standardError = std::sqrt(std::max(squared / count - mean * mean, 0.0) / count);
+    standardErrors = standardError > 0.0 ? std::abs(mean) / standardError : 0.0;
+    return mean;
+}
+
+template <typename Storage>
+void reportStorage(const Storage &storage, Rounding rounding, const SimulationState &accuracyReference, int accuracySteps, double accuracyDt,
+                   double throughputResolution, int throughputSteps, double float32CellsPerSecond) {
+    const EnergyBalanceParams params;
+    // Accuracy: the same run as the float32 reference, compared cell by cell at the end
+    PackedSimulationState<Storage> packed = packState(mixedPrecisionInitialState(accuracyReference.grid.resolution), storage, rounding);
+    for (int step = 0; step < accuracySteps; ++step) stepEnergyBalance(packed, params, accuracyDt);
+    SimulationState result;
+    unpackState(packed, result);
+    double squared = 0.0, worst = 0.0, weight = 0.0;
+    for (int row = 0; row < result.grid.nLat; ++row) {
+        for (int col = 0; col < result.grid.nLon; ++col) {
+            double error = (double)result.temperature.at(row, col) - accuracyReference.temperature.at(row, col);
+            squared += error * error * result.grid.areaWeight[row];
+            weight += result.grid.areaWeight[row];
+            worst = std::max(worst, std::abs(error));
+        }
+    }
+    double meanDrift = globalMeanTemperature(packed) - globalMeanTemperature(accuracyReference);
+
+    // Throughput on a grid large enough to be bound by memory rather than cache
+    PackedSimulationState<Storage> large = packState(mixedPrecisionInitialState(throughputResolution), storage, rounding);
+    const double dt = stableTimestep(mixedPrecisionInitialState(throughputResolution), params);
+    stepEnergyBalance(large, params, dt);
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < throughputSteps; ++step) stepEnergyBalance(large, params, dt);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cellsPerSecond = (double)large.grid.nLat * large.grid.nLon * throughputSteps / seconds;
+
+    std::cout << "  " << std::left << std::setw(9) << Storage::name << std::setw(11) << (rounding == Rounding::Nearest ? "nearest" : "stochastic")
+              << std::right << std::setw(2) << sizeof(typename Storage::Packed) << " B  rms " << std::scientific << std::setprecision(2) << std::sqrt(squared / weight)
+              << " K  max " << worst << " K  mean drift " << std::setw(9) << meanDrift << " K  " << std::fixed << std::setprecision(1) << std::setw(6)
+              << cellsPerSecond / 1e6 << " Mcells/s (" << std::setprecision(2) << cellsPerSecond / float32CellsPerSecond << "x)";
+    if (rounding == Rounding::Stochastic) {
+        double standardErrors;
+        double bias = packBias(storage, standardErrors);
+        std::cout << "  pack bias " << std::scientific << std::setprecision(1) << bias << " K (" << std::fixed << standardErrors << " se, "
+                  << (standardErrors < 4.0 ? "unbiased" : "BIASED") << ")";
+    }
+    std::cout << std::endl;
+}
+
+} // namespace
+
+void benchmarkMixedPrecision() {
+    const EnergyBalanceParams params;
+    const double accuracyResolution = 1.0, throughputResolution = 0.1;
+    const int accuracySteps = 4000, throughputSteps = 10;
+    SimulationState reference = mixedPrecisionInitialState(accuracyResolution);
+    const double accuracyDt = stableTimestep(reference, params);
+    for (int step = 0; step < accuracySteps; ++step) stepEnergyBalance(reference, params, accuracyDt);
+
+    SimulationState large = mixedPrecisionInitialState(throughputResolution);
+    const double dt = stableTimestep(large, params);
+    stepEnergyBalance(large, params, dt);
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < throughputSteps; ++step) stepEnergyBalance(large, params, dt);
+    double float32CellsPerSecond = (double)large.grid.nLat * large.grid.nLon * throughputSteps /
+                                   std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Mixed precision benchmark (" << threadPool().size() << " threads): error after " << accuracySteps << " steps ("
+              << accuracySteps * accuracyDt / 3600.0 << " h) at " << accuracyResolution << " deg against float32, throughput at "
+              << throughputResolution << " deg" << std::endl;
+    for (Rounding rounding : {Rounding::Nearest, Rounding::Stochastic}) {
+        if (rounding == Rounding::Nearest) {
+            reportStorage(Float32Storage(), rounding, reference, accuracySteps, accuracyDt, throughputResolution, throughputSteps, float32CellsPerSecond);
+        }
+        reportStorage(Float16Storage(), rounding, reference, accuracySteps, accuracyDt, throughputResolution, throughputSteps, float32CellsPerSecond);
+        reportStorage(BFloat16Storage(), rounding, reference, accuracySteps, accuracyDt, throughputResolution, throughputSteps, float32CellsPerSecond);
+        reportStorage(ScaledInt16Storage(), rounding, reference, accuracySteps, accuracyDt, throughputResolution, throughputSteps, float32CellsPerSecond);
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+
+#include <core/dataScanner.h>
+#include <core/threadPool.h>
+#include <renderLogic/stb_image.h>
+#include <simulation/preview.h>
+#include <simulation/scheduler.h>
+
+constexpr double previewPi = 3.14159265358979323846;
+// Observation samples wanted along each axis of a grid cell
+constexpr int samplesPerCell = 3;
+
+namespace {
+
+// Bilinear interpolation of a coarse field onto a finer grid, periodic in longitude and clamped at the poles
+void prolongate(const LatLonGrid &coarseGrid, const Field &coarse, const LatLonGrid &fineGrid, Field &fine) {
+    const double rowScale = (double)coarseGrid.nLat / previewPi, colScale = (double)coarseGrid.nLon / fineGrid.nLon;
+    threadPool().parallelFor(0, fineGrid.nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            const double position = std::min(std::max((previewPi / 2.0 - fineGrid.latitudes[row]) * rowScale - 0.5, 0.0), coarseGrid.nLat - 1.0);
+            const int north = std::min((int)position, coarseGrid.nLat - 1), south = std::min(north + 1, coarseGrid.nLat - 1);
+            const float rowWeight = (float)(position - north);
+            const float *northRow = coarse.row(north), *southRow = coarse.row(south);
+            float *out = fine.row(row);
+            for (int col = 0; col < fineGrid.nLon; ++col) {
+                const double x = (col + 0.5) * colScale - 0.5;
+                const int west = (int)std::floor(x);
+                const float colWeight = (float)(x - west);
+                const int w = (west + coarseGrid.nLon) % coarseGrid.nLon, e = (west + 1) % coarseGrid.nLon;
+                const float top = northRow[w] + colWeight * (northRow[e] - northRow[w]);
+                const float bottom = southRow[w] + colWeight * (southRow[e] - southRow[w]);
+                out[col] = top + rowWeight * (bottom - top);
+            }
+        }
+    }, 4);
+}
+
+} // namespace
+
+ThermalGrid sampleForGrid(const unsigned char *pixels, int width, int height, const LatLonGrid &grid) {
+    const int stride = std::max(1, std::min(width / (samplesPerCell * grid.nLon), height / (samplesPerCell * grid.nLat)));
+    if (stride == 1) return decodeThermalImage(pixels, width, height, STBI_rgb_alpha);
+    const int sampledWidth = width / stride, sampledHeight = height / stride;
+    std::vector<uint32_t> sampled((size_t)sampledWidth * sampledHeight);
+    const uint32_t *source = (const uint32_t *)pixels;
+    for (int row = 0; row < sampledHeight; ++row) {
+        // Centre of each stride x stride block, so the samples sit symmetrically in the cells
+        const uint32_t *sourceRow = source + ((size_t)row * stride + stride / 2) * width + stride / 2;
+        for (int col = 0; col < sampledWidth; ++col) sampled[(size_t)row * sampledWidth + col] = sourceRow[(size_t)col * stride];
+    }
+    return decodeThermalImage((const unsigned char *)sampled.data(), sampledWidth, sampledHeight, STBI_rgb_alpha);
+}
+
+bool loadLatestThermalImage(int numDays, std::vector<unsigned char> &pixels, int &width, int &height) {
+    const std::vector<std::string> fileNames = thermalHistoryFiles(numDays);
+    for (auto name = fileNames.rbegin(); name != fileNames.rend(); ++name) {
+        int channels;
+        unsigned char *data = stbi_load(name->c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (!data) continue;
+        pixels.assign(data, data + (size_t)width * height * STBI_rgb_alpha);
+        stbi_image_free(data);
+        return true;
+    }
+    return false;
+}
+
+ProgressiveSimulation::ProgressiveSimulation(std::vector<unsigned char> pixels, int width, int height, const EnergyBalanceParams &params,
+                                             const PreviewSettings &settings)
+    : pixels(std::move(pixels)), width(width), height(height), params(params), settings(settings) {}
+
+ProgressiveSimulation::~ProgressiveSimulation() {
+    stopping = true;
+    if (worker.joinable()) worker.join();
+}
+
+void ProgressiveSimulation::start() {
+    if (worker.joinable()) return;
+    startTime = std::chrono::steady_clock::now();
+    worker = std::thread([this]() { run(); });
+}
+
+void ProgressiveSimulation::setWind(const std::vector<WeatherSample> &speed, const std::vector<WeatherSample> &direction) {
+    std::lock_guard<std::mutex> lock(mutex);
+    windSpeed = speed;
+    windDirection = direction;
+}
+
+bool ProgressiveSimulation::takeFrame(PreviewFrame &frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fresh) return false;
+    frame = latest;
+    fresh = false;
+    return true;
+}
+
+void ProgressiveSimulation::wait() {
+    if (worker.joinable()) worker.join();
+}
+
+SimulationState ProgressiveSimulation::result() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return finest;
+}
+
+void ProgressiveSimulation::publish(int level, const SimulationState &state, int step) {
+    PreviewFrame frame;
+    frame.level = level;
+    frame.resolution = state.grid.resolution;
+    frame.step = step;
+    frame.packed = PackedField<Float16Storage>(state.grid.nLat, state.grid.nLon);
+    packField(state.temperature, frame.packed);
+    frame.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::lock_guard<std::mutex> lock(mutex);
+    latest = std::move(frame);
+    fresh = true;
+}
+
+void ProgressiveSimulation::run() {
+    SimulationState previous, previousObserved;
+    for (int level = 0; level < (int)settings.resolutions.size() && !stopping; ++level) {
+        const double resolution = settings.resolutions[level];
+        // This level's view of the observations
+        SimulationState observedState = createSimulation(resolution);
+        initializeFromThermal(observedState, sampleForGrid(pixels.data(), width, height, observedState.grid));
+
+        SimulationState state = observedState;
+        if (level > 0) {
+            // Coarse state as the initial guess, plus the detail only this grid's observations resolve
+            Field coarseState(state.grid.nLat, state.grid.nLon), coarseObserved(state.grid.nLat, state.grid.nLon);
+            prolongate(previous.grid, previous.temperature, state.grid, coarseState);
+            prolongate(previousObserved.grid, previousObserved.temperature, state.grid, coarseObserved);
+            for (int row = 0; row < state.grid.nLat; ++row) {
+                float *out = state.temperature.row(row);
+                const float *guess = coarseState.row(row), *coarse = coarseObserved.row(row);
+                for (int col = 0; col < state.grid.nLon; ++col) out[col] = guess[col] + (out[col] - coarse[col]);
+            }
+            state.scratch = state.temperature;
+            state.time = previous.time;
+            state.step = previous.step;
+        }
+        publish(level, state, 0);
+
+        std::vector<WeatherSample> speed, direction;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            speed = windSpeed;
+            direction = windDirection;
+        }
+        const WindField wind = windFromSamples(state.grid, speed, direction);
+        // Steps no longer than the explicit limit of radiation and diffusion together, as stepEnergyBalance takes
+        Scheduler scheduler(stableTimestep(state, params));
+        addEnergyBalanceComponents(scheduler, params, 1, speed.empty() ? nullptr : &wind);
+        for (int step = 0; step < settings.stepsPerLevel; ++step) {
+            if (stopping) return;
+            scheduler.step(state);
+        }
+        publish(level, state, settings.stepsPerLevel);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finest = state;
+        }
+        previous = std::move(state);
+        previousObserved = std::move(observedState);
+    }
+    done = true;
+}
+
+void benchmarkPreview() {
+    // The latest downloaded image when there is one, otherwise a field with cloud gaps
+    std::vector<unsigned char> pixels;
+    int width, height;
+    auto loadStart = std::chrono::steady_clock::now();
+    const bool downloaded = loadLatestThermalImage(4, pixels, width, height);
+    const double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+    if (!downloaded) {
+        ThermalGrid observed;
+        observed.width = width = 2048;
+        observed.height = height = 1024;
+        observed.values.resize((size_t)observed.width * observed.height);
+        observed.valid.resize(observed.values.size());
+        for (int row = 0; row < observed.height; ++row) {
+            const double sinLat = std::sin(previewPi * (0.5 - (row + 0.5) / observed.height));
+            for (int col = 0; col < observed.width; ++col) {
+                const size_t idx = (size_t)row * observed.width + col;
+                observed.values[idx] = (float)(300.0 - 45.0 * sinLat * sinLat + 4.0 * std::sin(col * 0.02) * std::cos(row * 0.03));
+                observed.valid[idx] = (row / 37 + col / 53) % 5 != 0;
+            }
+        }
+        pixels.resize((size_t)width * height * STBI_rgb_alpha);
+        encodeThermalImage(observed, pixels.data(), STBI_rgb_alpha);
+    }
+
+    std::cout << "Preview benchmark (" << threadPool().size() << " threads), " << width << "x" << height << " observations, "
+              << (downloaded ? "PNG decoded in " + std::to_string((int)std::lround(loadMs)) + " ms" : std::string("synthetic")) << std::endl;
+    const EnergyBalanceParams params;
+    ProgressiveSimulation preview(std::move(pixels), width, height, params);
+    preview.start();
+    PreviewFrame frame;
+    bool first = true;
+    while (true) {
+        const bool finished = preview.finished();
+        if (preview.takeFrame(frame)) {
+            // Mean of the texture as uploaded
+            double mean = 0.0;
+            LatLonGrid grid = makeLatLonGrid(frame.resolution);
+            for (int row = 0; row < grid.nLat; ++row) {
+                for (int col = 0; col < grid.nLon; ++col) mean += grid.areaWeight[row] * frame.packed.storage.unpack(frame.packed.row(row)[col]);
+            }
+            std::cout << "  " << std::setw(8) << std::fixed << std::setprecision(1) << frame.seconds * 1e3 << " ms  " << std::defaultfloat << std::setprecision(6)
+                      << std::setw(4) << frame.resolution << " deg " << std::setw(4) << frame.packed.rows << "x" << std::setw(4) << frame.packed.cols
+                      << " after " << frame.step << " steps, mean " << std::fixed << std::setprecision(2) << mean << " K" << (first ? "  (first frame)" : "")
+                      << std::endl;
+            first = false;
+        } else if (finished) {
+            break;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    preview.wait();
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
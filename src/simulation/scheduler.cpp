@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <utility>
+
+#include <core/taskGraph.h>
+#include <simulation/scheduler.h>
+#include <simulation/tiledStencil.h>
+
+constexpr double schedulerPi = 3.14159265358979323846;
+
+Scheduler::Scheduler(double maxTimestep, double safetyFactor) : maxTimestep(maxTimestep), safetyFactor(safetyFactor) {}
+
+void Scheduler::addComponent(const PhysicsComponent &component) {
+    Entry entry;
+    entry.component = component;
+    entry.component.interval = std::max(component.interval, 1);
+    entries.push_back(entry);
+    ComponentTimer timer;
+    timer.name = component.name;
+    componentTimers.push_back(timer);
+}
+
+double Scheduler::nextTimestep(const SimulationState &state) const {
+    double dt = maxTimestep;
+    for (const Entry &entry : entries) {
+        if (entry.component.subcycle || !entry.component.stableTimestep) continue;
+        // Interval components take interval steps at once, so their limit is shared out across them
+        dt = std::min(dt, safetyFactor * entry.component.stableTimestep(state) / entry.component.interval);
+    }
+    return dt;
+}
+
+void Scheduler::runComponent(SimulationState &state, size_t index, double span) {
+    Entry &entry = entries[index];
+    ComponentTimer &timer = componentTimers[index];
+    auto start = std::chrono::steady_clock::now();
+    long long substeps = 1;
+    if (entry.component.subcycle && entry.component.stableTimestep) {
+        substeps = std::max(1LL, (long long)std::ceil(span / (safetyFactor * entry.component.stableTimestep(state))));
+    }
+    double substep = span / substeps;
+    if (entry.component.stepRepeated) {
+        entry.component.stepRepeated(state, substep, substeps);
+    } else {
+        for (long long s = 0; s < substeps; ++s) entry.component.step(state, substep);
+    }
+    timer.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ++timer.calls;
+    timer.substeps += substeps;
+    timer.lastDt = substep;
+}
+
+void Scheduler::advance(SimulationState &state, double dt, bool flush) {
+    auto stepStart = std::chrono::steady_clock::now();
+    // Components due this step in order, with the span each advances over and the earlier due ones it follows
+    std::vector<std::pair<size_t, double>> due;
+    std::vector<std::vector<TaskGraph::TaskId>> afterLists;
+    bool chain = true;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry &entry = entries[i];
+        entry.pending += dt;
+        if (++entry.stepsSinceCall < entry.component.interval && !flush) continue;
+        const double span = entry.pending;
+        entry.pending = 0.0;
+        entry.stepsSinceCall = 0;
+        // Edges only to components that run this step; the rest have nothing to wait for
+        std::vector<TaskGraph::TaskId> after;
+        for (size_t k = 0; k < due.size(); ++k) {
+            const std::optional<std::vector<std::string>> &names = entry.component.after;
+            if (!names || std::find(names->begin(), names->end(), entries[due[k].first].component.name) != names->end()) after.push_back((TaskGraph::TaskId)k);
+        }
+        // Following the previous due component orders it after all of them
+        chain = chain && (due.empty() || (!after.empty() && after.back() == (TaskGraph::TaskId)due.size() - 1));
+        due.emplace_back(i, span);
+        afterLists.push_back(std::move(after));
+    }
+    if (chain) {
+        // Nothing can overlap: run in order on this thread, each component spreading its own work over the pool
+        for (const std::pair<size_t, double> &component : due) runComponent(state, component.first, component.second);
+    } else {
+        TaskGraph graph;
+        for (size_t k = 0; k < due.size(); ++k) {
+            const size_t i = due[k].first;
+            const double span = due[k].second;
+            graph.add(entries[i].component.name, [this, i, span, &state] { runComponent(state, i, span); }, afterLists[k], entries[i].component.priority);
+        }
+        graph.run();
+    }
+    state.time += dt;
+    ++state.step;
+    ++modelSteps;
+    modelSeconds += dt;
+    wallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - stepStart).count();
+}
+
+double Scheduler::step(SimulationState &state) {
+    double dt = nextTimestep(state);
+    advance(state, dt, false);
+    return dt;
+}
+
+void Scheduler::advanceTo(SimulationState &state, double endTime) {
+    while (state.time < endTime) {
+        double dt = nextTimestep(state);
+        // Stretch a step slightly rather than leave a sliver at the end
+        bool last = state.time + 1.01 * dt >= endTime;
+        if (last) dt = endTime - state.time;
+        // The last step also runs interval components over the time they have saved up, so the state at endTime
+        // holds all of their physics
+        advance(state, dt, last);
+    }
+}
+
+void Scheduler::resetTimers() {
+    for (ComponentTimer &timer : componentTimers) {
+        timer.calls = timer.substeps = 0;
+        timer.seconds = 0.0;
+    }
+    modelSteps = 0;
+    modelSeconds = wallSeconds = 0.0;
+}
+
+void Scheduler::printTimers(std::ostream &out) const {
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3) << modelSteps << " steps, " << modelSeconds / 86400.0 << " model days in " << wallSeconds << " s" << std::endl;
+    for (const ComponentTimer &timer : componentTimers) {
+        double share = wallSeconds > 0.0 ? 100.0 * timer.seconds / wallSeconds : 0.0;
+        out << "  " << std::left << std::setw(12) << timer.name << std::right << std::setw(8) << timer.calls << " calls " << std::setw(10) << timer.substeps
+            << " substeps " << std::setw(9) << timer.seconds << " s " << std::setprecision(1) << std::setw(5) << share << "%  dt "
+            << std::setprecision(1) << timer.lastDt << " s" << std::setprecision(3) << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void addEnergyBalanceComponents(Scheduler &scheduler, const EnergyBalanceParams &params, int radiationInterval, const WindField *wind, double maxCourant) {
+    PhysicsComponent radiation;
+    radiation.name = "radiation";
+    radiation.step = [params](SimulationState &state, double dt) { applyRadiation(state, params, dt); };
+    // Forward Euler on the linearised outgoing longwave term
+    radiation.stableTimestep = [params](const SimulationState &) { return minHeatCapacity(params) / params.olrB; };
+    radiation.interval = radiationInterval;
+    scheduler.addComponent(radiation);
+
+    PhysicsComponent diffusion;
+    diffusion.name = "diffusion";
+    diffusion.step = [params](SimulationState &state, double dt) { applyDiffusion(state, params, dt); };
+    // Substeps go through the tiled sweep, fused as deeply as the tuning for this grid found pays off
+    struct TunedGrid {
+        int nLat = 0;
+        int nLon = 0;
+        StencilTiling tiling;
+    };
+    auto tuned = std::make_shared<TunedGrid>();
+    diffusion.stepRepeated = [params, tuned](SimulationState &state, double dt, long long substeps) {
+        if (tuned->nLat != state.grid.nLat || tuned->nLon != state.grid.nLon) {
+            *tuned = TunedGrid{state.grid.nLat, state.grid.nLon, tunedTiling(StencilOperator::Diffusion, state.grid)};
+        }
+        applyDiffusionTiled(state, params, dt, (int)substeps, tuned->tiling);
+    };
+    diffusion.stableTimestep = [params](const SimulationState &state) { return diffusionTimestep(state, params); };
+    diffusion.subcycle = true;
+    scheduler.addComponent(diffusion);
+
+    if (!wind) return;
+    PhysicsComponent advection;
+    advection.name = "advection";
+    // Trajectories are retraced only when the step length changes
+    auto trajectories = std::make_shared<Trajectories>();
+    advection.step = [wind, trajectories](SimulationState &state, double dt) {
+        if (trajectories->rows.empty() || std::abs(trajectories->dt - dt) > 1e-9 * dt) *trajectories = traceDepartures(state.grid, *wind, dt);
+        advectTemperature(state, *trajectories);
+    };
+    advection.stableTimestep = [wind, maxCourant](const SimulationState &state) { return courantTimestep(state.grid, *wind, maxCourant); };
+    scheduler.addComponent(advection);
+}
+
+void benchmarkScheduler() {
+    EnergyBalanceParams params;
+    const double resolution = 1.0, modelDays = 1.0, maxTimestep = 3.0 * 3600.0;
+    std::cout << "Scheduler benchmark, " << resolution << " deg, " << modelDays << " model days" << std::endl;
+    LatLonGrid grid = makeLatLonGrid(resolution);
+    // 20 m/s zonal jet peaking at mid-latitudes
+    WindField wind{Field(grid.nLat, grid.nLon), Field(grid.nLat, grid.nLon)};
+    for (int row = 0; row < grid.nLat; ++row) {
+        float u = (float)(20.0 * std::pow(std::sin(2.0 * grid.latitudes[row]), 2));
+        std::fill(wind.eastward.row(row), wind.eastward.row(row) + grid.nLon, u);
+    }
+    for (int radiationInterval : {1, 4, 16}) {
+        SimulationState state = createSimulation(resolution);
+        for (int row = 0; row < grid.nLat; ++row) {
+            double sinLat = std::sin(state.grid.latitudes[row]);
+            for (int col = 0; col < grid.nLon; ++col) {
+                double lon = 2.0 * schedulerPi * col / grid.nLon;
+                state.temperature.row(row)[col] = (float)(300.0 - 45.0 * sinLat * sinLat + 5.0 * std::cos(3.0 * lon));
+            }
+        }
+        Scheduler scheduler(maxTimestep);
+        addEnergyBalanceComponents(scheduler, params, radiationInterval, &wind);
+        scheduler.advanceTo(state, modelDays * 86400.0);
+        std::cout << "Radiation every " << radiationInterval << " steps, mean " << std::fixed << std::setprecision(3)
+                  << globalMeanTemperature(state) << std::defaultfloat << std::setprecision(6) << " K: ";
+        scheduler.printTimers(std::cout);
+    }
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cmath>
+
+#include <core/gapFill.h>
+#include <core/threadPool.h>
+#include <simulation/simulationState.h>
+
+constexpr double simulationPi = 3.14159265358979323846;
+
+LatLonGrid makeLatLonGrid(double resolution) {
+    LatLonGrid grid;
+    grid.resolution = resolution;
+    grid.nLat = (int)std::lround(180.0 / resolution);
+    grid.nLon = 2 * grid.nLat;
+    double dLat = simulationPi / grid.nLat, dLon = 2.0 * simulationPi / grid.nLon;
+    for (int row = 0; row < grid.nLat; ++row) {
+        double lat = simulationPi / 2.0 - (row + 0.5) * dLat;
+        grid.latitudes.push_back(lat);
+        grid.cosLat.push_back(std::cos(lat));
+        // Exact cell area on the unit sphere over 4 pi
+        double north = simulationPi / 2.0 - row * dLat, south = north - dLat;
+        grid.areaWeight.push_back((std::sin(north) - std::sin(south)) * dLon / (4.0 * simulationPi));
+    }
+    for (int edge = 0; edge <= grid.nLat; ++edge) {
+        grid.cosEdge.push_back(edge == 0 || edge == grid.nLat ? 0.0 : std::cos(simulationPi / 2.0 - edge * dLat));
+    }
+    return grid;
+}
+
+SimulationState createSimulation(double resolution, float temperature) {
+    SimulationState state;
+    state.grid = makeLatLonGrid(resolution);
+    state.temperature = Field(state.grid.nLat, state.grid.nLon, temperature);
+    state.scratch = Field(state.grid.nLat, state.grid.nLon, temperature);
+    return state;
+}
+
+void initializeFromThermal(SimulationState &state, const ThermalGrid &thermal) {
+    const LatLonGrid &grid = state.grid;
+    if (thermal.width <= 0 || thermal.height <= 0) return;
+    ThermalGrid resampled;
+    resampled.width = grid.nLon;
+    resampled.height = grid.nLat;
+    resampled.values.assign((size_t)grid.nLon * grid.nLat, 0.0f);
+    resampled.valid.assign((size_t)grid.nLon * grid.nLat, 0);
+    threadPool().parallelFor(0, grid.nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            // Source pixels overlapping the cell, at least the nearest one when the model grid is finer
+            int srcRowBegin = (int)((long long)row * thermal.height / grid.nLat);
+            int srcRowEnd = std::max(srcRowBegin + 1, (int)((long long)(row + 1) * thermal.height / grid.nLat));
+            for (int col = 0; col < grid.nLon; ++col) {
+                int srcColBegin = (int)((long long)col * thermal.width / grid.nLon);
+                int srcColEnd = std::max(srcColBegin + 1, (int)((long long)(col + 1) * thermal.width / grid.nLon));
+                double sum = 0.0, weight = 0.0;
+                for (int srcRow = srcRowBegin; srcRow < srcRowEnd; ++srcRow) {
+                    double rowWeight = std::cos(simulationPi / 2.0 - (srcRow + 0.5) * simulationPi / thermal.height);
+                    for (int srcCol = srcColBegin; srcCol < srcColEnd; ++srcCol) {
+                        size_t srcIdx = (size_t)srcRow * thermal.width + srcCol;
+                        if (!thermal.valid[srcIdx]) continue;
+                        sum += rowWeight * thermal.values[srcIdx];
+                        weight += rowWeight;
+                    }
+                }
+                if (weight <= 0.0) continue;
+                size_t idx = (size_t)row * grid.nLon + col;
+                resampled.values[idx] = (float)(sum / weight);
+                resampled.valid[idx] = 1;
+            }
+        }
+    }, 4);
+    fillThermalGaps(resampled);
+    // Nothing observed at all leaves the state untouched
+    if (!resampled.valid[0]) return;
+    for (int row = 0; row < grid.nLat; ++row) {
+        std::copy(resampled.values.begin() + (size_t)row * grid.nLon, resampled.values.begin() + (size_t)(row + 1) * grid.nLon, state.temperature.row(row));
+    }
+    state.scratch = state.temperature;
+}
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include <core/reduction.h>
+#include <core/threadPool.h>
+#include <simulation/slabOcean.h>
+
+constexpr double oceanPi = 3.14159265358979323846;
+
+namespace {
+
+// Surface temperature and conductance the atmosphere sees over one row until the next ocean step
+void refreshSurfaceRow(SlabOcean &ocean, const SlabOceanParams &params, int row) {
+    const int nLon = ocean.temperature.cols;
+    const float *isOcean = ocean.ocean.row(row), *temperature = ocean.temperature.row(row), *ice = ocean.iceThickness.row(row);
+    float *surface = ocean.surfaceTemperature.row(row), *conductance = ocean.conductance.row(row);
+    for (int col = 0; col < nLon; ++col) {
+        const bool frozen = ice[col] > 0.0f;
+        surface[col] = frozen ? (float)params.freezingTemperature : temperature[col];
+        // Bulk exchange in series with conduction through the ice
+        conductance[col] = isOcean[col] * (float)(1.0 / (1.0 / params.exchangeCoefficient + ice[col] / params.iceConductivity));
+    }
+}
+
+} // namespace
+
+void initializeSlabOcean(SlabOcean &ocean, const SimulationState &state, const SurfaceMask &mask, const SlabOceanParams &params) {
+    const LatLonGrid &grid = state.grid;
+    ocean.ocean = Field(grid.nLat, grid.nLon);
+    ocean.temperature = Field(grid.nLat, grid.nLon);
+    ocean.iceThickness = Field(grid.nLat, grid.nLon);
+    ocean.surfaceTemperature = Field(grid.nLat, grid.nLon);
+    ocean.conductance = Field(grid.nLat, grid.nLon);
+    ocean.fluxBuffer = Field(grid.nLat, grid.nLon);
+    const bool masked = !mask.empty() && mask.nLat == grid.nLat && mask.nLon == grid.nLon;
+    for (int row = 0; row < grid.nLat; ++row) {
+        for (int col = 0; col < grid.nLon; ++col) {
+            if (masked && mask.at(row, col) != SurfaceType::Ocean) continue;
+            const float air = state.temperature.at(row, col);
+            ocean.ocean.at(row, col) = 1.0f;
+            ocean.temperature.at(row, col) = std::max(air, (float)params.freezingTemperature);
+            if (air < params.freezingTemperature) ocean.iceThickness.at(row, col) = (float)params.initialIceThickness;
+        }
+        refreshSurfaceRow(ocean, params, row);
+    }
+}
+
+void exchangeSurfaceFluxes(SimulationState &state, SlabOcean &ocean, double atmosphereHeatCapacity, double dt) {
+    const int nLon = state.grid.nLon;
+    const float scale = (float)(dt / atmosphereHeatCapacity), seconds = (float)dt;
+    threadPool().parallelFor(0, state.grid.nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            float *__restrict air = state.temperature.row(row), *__restrict buffer = ocean.fluxBuffer.row(row);
+            const float *__restrict surface = ocean.surfaceTemperature.row(row), *__restrict conductance = ocean.conductance.row(row);
+            // Land cells have zero conductance, so the loop needs no mask and vectorises
+            for (int col = 0; col < nLon; ++col) {
+                const float upward = conductance[col] * (surface[col] - air[col]);
+                air[col] += scale * upward;
+                buffer[col] -= seconds * upward;
+            }
+        }
+    }, 4);
+}
+
+void stepSlabOcean(SlabOcean &ocean, const SlabOceanParams &params) {
+    const int nLon = ocean.temperature.cols;
+    const float freezing = (float)params.freezingTemperature, heatCapacity = (float)params.heatCapacity;
+    const float fusionPerMetre = (float)(params.iceDensity * params.latentHeatOfFusion); // J m^-3 of ice
+    threadPool().parallelFor(0, ocean.temperature.rows, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            const float *isOcean = ocean.ocean.row(row);
+            float *temperature = ocean.temperature.row(row), *ice = ocean.iceThickness.row(row), *buffer = ocean.fluxBuffer.row(row);
+            for (int col = 0; col < nLon; ++col) {
+                const float heat = buffer[col];
+                buffer[col] = 0.0f;
+                if (isOcean[col] == 0.0f) continue;
+                if (ice[col] > 0.0f) {
+                    // The mixed layer stays at freezing under ice: heat lost through it grows ice, heat gained melts it
+                    ice[col] -= heat / fusionPerMetre;
+                    if (ice[col] < 0.0f) {
+                        temperature[col] = freezing - ice[col] * fusionPerMetre / heatCapacity;
+                        ice[col] = 0.0f;
+                    }
+                } else {
+                    temperature[col] += heat / heatCapacity;
+                    if (temperature[col] < freezing) {
+                        ice[col] = (freezing - temperature[col]) * heatCapacity / fusionPerMetre;
+                        temperature[col] = freezing;
+                    }
+                }
+            }
+            refreshSurfaceRow(ocean, params, row);
+        }
+    }, 4);
+}
+
+double iceCoverage(const SlabOcean &ocean, const LatLonGrid &grid) {
+    return reduceSum(0, grid.nLat, 1, [&](int row) {
+        const float *ice = ocean.iceThickness.row(row);
+        int covered = 0;
+        for (int col = 0; col < grid.nLon; ++col) covered += ice[col] > 0.0f;
+        return covered * grid.areaWeight[row];
+    });
+}
+
+double meanOceanTemperature(const SlabOcean &ocean, const LatLonGrid &grid) {
+    // Area-weighted sum and area of the open water, row by row through the fixed tree
+    const std::array<double, 2> totals = reduceSums<2>(0, grid.nLat, 1, [&](int row) {
+        const float *isOcean = ocean.ocean.row(row), *temperature = ocean.temperature.row(row), *ice = ocean.iceThickness.row(row);
+        double sum = 0.0;
+        int open = 0;
+        for (int col = 0; col < grid.nLon; ++col) {
+            if (isOcean[col] == 0.0f || ice[col] > 0.0f) continue;
+            sum += temperature[col];
+            ++open;
+        }
+        return std::array<double, 2>{sum * grid.areaWeight[row], open * grid.areaWeight[row]};
+    });
+    return totals[1] > 0.0 ? totals[0] / totals[1] : 0.0;
+}
+
+void addSlabOceanComponents(Scheduler &scheduler, std::shared_ptr<SlabOcean> ocean, const EnergyBalanceParams &atmosphere,
+                            const SlabOceanParams &params, int couplingInterval) {
+    PhysicsComponent fluxes;
+    fluxes.name = "surfaceFluxes";
+    const double atmosphereHeatCapacity = atmosphere.heatCapacity;
+    fluxes.step = [ocean, atmosphereHeatCapacity](SimulationState &state, double dt) { exchangeSurfaceFluxes(state, *ocean, atmosphereHeatCapacity, dt); };
+    // Forward Euler on the air side of the widest open-water exchange
+    fluxes.stableTimestep = [atmosphereHeatCapacity, params](const SimulationState &) { return atmosphereHeatCapacity / params.exchangeCoefficient; };
+    scheduler.addComponent(fluxes);
+
+    PhysicsComponent slab;
+    slab.name = "ocean";
+    // The buffer already holds everything that happened since the last call, so the span itself is not needed
+    slab.step = [ocean, params](SimulationState &, double) { stepSlabOcean(*ocean, params); };
+    // The atmosphere sees a surface up to one coupling interval old; the lag is stable while the ocean moves less
+    // than its gap to the air over it
+    slab.stableTimestep = [params](const SimulationState &) { return params.heatCapacity / params.exchangeCoefficient; };
+    slab.interval = couplingInterval;
+    slab.after = std::vector<std::string>{"surfaceFluxes"};
+    scheduler.addComponent(slab);
+}
+
+void benchmarkSlabOcean() {
+    const double resolution = 4.0, modelDays = 90.0, maxTimestep = 3.0 * 3600.0;
+    // The atmosphere keeps only the heat capacity of the air and the land surface; the ocean holds the rest
+    EnergyBalanceParams atmosphere;
+    atmosphere.heatCapacity = SurfaceParams().landHeatCapacity;
+    const SlabOceanParams params;
+    std::cout << "Slab ocean benchmark (" << threadPool().size() << " threads), " << resolution << " deg, " << modelDays << " model days" << std::endl;
+
+    LatLonGrid grid = makeLatLonGrid(resolution);
+    SurfaceMask mask = loadSurfaceMask(grid);
+    if (mask.empty()) std::cout << "No basemap, ocean everywhere" << std::endl;
+    SimulationState initial = createSimulation(resolution);
+    for (int row = 0; row < grid.nLat; ++row) {
+        double sinLat = std::sin(grid.latitudes[row]);
+        for (int col = 0; col < grid.nLon; ++col) {
+            double lon = 2.0 * oceanPi * col / grid.nLon;
+            initial.temperature.at(row, col) = (float)(300.0 - 45.0 * sinLat * sinLat + 3.0 * std::cos(3.0 * lon));
+        }
+    }
+    SlabOcean initialOcean;
+    initializeSlabOcean(initialOcean, initial, mask, params);
+
+    SlabOcean reference;
+    double referenceAir = 0.0;
+    for (int couplingInterval : {1, 4, 16, 64}) {
+        SimulationState state = initial;
+        auto ocean = std::make_shared<SlabOcean>(initialOcean);
+        Scheduler scheduler(maxTimestep);
+        addEnergyBalanceComponents(scheduler, atmosphere);
+        addSlabOceanComponents(scheduler, ocean, atmosphere, params, couplingInterval);
+        scheduler.advanceTo(state, modelDays * 86400.0);
+
+        const double air = globalMeanTemperature(state);
+        float drift = 0.0f;
+        if (couplingInterval == 1) {
+            reference = *ocean;
+            referenceAir = air;
+        } else {
+            for (int row = 0; row < grid.nLat; ++row) {
+                for (int col = 0; col < grid.nLon; ++col) drift = std::max(drift, std::abs(ocean->temperature.at(row, col) - reference.temperature.at(row, col)));
+            }
+        }
+        std::cout << "Coupling every " << couplingInterval << " steps, air " << std::fixed << std::setprecision(3) << air << " K ("
+                  << std::showpos << air - referenceAir << std::noshowpos << "), open ocean " << meanOceanTemperature(*ocean, grid) << " K, ice "
+                  << std::setprecision(2) << 100.0 * iceCoverage(*ocean, grid) << "% of the sphere, max ocean drift " << std::setprecision(4) << drift
+                  << " K" << std::defaultfloat << std::setprecision(6) << ": ";
+        scheduler.printTimers(std::cout);
+    }
+}
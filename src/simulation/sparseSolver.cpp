@@ -0,0 +1,526 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <utility>
+
+#include <core/reduction.h>
+#include <core/threadPool.h>
+#include <simulation/sparseSolver.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SELL_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SELL_SSE2
+#endif
+
+// Chebyshev preconditioner interval [spectrumTop / chebyshevRange, spectrumTop]; the polynomial stays positive below
+// it too, so it remains a valid preconditioner however small the smallest eigenvalue is
+constexpr double chebyshevRange = 30.0;
+
+namespace {
+
+double dot(const std::vector<double> &a, const std::vector<double> &b) {
+    return reduceSum(0, (int)a.size(), reductionLeaf, [&](int i) { return a[i] * b[i]; });
+}
+
+// y = a x + y
+void addScaled(double a, const std::vector<double> &x, std::vector<double> &y) {
+    threadPool().parallelFor(0, (int)x.size(), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) y[i] += a * x[i];
+    }, 4096);
+}
+
+} // namespace
+
+SellMatrix makeSellMatrix(const CsrMatrix &matrix, int sigma) {
+    SellMatrix sell;
+    const int rows = matrix.rows;
+    sell.rows = rows;
+    sell.sigma = std::max(sigma, 1);
+    auto length = [&](int row) { return matrix.offsets[row + 1] - matrix.offsets[row]; };
+    sell.permutation.resize(rows);
+    std::iota(sell.permutation.begin(), sell.permutation.end(), 0);
+    for (int window = 0; window < rows; window += sell.sigma) {
+        std::stable_sort(sell.permutation.begin() + window, sell.permutation.begin() + std::min(window + sell.sigma, rows),
+                         [&](int a, int b) { return length(a) > length(b); });
+    }
+
+    const int slices = (rows + sellChunk - 1) / sellChunk;
+    sell.sliceOffsets.resize(slices + 1);
+    sell.sliceWidths.resize(slices);
+    int total = 0;
+    for (int slice = 0; slice < slices; ++slice) {
+        int width = 0;
+        for (int lane = 0; lane < sellChunk && slice * sellChunk + lane < rows; ++lane) width = std::max(width, length(sell.permutation[slice * sellChunk + lane]));
+        sell.sliceOffsets[slice] = total;
+        sell.sliceWidths[slice] = width;
+        total += width * sellChunk;
+    }
+    sell.sliceOffsets[slices] = total;
+    sell.columns.assign(total, 0);
+    sell.values.assign(total, 0.0f);
+    threadPool().parallelFor(0, slices, [&](int sliceBegin, int sliceEnd) {
+        for (int slice = sliceBegin; slice < sliceEnd; ++slice) {
+            const int base = sell.sliceOffsets[slice];
+            for (int lane = 0; lane < sellChunk && slice * sellChunk + lane < rows; ++lane) {
+                const int row = sell.permutation[slice * sellChunk + lane], first = matrix.offsets[row], count = length(row);
+                for (int j = 0; j < sell.sliceWidths[slice]; ++j) {
+                    // Padding reads an x the row already reads, so it costs no extra cache line
+                    const int source = first + std::min(j, std::max(count - 1, 0));
+                    sell.columns[base + j * sellChunk + lane] = count > 0 ? matrix.columns[source] : row;
+                    sell.values[base + j * sellChunk + lane] = j < count ? matrix.values[source] : 0.0f;
+                }
+            }
+        }
+    }, 256);
+    return sell;
+}
+
+void multiply(const CsrMatrix &matrix, const double *x, double *y) {
+    threadPool().parallelFor(0, matrix.rows, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            double sum = 0.0;
+            for (int k = matrix.offsets[row]; k < matrix.offsets[row + 1]; ++k) sum += matrix.values[k] * x[matrix.columns[k]];
+            y[row] = sum;
+        }
+    }, 2048);
+}
+
+void multiply(const SellMatrix &matrix, const double *x, double *y) {
+    const int slices = (int)matrix.sliceWidths.size();
+    threadPool().parallelFor(0, slices, [&](int sliceBegin, int sliceEnd) {
+        for (int slice = sliceBegin; slice < sliceEnd; ++slice) {
+            const int *columns = matrix.columns.data() + matrix.sliceOffsets[slice];
+            const float *values = matrix.values.data() + matrix.sliceOffsets[slice];
+            alignas(32) double sum[sellChunk];
+            const int width = matrix.sliceWidths[slice];
+            // Each lane adds its row's products in column order, as the CSR kernel does, so the results are identical
+#if defined(SELL_AVX2)
+            __m256d low = _mm256_setzero_pd(), high = _mm256_setzero_pd();
+            for (int j = 0; j < width; ++j, columns += sellChunk, values += sellChunk) {
+                const __m256 value = _mm256_loadu_ps(values);
+                const __m256i column = _mm256_loadu_si256((const __m256i *)columns);
+                low = _mm256_add_pd(low, _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(value)),
+                                                       _mm256_i32gather_pd(x, _mm256_castsi256_si128(column), 8)));
+                high = _mm256_add_pd(high, _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(value, 1)),
+                                                         _mm256_i32gather_pd(x, _mm256_extracti128_si256(column, 1), 8)));
+            }
+            _mm256_store_pd(sum, low);
+            _mm256_store_pd(sum + 4, high);
+#elif defined(SELL_SSE2)
+            // No gather: x is read two lanes at a time into the halves of a register
+            __m128d partial[sellChunk / 2];
+            for (__m128d &lanes : partial) lanes = _mm_setzero_pd();
+            for (int j = 0; j < width; ++j, columns += sellChunk, values += sellChunk) {
+                for (int pair = 0; pair < sellChunk / 2; ++pair) {
+                    const __m128d value = _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double *)(values + 2 * pair))));
+                    const __m128d gathered = _mm_loadh_pd(_mm_load_sd(x + columns[2 * pair]), x + columns[2 * pair + 1]);
+                    partial[pair] = _mm_add_pd(partial[pair], _mm_mul_pd(value, gathered));
+                }
+            }
+            for (int pair = 0; pair < sellChunk / 2; ++pair) _mm_store_pd(sum + 2 * pair, partial[pair]);
+#else
+            for (double &lane : sum) lane = 0.0;
+            for (int j = 0; j < width; ++j, columns += sellChunk, values += sellChunk) {
+                for (int lane = 0; lane < sellChunk; ++lane) sum[lane] += values[lane] * x[columns[lane]];
+            }
+#endif
+            const int first = slice * sellChunk, count = std::min(sellChunk, matrix.rows - first);
+            for (int lane = 0; lane < count; ++lane) y[matrix.permutation[first + lane]] = sum[lane];
+        }
+    }, 256);
+}
+
+CsrMatrix assembleDiffusionMatrix(const SphericalMesh &mesh, double diffusivity, double shift) {
+    const int cells = mesh.numCells();
+    CsrMatrix matrix;
+    matrix.rows = cells;
+    matrix.offsets.resize(cells + 1);
+    // Every row is its neighbours plus the diagonal
+    for (int cell = 0; cell <= cells; ++cell) matrix.offsets[cell] = mesh.neighbourOffsets[cell] + cell;
+    matrix.columns.resize(matrix.offsets[cells]);
+    matrix.values.resize(matrix.offsets[cells]);
+    threadPool().parallelFor(0, cells, [&](int cellBegin, int cellEnd) {
+        std::vector<std::pair<int, float>> entries;
+        for (int cell = cellBegin; cell < cellEnd; ++cell) {
+            entries.clear();
+            double diagonal = shift * mesh.areas[cell];
+            for (int k = mesh.neighbourOffsets[cell]; k < mesh.neighbourOffsets[cell + 1]; ++k) {
+                const int neighbour = mesh.neighbours[k];
+                // edgeLength / edgeDistance from both sides, averaged so the matrix is symmetric to the last bit
+                double coupling = mesh.laplacianWeights[k] * mesh.areas[cell];
+                for (int j = mesh.neighbourOffsets[neighbour]; j < mesh.neighbourOffsets[neighbour + 1]; ++j) {
+                    if (mesh.neighbours[j] != cell) continue;
+                    const double reverse = mesh.laplacianWeights[j] * mesh.areas[neighbour];
+                    coupling = 0.5 * (coupling + reverse);
+                    break;
+                }
+                diagonal += diffusivity * coupling;
+                entries.emplace_back(neighbour, (float)(-diffusivity * coupling));
+            }
+            entries.emplace_back(cell, (float)diagonal);
+            std::sort(entries.begin(), entries.end());
+            for (size_t k = 0; k < entries.size(); ++k) {
+                matrix.columns[matrix.offsets[cell] + k] = entries[k].first;
+                matrix.values[matrix.offsets[cell] + k] = entries[k].second;
+            }
+        }
+    }, 1024);
+    return matrix;
+}
+
+CsrMatrix assembleLaplacian(const SphericalMesh &mesh) {
+    return assembleDiffusionMatrix(mesh, 1.0, 0.0);
+}
+
+PcgSolver::PcgSolver(const CsrMatrix &matrix, const PcgSettings &settings) : settings(settings), rows(matrix.rows) {
+    // SELL wins where its lanes fill evenly and the gathers vectorise; on near-uniform rows without a gather
+    // instruction CSR can be ahead, so a few products of each decide
+    sell = makeSellMatrix(matrix);
+    std::vector<double> x(rows, 1.0), y(rows);
+    auto seconds = [&](auto &&product) {
+        auto start = std::chrono::steady_clock::now();
+        product();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    // Best of several runs each, interleaved so that a change in machine load hits both formats alike
+    double csrSeconds = 1e300, sellSeconds = 1e300;
+    for (int run = 0; run < 6; ++run) {
+        csrSeconds = std::min(csrSeconds, seconds([&]() { multiply(matrix, x.data(), y.data()); }));
+        sellSeconds = std::min(sellSeconds, seconds([&]() { multiply(sell, x.data(), y.data()); }));
+    }
+    sellProduct = sellSeconds < csrSeconds;
+    if (!sellProduct) {
+        csr = matrix;
+        sell = SellMatrix();
+    }
+    inverseDiagonal.assign(matrix.rows, 1.0);
+    spectrumTop = 0.0;
+    for (int row = 0; row < matrix.rows; ++row) {
+        double diagonal = 0.0, absoluteSum = 0.0;
+        for (int k = matrix.offsets[row]; k < matrix.offsets[row + 1]; ++k) {
+            if (matrix.columns[k] == row) diagonal = matrix.values[k];
+            absoluteSum += std::abs(matrix.values[k]);
+        }
+        if (diagonal > 0.0) inverseDiagonal[row] = 1.0 / diagonal;
+        // Gershgorin bound of the Jacobi-scaled matrix
+        spectrumTop = std::max(spectrumTop, absoluteSum * inverseDiagonal[row]);
+    }
+    if (settings.preconditioner == Preconditioner::IncompleteCholesky) factorIncompleteCholesky(matrix);
+    work.resize(matrix.rows);
+    work2.resize(matrix.rows);
+}
+
+void PcgSolver::factorIncompleteCholesky(const CsrMatrix &matrix) {
+    const int rows = matrix.rows;
+    // Lower triangle of the pattern, diagonal last in each row
+    lowerFactor.rows = rows;
+    lowerFactor.offsets.assign(rows + 1, 0);
+    for (int row = 0; row < rows; ++row) {
+        int count = 0;
+        for (int k = matrix.offsets[row]; k < matrix.offsets[row + 1]; ++k) count += matrix.columns[k] <= row;
+        lowerFactor.offsets[row + 1] = lowerFactor.offsets[row] + count;
+    }
+    lowerFactor.columns.resize(lowerFactor.offsets[rows]);
+    lowerFactor.values.resize(lowerFactor.offsets[rows]);
+    for (int row = 0; row < rows; ++row) {
+        int out = lowerFactor.offsets[row];
+        for (int k = matrix.offsets[row]; k < matrix.offsets[row + 1] && matrix.columns[k] <= row; ++k, ++out) {
+            lowerFactor.columns[out] = matrix.columns[k];
+            lowerFactor.values[out] = matrix.values[k];
+        }
+    }
+
+    // Row by row: each entry takes away the products of the two rows' entries left of it, which a merge of the two
+    // sorted rows finds. Sequential, but done once per matrix.
+    std::vector<double> factor(lowerFactor.values.begin(), lowerFactor.values.end());
+    for (int row = 0; row < rows; ++row) {
+        const int rowFirst = lowerFactor.offsets[row], rowLast = lowerFactor.offsets[row + 1] - 1; // rowLast is the diagonal
+        for (int k = rowFirst; k <= rowLast; ++k) {
+            const int col = lowerFactor.columns[k];
+            double sum = factor[k];
+            int i = rowFirst, j = lowerFactor.offsets[col];
+            const int colLast = lowerFactor.offsets[col + 1] - 1;
+            while (i < k && j < colLast) {
+                if (lowerFactor.columns[i] < lowerFactor.columns[j]) {
+                    ++i;
+                } else if (lowerFactor.columns[i] > lowerFactor.columns[j]) {
+                    ++j;
+                } else {
+                    sum -= factor[i++] * factor[j++];
+                }
+            }
+            if (k < rowLast) {
+                factor[k] = sum / factor[colLast];
+            } else {
+                // A pivot lost to cancellation falls back to the matrix diagonal
+                factor[k] = std::sqrt(sum > 0.0 ? sum : (double)lowerFactor.values[k]);
+            }
+        }
+    }
+    std::copy(factor.begin(), factor.end(), lowerFactor.values.begin());
+
+    // Transpose for the backward solve: diagonal first in each row
+    upperFactor.rows = rows;
+    upperFactor.offsets.assign(rows + 1, 0);
+    for (int col : lowerFactor.columns) ++upperFactor.offsets[col + 1];
+    for (int row = 0; row < rows; ++row) upperFactor.offsets[row + 1] += upperFactor.offsets[row];
+    upperFactor.columns.resize(lowerFactor.columns.size());
+    upperFactor.values.resize(lowerFactor.values.size());
+    std::vector<int> next(upperFactor.offsets.begin(), upperFactor.offsets.end() - 1);
+    for (int row = 0; row < rows; ++row) {
+        for (int k = lowerFactor.offsets[row]; k < lowerFactor.offsets[row + 1]; ++k) {
+            const int slot = next[lowerFactor.columns[k]]++;
+            upperFactor.columns[slot] = row;
+            upperFactor.values[slot] = lowerFactor.values[k];
+        }
+    }
+
+    // Level schedules: a row waits only for the rows its off-diagonal entries name
+    std::vector<int> level(rows, 0);
+    lowerLevels.clear();
+    for (int row = 0; row < rows; ++row) {
+        for (int k = lowerFactor.offsets[row]; k < lowerFactor.offsets[row + 1] - 1; ++k) level[row] = std::max(level[row], level[lowerFactor.columns[k]] + 1);
+        if (level[row] >= (int)lowerLevels.size()) lowerLevels.resize(level[row] + 1);
+        lowerLevels[level[row]].push_back(row);
+    }
+    std::fill(level.begin(), level.end(), 0);
+    upperLevels.clear();
+    for (int row = rows - 1; row >= 0; --row) {
+        for (int k = upperFactor.offsets[row] + 1; k < upperFactor.offsets[row + 1]; ++k) level[row] = std::max(level[row], level[upperFactor.columns[k]] + 1);
+        if (level[row] >= (int)upperLevels.size()) upperLevels.resize(level[row] + 1);
+        upperLevels[level[row]].push_back(row);
+    }
+}
+
+void PcgSolver::triangularSolve(const CsrMatrix &factor, const std::vector<std::vector<int>> &levels, bool lower, std::vector<double> &values) const {
+    auto solveRow = [&](int row) {
+        const int first = factor.offsets[row], last = factor.offsets[row + 1];
+        const int diagonal = lower ? last - 1 : first;
+        double sum = values[row];
+        for (int k = lower ? first : first + 1; k < (lower ? last - 1 : last); ++k) sum -= factor.values[k] * values[factor.columns[k]];
+        values[row] = sum / factor.values[diagonal];
+    };
+    // Every row sees the same finished values in either order, so the result is identical; alone, a thread does
+    // better walking memory in order than hopping between the scattered rows of each level
+    if (threadPool().size() <= 1) {
+        if (lower) {
+            for (int row = 0; row < factor.rows; ++row) solveRow(row);
+        } else {
+            for (int row = factor.rows - 1; row >= 0; --row) solveRow(row);
+        }
+        return;
+    }
+    for (const std::vector<int> &rows : levels) {
+        threadPool().parallelFor(0, (int)rows.size(), [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) solveRow(rows[i]);
+        }, 512);
+    }
+}
+
+void PcgSolver::product(const double *x, double *y) const {
+    if (sellProduct) {
+        multiply(sell, x, y);
+    } else {
+        multiply(csr, x, y);
+    }
+}
+
+void PcgSolver::precondition(const std::vector<double> &residual, std::vector<double> &out) const {
+    const int rows = (int)residual.size();
+    switch (settings.preconditioner) {
+    case Preconditioner::Jacobi:
+        threadPool().parallelFor(0, rows, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) out[i] = inverseDiagonal[i] * residual[i];
+        }, 4096);
+        break;
+    case Preconditioner::IncompleteCholesky:
+        out = residual;
+        triangularSolve(lowerFactor, lowerLevels, true, out);
+        triangularSolve(upperFactor, upperLevels, false, out);
+        break;
+    case Preconditioner::Polynomial: {
+        // Chebyshev iteration on A out = residual from zero, each step Jacobi preconditioned
+        const double low = spectrumTop / chebyshevRange, theta = 0.5 * (spectrumTop + low), delta = 0.5 * (spectrumTop - low), sigma = theta / delta;
+        std::vector<double> &step = work2;
+        threadPool().parallelFor(0, rows, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                step[i] = inverseDiagonal[i] * residual[i] / theta;
+                out[i] = step[i];
+            }
+        }, 4096);
+        double rho = 1.0 / sigma;
+        for (int degree = 1; degree < settings.polynomialDegree; ++degree) {
+            product(out.data(), work.data());
+            const double rhoNext = 1.0 / (2.0 * sigma - rho), keep = rhoNext * rho, scale = 2.0 * rhoNext / delta;
+            threadPool().parallelFor(0, rows, [&](int begin, int end) {
+                for (int i = begin; i < end; ++i) {
+                    step[i] = keep * step[i] + scale * inverseDiagonal[i] * (residual[i] - work[i]);
+                    out[i] += step[i];
+                }
+            }, 4096);
+            rho = rhoNext;
+        }
+        break;
+    }
+    }
+}
+
+SolveStats PcgSolver::solve(const std::vector<double> &rhs, std::vector<double> &solution) const {
+    auto start = std::chrono::steady_clock::now();
+    SolveStats stats;
+    solution.resize(rows, 0.0);
+    const double rhsNorm = std::sqrt(dot(rhs, rhs));
+    if (rhsNorm == 0.0) {
+        std::fill(solution.begin(), solution.end(), 0.0);
+        return stats;
+    }
+    std::vector<double> residual(rows), preconditioned(rows), direction(rows), applied(rows);
+    product(solution.data(), applied.data());
+    threadPool().parallelFor(0, rows, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) residual[i] = rhs[i] - applied[i];
+    }, 4096);
+    stats.residual = std::sqrt(dot(residual, residual)) / rhsNorm;
+    precondition(residual, preconditioned);
+    direction = preconditioned;
+    double rz = dot(residual, preconditioned);
+    while (stats.residual > settings.tolerance && stats.cycles < settings.maxIterations) {
+        product(direction.data(), applied.data());
+        const double alpha = rz / dot(direction, applied);
+        addScaled(alpha, direction, solution);
+        addScaled(-alpha, applied, residual);
+        ++stats.cycles;
+        stats.residual = std::sqrt(dot(residual, residual)) / rhsNorm;
+        if (stats.residual <= settings.tolerance) break;
+        precondition(residual, preconditioned);
+        const double rzNext = dot(residual, preconditioned), beta = rzNext / rz;
+        rz = rzNext;
+        threadPool().parallelFor(0, rows, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) direction[i] = preconditioned[i] + beta * direction[i];
+        }, 4096);
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+PcgSolver diffusionSolver(const SphericalMesh &mesh, const EnergyBalanceParams &params, double dt, const PcgSettings &settings) {
+    // (C / dt) area T' - D area laplacian(T') = (C / dt) area T
+    return PcgSolver(assembleDiffusionMatrix(mesh, params.diffusivity, params.heatCapacity / dt), settings);
+}
+
+SolveStats implicitDiffusion(MeshSimulationState &state, const PcgSolver &solver, const EnergyBalanceParams &params, double dt) {
+    const SphericalMesh &mesh = *state.mesh;
+    const double shift = params.heatCapacity / dt;
+    std::vector<double> rhs(mesh.numCells()), solution(mesh.numCells());
+    for (int cell = 0; cell < mesh.numCells(); ++cell) {
+        rhs[cell] = shift * mesh.areas[cell] * state.temperature[cell];
+        solution[cell] = state.temperature[cell];
+    }
+    SolveStats stats = solver.solve(rhs, solution);
+    for (int cell = 0; cell < mesh.numCells(); ++cell) state.temperature[cell] = (float)solution[cell];
+    return stats;
+}
+
+void benchmarkSparseSolver() {
+#if defined(SELL_AVX2)
+    const char *sellKernel = "AVX2 gathers";
+#elif defined(SELL_SSE2)
+    const char *sellKernel = "SSE2 pairs";
+#else
+    const char *sellKernel = "scalar";
+#endif
+    std::cout << "Sparse solver benchmark (" << threadPool().size() << " threads), SELL chunk " << sellChunk << ", " << sellKernel << std::endl;
+    // Best of several runs, after one warm-up
+    auto bestSeconds = [](int runs, auto &&run) {
+        run();
+        double best = 1e300;
+        for (int i = 0; i < runs; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    };
+
+    // Reference bandwidth: a parallel copy far larger than the caches, counting the read and the write
+    std::vector<double> source((size_t)1 << 23, 1.0), target(source.size());
+    const double copySeconds = bestSeconds(5, [&]() {
+        threadPool().parallelFor(0, (int)source.size(), [&](int begin, int end) { std::copy(source.begin() + begin, source.begin() + end, target.begin() + begin); }, 1 << 16);
+    });
+    const double copyBandwidth = 2.0 * sizeof(double) * source.size() / copySeconds / 1e9;
+    std::cout << "  copy " << std::fixed << std::setprecision(2) << copyBandwidth << " GB/s" << std::endl;
+    source = std::vector<double>();
+    target = std::vector<double>();
+
+    const EnergyBalanceParams params;
+    const double dt = 30.0 * 86400.0;
+    struct NamedMesh {
+        const char *name;
+        SphericalMesh mesh;
+    };
+    NamedMesh meshes[] = {{"icosahedral", makeIcosahedralMesh(200)}, {"cubed sphere", makeCubedSphereMesh(256)}};
+    for (const NamedMesh &named : meshes) {
+        const SphericalMesh &mesh = named.mesh;
+        const int cells = mesh.numCells();
+        const CsrMatrix matrix = assembleDiffusionMatrix(mesh, params.diffusivity, params.heatCapacity / dt);
+        std::cout << "  " << named.name << ", " << cells << " cells, " << matrix.nonZeros() << " non-zeros" << std::endl;
+
+        // Minimal traffic of one product: the stored matrix, x and y once each
+        std::vector<double> x(cells), y(cells);
+        for (int cell = 0; cell < cells; ++cell) x[cell] = 1.0 + 0.1 * mesh.sinLat[cell];
+        const double vectorBytes = 2.0 * sizeof(double) * cells;
+        const double csrBytes = (sizeof(float) + sizeof(int)) * (double)matrix.nonZeros() + sizeof(int) * (cells + 1.0) + vectorBytes;
+        const double csrSeconds = bestSeconds(20, [&]() { multiply(matrix, x.data(), y.data()); });
+        const std::vector<double> reference = y;
+        std::cout << "    CSR          " << std::setw(8) << csrBytes / csrSeconds / 1e9 << " GB/s " << std::setw(5) << std::setprecision(1)
+                  << 100.0 * csrBytes / csrSeconds / 1e9 / copyBandwidth << "% of copy  " << std::setprecision(2) << std::setw(8)
+                  << matrix.nonZeros() / csrSeconds / 1e6 << " Mnz/s" << std::endl;
+        for (int sigma : {1, 32, 1024}) {
+            const SellMatrix sell = makeSellMatrix(matrix, sigma);
+            const double sellBytes = (sizeof(float) + sizeof(int)) * (double)sell.storedEntries() + 2.0 * sizeof(int) * sell.sliceWidths.size()
+                                     + sizeof(int) * (double)cells + vectorBytes;
+            const double sellSeconds = bestSeconds(20, [&]() { multiply(sell, x.data(), y.data()); });
+            double maxDifference = 0.0;
+            for (int cell = 0; cell < cells; ++cell) maxDifference = std::max(maxDifference, std::abs(y[cell] - reference[cell]));
+            std::cout << "    SELL-" << sellChunk << "-" << std::left << std::setw(4) << sigma << std::right << std::setw(9) << sellBytes / sellSeconds / 1e9
+                      << " GB/s " << std::setw(5) << std::setprecision(1) << 100.0 * sellBytes / sellSeconds / 1e9 / copyBandwidth << "% of copy  "
+                      << std::setprecision(2) << std::setw(8) << matrix.nonZeros() / sellSeconds / 1e6 << " Mnz/s  (" << csrSeconds / sellSeconds
+                      << "x CSR, padding " << std::setprecision(1) << 100.0 * (sell.storedEntries() - (double)matrix.nonZeros()) / matrix.nonZeros()
+                      << "%, max difference " << std::scientific << maxDifference << std::fixed << std::setprecision(2) << ")" << std::endl;
+        }
+
+        // A month of diffusion in one implicit step, from a field with structure at every scale
+        MeshSimulationState state = createMeshSimulation(mesh);
+        for (int cell = 0; cell < cells; ++cell) {
+            const glm::dvec3 &centre = mesh.centres[cell];
+            state.temperature[cell] = (float)(300.0 - 45.0 * mesh.sinLat[cell] * mesh.sinLat[cell] + 5.0 * std::sin(40.0 * centre.x) * std::cos(30.0 * centre.y));
+        }
+        const std::pair<Preconditioner, const char *> preconditioners[] = {
+            {Preconditioner::Jacobi, "Jacobi"}, {Preconditioner::IncompleteCholesky, "IC(0)"}, {Preconditioner::Polynomial, "Chebyshev"}
+        };
+        for (const auto &preconditioner : preconditioners) {
+            PcgSettings settings;
+            settings.preconditioner = preconditioner.first;
+            MeshSimulationState solved = state;
+            auto start = std::chrono::steady_clock::now();
+            const PcgSolver solver = diffusionSolver(mesh, params, dt, settings);
+            const double setupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            SolveStats stats = implicitDiffusion(solved, solver, params, dt);
+            // The next month reuses the solver, so its step pays only for the solve
+            start = std::chrono::steady_clock::now();
+            SolveStats next = implicitDiffusion(solved, solver, params, dt);
+            const double nextSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "    PCG " << std::left << std::setw(10) << preconditioner.second << std::right << std::setw(5) << stats.cycles << " iterations "
+                      << std::setw(8) << stats.seconds * 1e3 << " ms solve, setup " << std::setw(7) << setupSeconds * 1e3 << " ms once ("
+                      << (solver.usesSell() ? "SELL" : "CSR") << " product), next step " << std::setw(8) << nextSeconds * 1e3 << " ms ("
+                      << next.cycles << " iterations), residual " << std::scientific << std::setprecision(1) << stats.residual << std::fixed
+                      << std::setprecision(2) << ", mean " << globalMeanTemperature(solved) << " K" << std::endl;
+        }
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
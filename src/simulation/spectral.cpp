@@ -0,0 +1,387 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <core/threadPool.h>
+#include <simulation/spectral.h>
+
+constexpr double spectralPi = 3.14159265358979323846;
+
+using Complex = std::complex<double>;
+
+struct SphericalHarmonicTransform::FourierPlan {
+    int n = 0;    // Row length
+    int half = 0; // Length of the complex transform
+    std::vector<int> factors;
+    std::vector<Complex> twiddles; // exp(-2 pi i k / half)
+    std::vector<Complex> unpack;   // exp(-2 pi i m / n), m <= half
+
+    explicit FourierPlan(int n) : n(n), half(n / 2) {
+        int rest = half;
+        for (int radix : {4, 2, 3, 5}) {
+            while (rest % radix == 0) {
+                factors.push_back(radix);
+                rest /= radix;
+            }
+        }
+        for (int k = 0; k < half; ++k) twiddles.push_back(std::polar(1.0, -2.0 * spectralPi * k / half));
+        for (int m = 0; m <= half; ++m) unpack.push_back(std::polar(1.0, -2.0 * spectralPi * m / n));
+    }
+
+    // Mixed-radix decimation in time: transform the p interleaved subsequences, then combine them in place
+    void fft(const Complex *in, Complex *out, int length, int stride, const int *factor, int twiddleStride) const {
+        if (length == 1) {
+            out[0] = in[0];
+            return;
+        }
+        const int p = *factor, m = length / p;
+        for (int r = 0; r < p; ++r) fft(in + r * stride, out + r * m, m, stride * p, factor + 1, twiddleStride * p);
+        Complex t[5];
+        for (int k = 0; k < m; ++k) {
+            for (int r = 0; r < p; ++r) t[r] = out[r * m + k] * twiddles[(size_t)r * k * twiddleStride];
+            for (int q = 0; q < p; ++q) {
+                Complex sum = t[0];
+                for (int r = 1; r < p; ++r) sum += t[r] * twiddles[(size_t)((r * q) % p) * m * twiddleStride];
+                out[k + q * m] = sum;
+            }
+        }
+    }
+
+    // Fourier coefficients (1 / n) sum x exp(-i m lambda) of m = 0..truncation; work holds n complex values
+    void forward(const float *row, Complex *coefficients, int truncation, Complex *work) const {
+        Complex *packed = work, *spectrum = work + half;
+        for (int k = 0; k < half; ++k) packed[k] = Complex(row[2 * k], row[2 * k + 1]);
+        fft(packed, spectrum, half, 1, factors.data(), 1);
+        for (int m = 0; m <= truncation; ++m) {
+            const Complex z = spectrum[m % half], mirror = std::conj(spectrum[(half - m) % half]);
+            const Complex even = 0.5 * (z + mirror), odd = Complex(0.0, -0.5) * (z - mirror);
+            coefficients[m] = (even + unpack[m] * odd) / (double)n;
+        }
+    }
+
+    // Row sum of coefficients[m] exp(i m lambda) over m = -truncation..truncation; truncation must be below n / 2
+    void inverse(const Complex *coefficients, int truncation, float *row, Complex *work) const {
+        Complex *packed = work, *signal = work + half;
+        auto full = [&](int m) { return m <= truncation ? coefficients[m] * (double)n : Complex(); };
+        for (int m = 0; m < half; ++m) {
+            const Complex x = full(m), mirror = std::conj(full(half - m));
+            const Complex even = 0.5 * (x + mirror), odd = 0.5 * (x - mirror) * std::conj(unpack[m]);
+            // Conjugated so the forward transform runs the inverse
+            packed[m] = std::conj(even + Complex(0.0, 1.0) * odd);
+        }
+        fft(packed, signal, half, 1, factors.data(), 1);
+        for (int k = 0; k < half; ++k) {
+            const Complex z = std::conj(signal[k]) / (double)half;
+            row[2 * k] = (float)z.real();
+            row[2 * k + 1] = (float)z.imag();
+        }
+    }
+};
+
+namespace {
+
+// Gauss-Legendre nodes (descending) and weights of degree nLat by Newton iteration on P_nLat
+void gaussLegendre(int nLat, std::vector<double> &nodes, std::vector<double> &weights) {
+    nodes.assign(nLat, 0.0);
+    weights.assign(nLat, 0.0);
+    for (int i = 0; i < (nLat + 1) / 2; ++i) {
+        double x = std::cos(spectralPi * (i + 0.75) / (nLat + 0.5)), derivative = 1.0;
+        for (int iteration = 0; iteration < 100; ++iteration) {
+            double previous = 1.0, value = x;
+            for (int degree = 2; degree <= nLat; ++degree) {
+                double next = ((2 * degree - 1) * x * value - (degree - 1) * previous) / degree;
+                previous = value;
+                value = next;
+            }
+            derivative = nLat * (x * value - previous) / (x * x - 1.0);
+            double delta = value / derivative;
+            x -= delta;
+            if (std::abs(delta) < 1e-15) break;
+        }
+        nodes[i] = x;
+        nodes[nLat - 1 - i] = -x;
+        weights[i] = weights[nLat - 1 - i] = 2.0 / ((1.0 - x * x) * derivative * derivative);
+    }
+}
+
+bool smoothLength(int n) {
+    for (int radix : {2, 3, 5}) {
+        while (n % radix == 0) n /= radix;
+    }
+    return n == 1;
+}
+
+std::unique_ptr<LegendreTable> buildLegendreTable(int truncation, int nLat) {
+    auto table = std::make_unique<LegendreTable>();
+    table->truncation = truncation;
+    table->nLat = nLat;
+    std::vector<double> nodes, weights;
+    gaussLegendre(nLat, nodes, weights);
+    const int pairs = nLat / 2;
+    table->weights.assign(weights.begin(), weights.begin() + pairs);
+    size_t offset = 0;
+    for (int m = 0; m <= truncation; ++m) {
+        table->waveOffset.push_back(offset);
+        offset += (size_t)pairs * (truncation - m + 1);
+    }
+    table->values.resize(offset);
+
+    threadPool().parallelFor(0, pairs, [&](int pairBegin, int pairEnd) {
+        std::vector<double> column(truncation + 1);
+        for (int pair = pairBegin; pair < pairEnd; ++pair) {
+            const double mu = nodes[pair], sine = std::sqrt(1.0 - mu * mu);
+            double sectoral = std::sqrt(0.5); // P(m, m), normalised to unit integral over [-1, 1]
+            for (int m = 0; m <= truncation; ++m) {
+                if (m > 0) sectoral *= std::sqrt((2.0 * m + 1.0) / (2.0 * m)) * sine;
+                const int count = truncation - m + 1;
+                // Upward recurrence in n
+                column[0] = sectoral;
+                if (count > 1) column[1] = std::sqrt(2.0 * m + 3.0) * mu * sectoral;
+                for (int k = 2; k < count; ++k) {
+                    const int n = m + k;
+                    const double a = std::sqrt((4.0 * n * n - 1.0) / ((double)n * n - (double)m * m));
+                    const double aPrevious = std::sqrt((4.0 * (n - 1) * (n - 1) - 1.0) / ((double)(n - 1) * (n - 1) - (double)m * m));
+                    column[k] = a * (mu * column[k - 1] - column[k - 2] / aPrevious);
+                }
+                double *out = table->values.data() + table->waveOffset[m] + (size_t)pair * count;
+                const int evens = (count + 1) / 2;
+                for (int k = 0; k < count; ++k) out[k % 2 == 0 ? k / 2 : evens + k / 2] = column[k];
+            }
+        }
+    });
+    return table;
+}
+
+} // namespace
+
+LatLonGrid makeGaussianGrid(int nLat) {
+    LatLonGrid grid;
+    grid.nLat = nLat;
+    grid.nLon = 2 * nLat;
+    grid.resolution = 180.0 / nLat;
+    std::vector<double> nodes, weights;
+    gaussLegendre(nLat, nodes, weights);
+    double edge = 1.0;
+    grid.cosEdge.push_back(0.0);
+    for (int row = 0; row < nLat; ++row) {
+        grid.latitudes.push_back(std::asin(nodes[row]));
+        grid.cosLat.push_back(std::sqrt(1.0 - nodes[row] * nodes[row]));
+        // Quadrature weights sum to 2 over [-1, 1]; a cell spans 2 pi / nLon of the 4 pi sphere
+        grid.areaWeight.push_back(weights[row] / (2.0 * grid.nLon));
+        edge -= weights[row];
+        grid.cosEdge.push_back(row == nLat - 1 ? 0.0 : std::sqrt(std::max(1.0 - edge * edge, 0.0)));
+    }
+    return grid;
+}
+
+int gaussianRows(int truncation) {
+    int nLat = (3 * truncation + 2) / 2;
+    nLat += nLat % 2;
+    while (!smoothLength(2 * nLat)) nLat += 2;
+    return nLat;
+}
+
+std::shared_ptr<const LegendreTable> legendreTable(int truncation, int nLat) {
+    static std::mutex cacheMutex;
+    static std::map<std::pair<int, int>, std::shared_ptr<const LegendreTable>> cache;
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto &entry = cache[std::make_pair(truncation, nLat)];
+    if (!entry) entry = buildLegendreTable(truncation, nLat);
+    return entry;
+}
+
+SphericalHarmonicTransform::SphericalHarmonicTransform(int truncation)
+    : trunc(truncation), gaussian(makeGaussianGrid(gaussianRows(truncation))) {
+    legendre = legendreTable(trunc, gaussian.nLat);
+    fourier = std::make_shared<FourierPlan>(gaussian.nLon);
+    for (int m = 0; m <= trunc; ++m) {
+        waveStart.push_back(coefficients);
+        coefficients += trunc - m + 1;
+    }
+    // m = 0 has the longest sum and m = T the shortest; alternating from both ends gives every contiguous block of
+    // the parallel loop about the same work
+    for (int low = 0, high = trunc; low <= high; ++low, --high) {
+        waveOrder.push_back(low);
+        if (high != low) waveOrder.push_back(high);
+    }
+}
+
+void SphericalHarmonicTransform::analyse(const Field &field, std::vector<Complex> &spectrum) const {
+    const int nLat = gaussian.nLat, pairs = nLat / 2, waves = trunc + 1;
+    std::vector<Complex> rowCoefficients((size_t)nLat * waves);
+    threadPool().parallelFor(0, pairs, [&](int pairBegin, int pairEnd) {
+        std::vector<Complex> work(fourier->n);
+        for (int pair = pairBegin; pair < pairEnd; ++pair) {
+            for (int row : {pair, nLat - 1 - pair}) fourier->forward(field.row(row), rowCoefficients.data() + (size_t)row * waves, trunc, work.data());
+        }
+    });
+
+    spectrum.assign(coefficients, Complex());
+    threadPool().parallelFor(0, (int)waveOrder.size(), [&](int begin, int end) {
+        std::vector<double> sums(4 * (trunc + 1));
+        for (int i = begin; i < end; ++i) {
+            const int m = waveOrder[i], count = trunc - m + 1, evens = (count + 1) / 2, odds = count / 2;
+            double *evenRe = sums.data(), *evenIm = evenRe + evens, *oddRe = evenIm + evens, *oddIm = oddRe + odds;
+            std::fill(sums.begin(), sums.begin() + 2 * count, 0.0);
+            for (int pair = 0; pair < pairs; ++pair) {
+                const Complex north = rowCoefficients[(size_t)pair * waves + m], south = rowCoefficients[(size_t)(nLat - 1 - pair) * waves + m];
+                const double weight = legendre->weights[pair];
+                // Degrees with n - m even see the symmetric part of the pair, odd ones the antisymmetric part
+                const Complex symmetric = weight * (north + south), antisymmetric = weight * (north - south);
+                const double *p = legendre->pair(m, pair);
+                const double *__restrict pEven = p, *__restrict pOdd = p + evens;
+                for (int k = 0; k < evens; ++k) {
+                    evenRe[k] += pEven[k] * symmetric.real();
+                    evenIm[k] += pEven[k] * symmetric.imag();
+                }
+                for (int k = 0; k < odds; ++k) {
+                    oddRe[k] += pOdd[k] * antisymmetric.real();
+                    oddIm[k] += pOdd[k] * antisymmetric.imag();
+                }
+            }
+            Complex *out = spectrum.data() + waveStart[m];
+            for (int k = 0; k < count; ++k) out[k] = k % 2 == 0 ? Complex(evenRe[k / 2], evenIm[k / 2]) : Complex(oddRe[k / 2], oddIm[k / 2]);
+        }
+    }, 1);
+}
+
+void SphericalHarmonicTransform::synthesise(const std::vector<Complex> &spectrum, Field &field) const {
+    const int nLat = gaussian.nLat, pairs = nLat / 2, waves = trunc + 1;
+    std::vector<Complex> rowCoefficients((size_t)nLat * waves);
+    threadPool().parallelFor(0, (int)waveOrder.size(), [&](int begin, int end) {
+        std::vector<double> split(2 * (trunc + 1));
+        for (int i = begin; i < end; ++i) {
+            const int m = waveOrder[i], count = trunc - m + 1, evens = (count + 1) / 2, odds = count / 2;
+            // Coefficients in the table's order, real and imaginary parts apart
+            double *re = split.data(), *im = re + count;
+            const Complex *in = spectrum.data() + waveStart[m];
+            for (int k = 0; k < count; ++k) {
+                const int slot = k % 2 == 0 ? k / 2 : evens + k / 2;
+                re[slot] = in[k].real();
+                im[slot] = in[k].imag();
+            }
+            for (int pair = 0; pair < pairs; ++pair) {
+                const double *__restrict p = legendre->pair(m, pair);
+                double evenRe = 0.0, evenIm = 0.0, oddRe = 0.0, oddIm = 0.0;
+                for (int k = 0; k < evens; ++k) {
+                    evenRe += p[k] * re[k];
+                    evenIm += p[k] * im[k];
+                }
+                for (int k = evens; k < evens + odds; ++k) {
+                    oddRe += p[k] * re[k];
+                    oddIm += p[k] * im[k];
+                }
+                rowCoefficients[(size_t)pair * waves + m] = Complex(evenRe + oddRe, evenIm + oddIm);
+                rowCoefficients[(size_t)(nLat - 1 - pair) * waves + m] = Complex(evenRe - oddRe, evenIm - oddIm);
+            }
+        }
+    }, 1);
+
+    threadPool().parallelFor(0, pairs, [&](int pairBegin, int pairEnd) {
+        std::vector<Complex> work(fourier->n);
+        for (int pair = pairBegin; pair < pairEnd; ++pair) {
+            for (int row : {pair, nLat - 1 - pair}) fourier->inverse(rowCoefficients.data() + (size_t)row * waves, trunc, field.row(row), work.data());
+        }
+    });
+}
+
+SpectralEnergyBalance::SpectralEnergyBalance(int truncation, const EnergyBalanceParams &params, float temperature)
+    : sht(truncation), params(params) {
+    current.grid = sht.grid();
+    current.temperature = Field(current.grid.nLat, current.grid.nLon, temperature);
+    current.scratch = Field(current.grid.nLat, current.grid.nLon, temperature);
+}
+
+double SpectralEnergyBalance::stableTimestep() const {
+    // Forward Euler on the linearised outgoing longwave term
+    return params.heatCapacity / params.olrB;
+}
+
+void SpectralEnergyBalance::step(double dt) {
+    applyRadiation(current, params, dt);
+    sht.analyse(current.temperature, spectrum);
+    // Each harmonic decays independently under diffusion: exact integration at any dt
+    const double rate = params.diffusivity * dt / params.heatCapacity;
+    for (int m = 0; m <= sht.truncation(); ++m) {
+        for (int n = m; n <= sht.truncation(); ++n) spectrum[sht.index(m, n)] *= std::exp(-rate * n * (n + 1.0));
+    }
+    sht.synthesise(spectrum, current.temperature);
+    current.time += dt;
+    ++current.step;
+}
+
+void benchmarkSpectralCore() {
+    const EnergyBalanceParams params;
+    const double spectralTimestep = 3.0 * 3600.0;
+    std::cout << "Spectral core benchmark (" << threadPool().size() << " threads), spectral dt " << spectralTimestep << " s" << std::endl;
+    for (int truncation : {42, 63, 85, 106, 127, 170, 213, 255}) {
+        auto start = std::chrono::steady_clock::now();
+        SpectralEnergyBalance spectral(truncation, params);
+        const double setupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const SphericalHarmonicTransform &sht = spectral.transform();
+        const LatLonGrid &grid = sht.grid();
+
+        // Band-limited field: zonal mean up to n = 2 plus the n = 4, m = 4 harmonic
+        Field field(grid.nLat, grid.nLon), roundTrip(grid.nLat, grid.nLon);
+        for (int row = 0; row < grid.nLat; ++row) {
+            const double sinLat = std::sin(grid.latitudes[row]), cosLat = grid.cosLat[row];
+            for (int col = 0; col < grid.nLon; ++col) {
+                field.at(row, col) = (float)(300.0 - 45.0 * sinLat * sinLat + 5.0 * std::pow(cosLat, 4) * std::cos(4.0 * 2.0 * spectralPi * col / grid.nLon));
+            }
+        }
+        spectral.state().temperature = field;
+        std::vector<Complex> spectrum;
+        int pairs = 0;
+        start = std::chrono::steady_clock::now();
+        double elapsed = 0.0;
+        while (elapsed < 0.3 || pairs < 3) {
+            sht.analyse(field, spectrum);
+            sht.synthesise(spectrum, roundTrip);
+            ++pairs;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        const double transformSeconds = elapsed / pairs;
+        float roundTripError = 0.0f;
+        for (int row = 0; row < grid.nLat; ++row) {
+            for (int col = 0; col < grid.nLon; ++col) roundTripError = std::max(roundTripError, std::abs(roundTrip.at(row, col) - field.at(row, col)));
+        }
+
+        // One model day of the spectral core
+        const double dt = std::min(spectralTimestep, spectral.stableTimestep());
+        const int spectralSteps = (int)std::ceil(86400.0 / dt);
+        start = std::chrono::steady_clock::now();
+        for (int step = 0; step < spectralSteps; ++step) spectral.step(dt);
+        const double spectralSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // The grid-point core at the same row count, timed over a few steps and scaled to a day at its stable dt
+        SimulationState gridPoint = createSimulation(180.0 / grid.nLat);
+        gridPoint.temperature = Field(gridPoint.grid.nLat, gridPoint.grid.nLon);
+        for (int row = 0; row < gridPoint.grid.nLat; ++row) {
+            const double sinLat = std::sin(gridPoint.grid.latitudes[row]);
+            std::fill(gridPoint.temperature.row(row), gridPoint.temperature.row(row) + gridPoint.grid.nLon, (float)(300.0 - 45.0 * sinLat * sinLat));
+        }
+        const double gridDt = stableTimestep(gridPoint, params);
+        int gridSteps = 0;
+        start = std::chrono::steady_clock::now();
+        elapsed = 0.0;
+        while (elapsed < 0.3 || gridSteps < 3) {
+            stepEnergyBalance(gridPoint, params, gridDt);
+            ++gridSteps;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        const double gridSeconds = elapsed / gridSteps * 86400.0 / gridDt;
+
+        std::cout << "  T" << std::left << std::setw(4) << truncation << std::right << std::setw(4) << grid.nLat << "x" << std::left << std::setw(4) << grid.nLon
+                  << std::right << std::fixed << std::setprecision(1) << " setup " << std::setw(6) << setupSeconds * 1e3 << " ms  transform pair "
+                  << std::setw(7) << std::setprecision(2) << transformSeconds * 1e3 << " ms  round trip " << std::scientific << std::setprecision(1)
+                  << roundTripError << " K  per model day: spectral " << std::fixed << std::setprecision(3) << std::setw(7) << spectralSeconds
+                  << " s, grid point " << std::setw(9) << gridSeconds << " s (dt " << std::setprecision(1) << gridDt << " s, "
+                  << std::setprecision(1) << gridSeconds / spectralSeconds << "x)" << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <utility>
+
+#include <core/gapFill.h>
+#include <core/reduction.h>
+#include <core/threadPool.h>
+#include <simulation/sphericalMesh.h>
+
+constexpr double meshPi = 3.14159265358979323846;
+constexpr float meshFreezingKelvin = 273.15f;
+constexpr int insolationTableSize = 1024;
+constexpr double latticeWarp = 1.22;
+
+// Area of the spherical triangle abc (Van Oosterom & Strackee)
+double sphericalTriangleArea(const glm::dvec3 &a, const glm::dvec3 &b, const glm::dvec3 &c) {
+    double numerator = std::abs(glm::dot(a, glm::cross(b, c)));
+    double denominator = 1.0 + glm::dot(a, b) + glm::dot(b, c) + glm::dot(c, a);
+    return 2.0 * std::atan2(numerator, denominator);
+}
+
+double arcLength(const glm::dvec3 &a, const glm::dvec3 &b) {
+    return std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+}
+
+// Areas, edge geometry and Laplacian weights, once centres, neighbours and corners are in place
+void finishMesh(SphericalMesh &mesh) {
+    int numCells = mesh.numCells();
+    size_t numEntries = mesh.neighbours.size();
+    mesh.areas.assign(numCells, 0.0);
+    mesh.sinLat.resize(numCells);
+    mesh.edgeLengths.resize(numEntries);
+    mesh.edgeDistances.resize(numEntries);
+    mesh.laplacianWeights.resize(numEntries);
+    threadPool().parallelFor(0, numCells, [&](int cellBegin, int cellEnd) {
+        for (int cell = cellBegin; cell < cellEnd; ++cell) {
+            int first = mesh.neighbourOffsets[cell], count = mesh.neighbourOffsets[cell + 1] - first;
+            const glm::dvec3 &centre = mesh.centres[cell];
+            double area = 0.0;
+            for (int k = 0; k < count; ++k) {
+                area += sphericalTriangleArea(centre, mesh.corners[first + k], mesh.corners[first + (k + 1) % count]);
+            }
+            for (int k = 0; k < count; ++k) {
+                double length = arcLength(mesh.corners[first + k], mesh.corners[first + (k + 1) % count]);
+                double distance = arcLength(centre, mesh.centres[mesh.neighbours[first + k]]);
+                mesh.edgeLengths[first + k] = (float)length;
+                mesh.edgeDistances[first + k] = (float)distance;
+                mesh.laplacianWeights[first + k] = (float)(length / (distance * area));
+            }
+            mesh.areas[cell] = area;
+            mesh.sinLat[cell] = (float)centre.z;
+        }
+    }, 256);
+}
+
+SphericalMesh makeIcosahedralMesh(int divisions) {
+    const int n = std::max(divisions, 1);
+    SphericalMesh mesh;
+    mesh.type = MeshType::Icosahedral;
+    mesh.resolution = n;
+    // Icosahedron with a vertex on each pole and two staggered rings of five between them
+    std::vector<glm::dvec3> base{glm::dvec3(0.0, 0.0, 1.0)};
+    double ringZ = 1.0 / std::sqrt(5.0), ringRadius = 2.0 / std::sqrt(5.0);
+    for (int k = 0; k < 5; ++k) {
+        double lon = 2.0 * meshPi * k / 5.0;
+        base.push_back(glm::dvec3(ringRadius * std::cos(lon), ringRadius * std::sin(lon), ringZ));
+    }
+    for (int k = 0; k < 5; ++k) {
+        double lon = 2.0 * meshPi * (k + 0.5) / 5.0;
+        base.push_back(glm::dvec3(ringRadius * std::cos(lon), ringRadius * std::sin(lon), -ringZ));
+    }
+    base.push_back(glm::dvec3(0.0, 0.0, -1.0));
+    // Barycentric weights are bent by sin(w * latticeWarp) before projecting, pulling lattice points in
+    // towards face centres to offset the gnomonic stretch there: largest / smallest cell area drops from about 2 to 1.17
+    auto latticePoint = [&](int a, int b, int c, int i, int j) {
+        double wa = std::sin((double)(n - i - j) / n * latticeWarp), wb = std::sin((double)i / n * latticeWarp), wc = std::sin((double)j / n * latticeWarp);
+        return glm::normalize(base[a] * wa + base[b] * wb + base[c] * wc);
+    };
+    std::vector<glm::ivec3> faces;
+    for (int k = 0; k < 5; ++k) {
+        int upper0 = 1 + k, upper1 = 1 + (k + 1) % 5, lower0 = 6 + k, lower1 = 6 + (k + 1) % 5;
+        faces.push_back(glm::ivec3(0, upper0, upper1));
+        faces.push_back(glm::ivec3(upper0, lower0, upper1));
+        faces.push_back(glm::ivec3(upper1, lower0, lower1));
+        faces.push_back(glm::ivec3(11, lower1, lower0));
+    }
+    for (glm::ivec3 &face : faces) {
+        const glm::dvec3 &a = base[face.x], &b = base[face.y], &c = base[face.z];
+        if (glm::dot(glm::cross(b - a, c - a), a + b + c) < 0.0) std::swap(face.y, face.z);
+    }
+
+    // Lattice points of every face; points on shared edges are created once, walking from the lower index
+    std::vector<glm::dvec3> &points = mesh.centres;
+    points = base;
+    std::map<std::pair<int, int>, int> edgeStart;
+    auto edgePoint = [&](int from, int to, int step) {
+        int low = std::min(from, to), high = std::max(from, to);
+        auto it = edgeStart.find({low, high});
+        if (it == edgeStart.end()) {
+            it = edgeStart.emplace(std::make_pair(low, high), (int)points.size()).first;
+            for (int s = 1; s < n; ++s) points.push_back(latticePoint(low, high, high, s, 0));
+        }
+        return it->second + (from == low ? step : n - step) - 1;
+    };
+    std::vector<glm::ivec3> triangles;
+    triangles.reserve((size_t)20 * n * n);
+    std::vector<int> lattice((size_t)(n + 1) * (n + 1));
+    for (const glm::ivec3 &face : faces) {
+        for (int j = 0; j <= n; ++j) {
+            for (int i = 0; i + j <= n; ++i) {
+                int index;
+                if (i == 0 && j == 0) index = face.x;
+                else if (i == n) index = face.y;
+                else if (j == n) index = face.z;
+                else if (j == 0) index = edgePoint(face.x, face.y, i);
+                else if (i == 0) index = edgePoint(face.x, face.z, j);
+                else if (i + j == n) index = edgePoint(face.y, face.z, j);
+                else {
+                    index = (int)points.size();
+                    points.push_back(latticePoint(face.x, face.y, face.z, i, j));
+                }
+                lattice[(size_t)j * (n + 1) + i] = index;
+            }
+        }
+        auto at = [&](int i, int j) { return lattice[(size_t)j * (n + 1) + i]; };
+        for (int j = 0; j < n; ++j) {
+            for (int i = 0; i + j < n; ++i) {
+                triangles.push_back(glm::ivec3(at(i, j), at(i + 1, j), at(i, j + 1)));
+                if (i + j < n - 1) triangles.push_back(glm::ivec3(at(i + 1, j), at(i + 1, j + 1), at(i, j + 1)));
+            }
+        }
+    }
+
+    // Voronoi dual: each lattice point becomes a cell whose corners are the circumcentres of its triangles
+    const int numCells = (int)points.size();
+    std::vector<glm::dvec3> circumcentres(triangles.size());
+    std::vector<int> incidentOffsets(numCells + 1, 0);
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        const glm::ivec3 &tri = triangles[t];
+        circumcentres[t] = glm::normalize(glm::cross(points[tri.y] - points[tri.x], points[tri.z] - points[tri.x]));
+        for (int corner = 0; corner < 3; ++corner) ++incidentOffsets[tri[corner] + 1];
+    }
+    for (int cell = 0; cell < numCells; ++cell) incidentOffsets[cell + 1] += incidentOffsets[cell];
+    std::vector<int> incident(incidentOffsets.back()), cursor(incidentOffsets.begin(), incidentOffsets.end() - 1);
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        for (int corner = 0; corner < 3; ++corner) incident[cursor[triangles[t][corner]]++] = (int)t;
+    }
+    mesh.neighbourOffsets = incidentOffsets;
+    mesh.neighbours.resize(incident.size());
+    mesh.corners.resize(incident.size());
+    for (int cell = 0; cell < numCells; ++cell) {
+        int first = incidentOffsets[cell], count = incidentOffsets[cell + 1] - first;
+        // Corners of a triangle that follow the cell counter-clockwise
+        auto following = [&](int t, int offset) {
+            const glm::ivec3 &tri = triangles[t];
+            int position = tri.x == cell ? 0 : tri.y == cell ? 1 : 2;
+            return tri[(position + offset) % 3];
+        };
+        int t = incident[first];
+        for (int k = 0; k < count; ++k) {
+            // Triangle k spans neighbours k and k + 1, so its circumcentre is corner k + 1
+            mesh.neighbours[first + k] = following(t, 1);
+            mesh.corners[first + (k + 1) % count] = circumcentres[t];
+            int nextNeighbour = following(t, 2);
+            for (int other = first; other < first + count; ++other) {
+                if (following(incident[other], 1) == nextNeighbour) {
+                    t = incident[other];
+                    break;
+                }
+            }
+        }
+    }
+    finishMesh(mesh);
+    return mesh;
+}
+
+// Cube faces as (normal, u, v) with u x v = normal, so increasing u then v runs counter-clockwise
+struct CubeFace {
+    glm::dvec3 normal, u, v;
+};
+
+const CubeFace cubeFaces[6] = {
+    {glm::dvec3(1, 0, 0), glm::dvec3(0, 1, 0), glm::dvec3(0, 0, 1)},
+    {glm::dvec3(-1, 0, 0), glm::dvec3(0, -1, 0), glm::dvec3(0, 0, 1)},
+    {glm::dvec3(0, 1, 0), glm::dvec3(-1, 0, 0), glm::dvec3(0, 0, 1)},
+    {glm::dvec3(0, -1, 0), glm::dvec3(1, 0, 0), glm::dvec3(0, 0, 1)},
+    {glm::dvec3(0, 0, 1), glm::dvec3(1, 0, 0), glm::dvec3(0, 1, 0)},
+    {glm::dvec3(0, 0, -1), glm::dvec3(0, 1, 0), glm::dvec3(1, 0, 0)}
+};
+
+// Point of a face at equiangular coordinates a, b in [-1, 1]; values beyond run onto the extended face plane
+glm::dvec3 cubePoint(int face, double a, double b) {
+    const CubeFace &f = cubeFaces[face];
+    return glm::normalize(f.normal + std::tan(a * meshPi / 4.0) * f.u + std::tan(b * meshPi / 4.0) * f.v);
+}
+
+int locateCubeCell(const glm::dvec3 &point, int n) {
+    glm::dvec3 magnitude = glm::abs(point);
+    int axis = magnitude.x >= magnitude.y && magnitude.x >= magnitude.z ? 0 : magnitude.y >= magnitude.z ? 1 : 2;
+    int face = 2 * axis + (point[axis] < 0.0 ? 1 : 0);
+    const CubeFace &f = cubeFaces[face];
+    double depth = glm::dot(point, f.normal);
+    double a = std::atan(glm::dot(point, f.u) / depth) * 4.0 / meshPi, b = std::atan(glm::dot(point, f.v) / depth) * 4.0 / meshPi;
+    int i = std::min(std::max((int)std::floor((a + 1.0) * 0.5 * n), 0), n - 1);
+    int j = std::min(std::max((int)std::floor((b + 1.0) * 0.5 * n), 0), n - 1);
+    return (face * n + j) * n + i;
+}
+
+SphericalMesh makeCubedSphereMesh(int cellsPerEdge) {
+    const int n = std::max(cellsPerEdge, 1);
+    SphericalMesh mesh;
+    mesh.type = MeshType::CubedSphere;
+    mesh.resolution = n;
+    const int numCells = 6 * n * n;
+    mesh.centres.resize(numCells);
+    mesh.neighbourOffsets.resize(numCells + 1);
+    mesh.neighbours.resize((size_t)4 * numCells);
+    mesh.corners.resize((size_t)4 * numCells);
+    auto coordinate = [n](int node) { return -1.0 + 2.0 * node / n; };
+    threadPool().parallelFor(0, 6 * n, [&](int rowBegin, int rowEnd) {
+        for (int faceRow = rowBegin; faceRow < rowEnd; ++faceRow) {
+            int face = faceRow / n, j = faceRow % n;
+            for (int i = 0; i < n; ++i) {
+                int cell = faceRow * n + i, first = 4 * cell;
+                mesh.centres[cell] = cubePoint(face, -1.0 + (2.0 * i + 1.0) / n, -1.0 + (2.0 * j + 1.0) / n);
+                mesh.neighbourOffsets[cell] = first;
+                // East, north, west, south in face coordinates; across a cube edge, step half a cell
+                // past it on the extended face and find whichever cell holds that point
+                const int stepI[4] = {1, 0, -1, 0}, stepJ[4] = {0, 1, 0, -1};
+                for (int k = 0; k < 4; ++k) {
+                    int ni = i + stepI[k], nj = j + stepJ[k];
+                    if (ni >= 0 && ni < n && nj >= 0 && nj < n) {
+                        mesh.neighbours[first + k] = (face * n + nj) * n + ni;
+                    } else {
+                        mesh.neighbours[first + k] = locateCubeCell(cubePoint(face, -1.0 + (2.0 * ni + 1.0) / n, -1.0 + (2.0 * nj + 1.0) / n), n);
+                    }
+                }
+                // Corner k starts the edge shared with neighbour k
+                mesh.corners[first] = cubePoint(face, coordinate(i + 1), coordinate(j));
+                mesh.corners[first + 1] = cubePoint(face, coordinate(i + 1), coordinate(j + 1));
+                mesh.corners[first + 2] = cubePoint(face, coordinate(i), coordinate(j + 1));
+                mesh.corners[first + 3] = cubePoint(face, coordinate(i), coordinate(j));
+            }
+        }
+    }, 4);
+    mesh.neighbourOffsets[numCells] = 4 * numCells;
+    finishMesh(mesh);
+    return mesh;
+}
+
+void buildRenderMesh(const SphericalMesh &mesh, std::vector<float> &vertices, std::vector<unsigned int> &indices) {
+    vertices.clear();
+    indices.clear();
+    auto longitudeU = [](const glm::dvec3 &p) { return (std::atan2(p.y, p.x) + meshPi) / (2.0 * meshPi); };
+    auto unwrap = [](double u, double reference) { return u - std::round(u - reference); };
+    auto isPole = [](const glm::dvec3 &p) { return 1.0 - std::abs(p.z) < 1e-9; };
+    auto pushVertex = [&](const glm::dvec3 &p, double u) {
+        // Renderer frame has north along +y; texture u starts at the antimeridian and v at the north pole
+        vertices.push_back((float)p.x);
+        vertices.push_back((float)p.z);
+        vertices.push_back((float)-p.y);
+        vertices.push_back((float)u);
+        vertices.push_back((float)(std::acos(std::min(std::max(p.z, -1.0), 1.0)) / meshPi));
+    };
+    for (int cell = 0; cell < mesh.numCells(); ++cell) {
+        int first = mesh.neighbourOffsets[cell], count = mesh.neighbourOffsets[cell + 1] - first;
+        const glm::dvec3 &centre = mesh.centres[cell];
+        if (!isPole(centre)) {
+            // Fan around the centre; corners take the copy of u nearest the centre's, so cells
+            // straddling the antimeridian run past 0 or 1 and rely on a repeating texture
+            double centreU = longitudeU(centre);
+            unsigned int fan = (unsigned int)(vertices.size() / 5);
+            pushVertex(centre, centreU);
+            for (int k = 0; k < count; ++k) {
+                const glm::dvec3 &corner = mesh.corners[first + k];
+                pushVertex(corner, isPole(corner) ? centreU : unwrap(longitudeU(corner), centreU));
+            }
+            for (int k = 0; k < count; ++k) {
+                indices.push_back(fan);
+                indices.push_back(fan + 1 + k);
+                indices.push_back(fan + 1 + (k + 1) % count);
+            }
+        } else {
+            // Longitude is undefined at the pole, so each triangle gets its own pole vertex at the mean of its corners
+            for (int k = 0; k < count; ++k) {
+                const glm::dvec3 &from = mesh.corners[first + k], &to = mesh.corners[first + (k + 1) % count];
+                double fromU = longitudeU(from), toU = unwrap(longitudeU(to), fromU);
+                unsigned int triangle = (unsigned int)(vertices.size() / 5);
+                pushVertex(centre, 0.5 * (fromU + toU));
+                pushVertex(from, fromU);
+                pushVertex(to, toU);
+                indices.push_back(triangle);
+                indices.push_back(triangle + 1);
+                indices.push_back(triangle + 2);
+            }
+        }
+    }
+}
+
+MeshSimulationState createMeshSimulation(const SphericalMesh &mesh, float temperature) {
+    MeshSimulationState state;
+    state.mesh = &mesh;
+    state.temperature.assign(mesh.numCells(), temperature);
+    state.scratch.assign(mesh.numCells(), temperature);
+    return state;
+}
+
+void initializeFromThermal(MeshSimulationState &state, const ThermalGrid &thermal) {
+    if (thermal.width <= 0 || thermal.height <= 0) return;
+    ThermalGrid filled = thermal;
+    fillThermalGaps(filled);
+    // Nothing observed at all leaves the state untouched
+    if (!filled.valid[0]) return;
+    const SphericalMesh &mesh = *state.mesh;
+    threadPool().parallelFor(0, mesh.numCells(), [&](int cellBegin, int cellEnd) {
+        for (int cell = cellBegin; cell < cellEnd; ++cell) {
+            const glm::dvec3 &centre = mesh.centres[cell];
+            double colatitude = std::acos(std::min(std::max(centre.z, -1.0), 1.0));
+            double u = (std::atan2(centre.y, centre.x) + meshPi) / (2.0 * meshPi);
+            int row = std::min((int)(colatitude / meshPi * filled.height), filled.height - 1);
+            int col = std::min((int)(u * filled.width), filled.width - 1);
+            state.temperature[cell] = filled.values[(size_t)row * filled.width + col];
+        }
+    }, 1024);
+    state.scratch = state.temperature;
+}
+
+double stableTimestep(const MeshSimulationState &state, const EnergyBalanceParams &params) {
+    const SphericalMesh &mesh = *state.mesh;
+    double maxRate = 0.0;
+    for (int cell = 0; cell < mesh.numCells(); ++cell) {
+        double weightSum = 0.0;
+        for (int k = mesh.neighbourOffsets[cell]; k < mesh.neighbourOffsets[cell + 1]; ++k) weightSum += mesh.laplacianWeights[k];
+        maxRate = std::max(maxRate, params.diffusivity * weightSum + params.olrB);
+    }
+    return params.heatCapacity / maxRate;
+}
+
+void stepEnergyBalance(MeshSimulationState &state, const EnergyBalanceParams &params, double dt) {
+    const SphericalMesh &mesh = *state.mesh;
+    const float scale = (float)(dt / params.heatCapacity);
+    const float diffusivity = (float)params.diffusivity;
+    const float olrA = (float)params.olrA, olrB = (float)params.olrB;
+    const float warmAlbedo = (float)params.warmAlbedo, iceAlbedo = (float)params.iceAlbedo;
+    const float rampSlope = (float)((params.iceAlbedo - params.warmAlbedo) / params.iceRampWidth);
+    const float rampTop = (float)(params.iceTemperature + 0.5 * params.iceRampWidth);
+    // Insolation depends on latitude alone; tabulate it over sin(latitude) once per step rather than per cell
+    std::vector<float> insolation(insolationTableSize + 1);
+    for (int k = 0; k <= insolationTableSize; ++k) {
+        insolation[k] = (float)dailyInsolation(params, std::asin(-1.0 + 2.0 * k / insolationTableSize), state.time);
+    }
+    const float tableScale = 0.5f * insolationTableSize;
+    const float *current = state.temperature.data();
+    float *next = state.scratch.data();
+    threadPool().parallelFor(0, mesh.numCells(), [&](int cellBegin, int cellEnd) {
+        for (int cell = cellBegin; cell < cellEnd; ++cell) {
+            float t = current[cell];
+            float laplacian = 0.0f;
+            for (int k = mesh.neighbourOffsets[cell]; k < mesh.neighbourOffsets[cell + 1]; ++k) {
+                laplacian += mesh.laplacianWeights[k] * (current[mesh.neighbours[k]] - t);
+            }
+            float position = (mesh.sinLat[cell] + 1.0f) * tableScale;
+            int index = std::min((int)position, insolationTableSize - 1);
+            float q = insolation[index] + (position - index) * (insolation[index + 1] - insolation[index]);
+            float albedo = std::min(std::max(warmAlbedo + rampSlope * (rampTop - t), warmAlbedo), iceAlbedo);
+            float tendency = q * (1.0f - albedo) - (olrA + olrB * (t - meshFreezingKelvin)) + diffusivity * laplacian;
+            next[cell] = t + scale * tendency;
+        }
+    }, 1024);
+    std::swap(state.temperature, state.scratch);
+    state.time += dt;
+    ++state.step;
+}
+
+double globalMeanTemperature(const MeshSimulationState &state) {
+    const SphericalMesh &mesh = *state.mesh;
+    std::array<double, 2> sums = reduceSums<2>(0, mesh.numCells(), reductionLeaf, [&](int cell) {
+        return std::array<double, 2>{state.temperature[cell] * mesh.areas[cell], mesh.areas[cell]};
+    });
+    return sums[0] / sums[1];
+}
+
+void benchmarkSphericalMesh() {
+    EnergyBalanceParams params;
+    std::cout << "Spherical mesh benchmark (" << threadPool().size() << " threads)" << std::endl;
+    // Time a run of steps until a second has passed, after one warm-up step
+    auto timeSteps = [](auto &&step) {
+        step();
+        int steps = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0.0;
+        while (elapsed < 1.0 || steps < 3) {
+            step();
+            ++steps;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        return steps / elapsed;
+    };
+    auto report = [](const char *name, int cells, double areaRatio, double dt, double stepsPerSecond) {
+        std::cout << std::setw(12) << name << std::setw(9) << cells << " cells  area ratio " << std::fixed << std::setprecision(2) << areaRatio
+                  << "  dt " << std::setw(8) << std::setprecision(1) << dt << " s  " << std::setw(7) << stepsPerSecond
+                  << " steps/s  " << std::setw(7) << dt * stepsPerSecond / 86400.0 << " model days/s" << std::defaultfloat << std::endl;
+    };
+    // Matched cell counts at roughly 1 and 0.5 degrees
+    for (int level = 0; level < 2; ++level) {
+        double resolution = level == 0 ? 1.0 : 0.5;
+        SimulationState gridState = createSimulation(resolution);
+        double gridDt = stableTimestep(gridState, params);
+        double gridRate = timeSteps([&] { stepEnergyBalance(gridState, params, gridDt); });
+        const LatLonGrid &grid = gridState.grid;
+        report("lat/lon", grid.nLat * grid.nLon, grid.areaWeight[grid.nLat / 2] / grid.areaWeight[0], gridDt, gridRate);
+
+        int targetCells = grid.nLat * grid.nLon;
+        SphericalMesh meshes[2] = {
+            makeIcosahedralMesh((int)std::lround(std::sqrt((targetCells - 2) / 10.0))),
+            makeCubedSphereMesh((int)std::lround(std::sqrt(targetCells / 6.0)))
+        };
+        for (const SphericalMesh &mesh : meshes) {
+            MeshSimulationState state = createMeshSimulation(mesh);
+            double dt = stableTimestep(state, params);
+            double rate = timeSteps([&] { stepEnergyBalance(state, params, dt); });
+            auto extremes = std::minmax_element(mesh.areas.begin(), mesh.areas.end());
+            report(mesh.type == MeshType::Icosahedral ? "icosahedral" : "cubed sphere", mesh.numCells(), *extremes.second / *extremes.first, dt, rate);
+        }
+    }
+}
@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <core/threadPool.h>
+#include <renderLogic/stb_image.h>
+#include <simulation/surfaceMask.h>
+
+constexpr double surfacePi = 3.14159265358979323846;
+
+// Layout, native endianness: MaskHeader, then nLat * nLon type bytes, then nLat * nLon albedo bytes
+constexpr char maskMagic[8] = {'E', 'B', 'M', 'S', 'F', 'C', 'M', '\0'};
+constexpr uint32_t maskVersion = 1;
+
+struct MaskHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t nLat;
+    int32_t nLon;
+    uint32_t reserved;
+    double firstLatitude; // Tells a Gaussian grid from a regular one with the same rows
+    uint64_t basemapBytes;
+    int64_t basemapTime;  // Last write time of the basemap, in its clock's ticks
+};
+
+namespace {
+
+// Surface type and albedo of one basemap colour
+SurfaceType classifyPixel(int r, int g, int b, float &albedo) {
+    const int high = std::max(std::max(r, g), b), low = std::min(std::min(r, g), b);
+    const float brightness = (r + g + b) / 765.0f;
+    if (low > 190 && high - low < 40) {
+        albedo = 0.35f + 0.45f * brightness;
+        return SurfaceType::Ice;
+    }
+    if (b > r + 20 && b + 10 >= g) {
+        albedo = 0.06f;
+        return SurfaceType::Ocean;
+    }
+    // Dark forest near 0.12, bright desert near 0.3
+    albedo = 0.08f + 0.32f * brightness;
+    return SurfaceType::Land;
+}
+
+// Pixels of a source axis overlapping a target interval, with the overlap as weight
+struct Overlap {
+    int pixel;
+    double weight;
+};
+
+// Latitude bounds of each grid row, north first: midway between row centres, the poles at the ends
+std::vector<double> rowEdges(const LatLonGrid &grid) {
+    std::vector<double> edges{surfacePi / 2.0};
+    for (int row = 1; row < grid.nLat; ++row) edges.push_back(0.5 * (grid.latitudes[row - 1] + grid.latitudes[row]));
+    edges.push_back(-surfacePi / 2.0);
+    return edges;
+}
+
+std::string defaultCachePath(const LatLonGrid &grid, const std::string &basemap) {
+    std::ostringstream name;
+    name << "surfaceMask_" << grid.nLat << "x" << grid.nLon << ".bin";
+    return basemapCachePath(name.str(), basemap);
+}
+
+bool readMask(const std::string &path, const MaskHeader &expected, SurfaceMask &mask) {
+    std::ifstream file(path, std::ios::binary);
+    MaskHeader header;
+    if (!file.read((char *)&header, sizeof(header))) return false;
+    if (std::memcmp(header.magic, maskMagic, sizeof(maskMagic)) != 0 || header.version != maskVersion || header.nLat != expected.nLat ||
+        header.nLon != expected.nLon || header.firstLatitude != expected.firstLatitude || header.basemapBytes != expected.basemapBytes ||
+        header.basemapTime != expected.basemapTime) {
+        return false;
+    }
+    const size_t cells = (size_t)header.nLat * header.nLon;
+    mask.nLat = header.nLat;
+    mask.nLon = header.nLon;
+    mask.type.resize(cells);
+    mask.albedo.resize(cells);
+    if (!file.read((char *)mask.type.data(), cells) || !file.read((char *)mask.albedo.data(), cells)) {
+        mask = SurfaceMask();
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string basemapCachePath(const std::string &fileName, const std::string &basemap) {
+    return (std::filesystem::path(basemap).parent_path() / fileName).string();
+}
+
+SurfaceMask classifySurface(const unsigned char *pixels, int width, int height, int channels, const LatLonGrid &grid) {
+    SurfaceMask mask;
+    if (!pixels || width <= 0 || height <= 0 || channels < 3) return mask;
+    mask.nLat = grid.nLat;
+    mask.nLon = grid.nLon;
+    mask.type.assign((size_t)grid.nLat * grid.nLon, (unsigned char)SurfaceType::Ocean);
+    mask.albedo.assign(mask.type.size(), 0);
+
+    // Overlaps are separable: a pixel's share of a cell is its sine-of-latitude overlap times its longitude overlap
+    const std::vector<double> edges = rowEdges(grid);
+    std::vector<std::vector<Overlap>> rowOverlaps(grid.nLat), colOverlaps(grid.nLon);
+    for (int row = 0; row < grid.nLat; ++row) {
+        const double north = edges[row], south = edges[row + 1];
+        const int first = std::max((int)std::floor((surfacePi / 2.0 - north) / surfacePi * height), 0);
+        const int last = std::min((int)std::ceil((surfacePi / 2.0 - south) / surfacePi * height), height);
+        for (int y = first; y < last; ++y) {
+            const double top = std::min(surfacePi / 2.0 - y * surfacePi / height, north);
+            const double bottom = std::max(surfacePi / 2.0 - (y + 1) * surfacePi / height, south);
+            if (top > bottom) rowOverlaps[row].push_back(Overlap{y, std::sin(top) - std::sin(bottom)});
+        }
+    }
+    for (int col = 0; col < grid.nLon; ++col) {
+        const double left = (double)col * width / grid.nLon, right = (double)(col + 1) * width / grid.nLon;
+        for (int x = (int)std::floor(left); x < std::min((int)std::ceil(right), width); ++x) {
+            const double overlap = std::min(x + 1.0, right) - std::max((double)x, left);
+            if (overlap > 0.0) colOverlaps[col].push_back(Overlap{x, overlap});
+        }
+    }
+
+    threadPool().parallelFor(0, grid.nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            for (int col = 0; col < grid.nLon; ++col) {
+                double area[3] = {0.0, 0.0, 0.0}, albedoSum = 0.0, total = 0.0;
+                for (const Overlap &rowOverlap : rowOverlaps[row]) {
+                    const unsigned char *line = pixels + (size_t)rowOverlap.pixel * width * channels;
+                    for (const Overlap &colOverlap : colOverlaps[col]) {
+                        const unsigned char *pix = line + (size_t)colOverlap.pixel * channels;
+                        float albedo;
+                        const SurfaceType type = classifyPixel(pix[0], pix[1], pix[2], albedo);
+                        const double weight = rowOverlap.weight * colOverlap.weight;
+                        area[(int)type] += weight;
+                        albedoSum += weight * albedo;
+                        total += weight;
+                    }
+                }
+                if (total <= 0.0) continue;
+                const size_t idx = (size_t)row * grid.nLon + col;
+                mask.type[idx] = (unsigned char)(std::max_element(area, area + 3) - area);
+                mask.albedo[idx] = (unsigned char)std::lround(std::min(std::max(albedoSum / total, 0.0), 1.0) * 255.0);
+            }
+        }
+    }, 4);
+    return mask;
+}
+
+SurfaceMask loadSurfaceMask(const LatLonGrid &grid, const std::string &basemap, const std::string &cacheFile) {
+    const std::string cachePath = cacheFile.empty() ? defaultCachePath(grid, basemap) : cacheFile;
+    std::error_code error;
+    MaskHeader header{};
+    std::memcpy(header.magic, maskMagic, sizeof(maskMagic));
+    header.version = maskVersion;
+    header.nLat = grid.nLat;
+    header.nLon = grid.nLon;
+    header.firstLatitude = grid.latitudes.empty() ? 0.0 : grid.latitudes[0];
+    header.basemapBytes = std::filesystem::file_size(basemap, error);
+    if (error) header.basemapBytes = 0;
+    header.basemapTime = std::filesystem::last_write_time(basemap, error).time_since_epoch().count();
+    if (error) header.basemapTime = 0;
+
+    SurfaceMask mask;
+    if (readMask(cachePath, header, mask)) return mask;
+
+    int width, height, nrChannels;
+    unsigned char *pixels = stbi_load(basemap.c_str(), &width, &height, &nrChannels, STBI_rgb);
+    if (!pixels) {
+        std::cout << "Failed to load surface basemap " << basemap << std::endl;
+        return mask;
+    }
+    mask = classifySurface(pixels, width, height, STBI_rgb, grid);
+    stbi_image_free(pixels);
+
+    std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+    file.write((const char *)&header, sizeof(header));
+    file.write((const char *)mask.type.data(), mask.type.size());
+    file.write((const char *)mask.albedo.data(), mask.albedo.size());
+    if (!file) std::cout << "Failed to cache surface mask to " << cachePath << std::endl;
+    return mask;
+}
+
+Field surfaceHeatCapacity(const SurfaceMask &mask, const SurfaceParams &params) {
+    Field capacity(mask.nLat, mask.nLon);
+    for (int row = 0; row < mask.nLat; ++row) {
+        for (int col = 0; col < mask.nLon; ++col) {
+            const SurfaceType type = mask.at(row, col);
+            capacity.at(row, col) = (float)(type == SurfaceType::Ocean ? params.oceanHeatCapacity
+                                             : type == SurfaceType::Land ? params.landHeatCapacity : params.iceHeatCapacity);
+        }
+    }
+    return capacity;
+}
+
+std::shared_ptr<const SurfaceProperties> surfaceProperties(const SurfaceMask &mask, const LatLonGrid &grid, const EnergyBalanceParams &params,
+                                                           const SurfaceParams &surfaceParams) {
+    if (mask.nLat != grid.nLat || mask.nLon != grid.nLon) {
+        std::cout << "Surface mask is " << mask.nLat << "x" << mask.nLon << ", not on the " << grid.nLat << "x" << grid.nLon << " grid" << std::endl;
+        return nullptr;
+    }
+    auto surface = std::make_shared<SurfaceProperties>();
+    const Field capacity = surfaceHeatCapacity(mask, surfaceParams);
+    surface->inverseHeatCapacity = Field(grid.nLat, grid.nLon);
+    surface->warmAlbedo = Field(grid.nLat, grid.nLon);
+    surface->minHeatCapacity = 1e300;
+    double meanAlbedo = 0.0;
+    for (int row = 0; row < grid.nLat; ++row) {
+        for (int col = 0; col < grid.nLon; ++col) {
+            surface->inverseHeatCapacity.at(row, col) = 1.0f / capacity.at(row, col);
+            surface->minHeatCapacity = std::min(surface->minHeatCapacity, (double)capacity.at(row, col));
+            meanAlbedo += mask.albedoAt(row, col) * grid.areaWeight[row];
+        }
+    }
+    for (int row = 0; row < grid.nLat; ++row) {
+        for (int col = 0; col < grid.nLon; ++col) {
+            const double albedo = params.warmAlbedo + mask.albedoAt(row, col) - meanAlbedo;
+            surface->warmAlbedo.at(row, col) = (float)std::min(std::max(albedo, 0.0), params.iceAlbedo);
+        }
+    }
+    return surface;
+}
+
+void benchmarkSurfaceMask() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "climate_surface_benchmark";
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+    std::filesystem::create_directories(directory, error);
+
+    // The real basemap when it is here, otherwise ocean with two continents and polar caps, written as a PPM
+    std::string basemap = defaultBasemap;
+    if (!std::filesystem::exists(basemap)) {
+        const int width = 2048, height = 1024;
+        basemap = (directory / "syntheticMap.ppm").string();
+        std::ofstream file(basemap, std::ios::binary);
+        file << "P6\n" << width << " " << height << "\n255\n";
+        std::vector<unsigned char> line(width * 3);
+        for (int y = 0; y < height; ++y) {
+            const double lat = 90.0 - (y + 0.5) * 180.0 / height;
+            for (int x = 0; x < width; ++x) {
+                const double lon = (x + 0.5) * 360.0 / width - 180.0;
+                unsigned char *pix = line.data() + x * 3;
+                if (std::abs(lat) > 70.0) {
+                    pix[0] = pix[1] = pix[2] = 235;
+                } else if (std::hypot(lon + 90.0, lat - 30.0) < 35.0 || std::hypot(lon - 30.0, lat) < 40.0) {
+                    pix[0] = 120 + (x + y) % 60;
+                    pix[1] = 110;
+                    pix[2] = 60;
+                } else {
+                    pix[0] = 20;
+                    pix[1] = 60;
+                    pix[2] = 140;
+                }
+            }
+            file.write((const char *)line.data(), line.size());
+        }
+    }
+
+    std::cout << "Surface mask benchmark on " << basemap << std::endl;
+    for (double resolution : {1.0, 0.25, 0.1}) {
+        const LatLonGrid grid = makeLatLonGrid(resolution);
+        const std::string cache = (directory / ("mask_" + std::to_string(grid.nLat) + ".bin")).string();
+        auto start = std::chrono::steady_clock::now();
+        SurfaceMask classified = loadSurfaceMask(grid, basemap, cache);
+        const double classifySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        SurfaceMask cached = loadSurfaceMask(grid, basemap, cache);
+        const double cachedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (classified.empty()) return;
+
+        double area[3] = {0.0, 0.0, 0.0};
+        for (int row = 0; row < grid.nLat; ++row) {
+            for (int col = 0; col < grid.nLon; ++col) area[(int)classified.at(row, col)] += grid.areaWeight[row];
+        }
+        const bool identical = cached.type == classified.type && cached.albedo == classified.albedo;
+        std::cout << "  " << std::defaultfloat << std::setprecision(6) << std::setw(4) << resolution << " deg " << grid.nLat << "x" << grid.nLon << std::fixed << std::setprecision(1)
+                  << "  classify " << std::setw(7) << classifySeconds * 1e3 << " ms  cached " << std::setw(6) << cachedSeconds * 1e3 << " ms ("
+                  << std::filesystem::file_size(cache, error) / 1024 << " KiB, " << (identical ? "identical" : "DIFFERENT") << ")  ocean "
+                  << area[0] * 100.0 << "% land " << area[1] * 100.0 << "% ice " << area[2] * 100.0 << "%" << std::endl;
+    }
+
+    // A month from 1 January on the 4 degree grid, the same timestep with and without the surface: the small heat
+    // capacity of the northern continents lets them cool several kelvin further than the ocean beside them
+    const LatLonGrid grid = makeLatLonGrid(4.0);
+    const SurfaceMask mask = loadSurfaceMask(grid, basemap, (directory / "mask_4deg.bin").string());
+    EnergyBalanceParams uniform, surfaced;
+    surfaced.surface = surfaceProperties(mask, grid, surfaced);
+    if (surfaced.surface) {
+        SimulationState start = createSimulation(4.0);
+        for (int row = 0; row < grid.nLat; ++row) {
+            const double sinLat = std::sin(grid.latitudes[row]);
+            std::fill(start.temperature.row(row), start.temperature.row(row) + grid.nLon, (float)(300.0 - 45.0 * sinLat * sinLat));
+        }
+        const double dt = stableTimestep(start, surfaced);
+        const int steps = (int)std::ceil(30.0 * 86400.0 / dt);
+        std::cout << "  4 deg, 30 days in " << steps << " steps of " << std::setprecision(1) << dt << " s (uniform alone allows "
+                  << stableTimestep(start, uniform) << " s)" << std::endl;
+        for (const EnergyBalanceParams *params : {&uniform, &surfaced}) {
+            SimulationState state = start;
+            for (int step = 0; step < steps; ++step) stepEnergyBalance(state, *params, dt);
+            // Area-weighted means of northern land and ocean cells
+            double sum[2] = {0.0, 0.0}, weight[2] = {0.0, 0.0};
+            for (int row = 0; row < grid.nLat / 2; ++row) {
+                for (int col = 0; col < grid.nLon; ++col) {
+                    const SurfaceType type = mask.at(row, col);
+                    if (type == SurfaceType::Ice) continue;
+                    sum[type == SurfaceType::Land] += state.temperature.at(row, col) * grid.areaWeight[row];
+                    weight[type == SurfaceType::Land] += grid.areaWeight[row];
+                }
+            }
+            const double ocean = sum[0] / weight[0], land = sum[1] / weight[1];
+            std::cout << "    " << (params->surface ? "surface" : "uniform") << "  mean " << std::setprecision(2) << globalMeanTemperature(state)
+                      << " K  northern ocean " << ocean << " K land " << land << " K (" << std::showpos << land - ocean << std::noshowpos << " K)" << std::endl;
+        }
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+    std::filesystem::remove_all(directory, error);
+}
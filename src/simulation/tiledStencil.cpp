@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <core/threadPool.h>
+#include <simulation/surfaceMask.h>
+#include <simulation/tiledStencil.h>
+
+namespace {
+
+// Floating-point operations of one cell update, counted from the row kernels
+constexpr double energyBalanceFlops = 24.0;
+constexpr double diffusionFlops = 12.0;
+// Bytes a one-step sweep must move per cell: one float read and one written
+constexpr double bytesPerCellStep = 8.0;
+
+// Tilings the autotuner times; every fused count divides the steps it times them over
+constexpr int candidateBandRows[] = {4, 8, 16, 32, 64};
+constexpr int candidateFusedSteps[] = {1, 2, 4, 8};
+constexpr int tuningSteps = 8;
+
+// fused steps of kernel(step, row, north, centre, south, out) from in to out, band by band. Step s of a band
+// produces its rows widened by fused - 1 - s on each side, so the last step produces exactly the band and every
+// earlier step holds the neighbours the next one reads. Poles take themselves as their outer neighbour.
+template <typename RowKernel>
+void sweepTiled(const Field &in, Field &out, int fused, int bandRows, const RowKernel &kernel) {
+    const int nLat = in.rows, stride = in.stride;
+    const int bands = (nLat + bandRows - 1) / bandRows;
+    threadPool().parallelFor(0, bands, [&](int bandBegin, int bandEnd) {
+        // Intermediate steps ping-pong between two buffers holding the band and its halo
+        const int span = bandRows + 2 * (fused - 1);
+        AlignedVector<float> buffers[2];
+        if (fused > 1) {
+            for (AlignedVector<float> &buffer : buffers) buffer.resize((size_t)span * stride);
+        }
+        for (int band = bandBegin; band < bandEnd; ++band) {
+            const int first = band * bandRows, last = std::min(first + bandRows, nLat);
+            const int base = first - (fused - 1); // Grid row held in buffer row 0
+            auto buffered = [&](int step, int row) { return buffers[step % 2].data() + (size_t)(row - base) * stride; };
+            for (int step = 0; step < fused; ++step) {
+                const int halo = fused - 1 - step;
+                const int rowBegin = std::max(first - halo, 0), rowEnd = std::min(last + halo, nLat);
+                for (int row = rowBegin; row < rowEnd; ++row) {
+                    const int north = std::max(row - 1, 0), south = std::min(row + 1, nLat - 1);
+                    float *target = step == fused - 1 ? out.row(row) : buffered(step, row);
+                    if (step == 0) {
+                        kernel(step, row, in.row(north), in.row(row), in.row(south), target);
+                    } else {
+                        kernel(step, row, buffered(step - 1, north), buffered(step - 1, row), buffered(step - 1, south), target);
+                    }
+                }
+            }
+        }
+    });
+}
+
+const char *operatorName(StencilOperator op) {
+    return op == StencilOperator::EnergyBalance ? "energyBalance" : "diffusion";
+}
+
+std::string tuningKey(StencilOperator op, const LatLonGrid &grid) {
+    std::ostringstream key;
+    key << operatorName(op) << ' ' << grid.nLat << ' ' << grid.nLon << ' ' << threadPool().size();
+    return key.str();
+}
+
+bool readTuning(const std::string &path, const std::string &key, StencilTiling &tiling) {
+    std::ifstream file(path);
+    std::string line;
+    bool found = false;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        int nLat, nLon, threads;
+        StencilTiling entry;
+        if (!(fields >> name >> nLat >> nLon >> threads >> entry.bandRows >> entry.fusedSteps)) continue;
+        std::ostringstream entryKey;
+        entryKey << name << ' ' << nLat << ' ' << nLon << ' ' << threads;
+        // Later lines win, so a re-tune only has to append
+        if (entryKey.str() == key && entry.bandRows > 0 && entry.fusedSteps > 0) {
+            tiling = entry;
+            found = true;
+        }
+    }
+    return found;
+}
+
+SimulationState tuningState(const LatLonGrid &grid) {
+    SimulationState state;
+    state.grid = grid;
+    state.temperature = Field(grid.nLat, grid.nLon);
+    state.scratch = Field(grid.nLat, grid.nLon);
+    for (int row = 0; row < grid.nLat; ++row) {
+        double sinLat = std::sin(grid.latitudes[row]);
+        for (int col = 0; col < grid.nLon; ++col) {
+            state.temperature.row(row)[col] = (float)(300.0 - 45.0 * sinLat * sinLat + 3.0 * std::cos(4.0 * col * 6.283185307179586 / grid.nLon));
+        }
+    }
+    return state;
+}
+
+void runTiled(StencilOperator op, SimulationState &state, const EnergyBalanceParams &params, double dt, int steps, const StencilTiling &tiling) {
+    if (op == StencilOperator::EnergyBalance) {
+        stepEnergyBalanceTiled(state, params, dt, steps, tiling);
+    } else {
+        applyDiffusionTiled(state, params, dt, steps, tiling);
+    }
+}
+
+double operatorTimestep(StencilOperator op, const SimulationState &state, const EnergyBalanceParams &params) {
+    return op == StencilOperator::EnergyBalance ? stableTimestep(state, params) : diffusionTimestep(state, params);
+}
+
+} // namespace
+
+void stepEnergyBalanceTiled(SimulationState &state, const EnergyBalanceParams &params, double dt, int steps, const StencilTiling &tiling) {
+    const LatLonGrid &grid = state.grid;
+    std::vector<double> times;
+    for (int done = 0; done < steps;) {
+        const int fused = std::min(std::max(tiling.fusedSteps, 1), steps - done);
+        // The clock advances by repeated addition, exactly as a run of stepEnergyBalance calls advances it
+        times.resize(fused);
+        for (int step = 0; step < fused; ++step) {
+            times[step] = state.time;
+            state.time += dt;
+        }
+        sweepTiled(state.temperature, state.scratch, fused, std::max(tiling.bandRows, 1),
+                   [&](int step, int row, const float *north, const float *centre, const float *south, float *out) {
+                       stepEnergyBalanceRow(grid, params, row, times[step], dt, north, centre, south, out);
+                   });
+        std::swap(state.temperature, state.scratch);
+        state.step += fused;
+        done += fused;
+    }
+}
+
+void applyDiffusionTiled(SimulationState &state, const EnergyBalanceParams &params, double dt, int steps, const StencilTiling &tiling) {
+    const LatLonGrid &grid = state.grid;
+    for (int done = 0; done < steps;) {
+        const int fused = std::min(std::max(tiling.fusedSteps, 1), steps - done);
+        sweepTiled(state.temperature, state.scratch, fused, std::max(tiling.bandRows, 1),
+                   [&](int, int row, const float *north, const float *centre, const float *south, float *out) {
+                       applyDiffusionRow(grid, params, row, dt, north, centre, south, out);
+                   });
+        std::swap(state.temperature, state.scratch);
+        done += fused;
+    }
+}
+
+std::string defaultStencilTuningFile() {
+    return basemapCachePath("stencilTuning.txt");
+}
+
+StencilTiling tunedTiling(StencilOperator op, const LatLonGrid &grid, const std::string &tuningFile) {
+    const std::string key = tuningKey(op, grid);
+    const std::string path = tuningFile.empty() ? defaultStencilTuningFile() : tuningFile;
+    StencilTiling tiling;
+    if (readTuning(path, key, tiling)) return tiling;
+
+    const EnergyBalanceParams params;
+    SimulationState state = tuningState(grid);
+    const double dt = operatorTimestep(op, state, params);
+    runTiled(op, state, params, dt, 1, StencilTiling());
+    double bestSeconds = 1e300;
+    StencilTiling best;
+    for (int bandRows : candidateBandRows) {
+        for (int fusedSteps : candidateFusedSteps) {
+            // More fused steps than band rows spends most of the time on the halo
+            if (fusedSteps > bandRows) continue;
+            StencilTiling candidate{bandRows, fusedSteps};
+            auto start = std::chrono::steady_clock::now();
+            runTiled(op, state, params, dt, tuningSteps, candidate);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (seconds < bestSeconds) {
+                bestSeconds = seconds;
+                best = candidate;
+            }
+        }
+    }
+
+    std::ofstream file(path, std::ios::app);
+    file << key << ' ' << best.bandRows << ' ' << best.fusedSteps << '\n';
+    if (!file) std::cout << "Failed to save stencil tuning to " << path << std::endl;
+    return best;
+}
+
+void benchmarkTiledStencils() {
+    const EnergyBalanceParams params;
+    const int steps = 16;
+    std::cout << "Tiled stencil benchmark (" << threadPool().size() << " threads), " << steps << " steps, tuning in " << defaultStencilTuningFile() << std::endl;
+    for (double resolution : {0.25, 0.1}) {
+        const LatLonGrid grid = makeLatLonGrid(resolution);
+        const double cells = (double)grid.nLat * grid.nLon;
+        for (StencilOperator op : {StencilOperator::EnergyBalance, StencilOperator::Diffusion}) {
+            auto start = std::chrono::steady_clock::now();
+            const StencilTiling tiling = tunedTiling(op, grid);
+            double tuneSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            SimulationState naive = tuningState(grid), tiled = naive;
+            const double dt = operatorTimestep(op, naive, params);
+            start = std::chrono::steady_clock::now();
+            for (int step = 0; step < steps; ++step) {
+                if (op == StencilOperator::EnergyBalance) {
+                    stepEnergyBalance(naive, params, dt);
+                } else {
+                    applyDiffusion(naive, params, dt);
+                }
+            }
+            double naiveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            start = std::chrono::steady_clock::now();
+            runTiled(op, tiled, params, dt, steps, tiling);
+            double tiledSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            bool identical = true;
+            for (int row = 0; row < grid.nLat && identical; ++row) {
+                identical = std::equal(naive.temperature.row(row), naive.temperature.row(row) + grid.nLon, tiled.temperature.row(row));
+            }
+            const double flops = op == StencilOperator::EnergyBalance ? energyBalanceFlops : diffusionFlops;
+            auto report = [&](const char *name, double seconds) {
+                std::cout << "    " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2) << std::setw(7)
+                          << bytesPerCellStep * cells * steps / seconds / 1e9 << " GB/s " << std::setw(7) << flops * cells * steps / seconds / 1e9
+                          << " GFLOP/s" << std::endl;
+            };
+            std::cout << "  " << resolution << " deg " << grid.nLat << "x" << grid.nLon << " " << operatorName(op) << ": " << tiling.bandRows
+                      << " rows x " << tiling.fusedSteps << " steps per tile (" << std::setprecision(2) << std::fixed << tuneSeconds << " s to tune or load), "
+                      << std::setprecision(2) << naiveSeconds / tiledSeconds << "x, " << (identical ? "identical to" : "DIFFERS from") << " the naive sweep"
+                      << std::endl;
+            report("naive", naiveSeconds);
+            report("tiled", tiledSeconds);
+        }
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include <core/threadPool.h>
+#include <simulation/verticalDiffusion.h>
+
+// Columns eliminated together. Several vectors wide, so every equation row is read as a run of whole cache lines
+// rather than one line from each of dozens of rows spread far apart in memory.
+constexpr int tridiagonalChunk = 8 * columnBlock;
+
+namespace {
+
+// Thomas elimination of the width systems starting at column first, every lane in step. width is a whole number of
+// columnBlock vectors, so it stays within the padded rows. Equations past a lane's length become x = x, so short
+// columns and the padding past the last column need no separate path.
+void solveChunk(const TridiagonalBatch &batch, float *values, size_t valueStride, int first, int width, float *modified) {
+    const int layers = batch.layers;
+    alignas(fieldAlignment) int length[tridiagonalChunk];
+    for (int lane = 0; lane < width; ++lane) {
+        const int col = first + lane;
+        length[lane] = col < batch.columns ? (batch.lengths.empty() ? layers : batch.lengths[col]) : 0;
+    }
+
+    {
+        const float *diagonal = batch.diagonal.row(0) + first, *upper = batch.upper.row(0) + first;
+        float *x = values + first;
+        for (int lane = 0; lane < width; ++lane) {
+            const float inverse = 1.0f / (0 < length[lane] ? diagonal[lane] : 1.0f);
+            modified[lane] = 1 < length[lane] ? upper[lane] * inverse : 0.0f;
+            x[lane] *= inverse;
+        }
+    }
+    for (int layer = 1; layer < layers; ++layer) {
+        const float *lower = batch.lower.row(layer) + first, *diagonal = batch.diagonal.row(layer) + first, *upper = batch.upper.row(layer) + first;
+        const float *previousModified = modified + (size_t)(layer - 1) * tridiagonalChunk;
+        float *currentModified = modified + (size_t)layer * tridiagonalChunk;
+        const float *previous = values + (size_t)(layer - 1) * valueStride + first;
+        float *x = values + (size_t)layer * valueStride + first;
+        for (int lane = 0; lane < width; ++lane) {
+            const bool active = layer < length[lane];
+            const float a = active ? lower[lane] : 0.0f, b = active ? diagonal[lane] : 1.0f, c = layer + 1 < length[lane] ? upper[lane] : 0.0f;
+            const float inverse = 1.0f / (b - a * previousModified[lane]);
+            currentModified[lane] = c * inverse;
+            x[lane] = (x[lane] - a * previous[lane]) * inverse;
+        }
+    }
+    for (int layer = layers - 2; layer >= 0; --layer) {
+        const float *currentModified = modified + (size_t)layer * tridiagonalChunk;
+        const float *below = values + (size_t)(layer + 1) * valueStride + first;
+        float *x = values + (size_t)layer * valueStride + first;
+        for (int lane = 0; lane < width; ++lane) x[lane] -= currentModified[lane] * below[lane];
+    }
+}
+
+// Exchange rate between layer - 1 and layer (s^-1); zero at the top and at the surface, which no heat crosses
+double interfaceRate(const VerticalDiffusionParams &params, int layers, int layer) {
+    if (layer <= 0 || layer >= layers) return 0.0;
+    const double thickness = params.surfacePressure / layers;
+    const double aboveSurface = params.surfacePressure - layer * thickness;
+    const double diffusivity = params.freeDiffusivity + (params.boundaryDiffusivity - params.freeDiffusivity) * std::exp(-aboveSurface / params.boundaryLayerDepth);
+    return diffusivity / (thickness * thickness);
+}
+
+// Backward Euler coefficients of every layer, the same for each of columns columns
+TridiagonalBatch diffusionBatch(const VerticalDiffusionParams &params, int layers, int columns, double dt) {
+    TridiagonalBatch batch = makeTridiagonalBatch(layers, columns);
+    for (int layer = 0; layer < layers; ++layer) {
+        const float above = (float)(dt * interfaceRate(params, layers, layer)), below = (float)(dt * interfaceRate(params, layers, layer + 1));
+        std::fill(batch.lower.row(layer), batch.lower.row(layer) + batch.lower.stride, -above);
+        std::fill(batch.diagonal.row(layer), batch.diagonal.row(layer) + batch.diagonal.stride, 1.0f + above + below);
+        std::fill(batch.upper.row(layer), batch.upper.row(layer) + batch.upper.stride, -below);
+    }
+    return batch;
+}
+
+// Coefficients of one column of the batched step, so the baselines agree with it bit for bit
+struct ColumnCoefficients {
+    std::vector<float> lower;
+    std::vector<float> diagonal;
+    std::vector<float> upper;
+};
+
+ColumnCoefficients columnCoefficients(const VerticalDiffusionParams &params, int layers, double dt) {
+    const TridiagonalBatch batch = diffusionBatch(params, layers, 1, dt);
+    ColumnCoefficients coefficients{std::vector<float>(layers), std::vector<float>(layers), std::vector<float>(layers)};
+    for (int layer = 0; layer < layers; ++layer) {
+        coefficients.lower[layer] = batch.lower.at(layer, 0);
+        coefficients.diagonal[layer] = batch.diagonal.at(layer, 0);
+        coefficients.upper[layer] = batch.upper.at(layer, 0);
+    }
+    return coefficients;
+}
+
+// The same step one column at a time, each column's layers contiguous in columns (column-major), as a baseline
+void diffuseContiguousColumns(std::vector<float> &columns, int layers, const VerticalDiffusionParams &params, double dt) {
+    const ColumnCoefficients c = columnCoefficients(params, layers, dt);
+    const int count = (int)(columns.size() / layers);
+    threadPool().parallelFor(0, count, [&](int columnBegin, int columnEnd) {
+        std::vector<float> modified(layers);
+        for (int column = columnBegin; column < columnEnd; ++column) {
+            solveTridiagonalColumn(c.lower.data(), c.diagonal.data(), c.upper.data(), columns.data() + (size_t)column * layers, modified.data(), layers);
+        }
+    }, 256);
+}
+
+// The same step one column at a time in place: gather the column from the layer rows, solve, scatter it back
+void diffuseColumns(ColumnAtmosphere &atmosphere, int nLat, int nLon, const VerticalDiffusionParams &params, double dt) {
+    const int layers = atmosphere.layers;
+    const ColumnCoefficients c = columnCoefficients(params, layers, dt);
+    const std::vector<float> &lower = c.lower, &diagonal = c.diagonal, &upper = c.upper;
+    threadPool().parallelFor(0, nLat, [&](int rowBegin, int rowEnd) {
+        std::vector<float> column(layers), modified(layers);
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            for (int col = 0; col < nLon; ++col) {
+                for (int layer = 0; layer < layers; ++layer) column[layer] = atmosphere.layerRow(row, layer)[col];
+                solveTridiagonalColumn(lower.data(), diagonal.data(), upper.data(), column.data(), modified.data(), layers);
+                for (int layer = 0; layer < layers; ++layer) atmosphere.layerRow(row, layer)[col] = column[layer];
+            }
+        }
+    }, 4);
+}
+
+} // namespace
+
+TridiagonalBatch makeTridiagonalBatch(int layers, int columns) {
+    TridiagonalBatch batch;
+    batch.layers = layers;
+    batch.columns = columns;
+    batch.lower = Field(layers, columns);
+    batch.diagonal = Field(layers, columns);
+    batch.upper = Field(layers, columns);
+    return batch;
+}
+
+void solveTridiagonalBatch(const TridiagonalBatch &batch, float *values, size_t valueStride) {
+    if (batch.layers <= 0 || batch.columns <= 0) return;
+    const int chunks = (batch.columns + tridiagonalChunk - 1) / tridiagonalChunk;
+    threadPool().parallelFor(0, chunks, [&](int chunkBegin, int chunkEnd) {
+        AlignedVector<float> modified((size_t)batch.layers * tridiagonalChunk);
+        for (int chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+            const int first = chunk * tridiagonalChunk;
+            const int width = std::min(tridiagonalChunk, (batch.columns - first + columnBlock - 1) / columnBlock * columnBlock);
+            solveChunk(batch, values, valueStride, first, width, modified.data());
+        }
+    }, 2);
+}
+
+void solveTridiagonalBatch(const TridiagonalBatch &batch, Field &values) {
+    solveTridiagonalBatch(batch, values.data.data(), values.stride);
+}
+
+void solveTridiagonalColumn(const float *lower, const float *diagonal, const float *upper, float *values, float *modified, int length) {
+    if (length <= 0) return;
+    float inverse = 1.0f / diagonal[0];
+    modified[0] = length > 1 ? upper[0] * inverse : 0.0f;
+    values[0] *= inverse;
+    for (int k = 1; k < length; ++k) {
+        inverse = 1.0f / (diagonal[k] - lower[k] * modified[k - 1]);
+        modified[k] = k + 1 < length ? upper[k] * inverse : 0.0f;
+        values[k] = (values[k] - lower[k] * values[k - 1]) * inverse;
+    }
+    for (int k = length - 2; k >= 0; --k) values[k] -= modified[k] * values[k + 1];
+}
+
+void applyVerticalDiffusion(ColumnAtmosphere &atmosphere, const VerticalDiffusionParams &params, double dt) {
+    const int layers = atmosphere.layers;
+    if (layers < 2) return;
+    const int nLon = atmosphere.temperature.cols, nLat = atmosphere.temperature.rows / layers;
+    const TridiagonalBatch batch = diffusionBatch(params, layers, nLon, dt);
+    // Rows go over the pool; the solve inside each runs inline on its thread
+    threadPool().parallelFor(0, nLat, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) solveTridiagonalBatch(batch, atmosphere.layerRow(row, 0), atmosphere.temperature.stride);
+    }, 4);
+}
+
+void addVerticalDiffusionComponent(Scheduler &scheduler, std::shared_ptr<ColumnAtmosphere> atmosphere, const VerticalDiffusionParams &params, int interval) {
+    PhysicsComponent component;
+    component.name = "verticalDiffusion";
+    component.step = [atmosphere, params](SimulationState &, double dt) { applyVerticalDiffusion(*atmosphere, params, dt); };
+    component.interval = interval;
+    component.after = std::vector<std::string>{columnRadiationName};
+    scheduler.addComponent(component);
+}
+
+void benchmarkVerticalDiffusion() {
+    std::cout << "Vertical diffusion benchmark (" << threadPool().size() << " threads), " << tridiagonalChunk << " columns per chunk" << std::endl;
+
+    // General systems: diagonally dominant, different in every column, and a quarter of the columns cut short
+    const int columns = 360 * 180;
+    for (int layers : columnLayerCounts) {
+        TridiagonalBatch batch = makeTridiagonalBatch(layers, columns);
+        batch.lengths.resize(columns);
+        Field rhs(layers, columns);
+        std::vector<float> lower((size_t)columns * layers), diagonal(lower.size()), upper(lower.size()), reference(lower.size());
+        for (int col = 0; col < columns; ++col) {
+            batch.lengths[col] = col % 4 == 3 ? layers - 1 - col % (layers / 2) : layers;
+            for (int layer = 0; layer < layers; ++layer) {
+                const float a = -0.5f - 0.4f * std::sin(0.37f * col + layer), c = -0.5f - 0.4f * std::cos(0.11f * col + 3 * layer);
+                const float b = 1.1f - a - c, d = 250.0f + 30.0f * std::sin(0.01f * col) + layer;
+                batch.lower.at(layer, col) = a;
+                batch.diagonal.at(layer, col) = b;
+                batch.upper.at(layer, col) = c;
+                rhs.at(layer, col) = d;
+                const size_t idx = (size_t)col * layers + layer;
+                lower[idx] = a;
+                diagonal[idx] = b;
+                upper[idx] = c;
+                reference[idx] = d;
+            }
+        }
+        const int repeats = std::max(2, 512 / layers);
+        double batchedSeconds = 0.0, scalarSeconds = 0.0;
+        Field solution;
+        std::vector<float> solved;
+        for (int repeat = 0; repeat < repeats; ++repeat) {
+            solution = rhs;
+            auto start = std::chrono::steady_clock::now();
+            solveTridiagonalBatch(batch, solution);
+            batchedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            solved = reference;
+            start = std::chrono::steady_clock::now();
+            threadPool().parallelFor(0, columns, [&](int colBegin, int colEnd) {
+                std::vector<float> modified(layers);
+                for (int col = colBegin; col < colEnd; ++col) {
+                    const size_t offset = (size_t)col * layers;
+                    solveTridiagonalColumn(&lower[offset], &diagonal[offset], &upper[offset], &solved[offset], modified.data(), batch.lengths[col]);
+                }
+            }, 256);
+            scalarSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        float maxDifference = 0.0f;
+        for (int col = 0; col < columns; ++col) {
+            for (int layer = 0; layer < layers; ++layer) {
+                maxDifference = std::max(maxDifference, std::abs(solution.at(layer, col) - solved[(size_t)col * layers + layer]));
+            }
+        }
+        std::cout << "  " << std::setw(2) << layers << " layers  batched " << std::fixed << std::setprecision(2) << std::setw(8)
+                  << columns * repeats / batchedSeconds / 1e6 << " Mcolumns/s  per column " << std::setw(8) << columns * repeats / scalarSeconds / 1e6
+                  << " Mcolumns/s  (" << scalarSeconds / batchedSeconds << "x)  max difference " << std::scientific << std::setprecision(1)
+                  << maxDifference << std::endl;
+    }
+
+    // Implicit mixing of a whole 0.25 degree atmosphere, an hour a step
+    const double resolution = 0.25, dt = 3600.0;
+    const int layers = 32, steps = 4;
+    const VerticalDiffusionParams params;
+    SimulationState state = createSimulation(resolution);
+    for (int row = 0; row < state.grid.nLat; ++row) {
+        const double sinLat = std::sin(state.grid.latitudes[row]);
+        std::fill(state.temperature.row(row), state.temperature.row(row) + state.grid.nLon, (float)(300.0 - 45.0 * sinLat * sinLat));
+    }
+    ColumnAtmosphere batched, reference;
+    initializeColumnAtmosphere(batched, state, layers);
+    reference = batched;
+    const int nLat = state.grid.nLat, nLon = state.grid.nLon;
+    // Contiguous baseline: the layers copied column-major outside the timing, so it pays no strided gather
+    std::vector<float> columnMajor((size_t)nLat * nLon * layers);
+    for (int row = 0; row < nLat; ++row) {
+        for (int layer = 0; layer < layers; ++layer) {
+            const float *values = batched.layerRow(row, layer);
+            for (int col = 0; col < nLon; ++col) columnMajor[((size_t)row * nLon + col) * layers + layer] = values[col];
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step) applyVerticalDiffusion(batched, params, dt);
+    const double batchedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step) diffuseContiguousColumns(columnMajor, layers, params, dt);
+    const double contiguousSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step) diffuseColumns(reference, nLat, nLon, params, dt);
+    const double gatheredSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    float maxDifference = 0.0f;
+    for (int row = 0; row < nLat; ++row) {
+        for (int layer = 0; layer < layers; ++layer) {
+            const float *values = batched.layerRow(row, layer), *gathered = reference.layerRow(row, layer);
+            for (int col = 0; col < nLon; ++col) {
+                maxDifference = std::max(maxDifference, std::abs(values[col] - gathered[col]));
+                maxDifference = std::max(maxDifference, std::abs(values[col] - columnMajor[((size_t)row * nLon + col) * layers + layer]));
+            }
+        }
+    }
+    const double columnSteps = (double)nLat * nLon * steps;
+    std::cout << "  " << std::defaultfloat << std::setprecision(6) << resolution << " deg, " << layers << " layers, " << nLat * nLon << " columns: batched " << std::fixed
+              << std::setprecision(2) << columnSteps / batchedSeconds / 1e6 << " Mcolumns/s  per contiguous column " << columnSteps / contiguousSeconds / 1e6
+              << " Mcolumns/s (" << contiguousSeconds / batchedSeconds << "x)  per column gathered from the layer rows " << columnSteps / gatheredSeconds / 1e6
+              << " Mcolumns/s (" << gatheredSeconds / batchedSeconds << "x)  max difference " << std::scientific << std::setprecision(1) << maxDifference << " K"
+              << std::endl;
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cmath>
+
+#include <core/spatialIndex.h>
+
+constexpr double spatialDegToRad = 3.14159265358979323846 / 180.0;
+
+glm::dvec3 coordsToUnitVector(Coords coords) {
+    double lat = coords.latitude * spatialDegToRad, lon = coords.longitude * spatialDegToRad;
+    return glm::dvec3(std::cos(lat) * std::cos(lon), std::cos(lat) * std::sin(lon), std::sin(lat));
+}
+
+SphericalKdTree::SphericalKdTree(const std::vector<Coords> &coords) {
+    nodes.resize(coords.size());
+    for (size_t i = 0; i < coords.size(); ++i) {
+        nodes[i].pos = coordsToUnitVector(coords[i]);
+        nodes[i].index = (int)i;
+        nodes[i].axis = 0;
+    }
+    build(0, (int)nodes.size());
+}
+
+size_t SphericalKdTree::size() const {
+    return nodes.size();
+}
+
+void SphericalKdTree::build(int begin, int end) {
+    if (end - begin <= 1) return;
+    // Split along the axis with the widest spread
+    double lo[3] = {2.0, 2.0, 2.0}, hi[3] = {-2.0, -2.0, -2.0};
+    for (int i = begin; i < end; ++i) {
+        for (int d = 0; d < 3; ++d) {
+            lo[d] = std::min(lo[d], nodes[i].pos[d]);
+            hi[d] = std::max(hi[d], nodes[i].pos[d]);
+        }
+    }
+    int axis = 0;
+    for (int d = 1; d < 3; ++d) {
+        if (hi[d] - lo[d] > hi[axis] - lo[axis]) axis = d;
+    }
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(nodes.begin() + begin, nodes.begin() + mid, nodes.begin() + end,
+        [axis](const Node &a, const Node &b) { return a.pos[axis] < b.pos[axis]; });
+    nodes[mid].axis = axis;
+    build(begin, mid);
+    build(mid + 1, end);
+}
+
+void SphericalKdTree::search(int begin, int end, const glm::dvec3 &query, int k, std::vector<std::pair<double, int>> &heap) const {
+    if (begin >= end) return;
+    int mid = begin + (end - begin) / 2;
+    const Node &node = nodes[mid];
+    glm::dvec3 offset = node.pos - query;
+    double distance = glm::dot(offset, offset);
+    if ((int)heap.size() < k) {
+        heap.emplace_back(distance, node.index);
+        std::push_heap(heap.begin(), heap.end());
+    } else if (distance < heap.front().first) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = {distance, node.index};
+        std::push_heap(heap.begin(), heap.end());
+    }
+    if (end - begin == 1) return;
+    double split = query[node.axis] - node.pos[node.axis];
+    bool leftFirst = split < 0.0;
+    search(leftFirst ? begin : mid + 1, leftFirst ? mid : end, query, k, heap);
+    // Only cross the splitting plane when it is closer than the current k-th neighbour
+    if ((int)heap.size() < k || split * split < heap.front().first) {
+        search(leftFirst ? mid + 1 : begin, leftFirst ? end : mid, query, k, heap);
+    }
+}
+
+void SphericalKdTree::nearest(const glm::dvec3 &query, int k, std::vector<int> &indices, std::vector<double> &chordsSquared) const {
+    // Reused per thread so row-parallel queries don't allocate
+    thread_local std::vector<std::pair<double, int>> heap;
+    heap.clear();
+    search(0, (int)nodes.size(), query, k, heap);
+    std::sort_heap(heap.begin(), heap.end());
+    indices.resize(heap.size());
+    chordsSquared.resize(heap.size());
+    for (size_t i = 0; i < heap.size(); ++i) {
+        chordsSquared[i] = heap[i].first;
+        indices[i] = heap[i].second;
+    }
+}
+
+void SphericalKdTree::nearest(Coords coords, int k, std::vector<int> &indices, std::vector<double> &chordsSquared) const {
+    nearest(coordsToUnitVector(coords), k, indices, chordsSquared);
+}
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <random>
+#include <utility>
+
+#include <core/sphericalDelaunay.h>
+
+// Below this a point is treated as lying on a triangle's circumcircle (or on one of its corners)
+constexpr double delaunayEpsilon = 1e-15;
+
+SphericalDelaunay::SphericalDelaunay(const std::vector<glm::dvec3> &points) : vertices(points), numPoints((int)points.size()) {
+    // Octahedron seed: one face per octant, wound counter-clockwise from outside
+    const glm::dvec3 axes[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    for (const auto &axis : axes) vertices.push_back(axis);
+    for (int octant = 0; octant < 8; ++octant) {
+        int x = numPoints + ((octant & 1) ? 1 : 0), y = numPoints + ((octant & 2) ? 3 : 2), z = numPoints + ((octant & 4) ? 5 : 4);
+        Triangle triangle;
+        bool positive = glm::dot(glm::cross(vertices[x], vertices[y]), vertices[z]) > 0.0;
+        triangle.corner[0] = x;
+        triangle.corner[1] = positive ? y : z;
+        triangle.corner[2] = positive ? z : y;
+        triangles.push_back(triangle);
+    }
+    std::map<std::pair<int, int>, std::pair<int, int>> edges;
+    for (int t = 0; t < (int)triangles.size(); ++t) {
+        for (int i = 0; i < 3; ++i) edges[{triangles[t].corner[(i + 1) % 3], triangles[t].corner[(i + 2) % 3]}] = {t, i};
+    }
+    for (int t = 0; t < (int)triangles.size(); ++t) {
+        for (int i = 0; i < 3; ++i) triangles[t].adjacent[i] = edges[{triangles[t].corner[(i + 2) % 3], triangles[t].corner[(i + 1) % 3]}].first;
+    }
+
+    // Biased randomised insertion order: rounds of doubling size keep the expected cavity size constant,
+    // and a snake through latitude bands within each round keeps the point location walks short
+    std::vector<int> order(numPoints);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(12345));
+    for (int roundBegin = 0, roundSize = 64; roundBegin < numPoints; roundBegin += roundSize, roundSize *= 2) {
+        int roundEnd = std::min(roundBegin + roundSize, numPoints);
+        int bands = std::max(1, (int)std::sqrt((roundEnd - roundBegin) / 2.0));
+        auto key = [&](int vertex) {
+            const glm::dvec3 &v = vertices[vertex];
+            int band = std::min((int)((v.z + 1.0) * 0.5 * bands), bands - 1);
+            double lon = std::atan2(v.y, v.x);
+            return std::make_pair(band, band % 2 ? -lon : lon);
+        };
+        std::sort(order.begin() + roundBegin, order.begin() + roundEnd, [&](int a, int b) { return key(a) < key(b); });
+    }
+    for (int vertex : order) insert(vertex);
+}
+
+int SphericalDelaunay::auxiliaryBegin() const {
+    return numPoints;
+}
+
+int SphericalDelaunay::numVertices() const {
+    return (int)vertices.size();
+}
+
+bool SphericalDelaunay::inCircumcircle(const Triangle &triangle, const glm::dvec3 &point) const {
+    // On the sphere the circumcircle test is whether the point sees the triangle's plane from outside
+    const glm::dvec3 &a = vertices[triangle.corner[0]], &b = vertices[triangle.corner[1]], &c = vertices[triangle.corner[2]];
+    return glm::dot(glm::cross(b - a, c - a), point - a) > delaunayEpsilon;
+}
+
+int SphericalDelaunay::locate(const glm::dvec3 &point, int start) const {
+    int current = (start >= 0 && start < (int)triangles.size() && triangles[start].corner[0] >= 0) ? start : -1;
+    if (current < 0) {
+        for (current = 0; triangles[current].corner[0] < 0; ++current);
+    }
+    // Walk towards the point, crossing any edge it lies beyond; rotating the first edge tested avoids cycles
+    const int maxSteps = 4 * (int)triangles.size() + 16;
+    for (int step = 0; step < maxSteps; ++step) {
+        const Triangle &triangle = triangles[current];
+        int next = -1;
+        for (int e = 0; e < 3 && next < 0; ++e) {
+            int i = (e + step) % 3;
+            const glm::dvec3 &a = vertices[triangle.corner[(i + 1) % 3]], &b = vertices[triangle.corner[(i + 2) % 3]];
+            if (glm::dot(glm::cross(a, b), point) < 0.0) next = triangle.adjacent[i];
+        }
+        if (next < 0) return current;
+        current = next;
+    }
+    // Numerical trouble; fall back to the triangle the point is least outside of
+    int best = current;
+    double bestScore = -1e300;
+    for (int t = 0; t < (int)triangles.size(); ++t) {
+        if (triangles[t].corner[0] < 0) continue;
+        double score = 1e300;
+        for (int i = 0; i < 3; ++i) {
+            score = std::min(score, glm::dot(glm::cross(vertices[triangles[t].corner[(i + 1) % 3]], vertices[triangles[t].corner[(i + 2) % 3]]), point));
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            best = t;
+        }
+    }
+    return best;
+}
+
+void SphericalDelaunay::cavity(const glm::dvec3 &point, int start, std::vector<int> &found) const {
+    found.assign(1, start);
+    for (size_t next = 0; next < found.size(); ++next) {
+        for (int neighbour : triangles[found[next]].adjacent) {
+            if (std::find(found.begin(), found.end(), neighbour) != found.end()) continue;
+            if (inCircumcircle(triangles[neighbour], point)) found.push_back(neighbour);
+        }
+    }
+}
+
+void SphericalDelaunay::insert(int vertex) {
+    const glm::dvec3 &point = vertices[vertex];
+    int start = locate(point, lastTriangle);
+    for (int corner : triangles[start].corner) {
+        glm::dvec3 offset = vertices[corner] - point;
+        if (glm::dot(offset, offset) < delaunayEpsilon) return;
+    }
+    if (!inCircumcircle(triangles[start], point)) return;
+
+    std::vector<int> found;
+    cavity(point, start, found);
+    // Horizon edges of the cavity, each with the surviving triangle beyond it
+    struct HorizonEdge {
+        int from;
+        int to;
+        int outside;
+    };
+    std::vector<HorizonEdge> horizon;
+    for (int t : found) {
+        for (int i = 0; i < 3; ++i) {
+            int neighbour = triangles[t].adjacent[i];
+            if (std::find(found.begin(), found.end(), neighbour) != found.end()) continue;
+            horizon.push_back({triangles[t].corner[(i + 1) % 3], triangles[t].corner[(i + 2) % 3], neighbour});
+        }
+    }
+    for (int t : found) {
+        triangles[t].corner[0] = -1;
+        freeTriangles.push_back(t);
+    }
+
+    // Fan the horizon around the new vertex
+    std::vector<std::pair<int, int>> created; // Horizon start vertex, new triangle
+    for (const auto &edge : horizon) {
+        int t;
+        if (!freeTriangles.empty()) {
+            t = freeTriangles.back();
+            freeTriangles.pop_back();
+        } else {
+            t = (int)triangles.size();
+            triangles.emplace_back();
+        }
+        triangles[t] = Triangle{{edge.from, edge.to, vertex}, {-1, -1, edge.outside}};
+        Triangle &outside = triangles[edge.outside];
+        for (int j = 0; j < 3; ++j) {
+            if (outside.corner[(j + 1) % 3] == edge.to && outside.corner[(j + 2) % 3] == edge.from) outside.adjacent[j] = t;
+        }
+        created.emplace_back(edge.from, t);
+    }
+    for (const auto &entry : created) {
+        Triangle &triangle = triangles[entry.second];
+        for (const auto &other : created) {
+            if (other.first != triangle.corner[1]) continue;
+            triangle.adjacent[0] = other.second;
+            triangles[other.second].adjacent[1] = entry.second;
+            break;
+        }
+    }
+    lastTriangle = created.front().second;
+}
+
+void SphericalDelaunay::naturalNeighbours(const glm::dvec3 &query, std::vector<int> &neighbours, std::vector<double> &weights, int &hint) const {
+    neighbours.clear();
+    weights.clear();
+    int start = locate(query, hint >= 0 ? hint : lastTriangle);
+    hint = start;
+    for (int corner : triangles[start].corner) {
+        glm::dvec3 offset = vertices[corner] - query;
+        if (glm::dot(offset, offset) < delaunayEpsilon) {
+            neighbours.push_back(corner);
+            weights.push_back(1.0);
+            return;
+        }
+    }
+
+    thread_local std::vector<int> found;
+    cavity(query, start, found);
+    // Each horizon edge (a, b) would become the triangle (a, b, query), whose circumcentre is a Voronoi
+    // vertex of the query's cell. A neighbour's shared Voronoi edge joins the circumcentres of its two edges.
+    thread_local std::vector<glm::dvec3> leaving, arriving;
+    leaving.clear();
+    arriving.clear();
+    for (int t : found) {
+        const Triangle &triangle = triangles[t];
+        for (int i = 0; i < 3; ++i) {
+            if (std::find(found.begin(), found.end(), triangle.adjacent[i]) != found.end()) continue;
+            int from = triangle.corner[(i + 1) % 3], to = triangle.corner[(i + 2) % 3];
+            glm::dvec3 centre = glm::normalize(glm::cross(vertices[to] - vertices[from], query - vertices[from]));
+            for (int vertex : {from, to}) {
+                auto existing = std::find(neighbours.begin(), neighbours.end(), vertex);
+                size_t slot = existing - neighbours.begin();
+                if (existing == neighbours.end()) {
+                    neighbours.push_back(vertex);
+                    leaving.resize(neighbours.size());
+                    arriving.resize(neighbours.size());
+                }
+                (vertex == from ? leaving : arriving)[slot] = centre;
+            }
+        }
+    }
+    double total = 0.0;
+    for (size_t n = 0; n < neighbours.size(); ++n) {
+        const glm::dvec3 &vertex = vertices[neighbours[n]];
+        double edgeLength = std::atan2(glm::length(glm::cross(leaving[n], arriving[n])), glm::dot(leaving[n], arriving[n]));
+        double distance = std::atan2(glm::length(glm::cross(vertex, query)), glm::dot(vertex, query));
+        weights.push_back(edgeLength / std::max(distance, 1e-12));
+        total += weights.back();
+    }
+    for (auto &weight : weights) weight /= total;
+}
\ No newline at end of file
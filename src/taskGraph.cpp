@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include <core/taskGraph.h>
+
+// Set while a task runs so a graph run from inside it runs inline instead of waiting on its own scheduler
+thread_local bool insideTaskScheduler = false;
+
+struct TaskScheduler::Run {
+    TaskGraph &graph;
+    std::vector<std::atomic<int>> waiting; // Unfinished predecessors of each task
+    std::atomic<int> remaining;
+    std::atomic<long long> order{0};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    explicit Run(TaskGraph &graph) : graph(graph), waiting(graph.tasks.size()), remaining((int)graph.tasks.size()) {
+        for (size_t task = 0; task < graph.tasks.size(); ++task) waiting[task] = graph.tasks[task].predecessors;
+    }
+};
+
+namespace {
+
+// Highest priority first; among equals the newest for the list's owner and the oldest for a thief
+template <typename Ready>
+bool takeReady(std::vector<Ready> &tasks, bool owner, Ready &taken) {
+    if (tasks.empty()) return false;
+    size_t best = 0;
+    for (size_t i = 1; i < tasks.size(); ++i) {
+        if (tasks[i].priority != tasks[best].priority) {
+            if (tasks[i].priority > tasks[best].priority) best = i;
+        } else if (owner == (tasks[i].order > tasks[best].order)) {
+            best = i;
+        }
+    }
+    taken = tasks[best];
+    tasks.erase(tasks.begin() + best);
+    return true;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+TaskGraph::TaskId TaskGraph::add(const std::string &name, std::function<void()> work, const std::vector<TaskId> &after, int priority,
+                                 TaskAffinity affinity) {
+    Task task;
+    task.name = name;
+    task.work = std::move(work);
+    task.priority = priority;
+    task.affinity = affinity;
+    tasks.push_back(std::move(task));
+    TaskId id = (TaskId)tasks.size() - 1;
+    for (TaskId prerequisite : after) precede(prerequisite, id);
+    return id;
+}
+
+void TaskGraph::precede(TaskId prerequisite, TaskId task) {
+    tasks[prerequisite].successors.push_back(task);
+    ++tasks[task].predecessors;
+}
+
+bool TaskGraph::run() {
+    return run(taskScheduler());
+}
+
+bool TaskGraph::run(TaskScheduler &scheduler) {
+    // Kahn's algorithm up front: a cycle would otherwise leave the run waiting forever
+    std::vector<int> waiting(tasks.size());
+    std::vector<TaskId> order;
+    for (size_t task = 0; task < tasks.size(); ++task) {
+        waiting[task] = tasks[task].predecessors;
+        if (waiting[task] == 0) order.push_back((TaskId)task);
+    }
+    for (size_t i = 0; i < order.size(); ++i) {
+        for (TaskId successor : tasks[order[i]].successors) {
+            if (--waiting[successor] == 0) order.push_back(successor);
+        }
+    }
+    if (order.size() != tasks.size()) {
+        std::cout << "Task graph has a dependency cycle; nothing was run" << std::endl;
+        return false;
+    }
+
+    taskTimings.assign(tasks.size(), TaskTiming());
+    for (size_t task = 0; task < tasks.size(); ++task) taskTimings[task].name = tasks[task].name;
+    auto start = std::chrono::steady_clock::now();
+    if (insideTaskScheduler) {
+        // Nested inside a task: the workers are busy with the outer graph, so run in dependency order here
+        for (TaskId task : order) {
+            taskTimings[task].start = secondsSince(start);
+            tasks[task].work();
+            taskTimings[task].seconds = secondsSince(start) - taskTimings[task].start;
+        }
+    } else {
+        scheduler.execute(*this);
+    }
+    runSeconds = secondsSince(start);
+    return true;
+}
+
+double TaskGraph::criticalPathSeconds() const {
+    if (taskTimings.size() != tasks.size()) return 0.0;
+    // Finish time of the longest chain ending at each task, relaxed in dependency order
+    std::vector<int> waiting(tasks.size());
+    std::vector<double> chain(tasks.size(), 0.0);
+    std::vector<TaskId> order;
+    for (size_t task = 0; task < tasks.size(); ++task) {
+        waiting[task] = tasks[task].predecessors;
+        if (waiting[task] == 0) order.push_back((TaskId)task);
+    }
+    double longest = 0.0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        TaskId task = order[i];
+        chain[task] += taskTimings[task].seconds;
+        longest = std::max(longest, chain[task]);
+        for (TaskId successor : tasks[task].successors) {
+            chain[successor] = std::max(chain[successor], chain[task]);
+            if (--waiting[successor] == 0) order.push_back(successor);
+        }
+    }
+    return longest;
+}
+
+void TaskGraph::printTimings(std::ostream &out) const {
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    double work = 0.0;
+    for (const TaskTiming &timing : taskTimings) work += timing.seconds;
+    out << std::fixed << std::setprecision(1) << taskTimings.size() << " tasks in " << runSeconds * 1e3 << " ms: " << work * 1e3 << " ms of work, critical path "
+        << criticalPathSeconds() * 1e3 << " ms" << std::endl;
+    for (const TaskTiming &timing : taskTimings) {
+        out << "  " << std::left << std::setw(16) << timing.name << std::right << " worker " << std::setw(2) << timing.worker << "  start " << std::setw(8)
+            << timing.start * 1e3 << " ms  took " << std::setw(8) << timing.seconds * 1e3 << " ms" << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+TaskScheduler::TaskScheduler(ThreadPool &pool) : pool(pool) {
+    for (unsigned int i = 0; i < pool.size(); ++i) readyLists.push_back(std::make_unique<ReadyList>());
+}
+
+bool TaskScheduler::runOne(Run &run, int worker) {
+    Ready ready;
+    bool found = false;
+    if (worker == 0) {
+        std::lock_guard<std::mutex> lock(mainThreadReady.mutex);
+        found = takeReady(mainThreadReady.tasks, true, ready);
+    }
+    if (!found) {
+        std::lock_guard<std::mutex> lock(readyLists[worker]->mutex);
+        found = takeReady(readyLists[worker]->tasks, true, ready);
+    }
+    // Steal, starting from the next worker round so thieves spread over victims
+    for (size_t offset = 1; !found && offset < readyLists.size(); ++offset) {
+        ReadyList &victim = *readyLists[(worker + offset) % readyLists.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        found = takeReady(victim.tasks, false, ready);
+    }
+    if (!found) return false;
+
+    TaskTiming &timing = run.graph.taskTimings[ready.task];
+    timing.worker = worker;
+    timing.start = secondsSince(run.start);
+    const bool nested = insideTaskScheduler;
+    insideTaskScheduler = true;
+    run.graph.tasks[ready.task].work();
+    insideTaskScheduler = nested;
+    timing.seconds = secondsSince(run.start) - timing.start;
+    finish(run, ready.task, worker);
+    return true;
+}
+
+void TaskScheduler::finish(Run &run, TaskGraph::TaskId task, int worker) {
+    int shared = 0, forMain = 0;
+    for (TaskGraph::TaskId successor : run.graph.tasks[task].successors) {
+        if (run.waiting[successor].fetch_sub(1) != 1) continue;
+        const TaskGraph::Task &next = run.graph.tasks[successor];
+        Ready ready{successor, next.priority, run.order.fetch_add(1)};
+        if (next.affinity == TaskAffinity::MainThread) {
+            std::lock_guard<std::mutex> lock(mainThreadReady.mutex);
+            mainThreadReady.tasks.push_back(ready);
+            ++forMain;
+        } else {
+            std::lock_guard<std::mutex> lock(readyLists[worker]->mutex);
+            readyLists[worker]->tasks.push_back(ready);
+            ++shared;
+        }
+    }
+    bool last = run.remaining.fetch_sub(1) == 1;
+    // This thread goes on to one of the new tasks itself; only wake the others when there is more to share, work
+    // only the main thread can take, or nothing left at all
+    if (last || shared > 1 || (forMain > 0 && worker != 0) || (forMain > 0 && shared > 0)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++generation;
+        }
+        wake.notify_all();
+        pool.wakeHelpers();
+    }
+}
+
+void TaskScheduler::execute(TaskGraph &graph) {
+    std::lock_guard<std::mutex> runLock(runMutex);
+    Run run(graph);
+    if (graph.tasks.empty()) return;
+    for (size_t task = 0; task < graph.tasks.size(); ++task) {
+        if (graph.tasks[task].predecessors != 0) continue;
+        Ready ready{(TaskGraph::TaskId)task, graph.tasks[task].priority, run.order.fetch_add(1)};
+        ReadyList &list = graph.tasks[task].affinity == TaskAffinity::MainThread ? mainThreadReady : *readyLists[0];
+        list.tasks.push_back(ready);
+    }
+    unsigned long long seen;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        seen = generation;
+    }
+    // The pool's idle workers take tasks as helpers, numbered after the caller
+    pool.setHelper([this, &run](int worker) { return runOne(run, worker); });
+    while (true) {
+        if (runOne(run, 0)) continue;
+        std::unique_lock<std::mutex> lock(mutex);
+        if (run.remaining.load() == 0) break;
+        wake.wait(lock, [&] { return generation != seen || run.remaining.load() == 0; });
+        seen = generation;
+    }
+    // Workers may still be scanning the ready lists of this run
+    pool.setHelper(nullptr);
+}
+
+TaskScheduler &taskScheduler() {
+    static TaskScheduler scheduler(threadPool());
+    return scheduler;
+}
+
+namespace {
+
+// Roughly fixed amount of arithmetic standing in for a physics or decode stage
+double syntheticWork(int iterations) {
+    double x = 1.0;
+    for (int i = 0; i < iterations; ++i) x = std::sqrt(x + i);
+    return x;
+}
+
+} // namespace
+
+void benchmarkTaskGraph() {
+    // Four layers of 16 tasks, each depending on two tasks of the layer above, as in a diamond-shaped pipeline
+    const int layers = 4, width = 16, iterations = 200000;
+    std::vector<double> sink(layers * width);
+    TaskGraph graph;
+    for (int layer = 0; layer < layers; ++layer) {
+        for (int i = 0; i < width; ++i) {
+            std::vector<TaskGraph::TaskId> after;
+            if (layer > 0) after = {(layer - 1) * width + i, (layer - 1) * width + (i + 1) % width};
+            const int slot = layer * width + i;
+            graph.add("layer" + std::to_string(layer) + "." + std::to_string(i), [&sink, slot] { sink[slot] = syntheticWork(iterations); }, after, layers - layer);
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int slot = 0; slot < layers * width; ++slot) sink[slot] = syntheticWork(iterations);
+    double serialSeconds = secondsSince(start);
+    graph.run();
+
+    // Scheduling overhead: a long chain of empty tasks never wakes a worker
+    const int chainLength = 10000;
+    TaskGraph chain;
+    for (int i = 0; i < chainLength; ++i) chain.add("link", [] {}, i > 0 ? std::vector<TaskGraph::TaskId>{i - 1} : std::vector<TaskGraph::TaskId>{});
+    chain.run();
+
+    std::cout << "Task graph benchmark (" << taskScheduler().size() << " threads): " << layers * width << " tasks, serial " << std::fixed << std::setprecision(1)
+              << serialSeconds * 1e3 << " ms, graph " << graph.wallSeconds() * 1e3 << " ms (" << std::setprecision(2) << serialSeconds / graph.wallSeconds()
+              << "x), critical path " << std::setprecision(1) << graph.criticalPathSeconds() * 1e3 << " ms; " << std::setprecision(2)
+              << chain.wallSeconds() / chainLength * 1e6 << " us per chained empty task" << std::endl;
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <cmath>
+
+#include <core/thermalGrid.h>
+#include <core/threadPool.h>
+
+// The colormap runs from violet (cold) to red (hot) around the hue wheel
+constexpr float coldHue = 270.0f;
+
+// Hue in degrees of an RGB colour, negative when the colour is grey
+float pixelHue(float r, float g, float b) {
+    float maxC = std::max(r, std::max(g, b)), minC = std::min(r, std::min(g, b));
+    float chroma = maxC - minC;
+    if (chroma <= 0.0f) return -1.0f;
+    float hue;
+    if (maxC == r) hue = std::fmod((g - b) / chroma + 6.0f, 6.0f);
+    else if (maxC == g) hue = (b - r) / chroma + 2.0f;
+    else hue = (r - g) / chroma + 4.0f;
+    hue *= 60.0f;
+    // Magenta tints just past red wrap around to the hot end
+    if (hue > coldHue + 45.0f) hue = 0.0f;
+    return hue;
+}
+
+ThermalGrid decodeThermalImage(const unsigned char *pixels, int width, int height, int channels) {
+    ThermalGrid grid;
+    grid.width = width;
+    grid.height = height;
+    grid.values.assign((size_t)width * height, 0.0f);
+    grid.valid.assign((size_t)width * height, 0);
+    if (!pixels) return grid;
+    threadPool().parallelFor(0, height, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            for (int col = 0; col < width; ++col) {
+                size_t idx = (size_t)row * width + col;
+                const unsigned char *pix = pixels + idx * channels;
+                bool transparent = channels == 4 && pix[3] == 0;
+                bool black = pix[0] == 0 && pix[1] == 0 && pix[2] == 0;
+                float hue = pixelHue(pix[0], pix[1], pix[2]);
+                if (transparent || black || hue < 0.0f) continue;
+                float t = std::min(std::max((coldHue - hue) / coldHue, 0.0f), 1.0f);
+                grid.values[idx] = thermalMinKelvin + t * (thermalMaxKelvin - thermalMinKelvin);
+                grid.valid[idx] = 1;
+            }
+        }
+    }, 16);
+    return grid;
+}
+
+void encodeThermalImage(const ThermalGrid &grid, unsigned char *pixels, int channels) {
+    if (!pixels) return;
+    threadPool().parallelFor(0, grid.height, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            for (int col = 0; col < grid.width; ++col) {
+                size_t idx = (size_t)row * grid.width + col;
+                unsigned char *pix = pixels + idx * channels;
+                if (!grid.valid[idx]) {
+                    for (int c = 0; c < channels; ++c) pix[c] = 0;
+                    continue;
+                }
+                float t = (grid.values[idx] - thermalMinKelvin) / (thermalMaxKelvin - thermalMinKelvin);
+                float hue = (1.0f - std::min(std::max(t, 0.0f), 1.0f)) * coldHue / 60.0f;
+                float x = 1.0f - std::fabs(std::fmod(hue, 2.0f) - 1.0f);
+                float r = 0.0f, g = 0.0f, b = 0.0f;
+                switch ((int)hue) {
+                    case 0: r = 1.0f; g = x; break;
+                    case 1: r = x; g = 1.0f; break;
+                    case 2: g = 1.0f; b = x; break;
+                    case 3: g = x; b = 1.0f; break;
+                    default: r = x; b = 1.0f; break;
+                }
+                pix[0] = (unsigned char)(r * 255.0f + 0.5f);
+                pix[1] = (unsigned char)(g * 255.0f + 0.5f);
+                pix[2] = (unsigned char)(b * 255.0f + 0.5f);
+                if (channels == 4) pix[3] = 255;
+            }
+        }
+    }, 16);
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include <algorithm>
+
+#include <core/threadPool.h>
+
+// Set on pool workers (and on callers while they help) so nested parallelFor calls run inline
+thread_local bool insidePool = false;
+
+struct ThreadPool::Job {
+    const std::function<void(int, int)> *body;
+    int begin;
+    int blockSize;
+    int numBlocks;
+    int end;
+    std::atomic<int> nextBlock{0};
+    std::atomic<int> remaining{0};
+    std::mutex *mutex;
+    std::condition_variable *done;
+};
+
+ThreadPool::ThreadPool(unsigned int numThreads) {
+    // The calling thread always helps, so spawn one fewer worker
+    if (numThreads == 0) numThreads = 1;
+    for (unsigned int i = 1; i < numThreads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, (int)i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers) worker.join();
+}
+
+unsigned int ThreadPool::size() const {
+    return (unsigned int)workers.size() + 1;
+}
+
+void ThreadPool::runBlocks(Job &job) {
+    while (true) {
+        int block = job.nextBlock.fetch_add(1);
+        if (block >= job.numBlocks) return;
+        int blockBegin = job.begin + block * job.blockSize;
+        int blockEnd = std::min(job.end, blockBegin + job.blockSize);
+        (*job.body)(blockBegin, blockEnd);
+        if (job.remaining.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(*job.mutex);
+            job.done->notify_all();
+        }
+    }
+}
+
+std::shared_ptr<ThreadPool::Job> ThreadPool::claimableJob() {
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](const std::shared_ptr<Job> &job) { return job->nextBlock.load() >= job->numBlocks; }),
+               jobs.end());
+    return jobs.empty() ? nullptr : jobs.front();
+}
+
+void ThreadPool::workerLoop(int worker) {
+    insidePool = true;
+    unsigned long long seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        // parallelFor blocks first: their callers are waiting on them
+        if (std::shared_ptr<Job> job = claimableJob()) {
+            lock.unlock();
+            runBlocks(*job);
+            lock.lock();
+            continue;
+        }
+        seen = generation;
+        if (helper) {
+            std::function<bool(int)> help = helper;
+            ++activeHelpers;
+            lock.unlock();
+            // Helper work is a task graph's: let its tasks spread their own parallelFor calls over the idle workers
+            insidePool = false;
+            bool ran = false;
+            while (help(worker)) ran = true;
+            insidePool = true;
+            lock.lock();
+            if (--activeHelpers == 0) helperIdle.notify_all();
+            if (ran) continue;
+        }
+        // Nothing changed since the last look: sleep until something does
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int)> &body, int grain) {
+    if (end <= begin) return;
+    int count = end - begin;
+    grain = std::max(grain, 1);
+    // A few blocks per thread smooths out uneven rows without much scheduling overhead
+    int numBlocks = std::min((count + grain - 1) / grain, (int)size() * 4);
+    if (workers.empty() || insidePool || numBlocks <= 1) {
+        body(begin, end);
+        return;
+    }
+    auto job = std::make_shared<Job>();
+    job->body = &body;
+    job->begin = begin;
+    job->end = end;
+    job->blockSize = (count + numBlocks - 1) / numBlocks;
+    job->numBlocks = (count + job->blockSize - 1) / job->blockSize;
+    job->remaining = job->numBlocks;
+    job->mutex = &mutex;
+    job->done = &done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(job);
+        ++generation;
+    }
+    wake.notify_all();
+    insidePool = true;
+    runBlocks(*job);
+    insidePool = false;
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return job->remaining.load() == 0; });
+}
+
+void ThreadPool::setHelper(std::function<bool(int)> newHelper) {
+    std::unique_lock<std::mutex> lock(mutex);
+    helper = std::move(newHelper);
+    if (!helper) {
+        helperIdle.wait(lock, [&] { return activeHelpers == 0; });
+        return;
+    }
+    ++generation;
+    lock.unlock();
+    wake.notify_all();
+}
+
+void ThreadPool::wakeHelpers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++generation;
+    }
+    wake.notify_all();
+}
+
+ThreadPool &threadPool() {
+    static ThreadPool pool;
+    return pool;
+}
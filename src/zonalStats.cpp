@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <utility>
+
+#include <core/zonalStats.h>
+#include <core/threadPool.h>
+
+constexpr double zonalPi = 3.14159265358979323846;
+constexpr double earthRadiusKm = 6371.0;
+constexpr int histogramBins = 1024;
+
+LabelGrid makeLabelGrid(int width, int height) {
+    LabelGrid grid;
+    grid.width = width;
+    grid.height = height;
+    grid.labels.assign((size_t)width * height, 0);
+    return grid;
+}
+
+void rasterizePolygons(LabelGrid &grid, const std::vector<RegionPolygon> &polygons) {
+    // Latitude extent of each polygon lets rows skip regions they cannot touch
+    std::vector<std::pair<double, double>> extents;
+    for (const auto &polygon : polygons) {
+        grid.numLabels = std::max(grid.numLabels, polygon.id + 1);
+        double south = 90.0, north = -90.0;
+        for (const auto &vertex : polygon.vertices) {
+            south = std::min(south, vertex.latitude);
+            north = std::max(north, vertex.latitude);
+        }
+        extents.emplace_back(south, north);
+    }
+    threadPool().parallelFor(0, grid.height, [&](int rowBegin, int rowEnd) {
+        std::vector<double> crossings;
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            double latitude = 90.0 - (row + 0.5) / grid.height * 180.0;
+            unsigned int *rowLabels = grid.labels.data() + (size_t)row * grid.width;
+            for (size_t p = 0; p < polygons.size(); ++p) {
+                if (latitude < extents[p].first || latitude > extents[p].second) continue;
+                const RegionPolygon &polygon = polygons[p];
+                // Longitudes where the polygon's edges cross this row's centre line
+                crossings.clear();
+                size_t numVertices = polygon.vertices.size();
+                for (size_t i = 0; i < numVertices; ++i) {
+                    const Coords &a = polygon.vertices[i], &b = polygon.vertices[(i + 1) % numVertices];
+                    if ((a.latitude > latitude) == (b.latitude > latitude)) continue;
+                    double t = (latitude - a.latitude) / (b.latitude - a.latitude);
+                    crossings.push_back(a.longitude + t * (b.longitude - a.longitude));
+                }
+                std::sort(crossings.begin(), crossings.end());
+                for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+                    int colBegin = (int)std::ceil((crossings[i] + 180.0) / 360.0 * grid.width - 0.5);
+                    int colEnd = (int)std::ceil((crossings[i + 1] + 180.0) / 360.0 * grid.width - 0.5);
+                    colEnd = std::min(colEnd, colBegin + grid.width);
+                    for (int col = colBegin; col < colEnd; ++col) {
+                        rowLabels[((col % grid.width) + grid.width) % grid.width] = polygon.id;
+                    }
+                }
+            }
+        }
+    }, 8);
+}
+
+void rasterizeRings(LabelGrid &grid, Coords centre, double ringWidthKm, int numRings, unsigned int firstId) {
+    if (numRings <= 0) return;
+    grid.numLabels = std::max(grid.numLabels, firstId + (unsigned int)numRings);
+    double lat0 = centre.latitude * zonalPi / 180.0, lon0 = centre.longitude * zonalPi / 180.0;
+    threadPool().parallelFor(0, grid.height, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            double lat = zonalPi / 2.0 - (row + 0.5) / grid.height * zonalPi;
+            double sinHalfLat = std::sin((lat - lat0) / 2.0), cosProduct = std::cos(lat) * std::cos(lat0);
+            for (int col = 0; col < grid.width; ++col) {
+                double lon = (col + 0.5) / grid.width * 2.0 * zonalPi - zonalPi;
+                double sinHalfLon = std::sin((lon - lon0) / 2.0);
+                double haversine = sinHalfLat * sinHalfLat + cosProduct * sinHalfLon * sinHalfLon;
+                double distanceKm = 2.0 * earthRadiusKm * std::asin(std::sqrt(std::min(haversine, 1.0)));
+                int ring = (int)(distanceKm / ringWidthKm);
+                if (ring < numRings) grid.labels[(size_t)row * grid.width + col] = firstId + ring;
+            }
+        }
+    }, 8);
+}
+
+// Running sums for one region within one chunk of rows
+struct ZonalAccumulator {
+    size_t count = 0;
+    double weight = 0.0;
+    double sum = 0.0;
+    float min = std::numeric_limits<float>::max();
+    float max = std::numeric_limits<float>::lowest();
+};
+
+// Partial results of one chunk; histograms are only allocated for regions the chunk touches
+struct ZonalPartial {
+    std::vector<ZonalAccumulator> accumulators;
+    std::vector<std::vector<float>> histograms;
+};
+
+std::vector<ZonalStats> computeZonalStats(const ThermalGrid &grid, const LabelGrid &labels, const std::vector<float> &percentiles, ThreadPool &pool) {
+    const unsigned int numLabels = labels.numLabels;
+    std::vector<ZonalStats> stats(numLabels);
+    if (grid.width != labels.width || grid.height != labels.height) return stats;
+    const float binScale = histogramBins / (thermalMaxKelvin - thermalMinKelvin);
+
+    // One partial per chunk of rows, so a chunk is only ever written by a single worker
+    const int numChunks = std::min((int)pool.size() * 2, std::max(grid.height, 1));
+    std::vector<ZonalPartial> partials(numChunks);
+    std::vector<double> rowWeights(grid.height);
+    for (int row = 0; row < grid.height; ++row) {
+        rowWeights[row] = std::cos(zonalPi / 2.0 - (row + 0.5) / grid.height * zonalPi);
+    }
+    pool.parallelFor(0, numChunks, [&](int chunkBegin, int chunkEnd) {
+        for (int chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+            ZonalPartial &partial = partials[chunk];
+            partial.accumulators.resize(numLabels);
+            partial.histograms.resize(numLabels);
+            int rowBegin = (int)((long long)grid.height * chunk / numChunks);
+            int rowEnd = (int)((long long)grid.height * (chunk + 1) / numChunks);
+            for (int row = rowBegin; row < rowEnd; ++row) {
+                float rowWeight = (float)rowWeights[row];
+                size_t rowOffset = (size_t)row * grid.width;
+                for (int col = 0; col < grid.width; ++col) {
+                    size_t idx = rowOffset + col;
+                    unsigned int label = labels.labels[idx];
+                    if (label == 0 || label >= numLabels || !grid.valid[idx]) continue;
+                    float value = grid.values[idx];
+                    ZonalAccumulator &acc = partial.accumulators[label];
+                    ++acc.count;
+                    acc.weight += rowWeight;
+                    acc.sum += (double)rowWeight * value;
+                    acc.min = std::min(acc.min, value);
+                    acc.max = std::max(acc.max, value);
+                    auto &histogram = partial.histograms[label];
+                    if (histogram.empty()) histogram.assign(histogramBins, 0.0f);
+                    int bin = (int)((value - thermalMinKelvin) * binScale);
+                    histogram[std::min(std::max(bin, 0), histogramBins - 1)] += rowWeight;
+                }
+            }
+        }
+    });
+
+    // Merge chunks in a fixed order, one region per task
+    double totalWeight = 0.0;
+    for (int row = 0; row < grid.height; ++row) totalWeight += rowWeights[row] * grid.width;
+    pool.parallelFor(1, (int)numLabels, [&](int labelBegin, int labelEnd) {
+        std::vector<float> histogram(histogramBins);
+        for (int label = labelBegin; label < labelEnd; ++label) {
+            ZonalAccumulator total;
+            std::fill(histogram.begin(), histogram.end(), 0.0f);
+            for (const auto &partial : partials) {
+                const ZonalAccumulator &acc = partial.accumulators[label];
+                if (acc.count == 0) continue;
+                total.count += acc.count;
+                total.weight += acc.weight;
+                total.sum += acc.sum;
+                total.min = std::min(total.min, acc.min);
+                total.max = std::max(total.max, acc.max);
+                const auto &partialHistogram = partial.histograms[label];
+                for (int bin = 0; bin < histogramBins; ++bin) histogram[bin] += partialHistogram[bin];
+            }
+            if (total.count == 0) continue;
+            ZonalStats &region = stats[label];
+            region.count = total.count;
+            region.area = total.weight / totalWeight;
+            region.mean = (float)(total.sum / total.weight);
+            region.min = total.min;
+            region.max = total.max;
+            // Walk the cumulative histogram, interpolating within the bin that crosses each target
+            for (float fraction : percentiles) {
+                double target = std::min(std::max((double)fraction, 0.0), 1.0) * total.weight, cumulative = 0.0;
+                float value = total.max;
+                for (int bin = 0; bin < histogramBins; ++bin) {
+                    if (histogram[bin] <= 0.0f) continue;
+                    if (cumulative + histogram[bin] >= target) {
+                        float within = (float)((target - cumulative) / histogram[bin]);
+                        value = thermalMinKelvin + (bin + within) / binScale;
+                        break;
+                    }
+                    cumulative += histogram[bin];
+                }
+                region.percentiles.push_back(std::min(std::max(value, total.min), total.max));
+            }
+        }
+    }, 16);
+    return stats;
+}
+
+void benchmarkZonalStats() {
+    const int width = 2048, height = 1024, numPolygons = 4000, numRings = 50, repeats = 3;
+    const std::vector<float> percentiles{0.1f, 0.5f, 0.9f};
+    std::mt19937 rng(28);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    // Smooth temperatures with small-scale texture, and rectangular cloud gaps over about a fifth of the pixels
+    ThermalGrid grid;
+    grid.width = width;
+    grid.height = height;
+    grid.values.resize((size_t)width * height);
+    grid.valid.resize(grid.values.size());
+    for (int row = 0; row < height; ++row) {
+        double lat = zonalPi / 2.0 - (row + 0.5) / height * zonalPi;
+        for (int col = 0; col < width; ++col) {
+            double lon = (col + 0.5) / width * 2.0 * zonalPi - zonalPi;
+            size_t idx = (size_t)row * width + col;
+            grid.values[idx] = (float)(300.0 - 50.0 * std::sin(lat) * std::sin(lat) + 6.0 * std::sin(7.0 * lon) * std::cos(5.0 * lat) + 3.0 * std::sin(0.7 * col + 0.3 * row));
+            grid.valid[idx] = (row / 23 * 7 + col / 41 * 3) % 5 != 0;
+        }
+    }
+
+    // Star-shaped polygons of 5-9 vertices and 0.5-3 degrees, uniform over the sphere away from the poles;
+    // some cross the antimeridian, and later ones overlap earlier ones
+    std::vector<RegionPolygon> polygons(numPolygons);
+    for (int p = 0; p < numPolygons; ++p) {
+        double lat = std::asin((2.0 * uniform(rng) - 1.0) * 0.98) * 180.0 / zonalPi, lon = uniform(rng) * 360.0 - 180.0;
+        double radius = 0.5 + 2.5 * uniform(rng);
+        int numVertices = 5 + (int)(uniform(rng) * 5.0);
+        polygons[p].id = p + 1;
+        for (int v = 0; v < numVertices; ++v) {
+            double angle = 2.0 * zonalPi * (v + 0.8 * uniform(rng)) / numVertices, r = radius * (0.6 + 0.4 * uniform(rng));
+            polygons[p].vertices.push_back({lat + r * std::sin(angle), lon + r * std::cos(angle) / std::cos(lat * zonalPi / 180.0)});
+        }
+    }
+    LabelGrid labels = makeLabelGrid(width, height);
+    auto start = std::chrono::steady_clock::now();
+    rasterizePolygons(labels, polygons);
+    rasterizeRings(labels, Coords{43.45, -79.68}, 100.0, numRings, numPolygons + 1);
+    const double rasterizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Serial reference: each region's pixels gathered, then sorted for exact area-weighted percentiles
+    start = std::chrono::steady_clock::now();
+    std::vector<std::vector<std::pair<float, float>>> regionPixels(labels.numLabels);
+    for (int row = 0; row < height; ++row) {
+        float weight = (float)std::cos(zonalPi / 2.0 - (row + 0.5) / height * zonalPi);
+        for (int col = 0; col < width; ++col) {
+            size_t idx = (size_t)row * width + col;
+            if (labels.labels[idx] != 0 && grid.valid[idx]) regionPixels[labels.labels[idx]].emplace_back(grid.values[idx], weight);
+        }
+    }
+    std::vector<ZonalStats> reference(labels.numLabels);
+    for (unsigned int label = 1; label < labels.numLabels; ++label) {
+        auto &pixels = regionPixels[label];
+        if (pixels.empty()) continue;
+        ZonalStats &region = reference[label];
+        double sum = 0.0, weight = 0.0;
+        region.min = std::numeric_limits<float>::max();
+        region.max = std::numeric_limits<float>::lowest();
+        for (const auto &pixel : pixels) {
+            sum += (double)pixel.second * pixel.first;
+            weight += pixel.second;
+            region.min = std::min(region.min, pixel.first);
+            region.max = std::max(region.max, pixel.first);
+        }
+        region.count = pixels.size();
+        region.mean = (float)(sum / weight);
+        std::sort(pixels.begin(), pixels.end());
+        for (float fraction : percentiles) {
+            double target = fraction * weight, cumulative = 0.0;
+            size_t i = 0;
+            while (i + 1 < pixels.size() && cumulative + pixels[i].second < target) cumulative += pixels[i++].second;
+            region.percentiles.push_back(pixels[i].first);
+        }
+    }
+    const double serialMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<ZonalStats> stats = computeZonalStats(grid, labels, percentiles);
+    size_t regions = 0, countMismatches = 0, extremeMismatches = 0;
+    double meanError = 0.0, percentileError = 0.0;
+    for (unsigned int label = 1; label < labels.numLabels; ++label) {
+        if (reference[label].count == 0 && stats[label].count == 0) continue;
+        ++regions;
+        if (stats[label].count != reference[label].count) {
+            ++countMismatches;
+            continue;
+        }
+        if (stats[label].min != reference[label].min || stats[label].max != reference[label].max) ++extremeMismatches;
+        meanError = std::max(meanError, (double)std::abs(stats[label].mean - reference[label].mean));
+        for (size_t k = 0; k < percentiles.size(); ++k) {
+            percentileError = std::max(percentileError, (double)std::abs(stats[label].percentiles[k] - reference[label].percentiles[k]));
+        }
+    }
+
+    std::cout << "Zonal statistics benchmark, " << width << "x" << height << " grid, " << numPolygons << " polygons + " << numRings << " rings ("
+              << regions << " regions with observations)" << std::endl;
+    std::cout << "  rasterise " << std::fixed << std::setprecision(1) << rasterizeMs << " ms, serial per-region pass " << serialMs << " ms" << std::endl;
+    std::cout << "  vs serial: " << countMismatches << " count and " << extremeMismatches << " min/max mismatches, max mean error " << std::scientific
+              << std::setprecision(2) << meanError << " K, max percentile error " << std::fixed << std::setprecision(3) << percentileError << " K (bins "
+              << (thermalMaxKelvin - thermalMinKelvin) / histogramBins << " K)" << std::endl;
+    double oneThread = 0.0;
+    for (unsigned int threads : {1u, 2u, 4u, 8u}) {
+        ThreadPool pool(threads);
+        double best = 1e300;
+        for (int repeat = 0; repeat < repeats; ++repeat) {
+            start = std::chrono::steady_clock::now();
+            computeZonalStats(grid, labels, percentiles, pool);
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        if (threads == 1) oneThread = best;
+        std::cout << "  " << threads << " threads " << std::setprecision(1) << std::setw(7) << best << " ms, " << std::setprecision(2) << oneThread / best
+                  << "x, " << std::setprecision(0) << (double)width * height / best * 1e-3 << " Mpixel/s" << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}